@@ -49,6 +49,7 @@
 #include "osi/include/socket_utils/sockets.h"
 
 #include "audio_a2dp_hw.h"
+#include "uipc_ring.h"
 
 /*****************************************************************************
  *  Constants & Macros
@@ -125,6 +126,9 @@ struct a2dp_stream_common {
   size_t buffer_sz;
   struct a2dp_config cfg;
   a2dp_state_t state;
+  bool use_ring;    // A ring is offered to the stack when connecting
+  tUIPC_RING ring;  // Attached once acknowledged, then written instead of
+                    // |audio_fd|. Only unmapped by the writing thread.
 };
 
 struct a2dp_stream_out {
@@ -332,6 +336,56 @@ static int skt_write(int fd, const void* p, size_t len) {
   return (int)count;
 }
 
+static int ring_write(tUIPC_RING* ring, int fd, const void* p, size_t len) {
+  FNLOG();
+
+  ts_log("ring_write", len, NULL);
+
+  size_t count = 0;
+  while (count < len) {
+    count += uipc_ring_write(ring, (const uint8_t*)p + count, len - count);
+    if (count == len) break;
+
+    // wait for the stack to consume, or to close the audio socket
+    if (uipc_ring_wait_space(ring, fd, SOCK_SEND_TIMEOUT_MS) <= 0) {
+      WARN("write timeout or stream closed, sent %zu bytes", count);
+      return -1;
+    }
+  }
+  return (int)count;
+}
+
+// Sets up the shared memory ring on a newly connected audio socket. When the
+// ring can't be created the stack is told to keep reading from the socket.
+// The ring is only used once the stack acknowledged attaching it, it may
+// reject it, e.g. when the policy does not let it receive our fds.
+static int ring_connect(struct a2dp_stream_common* common) {
+  uipc_ring_close(&common->ring);
+  if (!uipc_ring_create(&common->ring, common->buffer_sz))
+    WARN("can't create audio ring, using the socket");
+
+  if (!uipc_ring_send_setup(common->audio_fd, &common->ring)) {
+    uipc_ring_close(&common->ring);
+    return -1;
+  }
+
+  int ret = uipc_ring_recv_ack(common->audio_fd, &common->ring,
+                               SOCK_SEND_TIMEOUT_MS);
+  if (ret < 0) {
+    uipc_ring_close(&common->ring);
+    return -1;
+  }
+  if (ret == 0) {
+    if (uipc_ring_is_attached(&common->ring))
+      WARN("audio ring rejected by the stack, using the socket");
+    uipc_ring_close(&common->ring);
+    return 0;
+  }
+
+  INFO("audio ring of %u bytes", common->ring.size);
+  return 0;
+}
+
 static int skt_disconnect(int fd) {
   INFO("fd %d", fd);
 
@@ -834,6 +888,8 @@ static void a2dp_stream_common_init(struct a2dp_stream_common* common) {
   common->ctrl_fd = AUDIO_SKT_DISCONNECTED;
   common->audio_fd = AUDIO_SKT_DISCONNECTED;
   common->state = AUDIO_A2DP_STATE_STOPPED;
+  common->use_ring = false;
+  uipc_ring_init(&common->ring);
 
   /* manages max capacity of socket pipe */
   common->buffer_sz = AUDIO_STREAM_OUTPUT_BUFFER_SZ;
@@ -844,6 +900,8 @@ static void a2dp_stream_common_destroy(struct a2dp_stream_common* common) {
 
   delete common->mutex;
   common->mutex = NULL;
+
+  uipc_ring_close(&common->ring);
 }
 
 static int start_audio_datapath(struct a2dp_stream_common* common) {
@@ -868,6 +926,12 @@ static int start_audio_datapath(struct a2dp_stream_common* common) {
       ERROR("Audiopath start failed - error opening data socket");
       goto error;
     }
+    if (common->use_ring && ring_connect(common) < 0) {
+      ERROR("Audiopath start failed - error setting up audio ring");
+      skt_disconnect(common->audio_fd);
+      common->audio_fd = AUDIO_SKT_DISCONNECTED;
+      goto error;
+    }
   }
   common->state = (a2dp_state_t)AUDIO_A2DP_STATE_STARTED;
 
@@ -971,8 +1035,14 @@ static ssize_t out_write(struct audio_stream_out* stream, const void* buffer,
           out->common.audio_fd);
   }
 
+  // The ring is only remapped by start_audio_datapath() above, from this
+  // thread, so it stays valid while the lock is released.
   lock.unlock();
-  sent = skt_write(out->common.audio_fd, buffer, write_bytes);
+  if (uipc_ring_is_attached(&out->common.ring))
+    sent = ring_write(&out->common.ring, out->common.audio_fd, buffer,
+                      write_bytes);
+  else
+    sent = skt_write(out->common.audio_fd, buffer, write_bytes);
   lock.lock();
 
   if (sent == -1) {
@@ -1628,6 +1698,7 @@ static int adev_open_output_stream(struct audio_hw_device* dev,
 
   /* initialize a2dp specifics */
   a2dp_stream_common_init(&out->common);
+  out->common.use_ring = true;
 
   // Make sure we always have the feeding parameters configured
   btav_a2dp_codec_config_t codec_config;
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include "gatt/database_builder.h"
+#include "gatt/database_store.h"
+
+using ::benchmark::State;
+using bluetooth::Uuid;
+using gatt::Database;
+using gatt::DatabaseBuilder;
+using gatt::DatabaseHash;
+using gatt::DatabaseStore;
+using gatt::StoredAttribute;
+
+static const RawAddress kAddress({0x00, 0x11, 0x22, 0x33, 0x44, 0x55});
+
+// A server with |num_services| services of ten characteristics, each with a
+// client configuration descriptor.
+static std::vector<StoredAttribute> build_attributes(int num_services) {
+  DatabaseBuilder builder;
+  uint16_t handle = 1;
+  for (int i = 0; i < num_services; i++) {
+    builder.AddService(handle, handle + 30, Uuid::From16Bit(0x1800 + i), true);
+    for (int j = 0; j < 10; j++) {
+      uint16_t decl = handle + 1 + j * 3;
+      builder.AddCharacteristic(decl, decl + 1,
+                                Uuid::From32Bit(0x12340000 + i * 16 + j), 0x12);
+      builder.AddDescriptor(decl + 2, Uuid::From16Bit(0x2902));
+    }
+    handle += 31;
+  }
+  return builder.Build().Serialize();
+}
+
+class CacheDirectory {
+ public:
+  CacheDirectory() {
+    char tmpl[] = "/tmp/gatt_cache_benchmark_XXXXXX";
+    path_ = std::string(mkdtemp(tmpl)) + "/";
+  }
+  ~CacheDirectory() {
+    DIR* dir = opendir(path_.c_str());
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') unlink((path_ + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path_.c_str());
+  }
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+// The previous cache format: one file per server holding a version, the
+// number of attributes and the attributes, read back into a vector.
+static void write_address_keyed(const std::string& fname,
+                                const std::vector<StoredAttribute>& attr) {
+  FILE* fd = fopen(fname.c_str(), "wb");
+  uint16_t version = 5, num_attr = attr.size();
+  fwrite(&version, sizeof(version), 1, fd);
+  fwrite(&num_attr, sizeof(num_attr), 1, fd);
+  fwrite(attr.data(), sizeof(StoredAttribute), attr.size(), fd);
+  fclose(fd);
+}
+
+static bool load_address_keyed(const std::string& fname, Database* p_db) {
+  FILE* fd = fopen(fname.c_str(), "rb");
+  if (!fd) return false;
+  uint16_t version = 0, num_attr = 0;
+  bool success = fread(&version, sizeof(version), 1, fd) == 1 &&
+                 fread(&num_attr, sizeof(num_attr), 1, fd) == 1;
+  std::vector<StoredAttribute> attr(num_attr);
+  success = success && fread(attr.data(), sizeof(StoredAttribute), num_attr,
+                             fd) == num_attr;
+  fclose(fd);
+  if (success) *p_db = Database::Deserialize(attr, &success);
+  return success;
+}
+
+// Reconnection to a bonded server with the previous format
+static void BM_GattCacheLoadRead(State& state) {
+  CacheDirectory dir;
+  std::string fname = dir.path() + "gatt_cache_legacy";
+  write_address_keyed(fname, build_attributes(state.range(0)));
+
+  for (auto _ : state) {
+    Database db;
+    if (!load_address_keyed(fname, &db)) {
+      state.SkipWithError("load failed");
+      return;
+    }
+    benchmark::DoNotOptimize(db);
+  }
+}
+BENCHMARK(BM_GattCacheLoadRead)->Arg(1)->Arg(10)->Arg(50);
+
+// Reconnection to a bonded server, database file already mapped
+static void BM_GattCacheLoadMapped(State& state) {
+  CacheDirectory dir;
+  DatabaseStore store(dir.path());
+  std::vector<StoredAttribute> attr = build_attributes(state.range(0));
+  store.Store(kAddress, DatabaseStore::ComputeHash(attr), attr);
+
+  for (auto _ : state) {
+    Database db;
+    DatabaseHash hash;
+    if (!store.LoadByAddress(kAddress, &db, &hash)) {
+      state.SkipWithError("load failed");
+      return;
+    }
+    benchmark::DoNotOptimize(db);
+  }
+}
+BENCHMARK(BM_GattCacheLoadMapped)->Arg(1)->Arg(10)->Arg(50);
+
+// First server of a known model: Database Hash lookup instead of discovery
+static void BM_GattCacheLoadByHash(State& state) {
+  CacheDirectory dir;
+  std::vector<StoredAttribute> attr = build_attributes(state.range(0));
+  DatabaseHash hash = DatabaseStore::ComputeHash(attr);
+  DatabaseStore(dir.path()).Store(kAddress, hash, attr);
+
+  for (auto _ : state) {
+    DatabaseStore store(dir.path());
+    Database db;
+    if (!store.LoadByHash(hash, &db)) {
+      state.SkipWithError("load failed");
+      return;
+    }
+    benchmark::DoNotOptimize(db);
+  }
+}
+BENCHMARK(BM_GattCacheLoadByHash)->Arg(1)->Arg(10)->Arg(50);
+
+// Storing after a discovery
+static void BM_GattCacheStore(State& state) {
+  CacheDirectory dir;
+  std::vector<StoredAttribute> attr = build_attributes(state.range(0));
+
+  for (auto _ : state) {
+    DatabaseStore store(dir.path());
+    store.Store(kAddress, DatabaseStore::ComputeHash(attr), attr);
+    state.PauseTiming();
+    store.Unlink(kAddress);
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_GattCacheStore)->Arg(1)->Arg(10)->Arg(50);
+
+BENCHMARK_MAIN();
@@ -657,8 +657,8 @@ void bta_gattc_start_discover(tBTA_GATTC_CLCB* p_clcb,
       bta_gattc_set_discover_st(p_clcb->p_srcb);
 
       bta_gattc_init_cache(p_clcb->p_srcb);
-      p_clcb->status = bta_gattc_discover_pri_service(
-          p_clcb->bta_conn_id, p_clcb->p_srcb, GATT_DISC_SRVC_ALL);
+      p_clcb->status =
+          bta_gattc_discover_db_hash(p_clcb->bta_conn_id, p_clcb->p_srcb);
       if (p_clcb->status != GATT_SUCCESS) {
         LOG(ERROR) << "discovery on server failed";
         bta_gattc_reset_discover_st(p_clcb->p_srcb, p_clcb->status);
@@ -687,6 +687,7 @@ void bta_gattc_disc_cmpl(tBTA_GATTC_CLCB* p_clcb,
   if (p_clcb->transport == BTA_TRANSPORT_LE)
     L2CA_EnableUpdateBleConnParams(p_clcb->p_srcb->server_bda, true);
   p_clcb->p_srcb->state = BTA_GATTC_SERV_IDLE;
+  p_clcb->p_srcb->db_hash_pending = false;
   p_clcb->disc_active = false;
 
   if (p_clcb->status != GATT_SUCCESS) {
@@ -1305,6 +1306,13 @@ static void bta_gattc_cmpl_cback(uint16_t conn_id, tGATTC_OPTYPE op,
     bta_sys_idle(BTA_ID_GATTC, BTA_ALL_APP_ID, p_clcb->bda);
   }
 
+  /* Database Hash read issued by the discovery this clcb started */
+  if (op == GATTC_OPTYPE_READ && p_clcb->disc_active &&
+      p_clcb->p_srcb->db_hash_pending) {
+    bta_gattc_db_hash_read_cmpl(p_clcb, status, p_data);
+    return;
+  }
+
   bta_gattc_cmpl_sendmsg(conn_id, op, status, p_data);
 }
 
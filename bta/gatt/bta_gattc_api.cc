@@ -738,3 +738,16 @@ void BTA_GATTC_Refresh(const RawAddress& remote_bda) {
   do_in_main_thread(FROM_HERE,
                     base::Bind(&bta_gattc_process_api_refresh, remote_bda));
 }
+
+/*******************************************************************************
+ *
+ * Function         BTA_GATTC_DebugDump
+ *
+ * Description      Dump the GATT client discovery statistics.
+ *
+ * Parameters       fd: file descriptor to dump to.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void BTA_GATTC_DebugDump(int fd) { bta_gattc_debug_dump(fd); }
@@ -31,6 +31,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 
 #include "bt_common.h"
@@ -39,8 +41,10 @@
 #include "btm_api.h"
 #include "btm_ble_api.h"
 #include "btm_int.h"
+#include "common/time_util.h"
 #include "database.h"
 #include "database_builder.h"
+#include "database_store.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "sdp_api.h"
@@ -52,12 +56,14 @@ using bluetooth::Uuid;
 using gatt::Characteristic;
 using gatt::Database;
 using gatt::DatabaseBuilder;
+using gatt::DatabaseHash;
+using gatt::DatabaseStore;
 using gatt::Descriptor;
 using gatt::IncludedService;
 using gatt::Service;
 using gatt::StoredAttribute;
 
-static void bta_gattc_cache_write(const RawAddress& server_bda,
+static void bta_gattc_cache_write(tBTA_GATTC_SERV* p_srcb,
                                   const std::vector<StoredAttribute>& attr);
 static tGATT_STATUS bta_gattc_sdp_service_disc(uint16_t conn_id,
                                                tBTA_GATTC_SERV* p_server_cb);
@@ -70,14 +76,27 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
 
 #define BTA_GATT_SDP_DB_SIZE 4096
 
-#define GATT_CACHE_PREFIX "/data/misc/bluetooth/gatt_cache_"
-#define GATT_CACHE_VERSION 5
-
-static void bta_gattc_generate_cache_file_name(char* buffer, size_t buffer_len,
-                                               const RawAddress& bda) {
-  snprintf(buffer, buffer_len, "%s%02x%02x%02x%02x%02x%02x", GATT_CACHE_PREFIX,
-           bda.address[0], bda.address[1], bda.address[2], bda.address[3],
-           bda.address[4], bda.address[5]);
+#define GATT_CACHE_DIRECTORY "/data/misc/bluetooth/"
+
+/* Discovery statistics, see bta_gattc_debug_dump(). Only updated on the BTA
+ * thread, but dumped from another one. */
+static struct {
+  /* discoveries completed, and those skipped for a known Database Hash */
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> by_hash;
+  /* time from start to completion */
+  std::atomic<uint64_t> total_ms;
+  std::atomic<uint64_t> max_ms;
+  /* ATT discovery requests */
+  std::atomic<uint64_t> total_requests;
+  std::atomic<uint32_t> max_requests;
+} bta_gattc_disc_stats;
+
+/* GATT client caches of bonded servers, shared by servers with identical
+ * databases */
+static DatabaseStore& bta_gattc_cache_store() {
+  static DatabaseStore* store = new DatabaseStore(GATT_CACHE_DIRECTORY);
+  return *store;
 }
 
 /*****************************************************************************
@@ -144,6 +163,84 @@ tGATT_STATUS bta_gattc_discover_pri_service(uint16_t conn_id,
   return bta_gattc_sdp_service_disc(conn_id, p_server_cb);
 }
 
+/** Start discovery by reading the GATT Database Hash of the server. A server
+ * whose database is already cached, possibly for another server of the same
+ * model, needs no further discovery. */
+tGATT_STATUS bta_gattc_discover_db_hash(uint16_t conn_id,
+                                        tBTA_GATTC_SERV* p_server_cb) {
+  tBTA_GATTC_CLCB* p_clcb = bta_gattc_find_clcb_by_conn_id(conn_id);
+  if (!p_clcb) return GATT_ERROR;
+
+  p_server_cb->disc_start_ms = bluetooth::common::time_get_os_boottime_ms();
+  p_server_cb->disc_start_req = GATTC_GetDiscoveryRequestCount(conn_id);
+
+  p_server_cb->has_db_hash = false;
+  if (p_clcb->transport == BTA_TRANSPORT_LE) {
+    tGATT_READ_PARAM read_param;
+    memset(&read_param, 0, sizeof(tGATT_READ_PARAM));
+    read_param.char_type.s_handle = 0x0001;
+    read_param.char_type.e_handle = 0xFFFF;
+    read_param.char_type.uuid = Uuid::From16Bit(GATT_UUID_DATABASE_HASH);
+    read_param.char_type.auth_req = GATT_AUTH_REQ_NONE;
+    if (GATTC_Read(conn_id, GATT_READ_BY_TYPE, &read_param) == GATT_SUCCESS) {
+      p_server_cb->db_hash_pending = true;
+      return GATT_SUCCESS;
+    }
+  }
+
+  return bta_gattc_discover_pri_service(conn_id, p_server_cb,
+                                        GATT_DISC_SRVC_ALL);
+}
+
+/** Account a discovery that completed successfully */
+static void bta_gattc_disc_stats_update(uint16_t conn_id,
+                                        tBTA_GATTC_SERV* p_srvc_cb,
+                                        bool by_hash) {
+  uint64_t duration_ms = bluetooth::common::time_get_os_boottime_ms() -
+                         p_srvc_cb->disc_start_ms;
+  uint32_t requests =
+      GATTC_GetDiscoveryRequestCount(conn_id) - p_srvc_cb->disc_start_req;
+
+  LOG(INFO) << __func__ << ": discovery took " << duration_ms << " ms, "
+            << requests << " requests";
+
+  bta_gattc_disc_stats.count++;
+  if (by_hash) bta_gattc_disc_stats.by_hash++;
+  bta_gattc_disc_stats.total_ms += duration_ms;
+  if (duration_ms > bta_gattc_disc_stats.max_ms)
+    bta_gattc_disc_stats.max_ms = duration_ms;
+  bta_gattc_disc_stats.total_requests += requests;
+  if (requests > bta_gattc_disc_stats.max_requests)
+    bta_gattc_disc_stats.max_requests = requests;
+}
+
+/** Database Hash read complete: load the matching cache, or discover */
+void bta_gattc_db_hash_read_cmpl(tBTA_GATTC_CLCB* p_clcb, tGATT_STATUS status,
+                                 tGATT_CL_COMPLETE* p_data) {
+  tBTA_GATTC_SERV* p_srvc_cb = p_clcb->p_srcb;
+  p_srvc_cb->db_hash_pending = false;
+
+  if (status == GATT_SUCCESS && p_data &&
+      p_data->att_value.len == OCTET16_LEN) {
+    p_srvc_cb->has_db_hash = true;
+    memcpy(p_srvc_cb->db_hash.data(), p_data->att_value.value, OCTET16_LEN);
+
+    if (bta_gattc_cache_load_by_hash(p_srvc_cb, p_srvc_cb->db_hash)) {
+      LOG(INFO) << __func__ << ": database hash is cached, skip discovery";
+      bta_gattc_disc_stats_update(p_clcb->bta_conn_id, p_srvc_cb, true);
+      bta_gattc_reset_discover_st(p_srvc_cb, GATT_SUCCESS);
+      return;
+    }
+  }
+
+  p_clcb->status = bta_gattc_discover_pri_service(
+      p_clcb->bta_conn_id, p_srvc_cb, GATT_DISC_SRVC_ALL);
+  if (p_clcb->status != GATT_SUCCESS) {
+    LOG(ERROR) << "discovery on server failed";
+    bta_gattc_reset_discover_st(p_srvc_cb, p_clcb->status);
+  }
+}
+
 /** start exploring next service, or finish discovery if no more services left
  */
 static void bta_gattc_explore_next_service(uint16_t conn_id,
@@ -178,6 +275,7 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
   LOG(INFO) << __func__ << ": service discovery finished";
 
   p_srvc_cb->gatt_database = p_srvc_cb->pending_discovery.Build();
+  bta_gattc_disc_stats_update(conn_id, p_srvc_cb, false);
 
 #if (BTA_GATT_DEBUG == TRUE)
   bta_gattc_display_cache_server(p_srvc_cb->gatt_database);
@@ -186,7 +284,7 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
   p_clcb->p_srcb->state = BTA_GATTC_SERV_SAVE;
 
   if (btm_sec_is_a_bonded_dev(p_srvc_cb->server_bda)) {
-    bta_gattc_cache_write(p_clcb->p_srcb->server_bda,
+    bta_gattc_cache_write(p_clcb->p_srcb,
                           p_clcb->p_srcb->gatt_database.Serialize());
   }
 
@@ -709,50 +807,42 @@ void bta_gattc_get_gatt_db(uint16_t conn_id, uint16_t start_handle,
  *
  ******************************************************************************/
 bool bta_gattc_cache_load(tBTA_GATTC_SERV* p_srcb) {
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname), p_srcb->server_bda);
-
-  FILE* fd = fopen(fname, "rb");
-  if (!fd) {
-    LOG(ERROR) << __func__ << ": can't open GATT cache file " << fname
-               << " for reading, error: " << strerror(errno);
+  DatabaseHash hash;
+  if (!bta_gattc_cache_store().LoadByAddress(
+          p_srcb->server_bda, &p_srcb->gatt_database, &hash)) {
+    p_srcb->gatt_database.Clear();
     return false;
   }
 
-  uint16_t cache_ver = 0;
-  bool success = false;
-  uint16_t num_attr = 0;
-
-  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't read GATT cache version from: " << fname;
-    goto done;
-  }
-
-  if (cache_ver != GATT_CACHE_VERSION) {
-    LOG(ERROR) << __func__ << ": wrong GATT cache version: " << fname;
-    goto done;
-  }
-
-  if (fread(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't read number of GATT attributes: " << fname;
-    goto done;
-  }
-
-  {
-    std::vector<StoredAttribute> attr(num_attr);
-
-    if (fread(attr.data(), sizeof(StoredAttribute), num_attr, fd) != num_attr) {
-      LOG(ERROR) << __func__ << "s: can't read GATT attributes: " << fname;
-      goto done;
-    }
+  p_srcb->db_hash = hash;
+  return true;
+}
 
-    p_srcb->gatt_database = gatt::Database::Deserialize(attr, &success);
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_load_by_hash
+ *
+ * Description      Load the GATT cache stored under the Database Hash read
+ *                  from the server, which may come from another server with
+ *                  the same database, and link the server to it if bonded.
+ *
+ * Parameter        p_srcb: pointer to server cache, that will
+ *                          be filled from storage
+ *                  hash: GATT Database Hash of the server.
+ * Returns          true on success, false otherwise
+ *
+ ******************************************************************************/
+bool bta_gattc_cache_load_by_hash(tBTA_GATTC_SERV* p_srcb,
+                                  const Octet16& hash) {
+  if (!bta_gattc_cache_store().LoadByHash(hash, &p_srcb->gatt_database)) {
+    p_srcb->gatt_database.Clear();
+    return false;
   }
 
-done:
-  fclose(fd);
-  return success;
+  p_srcb->db_hash = hash;
+  if (btm_sec_is_a_bonded_dev(p_srcb->server_bda))
+    bta_gattc_cache_store().Link(p_srcb->server_bda, hash);
+  return true;
 }
 
 /*******************************************************************************
@@ -762,45 +852,17 @@ done:
  * Description      This callout function is executed by GATT when a server
  *                  cache is available to save.
  *
- * Parameter        server_bda: server bd address of this cache belongs to
+ * Parameter        p_srcb: server cache the attributes belong to
  *                  attr: attributes to save.
  * Returns
  *
  ******************************************************************************/
-static void bta_gattc_cache_write(const RawAddress& server_bda,
+static void bta_gattc_cache_write(tBTA_GATTC_SERV* p_srcb,
                                   const std::vector<StoredAttribute>& attr) {
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
-
-  FILE* fd = fopen(fname, "wb");
-  if (!fd) {
-    LOG(ERROR) << __func__
-               << ": can't open GATT cache file for writing: " << fname;
-    return;
-  }
-
-  uint16_t cache_ver = GATT_CACHE_VERSION;
-  if (fwrite(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache version: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  uint16_t num_attr = attr.size();
-  if (fwrite(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't write GATT cache attribute count: " << fname;
-    fclose(fd);
-    return;
-  }
+  /* servers without a Database Hash are keyed by the database content */
+  if (!p_srcb->has_db_hash) p_srcb->db_hash = DatabaseStore::ComputeHash(attr);
 
-  if (fwrite(attr.data(), sizeof(StoredAttribute), num_attr, fd) != num_attr) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache attributes: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  fclose(fd);
+  bta_gattc_cache_store().Store(p_srcb->server_bda, p_srcb->db_hash, attr);
 }
 
 /*******************************************************************************
@@ -817,7 +879,33 @@ static void bta_gattc_cache_write(const RawAddress& server_bda,
  ******************************************************************************/
 void bta_gattc_cache_reset(const RawAddress& server_bda) {
   VLOG(1) << __func__;
-  char fname[255] = {0};
-  bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
-  unlink(fname);
+  bta_gattc_cache_store().Unlink(server_bda);
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_debug_dump
+ *
+ * Description      Dump the GATT client discovery statistics to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void bta_gattc_debug_dump(int fd) {
+  uint32_t count = bta_gattc_disc_stats.count;
+
+  dprintf(fd, "\nGATT Client Discovery:\n");
+  dprintf(fd, "  Discoveries            : %u (%u by Database Hash)\n", count,
+          bta_gattc_disc_stats.by_hash.load());
+  dprintf(fd, "  Average time           : %llu ms\n",
+          (unsigned long long)(count ? bta_gattc_disc_stats.total_ms / count
+                                     : 0));
+  dprintf(fd, "  Max time               : %llu ms\n",
+          (unsigned long long)bta_gattc_disc_stats.max_ms);
+  dprintf(fd, "  Average requests       : %llu\n",
+          (unsigned long long)(count ? bta_gattc_disc_stats.total_requests /
+                                           count
+                                     : 0));
+  dprintf(fd, "  Max requests           : %u\n",
+          bta_gattc_disc_stats.max_requests.load());
 }
@@ -216,6 +216,13 @@ typedef struct {
   uint8_t srvc_hdl_chg; /* service handle change indication pending */
   uint16_t attr_index;  /* cahce NV saving/loading attribute index */
 
+  bool db_hash_pending; /* reading the Database Hash before discovery */
+  bool has_db_hash;     /* db_hash was read from the server */
+  Octet16 db_hash;      /* key of the server database in the cache store */
+
+  uint64_t disc_start_ms;  /* discovery start time, for statistics */
+  uint32_t disc_start_req; /* discovery requests sent before discovery */
+
   uint16_t mtu;
 } tBTA_GATTC_SERV;
 
@@ -424,6 +431,11 @@ extern void bta_gattc_disc_cmpl_cback(uint16_t conn_id,
 extern tGATT_STATUS bta_gattc_discover_pri_service(uint16_t conn_id,
                                                    tBTA_GATTC_SERV* p_server_cb,
                                                    uint8_t disc_type);
+extern tGATT_STATUS bta_gattc_discover_db_hash(uint16_t conn_id,
+                                              tBTA_GATTC_SERV* p_server_cb);
+extern void bta_gattc_db_hash_read_cmpl(tBTA_GATTC_CLCB* p_clcb,
+                                        tGATT_STATUS status,
+                                        tGATT_CL_COMPLETE* p_data);
 extern void bta_gattc_search_service(tBTA_GATTC_CLCB* p_clcb,
                                      bluetooth::Uuid* p_uuid);
 extern const std::list<gatt::Service>* bta_gattc_get_services(uint16_t conn_id);
@@ -452,6 +464,9 @@ extern tBTA_GATTC_CONN* bta_gattc_conn_find_alloc(const RawAddress& remote_bda);
 extern bool bta_gattc_conn_dealloc(const RawAddress& remote_bda);
 
 extern bool bta_gattc_cache_load(tBTA_GATTC_SERV* p_srcb);
+extern bool bta_gattc_cache_load_by_hash(tBTA_GATTC_SERV* p_srcb,
+                                         const Octet16& hash);
 extern void bta_gattc_cache_reset(const RawAddress& server_bda);
+extern void bta_gattc_debug_dump(int fd);
 
 #endif /* BTA_GATTC_INT_H */
@@ -105,6 +105,12 @@ void DatabaseBuilder::AddDescriptor(uint16_t handle, const Uuid& uuid) {
     return;
   }
 
+  /* Merged descriptor ranges also span the declarations between them */
+  if (handle == service->handle) return;
+  for (const IncludedService& included : service->included_services) {
+    if (included.handle == handle) return;
+  }
+
   if (service->characteristics.empty()) {
     LOG(ERROR) << __func__
                << ": Illegal action to add to non-existing characteristic!";
@@ -118,6 +124,9 @@ void DatabaseBuilder::AddDescriptor(uint16_t handle, const Uuid& uuid) {
     char_node = &(*it);
   }
 
+  /* Characteristic Declaration or Value */
+  if (handle <= char_node->value_handle) return;
+
   char_node->descriptors.emplace_back(
       gatt::Descriptor{.handle = handle, .uuid = uuid});
 }
@@ -128,6 +137,14 @@ bool DatabaseBuilder::StartNextServiceExploration() {
     pending_service = *handle_range;
     services_to_discover.erase(handle_range);
 
+    /* Explore adjacent services together, so that each discovery procedure
+     * covers as many of them as possible */
+    while (!services_to_discover.empty() &&
+           services_to_discover.begin()->first == pending_service.second + 1) {
+      pending_service.second = services_to_discover.begin()->second;
+      services_to_discover.erase(services_to_discover.begin());
+    }
+
     // Empty service declaration, nothing to explore, skip to next.
     if (pending_service.first == pending_service.second) continue;
 
@@ -143,36 +160,47 @@ DatabaseBuilder::CurrentlyExploredService() {
 }
 
 std::pair<uint16_t, uint16_t> DatabaseBuilder::NextDescriptorRangeToExplore() {
-  Service* service = FindService(database.services, pending_service.first);
-  if (!service || service->characteristics.empty()) {
-    return {HANDLE_MAX, HANDLE_MAX};
-  }
-
-  for (auto it = service->characteristics.cbegin();
-       it != service->characteristics.cend(); it++) {
-    if (it->declaration_handle > pending_characteristic) {
-      auto next = std::next(it);
+  std::pair<uint16_t, uint16_t> range = EXPLORE_END;
+
+  for (const Service& service : database.services) {
+    if (service.end_handle < pending_service.first) continue;
+    if (service.handle > pending_service.second) break;
+
+    for (auto it = service.characteristics.cbegin();
+         it != service.characteristics.cend(); it++) {
+      if (it->declaration_handle <= pending_characteristic) continue;
+
+      /* Extending the range over a Characteristic Value with a 128 bit type
+       * would split the Find Information response, and cost a round trip
+       * instead of saving one. Other declarations are skipped by
+       * AddDescriptor(). */
+      if (range != EXPLORE_END &&
+          it->uuid.GetShortestRepresentationSize() != Uuid::kNumBytes16) {
+        pending_characteristic = range.second;
+        return range;
+      }
 
       /* Characteristic Declaration is followed by Characteristic Value
        * Declaration, first descriptor is after that, see BT Spect 5.0 Vol 3,
        * Part G 3.3.2 and 3.3.3 */
+      auto next = std::next(it);
       uint16_t start = it->declaration_handle + 2;
       uint16_t end;
-      if (next != service->characteristics.end())
+      if (next != service.characteristics.end())
         end = next->declaration_handle - 1;
       else
-        end = service->end_handle;
+        end = service.end_handle;
 
       // No place for descriptor - skip to next characteristic
       if (start > end) continue;
 
-      pending_characteristic = start;
-      return {start, end};
+      if (range == EXPLORE_END) range.first = start;
+      range.second = end;
     }
   }
 
-  pending_characteristic = HANDLE_MAX;
-  return {HANDLE_MAX, HANDLE_MAX};
+  pending_characteristic = range.second;
+  return range;
 }
 
 bool DatabaseBuilder::InProgress() const { return !database.services.empty(); }
@@ -38,15 +38,17 @@ class DatabaseBuilder {
   void AddDescriptor(uint16_t handle, const bluetooth::Uuid& uuid);
 
   /* Returns true if next service exploration started, false if there are no
-   * more services to explore. */
+   * more services to explore. Adjacent services are explored together. */
   bool StartNextServiceExploration();
 
-  /* Return pair with start and end handle of the currently explored service.
+  /* Return pair with start and end handle of the currently explored services.
    */
   const std::pair<uint16_t, uint16_t>& CurrentlyExploredService();
 
   /* Return pair with start and end handle of the descriptor range to discover,
-   * or DatabaseBuilder::EXPLORE_END if no more descriptors left.
+   * or DatabaseBuilder::EXPLORE_END if no more descriptors left. Ranges of
+   * consecutive characteristics are merged, declarations in between are
+   * ignored by AddDescriptor().
    */
   std::pair<uint16_t, uint16_t> NextDescriptorRangeToExplore();
 
@@ -69,10 +71,10 @@ class DatabaseBuilder {
 
  private:
   Database database;
-  /* Start and end handle of service that is currently being discovered on the
-   * remote device */
+  /* Start and end handle of adjacent services that are currently being
+   * discovered on the remote device */
   std::pair<uint16_t, uint16_t> pending_service;
-  /* Characteristic inside pending_service that is currently being explored */
+  /* End of the last descriptor range explored inside pending_service */
   uint16_t pending_characteristic;
 
   /* sorted, unique set of start_handle, end_handle pair of all services that
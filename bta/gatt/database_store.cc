@@ -0,0 +1,303 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "database_store.h"
+#include "stack/include/gattdefs.h"
+
+#include <base/logging.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/sha.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using bluetooth::Uuid;
+
+namespace gatt {
+
+namespace {
+#define GATT_CACHE_VERSION 6
+
+const char LINK_FILE_PREFIX[] = "gatt_cache_";
+const char DATABASE_FILE_PREFIX[] = "gatt_hash_";
+
+const Uuid PRIMARY_SERVICE = Uuid::From16Bit(GATT_UUID_PRI_SERVICE);
+const Uuid SECONDARY_SERVICE = Uuid::From16Bit(GATT_UUID_SEC_SERVICE);
+const Uuid INCLUDE = Uuid::From16Bit(GATT_UUID_INCLUDE_SERVICE);
+const Uuid CHARACTERISTIC = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
+
+/* A link file holds the version and the hash of the server database. A
+ * database file starts with this header, followed by the attributes. */
+struct DatabaseFileHeader {
+  uint16_t version;
+  uint16_t num_attr;
+  DatabaseHash hash;
+};
+
+static_assert(sizeof(DatabaseFileHeader) % alignof(StoredAttribute) == 0,
+              "attributes must be aligned in mapped database files");
+
+void AppendUint16(std::vector<uint8_t>& out, uint16_t value) {
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+void AppendUuid(std::vector<uint8_t>& out, const Uuid& uuid) {
+  const Uuid::UUID128Bit& bytes = uuid.To128BitBE();
+  out.insert(out.end(), bytes.begin(), bytes.end());
+}
+}  // namespace
+
+std::string DatabaseStore::LinkFileName(const RawAddress& bda) const {
+  char name[sizeof(LINK_FILE_PREFIX) + 12];
+  snprintf(name, sizeof(name), "%s%02x%02x%02x%02x%02x%02x", LINK_FILE_PREFIX,
+           bda.address[0], bda.address[1], bda.address[2], bda.address[3],
+           bda.address[4], bda.address[5]);
+  return directory_ + name;
+}
+
+std::string DatabaseStore::DatabaseFileName(const DatabaseHash& hash) const {
+  std::string name = directory_ + DATABASE_FILE_PREFIX;
+  for (uint8_t byte : hash) {
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02x", byte);
+    name += hex;
+  }
+  return name;
+}
+
+bool DatabaseStore::ReadLink(const std::string& fname,
+                             DatabaseHash* p_hash) const {
+  FILE* fd = fopen(fname.c_str(), "rb");
+  if (!fd) return false;
+
+  uint16_t version = 0;
+  bool success = fread(&version, sizeof(version), 1, fd) == 1 &&
+                 version == GATT_CACHE_VERSION &&
+                 fread(p_hash->data(), p_hash->size(), 1, fd) == 1;
+  fclose(fd);
+  return success;
+}
+
+/* Maps the valid database file of |hash|, the caller unmaps it */
+bool DatabaseStore::MapDatabase(const DatabaseHash& hash,
+                                Mapping* p_mapping) const {
+  std::string fname = DatabaseFileName(hash);
+  int fd = open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    LOG(ERROR) << __func__ << ": can't stat GATT cache file " << fname;
+    close(fd);
+    return false;
+  }
+
+  /* invalid files are removed, so that the database is stored again */
+  if (st.st_size < (off_t)sizeof(DatabaseFileHeader)) {
+    LOG(ERROR) << __func__ << ": invalid GATT cache file " << fname;
+    close(fd);
+    unlink(fname.c_str());
+    return false;
+  }
+
+  void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << __func__ << ": can't map GATT cache file " << fname;
+    return false;
+  }
+
+  const DatabaseFileHeader* header =
+      static_cast<const DatabaseFileHeader*>(addr);
+  if (header->version != GATT_CACHE_VERSION || header->hash != hash ||
+      (size_t)st.st_size != sizeof(DatabaseFileHeader) +
+                                header->num_attr * sizeof(StoredAttribute)) {
+    LOG(ERROR) << __func__ << ": invalid GATT cache file " << fname;
+    munmap(addr, st.st_size);
+    unlink(fname.c_str());
+    return false;
+  }
+
+  *p_mapping = Mapping{addr, (size_t)st.st_size};
+  return true;
+}
+
+bool DatabaseStore::LoadByAddress(const RawAddress& bda, Database* p_db,
+                                  DatabaseHash* p_hash) {
+  std::string fname = LinkFileName(bda);
+  if (!ReadLink(fname, p_hash)) {
+    LOG(ERROR) << __func__ << ": can't read GATT cache link " << fname;
+    return false;
+  }
+
+  return LoadByHash(*p_hash, p_db);
+}
+
+bool DatabaseStore::LoadByHash(const DatabaseHash& hash, Database* p_db) {
+  Mapping mapping;
+  if (!MapDatabase(hash, &mapping)) return false;
+
+  const DatabaseFileHeader* header =
+      static_cast<const DatabaseFileHeader*>(mapping.addr);
+  const StoredAttribute* attr =
+      reinterpret_cast<const StoredAttribute*>(header + 1);
+
+  bool success = false;
+  *p_db = Database::Deserialize(attr, header->num_attr, &success);
+  munmap(mapping.addr, mapping.size);
+  if (!success) {
+    LOG(ERROR) << __func__ << ": invalid GATT cache file "
+               << DatabaseFileName(hash);
+    unlink(DatabaseFileName(hash).c_str());
+  }
+  return success;
+}
+
+bool DatabaseStore::Store(const RawAddress& bda, const DatabaseHash& hash,
+                          const std::vector<StoredAttribute>& attr) {
+  std::string fname = DatabaseFileName(hash);
+
+  /* identical databases are only written once, a missing or invalid file is
+   * written again */
+  Mapping mapping;
+  if (MapDatabase(hash, &mapping)) {
+    munmap(mapping.addr, mapping.size);
+  } else {
+    /* write to a temporary file first, so the database file is complete as
+     * soon as it exists */
+    std::string tmp_fname = fname + ".tmp";
+    FILE* fd = fopen(tmp_fname.c_str(), "wb");
+    if (!fd) {
+      LOG(ERROR) << __func__
+                 << ": can't open GATT cache file for writing: " << tmp_fname;
+      return false;
+    }
+
+    DatabaseFileHeader header = {.version = GATT_CACHE_VERSION,
+                                 .num_attr = (uint16_t)attr.size(),
+                                 .hash = hash};
+    bool success = fwrite(&header, sizeof(header), 1, fd) == 1 &&
+                   fwrite(attr.data(), sizeof(StoredAttribute), attr.size(),
+                          fd) == attr.size();
+    success = (fclose(fd) == 0) && success;
+
+    if (!success || rename(tmp_fname.c_str(), fname.c_str()) != 0) {
+      LOG(ERROR) << __func__ << ": can't write GATT cache file: " << fname;
+      unlink(tmp_fname.c_str());
+      return false;
+    }
+  }
+
+  return Link(bda, hash);
+}
+
+bool DatabaseStore::Link(const RawAddress& bda, const DatabaseHash& hash) {
+  std::string fname = LinkFileName(bda);
+  DatabaseHash old_hash;
+  bool relinked = ReadLink(fname, &old_hash) && old_hash != hash;
+
+  FILE* fd = fopen(fname.c_str(), "wb");
+  if (!fd) {
+    LOG(ERROR) << __func__
+               << ": can't open GATT cache link for writing: " << fname;
+    return false;
+  }
+
+  uint16_t version = GATT_CACHE_VERSION;
+  bool success = fwrite(&version, sizeof(version), 1, fd) == 1 &&
+                 fwrite(hash.data(), hash.size(), 1, fd) == 1;
+  success = (fclose(fd) == 0) && success;
+  if (!success) {
+    LOG(ERROR) << __func__ << ": can't write GATT cache link: " << fname;
+    unlink(fname.c_str());
+  }
+
+  /* the database of the server changed, e.g. after Service Changed */
+  if (relinked) RemoveIfUnlinked(old_hash);
+  return success;
+}
+
+void DatabaseStore::Unlink(const RawAddress& bda) {
+  std::string fname = LinkFileName(bda);
+  DatabaseHash hash;
+  bool linked = ReadLink(fname, &hash);
+  unlink(fname.c_str());
+  if (linked) RemoveIfUnlinked(hash);
+}
+
+bool DatabaseStore::IsLinked(const DatabaseHash& hash) const {
+  DIR* dir = opendir(directory_.c_str());
+  if (!dir) return true;
+
+  bool in_use = false;
+  const size_t prefix_len = strlen(LINK_FILE_PREFIX);
+  while (struct dirent* entry = readdir(dir)) {
+    if (strncmp(entry->d_name, LINK_FILE_PREFIX, prefix_len) != 0) continue;
+
+    DatabaseHash other;
+    if (ReadLink(directory_ + entry->d_name, &other) && other == hash) {
+      in_use = true;
+      break;
+    }
+  }
+  closedir(dir);
+  return in_use;
+}
+
+/* keeps the database while another server links to it */
+void DatabaseStore::RemoveIfUnlinked(const DatabaseHash& hash) const {
+  if (!IsLinked(hash)) unlink(DatabaseFileName(hash).c_str());
+}
+
+DatabaseHash DatabaseStore::ComputeHash(
+    const std::vector<StoredAttribute>& attr) {
+  /* hash the fields in use only, unused union bytes are undefined */
+  std::vector<uint8_t> data;
+  data.reserve(attr.size() * (2 + 2 * Uuid::kNumBytes128 + 4));
+  for (const StoredAttribute& a : attr) {
+    AppendUint16(data, a.handle);
+    AppendUuid(data, a.type);
+
+    if (a.type == PRIMARY_SERVICE || a.type == SECONDARY_SERVICE) {
+      AppendUuid(data, a.value.service.uuid);
+      AppendUint16(data, a.value.service.end_handle);
+    } else if (a.type == INCLUDE) {
+      AppendUint16(data, a.value.included_service.handle);
+      AppendUint16(data, a.value.included_service.end_handle);
+      AppendUuid(data, a.value.included_service.uuid);
+    } else if (a.type == CHARACTERISTIC) {
+      data.push_back(a.value.characteristic.properties);
+      AppendUint16(data, a.value.characteristic.value_handle);
+      AppendUuid(data, a.value.characteristic.uuid);
+    }
+  }
+
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  SHA256(data.data(), data.size(), digest);
+
+  DatabaseHash hash;
+  memcpy(hash.data(), digest, hash.size());
+  return hash;
+}
+
+}  // namespace gatt
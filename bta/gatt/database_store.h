@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "gatt/database.h"
+#include "types/raw_address.h"
+
+namespace gatt {
+
+/* Key of a stored database: the GATT Database Hash read from the server when
+ * it has one, otherwise DatabaseStore::ComputeHash() of the database */
+using DatabaseHash = std::array<uint8_t, 16>;
+
+/* Content addressed storage for GATT client caches.
+ *
+ * Each distinct database is written once, to a file named after its hash, and
+ * every bonded server links to the hash of its database. Servers of the same
+ * model thus share one file, and a new server announcing a known Database
+ * Hash can skip discovery. Database files are mapped read-only while they are
+ * loaded, so loading one does not read it into an intermediate buffer. */
+class DatabaseStore {
+ public:
+  /* |directory| is prepended to file names and must end with '/' */
+  explicit DatabaseStore(std::string directory)
+      : directory_(std::move(directory)) {}
+
+  DatabaseStore(const DatabaseStore&) = delete;
+  DatabaseStore& operator=(const DatabaseStore&) = delete;
+
+  /* Loads the database |bda| is linked to. Returns true on success, and the
+   * hash of the database in |p_hash| */
+  bool LoadByAddress(const RawAddress& bda, Database* p_db,
+                     DatabaseHash* p_hash);
+
+  /* Loads the database stored under |hash|. Returns true on success */
+  bool LoadByHash(const DatabaseHash& hash, Database* p_db);
+
+  /* Stores |attr| under |hash|, unless a valid database with that hash is
+   * already stored, and links |bda| to it. Returns true on success */
+  bool Store(const RawAddress& bda, const DatabaseHash& hash,
+             const std::vector<StoredAttribute>& attr);
+
+  /* Links |bda| to the database stored under |hash|. The database |bda| was
+   * linked to before is removed once no other server links to it */
+  bool Link(const RawAddress& bda, const DatabaseHash& hash);
+
+  /* Forgets the database of |bda|. The database file is removed once no other
+   * server links to it */
+  void Unlink(const RawAddress& bda);
+
+  /* Returns a digest of |attr|, used as key for servers without a GATT
+   * Database Hash characteristic */
+  static DatabaseHash ComputeHash(const std::vector<StoredAttribute>& attr);
+
+ private:
+  struct Mapping {
+    void* addr;
+    size_t size;
+  };
+
+  std::string LinkFileName(const RawAddress& bda) const;
+  std::string DatabaseFileName(const DatabaseHash& hash) const;
+  bool ReadLink(const std::string& fname, DatabaseHash* p_hash) const;
+  bool MapDatabase(const DatabaseHash& hash, Mapping* p_mapping) const;
+  bool IsLinked(const DatabaseHash& hash) const;
+  void RemoveIfUnlinked(const DatabaseHash& hash) const;
+
+  std::string directory_;
+};
+
+}  // namespace gatt
@@ -736,6 +736,19 @@ extern void BTA_GATTC_ReadMultiple(uint16_t conn_id,
                                    tBTA_GATTC_MULTI* p_read_multi,
                                    tGATT_AUTH_REQ auth_req);
 
+/*******************************************************************************
+ *
+ * Function         BTA_GATTC_DebugDump
+ *
+ * Description      Dump the GATT client discovery statistics.
+ *
+ * Parameters       fd: file descriptor to dump to.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void BTA_GATTC_DebugDump(int fd);
+
 /*******************************************************************************
  *
  * Function         BTA_GATTC_Refresh
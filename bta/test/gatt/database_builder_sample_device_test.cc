@@ -136,41 +136,20 @@ TEST(DatabaseBuilderSampleDeviceTest, DoDiscovery) {
   builder.AddService(0x001b, 0x0029, SERVICE_5_UUID, true);
   builder.AddService(0x002a, 0x0031, SERVICE_6_UUID, true);
 
-  // At this moment, all services are received, stack will grab them one and one
-  // to discover their content.
+  // At this moment, all services are received. They are adjacent, so the
+  // stack will discover their content all at once.
   EXPECT_TRUE(builder.StartNextServiceExploration());
 
-  // Grabbing first service, to start Included Service and Characteristic
+  // Grabbing all services, to start Included Service and Characteristic
   // discovery
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0001, 0x0007));
+  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0001, 0x0031));
 
   builder.AddCharacteristic(0x0002, 0x0003, SERVICE_1_CHAR_1_UUID, 0x02);
   builder.AddCharacteristic(0x0004, 0x0005, SERVICE_1_CHAR_2_UUID, 0x02);
   builder.AddCharacteristic(0x0006, 0x0007, SERVICE_1_CHAR_3_UUID, 0x02);
 
-  // All characteristics were discovered, stack will try to look for
-  // descriptors. Since there is no space for descriptors, builder should return
-  // nothing more to discover
-  EXPECT_EQ(builder.NextDescriptorRangeToExplore(), EXPLORE_END);
-
-  // Service with handles 0x0008, 0x0008 is skipped for exploration - we know
-  // it's empty.
-  EXPECT_TRUE(builder.StartNextServiceExploration());
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0009, 0x000c));
-
   builder.AddCharacteristic(0x000a, 0x000b, SERVICE_3_CHAR_1_UUID, 0x12);
 
-  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
-            make_pair_u16(0x000c, 0x000c));
-
-  builder.AddDescriptor(0x000c, SERVICE_3_CHAR_1_DESC_1_UUID);
-
-  // All descriptors were explored
-  EXPECT_EQ(builder.NextDescriptorRangeToExplore(), EXPLORE_END);
-
-  EXPECT_TRUE(builder.StartNextServiceExploration());
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x000d, 0x001a));
-
   builder.AddCharacteristic(0x000e, 0x000f, SERVICE_4_CHAR_1_UUID, 0x0a);
   builder.AddCharacteristic(0x0010, 0x0011, SERVICE_4_CHAR_2_UUID, 0x0a);
   builder.AddCharacteristic(0x0012, 0x0013, SERVICE_4_CHAR_3_UUID, 0x02);
@@ -178,18 +157,6 @@ TEST(DatabaseBuilderSampleDeviceTest, DoDiscovery) {
   builder.AddCharacteristic(0x0016, 0x0017, SERVICE_4_CHAR_5_UUID, 0x0e);
   builder.AddCharacteristic(0x0018, 0x0019, SERVICE_4_CHAR_6_UUID, 0x12);
 
-  // Just last Characteristic have space for descriptor
-  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
-            make_pair_u16(0x001a, 0x001a));
-
-  builder.AddDescriptor(0x001a, SERVICE_4_CHAR_6_DESC_1_UUID);
-
-  // All descriptors were explored
-  EXPECT_EQ(builder.NextDescriptorRangeToExplore(), EXPLORE_END);
-
-  EXPECT_TRUE(builder.StartNextServiceExploration());
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x001b, 0x0029));
-
   builder.AddCharacteristic(0x001c, 0x001d, SERVICE_5_CHAR_1_UUID, 0x02);
   builder.AddCharacteristic(0x001e, 0x001f, SERVICE_5_CHAR_2_UUID, 0x02);
   builder.AddCharacteristic(0x0020, 0x0021, SERVICE_5_CHAR_3_UUID, 0x02);
@@ -198,17 +165,23 @@ TEST(DatabaseBuilderSampleDeviceTest, DoDiscovery) {
   builder.AddCharacteristic(0x0026, 0x0027, SERVICE_5_CHAR_6_UUID, 0x02);
   builder.AddCharacteristic(0x0028, 0x0029, SERVICE_5_CHAR_7_UUID, 0x02);
 
-  // No space for descriptors
-  EXPECT_EQ(builder.NextDescriptorRangeToExplore(), EXPLORE_END);
-
-  EXPECT_TRUE(builder.StartNextServiceExploration());
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x002a, 0x0031));
-
   builder.AddCharacteristic(0x002b, 0x002c, SERVICE_6_CHAR_1_UUID, 0x10);
   builder.AddCharacteristic(0x002e, 0x002f, SERVICE_6_CHAR_2_UUID, 0x08);
   builder.AddCharacteristic(0x0030, 0x0031, SERVICE_6_CHAR_3_UUID, 0x02);
 
-  // Just one Characteristic have space for descriptor
+  // All characteristics were discovered, stack will look for descriptors.
+  // Ranges are not extended over values with 128 bit UUIDs, so each of the
+  // three places for a descriptor is explored on its own.
+  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
+            make_pair_u16(0x000c, 0x000c));
+
+  builder.AddDescriptor(0x000c, SERVICE_3_CHAR_1_DESC_1_UUID);
+
+  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
+            make_pair_u16(0x001a, 0x001a));
+
+  builder.AddDescriptor(0x001a, SERVICE_4_CHAR_6_DESC_1_UUID);
+
   EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
             make_pair_u16(0x002d, 0x002d));
 
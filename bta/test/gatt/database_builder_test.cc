@@ -44,6 +44,12 @@ Uuid SERVICE_1_CHAR_1_UUID =
     Uuid::FromString("00002a00-0000-1000-8000-00805f9b34fb");
 Uuid SERVICE_1_CHAR_1_DESC_1_UUID =
     Uuid::FromString("00002902-0000-1000-8000-00805f9b34fb");
+Uuid SERVICE_1_CHAR_2_UUID =
+    Uuid::FromString("00002a01-0000-1000-8000-00805f9b34fb");
+Uuid SERVICE_2_CHAR_1_UUID =
+    Uuid::FromString("00002a19-0000-1000-8000-00805f9b34fb");
+Uuid SERVICE_2_CHAR_2_UUID =
+    Uuid::FromString("8082caa8-41a6-4021-91c6-56f9b954cc34");
 
 }  // namespace
 
@@ -129,13 +135,12 @@ TEST(DatabaseBuilderTest, SecondaryServiceOutOfOrderTest) {
   EXPECT_TRUE(builder.StartNextServiceExploration());
   EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0020, 0x002f));
 
-  /* Secondary service exploration */
+  /* Secondary service exploration, together with the adjacent primary
+   * service */
   EXPECT_TRUE(builder.StartNextServiceExploration());
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0040, 0x004f));
+  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0040, 0x005f));
 
-  /* Back to primary service exploration */
-  EXPECT_TRUE(builder.StartNextServiceExploration());
-  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0050, 0x005f));
+  EXPECT_FALSE(builder.StartNextServiceExploration());
 
   Database result = builder.Build();
 
@@ -171,4 +176,59 @@ TEST(DatabaseBuilderTest, SecondaryServiceOutOfOrderTest) {
   ASSERT_EQ(service, result.Services().end());
 }
 
+/* This test verifies that descriptor ranges of consecutive characteristics,
+ * in adjacent services, are discovered at once, and that the declarations
+ * returned from the merged range are not taken as descriptors. */
+TEST(DatabaseBuilderTest, MergedDescriptorRangeTest) {
+  DatabaseBuilder builder;
+
+  builder.AddService(0x0001, 0x0007, SERVICE_1_UUID, true);
+  builder.AddService(0x0008, 0x0010, SERVICE_2_UUID, true);
+
+  EXPECT_TRUE(builder.StartNextServiceExploration());
+  EXPECT_EQ(builder.CurrentlyExploredService(), make_pair_u16(0x0001, 0x0010));
+
+  builder.AddCharacteristic(0x0002, 0x0003, SERVICE_1_CHAR_1_UUID, 0x12);
+  builder.AddCharacteristic(0x0005, 0x0006, SERVICE_1_CHAR_2_UUID, 0x12);
+  builder.AddCharacteristic(0x0009, 0x000a, SERVICE_2_CHAR_1_UUID, 0x12);
+  builder.AddCharacteristic(0x000c, 0x000d, SERVICE_2_CHAR_2_UUID, 0x12);
+
+  // Ranges are merged up to the value with a 128 bit UUID
+  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
+            make_pair_u16(0x0004, 0x000b));
+
+  // Find Information on the merged range returns everything in it
+  builder.AddDescriptor(0x0004, SERVICE_1_CHAR_1_DESC_1_UUID);
+  builder.AddDescriptor(0x0005, Uuid::From16Bit(0x2803));
+  builder.AddDescriptor(0x0006, SERVICE_1_CHAR_2_UUID);
+  builder.AddDescriptor(0x0007, SERVICE_1_CHAR_1_DESC_1_UUID);
+  builder.AddDescriptor(0x0008, Uuid::From16Bit(0x2800));
+  builder.AddDescriptor(0x0009, Uuid::From16Bit(0x2803));
+  builder.AddDescriptor(0x000a, SERVICE_2_CHAR_1_UUID);
+  builder.AddDescriptor(0x000b, SERVICE_1_CHAR_1_DESC_1_UUID);
+
+  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
+            make_pair_u16(0x000e, 0x0010));
+  builder.AddDescriptor(0x000e, SERVICE_1_CHAR_1_DESC_1_UUID);
+
+  EXPECT_EQ(builder.NextDescriptorRangeToExplore(),
+            DatabaseBuilder::EXPLORE_END);
+  EXPECT_FALSE(builder.StartNextServiceExploration());
+
+  Database result = builder.Build();
+  auto service = result.Services().begin();
+  ASSERT_EQ(service->characteristics.size(), 2u);
+  ASSERT_EQ(service->characteristics[0].descriptors.size(), 1u);
+  EXPECT_EQ(service->characteristics[0].descriptors[0].handle, 0x0004);
+  ASSERT_EQ(service->characteristics[1].descriptors.size(), 1u);
+  EXPECT_EQ(service->characteristics[1].descriptors[0].handle, 0x0007);
+
+  service++;
+  ASSERT_EQ(service->characteristics.size(), 2u);
+  ASSERT_EQ(service->characteristics[0].descriptors.size(), 1u);
+  EXPECT_EQ(service->characteristics[0].descriptors[0].handle, 0x000b);
+  ASSERT_EQ(service->characteristics[1].descriptors.size(), 1u);
+  EXPECT_EQ(service->characteristics[1].descriptors[0].handle, 0x000e);
+}
+
 }  // namespace gatt
\ No newline at end of file
@@ -0,0 +1,265 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gatt/database_builder.h"
+#include "gatt/database_store.h"
+
+using bluetooth::Uuid;
+
+namespace gatt {
+
+namespace {
+const RawAddress ADDRESS_1({0x00, 0x11, 0x22, 0x33, 0x44, 0x55});
+const RawAddress ADDRESS_2({0x00, 0x11, 0x22, 0x33, 0x44, 0x66});
+
+Uuid SERVICE_1_UUID = Uuid::FromString("1800");
+Uuid SERVICE_2_UUID = Uuid::FromString("1801");
+Uuid SERVICE_1_CHAR_1_UUID = Uuid::FromString("2a00");
+Uuid SERVICE_1_CHAR_1_DESC_1_UUID = Uuid::FromString("2902");
+
+std::vector<StoredAttribute> BuildAttributes(uint8_t properties) {
+  DatabaseBuilder builder;
+  builder.AddService(0x0001, 0x000f, SERVICE_1_UUID, true);
+  builder.AddService(0x0010, 0x001f, SERVICE_2_UUID, false);
+  builder.AddIncludedService(0x0002, SERVICE_2_UUID, 0x0010, 0x001f);
+  builder.AddCharacteristic(0x0003, 0x0004, SERVICE_1_CHAR_1_UUID, properties);
+  builder.AddDescriptor(0x0005, SERVICE_1_CHAR_1_DESC_1_UUID);
+  return builder.Build().Serialize();
+}
+
+DatabaseHash MakeHash(uint8_t value) {
+  DatabaseHash hash;
+  hash.fill(value);
+  return hash;
+}
+}  // namespace
+
+class DatabaseStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char tmpl[] = "/tmp/gatt_store_test_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    directory_ = std::string(tmpl) + "/";
+  }
+
+  void TearDown() override {
+    DIR* dir = opendir(directory_.c_str());
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') unlink((directory_ + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(directory_.c_str());
+  }
+
+  int CountFiles(const char* prefix) {
+    int count = 0;
+    DIR* dir = opendir(directory_.c_str());
+    while (struct dirent* entry = readdir(dir)) {
+      if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0) count++;
+    }
+    closedir(dir);
+    return count;
+  }
+
+  /* Returns the name of the only database file */
+  std::string DatabaseFile() {
+    std::string database_file;
+    DIR* dir = opendir(directory_.c_str());
+    while (struct dirent* entry = readdir(dir)) {
+      if (strncmp(entry->d_name, "gatt_hash_", 10) == 0)
+        database_file = directory_ + entry->d_name;
+    }
+    closedir(dir);
+    return database_file;
+  }
+
+  std::string directory_;
+};
+
+TEST_F(DatabaseStoreTest, store_load_by_address_test) {
+  std::vector<StoredAttribute> attr = BuildAttributes(0x02);
+  DatabaseHash hash = MakeHash(0xa5);
+  {
+    DatabaseStore store(directory_);
+    ASSERT_TRUE(store.Store(ADDRESS_1, hash, attr));
+  }
+
+  DatabaseStore store(directory_);
+  Database db;
+  DatabaseHash loaded_hash;
+  ASSERT_TRUE(store.LoadByAddress(ADDRESS_1, &db, &loaded_hash));
+  EXPECT_EQ(loaded_hash, hash);
+  bool success = false;
+  EXPECT_EQ(db.ToString(), Database::Deserialize(attr, &success).ToString());
+
+  EXPECT_FALSE(store.LoadByAddress(ADDRESS_2, &db, &loaded_hash));
+}
+
+TEST_F(DatabaseStoreTest, servers_share_database_test) {
+  DatabaseStore store(directory_);
+  std::vector<StoredAttribute> attr = BuildAttributes(0x02);
+  DatabaseHash hash = MakeHash(0x01);
+
+  ASSERT_TRUE(store.Store(ADDRESS_1, hash, attr));
+  ASSERT_TRUE(store.Store(ADDRESS_2, hash, attr));
+  EXPECT_EQ(CountFiles("gatt_cache_"), 2);
+  EXPECT_EQ(CountFiles("gatt_hash_"), 1);
+
+  Database db_1, db_2;
+  DatabaseHash hash_1, hash_2;
+  ASSERT_TRUE(store.LoadByAddress(ADDRESS_1, &db_1, &hash_1));
+  ASSERT_TRUE(store.LoadByAddress(ADDRESS_2, &db_2, &hash_2));
+  EXPECT_EQ(hash_1, hash_2);
+  EXPECT_EQ(db_1.ToString(), db_2.ToString());
+}
+
+TEST_F(DatabaseStoreTest, load_by_hash_link_test) {
+  DatabaseStore store(directory_);
+  DatabaseHash hash = MakeHash(0x02);
+  ASSERT_TRUE(store.Store(ADDRESS_1, hash, BuildAttributes(0x02)));
+
+  Database db;
+  EXPECT_FALSE(store.LoadByHash(MakeHash(0x03), &db));
+  ASSERT_TRUE(store.LoadByHash(hash, &db));
+  EXPECT_FALSE(db.IsEmpty());
+
+  /* a server announcing a known hash is linked without storing again */
+  ASSERT_TRUE(store.Link(ADDRESS_2, hash));
+  DatabaseHash loaded_hash;
+  ASSERT_TRUE(store.LoadByAddress(ADDRESS_2, &db, &loaded_hash));
+  EXPECT_EQ(loaded_hash, hash);
+}
+
+TEST_F(DatabaseStoreTest, unlink_test) {
+  DatabaseStore store(directory_);
+  DatabaseHash hash = MakeHash(0x04);
+  ASSERT_TRUE(store.Store(ADDRESS_1, hash, BuildAttributes(0x02)));
+  ASSERT_TRUE(store.Link(ADDRESS_2, hash));
+
+  Database db;
+  ASSERT_TRUE(store.LoadByHash(hash, &db));
+
+  /* the database is kept while ADDRESS_2 links to it */
+  store.Unlink(ADDRESS_1);
+  DatabaseHash loaded_hash;
+  EXPECT_FALSE(store.LoadByAddress(ADDRESS_1, &db, &loaded_hash));
+  EXPECT_EQ(CountFiles("gatt_hash_"), 1);
+  EXPECT_TRUE(store.LoadByHash(hash, &db));
+
+  store.Unlink(ADDRESS_2);
+  EXPECT_EQ(CountFiles("gatt_cache_"), 0);
+  EXPECT_EQ(CountFiles("gatt_hash_"), 0);
+  EXPECT_FALSE(store.LoadByHash(hash, &db));
+}
+
+TEST_F(DatabaseStoreTest, relink_test) {
+  DatabaseStore store(directory_);
+  std::vector<StoredAttribute> attr = BuildAttributes(0x02);
+  std::vector<StoredAttribute> new_attr = BuildAttributes(0x0a);
+
+  ASSERT_TRUE(store.Store(ADDRESS_1, MakeHash(0x01), attr));
+  ASSERT_TRUE(store.Store(ADDRESS_2, MakeHash(0x01), attr));
+
+  /* the old database is kept while the second server links to it */
+  ASSERT_TRUE(store.Store(ADDRESS_1, MakeHash(0x02), new_attr));
+  EXPECT_EQ(CountFiles("gatt_hash_"), 2);
+
+  ASSERT_TRUE(store.Store(ADDRESS_2, MakeHash(0x02), new_attr));
+  EXPECT_EQ(CountFiles("gatt_hash_"), 1);
+
+  Database db;
+  EXPECT_FALSE(store.LoadByHash(MakeHash(0x01), &db));
+  EXPECT_TRUE(store.LoadByHash(MakeHash(0x02), &db));
+}
+
+TEST_F(DatabaseStoreTest, invalid_file_test) {
+  DatabaseHash hash = MakeHash(0x05);
+  {
+    DatabaseStore store(directory_);
+    ASSERT_TRUE(store.Store(ADDRESS_1, hash, BuildAttributes(0x02)));
+  }
+
+  std::string database_file = DatabaseFile();
+  ASSERT_FALSE(database_file.empty());
+
+  /* truncated database */
+  ASSERT_EQ(truncate(database_file.c_str(), 20), 0);
+  DatabaseStore store(directory_);
+  Database db;
+  EXPECT_FALSE(store.LoadByHash(hash, &db));
+
+  /* database from another cache version */
+  FILE* fd = fopen(database_file.c_str(), "wb");
+  uint16_t version = 1;
+  fwrite(&version, sizeof(version), 1, fd);
+  uint8_t padding[64] = {0};
+  fwrite(padding, sizeof(padding), 1, fd);
+  fclose(fd);
+  EXPECT_FALSE(store.LoadByHash(hash, &db));
+}
+
+TEST_F(DatabaseStoreTest, invalid_file_is_stored_again_test) {
+  std::vector<StoredAttribute> attr = BuildAttributes(0x02);
+  DatabaseHash hash = MakeHash(0x06);
+  {
+    DatabaseStore store(directory_);
+    ASSERT_TRUE(store.Store(ADDRESS_1, hash, attr));
+  }
+  std::string database_file = DatabaseFile();
+  ASSERT_FALSE(database_file.empty());
+
+  /* a failed load removes the file, and the next discovery stores it */
+  ASSERT_EQ(truncate(database_file.c_str(), 20), 0);
+  {
+    DatabaseStore store(directory_);
+    Database db;
+    DatabaseHash loaded_hash;
+    EXPECT_FALSE(store.LoadByAddress(ADDRESS_1, &db, &loaded_hash));
+    EXPECT_EQ(CountFiles("gatt_hash_"), 0);
+
+    ASSERT_TRUE(store.Store(ADDRESS_1, hash, attr));
+    ASSERT_TRUE(store.LoadByAddress(ADDRESS_1, &db, &loaded_hash));
+    EXPECT_EQ(loaded_hash, hash);
+  }
+
+  /* an invalid file is replaced even if it was never loaded */
+  ASSERT_EQ(truncate(database_file.c_str(), 20), 0);
+  DatabaseStore store(directory_);
+  ASSERT_TRUE(store.Store(ADDRESS_2, hash, attr));
+  Database db;
+  ASSERT_TRUE(store.LoadByHash(hash, &db));
+  bool success = false;
+  EXPECT_EQ(db.ToString(), Database::Deserialize(attr, &success).ToString());
+}
+
+TEST_F(DatabaseStoreTest, compute_hash_test) {
+  EXPECT_EQ(DatabaseStore::ComputeHash(BuildAttributes(0x02)),
+            DatabaseStore::ComputeHash(BuildAttributes(0x02)));
+  EXPECT_NE(DatabaseStore::ComputeHash(BuildAttributes(0x02)),
+            DatabaseStore::ComputeHash(BuildAttributes(0x0a)));
+}
+
+}  // namespace gatt
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Signals sockets served by a socket poll thread among a growing number of
+// open ones, and waits for the thread to report them, the way the RFCOMM and
+// L2CAP sockets are read and rearmed.
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "bt_trace.h"
+#include "bt_types.h"
+#include "btif/include/btif_sock_thread.h"
+
+using ::benchmark::State;
+
+uint8_t appl_trace_level = BT_TRACE_LEVEL_WARNING;
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+static int g_thread_handle = -1;
+static std::mutex g_mutex;
+static std::condition_variable g_signaled_cv;
+static size_t g_signaled = 0;
+
+static void sock_signaled(int fd, int type, int flags, uint32_t user_id) {
+  if (flags & SOCK_THREAD_FD_RD) {
+    char byte;
+    CHECK_EQ(recv(fd, &byte, 1, MSG_DONTWAIT), 1);
+    btsock_thread_add_fd(g_thread_handle, fd, type, SOCK_THREAD_FD_RD,
+                         user_id);
+  }
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_signaled++;
+  g_signaled_cv.notify_one();
+}
+
+class BM_SockThread : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    btsock_thread_init();
+    g_thread_handle = btsock_thread_create(sock_signaled, nullptr);
+    CHECK_GE(g_thread_handle, 0);
+    g_signaled = 0;
+    for (int i = 0; i < st.range(0); i++) {
+      int fds[2];
+      CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+      our_fds_.push_back(fds[0]);
+      app_fds_.push_back(fds[1]);
+      btsock_thread_add_fd(g_thread_handle, fds[0], 0, SOCK_THREAD_FD_RD, i);
+    }
+  }
+
+  void TearDown(State& st) override {
+    btsock_thread_exit(g_thread_handle);
+    g_thread_handle = -1;
+    for (int fd : our_fds_) close(fd);
+    for (int fd : app_fds_) close(fd);
+    our_fds_.clear();
+    app_fds_.clear();
+    benchmark::Fixture::TearDown(st);
+  }
+
+  // Writes a byte to |count| sockets and waits for all of them to be read
+  void Signal(size_t first, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      CHECK_EQ(write(app_fds_[(first + i) % app_fds_.size()], "", 1), 1);
+    }
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_signaled_cv.wait(lock, [count] { return g_signaled >= count; });
+    g_signaled -= count;
+  }
+
+  std::vector<int> our_fds_;
+  std::vector<int> app_fds_;
+};
+
+// A single socket has traffic, the others are idle
+BENCHMARK_DEFINE_F(BM_SockThread, one_active_socket)(State& state) {
+  size_t next = 0;
+  for (auto _ : state) {
+    Signal(next++, 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(BM_SockThread, one_active_socket)
+    ->RangeMultiplier(4)
+    ->Range(1, 256);
+
+// Every open socket has traffic
+BENCHMARK_DEFINE_F(BM_SockThread, all_sockets_active)(State& state) {
+  for (auto _ : state) {
+    Signal(0, state.range(0));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_REGISTER_F(BM_SockThread, all_sockets_active)
+    ->RangeMultiplier(4)
+    ->Range(1, 256);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_A2DP_ENCODE_AHEAD_H
+#define BTIF_A2DP_ENCODE_AHEAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "bt_types.h"
+
+//
+// Media packets of the A2DP Source encoded ahead of the media tick they are
+// sent on.
+//
+// The media thread posts the encoding of each tick to the encoder thread,
+// which keeps the packets it encodes here. They are handed to the transmit
+// queue, in encoding order, |ahead_ticks| media ticks after the tick they
+// were read on.
+//
+// The media thread waits for the encoder to be idle before it uses the
+// encoder itself or drops the packets encoded ahead, so a packet encoded
+// before a flush or a stop is never sent after it.
+//
+class BtifA2dpEncodeAhead {
+ public:
+  // Sends a packet on the media thread, and takes ownership of |p_buf|
+  typedef bool (*SendCallback)(BT_HDR* p_buf, size_t frames_n,
+                               uint32_t bytes_read);
+
+  // Keeps at most |max_packets| packets.
+  BtifA2dpEncodeAhead(uint8_t ahead_ticks, size_t max_packets);
+  ~BtifA2dpEncodeAhead();
+
+  uint8_t AheadTicks() const { return ahead_ticks_; }
+
+  // Called on the media thread for each encoding it posts to the encoder
+  // thread, and again with |posted| false if the posting failed.
+  void EncodePosted(bool posted = true);
+
+  // Called on the encoder thread around the encoding of media tick |tick|.
+  void EncodeStarted(uint64_t tick);
+  void EncodeDone();
+
+  // Keeps the packet |p_buf| encoded by the encoder thread. Frees it and
+  // returns false if too many packets are kept already.
+  bool Enqueue(BT_HDR* p_buf, size_t frames_n, uint32_t bytes_read);
+
+  // Hands the packets due on media tick |tick| to |send|.
+  void Handoff(uint64_t tick, SendCallback send);
+
+  // Waits for the encoder thread to be done with the encodings posted.
+  void WaitIdle();
+
+  // Waits for the encoder thread to be idle, then frees all packets.
+  void Flush();
+
+  // Returns the number of packets kept.
+  size_t Length();
+
+ private:
+  struct Packet {
+    BT_HDR* p_buf;
+    size_t frames_n;
+    uint32_t bytes_read;
+    uint64_t tick;  // Media tick the audio was read on
+  };
+
+  void FreePackets();
+
+  const uint8_t ahead_ticks_;
+  const size_t max_packets_;
+
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  std::deque<Packet> packets_;
+  size_t pending_;          // Encodings posted and not done
+  uint64_t encoding_tick_;  // Used by the encoder thread only
+};
+
+#endif  // BTIF_A2DP_ENCODE_AHEAD_H
@@ -0,0 +1,144 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_A2DP_JITTER_BUFFER_H
+#define BTIF_A2DP_JITTER_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include "bt_types.h"
+
+// Period of the decoding ticks of the A2DP Sink
+#define BTIF_SINK_MEDIA_TIME_TICK_MS 20
+
+//
+// Jitter buffer of the encoded media packets received by the A2DP Sink.
+//
+// Packets are kept in RTP timestamp order and handed to the decoder as a
+// playout clock reaches them. The depth kept ahead of the playout clock
+// follows the delays observed on arrival. Playout pauses to rebuild it after
+// an underrun and the oldest packets are dropped when it overflows. Smaller
+// differences, including the drift between the clocks of the peer and of the
+// audio output, are steered away by playing out slightly faster or slower
+// than the sample rate and dropping or repeating single PCM frames to match.
+//
+// Peers whose timestamps do not follow the sample rate are played untimed:
+// everything queued is decoded at each tick.
+//
+// The buffer is not thread safe.
+//
+class BtifA2dpJitterBuffer {
+ public:
+  struct Stats {
+    size_t total_packets;    // Packets enqueued
+    size_t late_packets;     // Dropped for arriving after their playout
+    size_t dropped_packets;  // Dropped to recover from an overflow
+    size_t underruns;        // Times playout caught up with the packets
+    uint64_t depth_us;       // Media time buffered ahead of playout
+    uint64_t max_depth_us;
+    uint64_t target_depth_us;
+    uint64_t jitter_us;  // Interarrival jitter as defined by RFC 3550
+    int32_t drift_ppm;   // Playout rate correction
+    bool timed;          // False if the peer timestamps are not usable
+  };
+
+  BtifA2dpJitterBuffer();
+  ~BtifA2dpJitterBuffer();
+
+  // Sets the format of the decoded stream and flushes the buffer.
+  // A |sample_rate| of 0 plays the stream untimed.
+  void SetFormat(uint32_t sample_rate, uint8_t channel_count,
+                 uint8_t bits_per_sample);
+
+  // Frees all packets. Playout resumes when the target depth is reached.
+  void Flush();
+
+  // Takes ownership of |p_pkt| with RTP timestamp |timestamp|, received at
+  // |now_us|.
+  void Enqueue(BT_HDR* p_pkt, uint32_t timestamp, uint64_t now_us);
+
+  // Returns whether playout has started, so packets are due for decoding.
+  bool IsPlaying() const { return playing_; }
+
+  // Moves the playout clock to |now_us| and returns the next packet due for
+  // decoding, or nullptr if there is none. The caller owns the packet.
+  BT_HDR* Dequeue(uint64_t now_us);
+
+  // Applies the playout rate correction to |*p_len| bytes of PCM decoded at
+  // |p_data|. Returns the PCM to play, |p_data| itself or a buffer valid
+  // until the next call, and updates |*p_len| to its length.
+  const uint8_t* AdjustPcm(const uint8_t* p_data, uint32_t* p_len);
+
+  size_t Length() const { return packets_.size(); }
+
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  struct Packet {
+    BT_HDR* p_pkt;
+    uint32_t timestamp;
+  };
+
+  void StartPlayout(uint64_t now_us);
+  void UpdateArrival(uint32_t timestamp, uint64_t now_us);
+  void UpdateTarget();
+  void UpdateDepth();
+  void UpdateDrift();
+  void SetUntimed(const char* reason);
+  void DropOldest();
+  uint64_t MediaToUs(uint64_t frames) const;
+
+  uint32_t sample_rate_;
+  size_t frame_bytes_;
+  bool pcm_16bit_;
+  bool timed_;
+
+  std::deque<Packet> packets_;
+  bool playing_;
+  bool has_newest_;
+  uint32_t newest_timestamp_;     // Highest timestamp received
+  uint32_t repeated_timestamps_;  // Packets in a row at |newest_timestamp_|
+  uint32_t frames_per_packet_;
+  bool has_released_;
+  uint32_t released_timestamp_;  // Last packet decoded or dropped
+
+  // Playout clock, in timestamp units and 1/10^12 of a unit
+  uint32_t playout_timestamp_;
+  uint64_t playout_fraction_;
+  uint64_t last_playout_us_;
+
+  // Arrival statistics
+  uint64_t first_arrival_us_;
+  uint64_t last_arrival_us_;
+  uint64_t arrival_frames_;  // Media time since the first arrival
+  int64_t base_transit_us_;
+  uint64_t peak_delay_us_;
+  int64_t jitter_us_;
+  bool clock_checked_;
+
+  int64_t smoothed_depth_us_;
+  int64_t slip_;  // Frames to drop or repeat, in millionths of a frame
+  std::vector<uint8_t> pcm_;
+
+  Stats stats_;
+};
+
+#endif  // BTIF_A2DP_JITTER_BUFFER_H
@@ -113,10 +113,10 @@ void btif_a2dp_sink_on_suspended(tBTA_AV_SUSPEND* p_av_suspend);
 // If |enable| is true, the discarding is enabled, otherwise is disabled.
 void btif_a2dp_sink_set_rx_flush(bool enable);
 
-// Enqueue a buffer to the A2DP Sink queue. If the queue has reached its
-// maximum size |MAX_INPUT_A2DP_FRAME_QUEUE_SZ|, the oldest buffer is
-// removed from the queue.
-// |p_buf| is the buffer to enqueue.
+// Enqueue a buffer to the A2DP Sink jitter buffer, which drops it if it
+// arrived too late to be played, or drops the oldest buffers if it overflows.
+// |p_buf| is the buffer to enqueue, with the RTP timestamp of the media
+// stored in its first four bytes as by |bta_av_sink_data_cback|.
 // Returns the number of buffers in the Sink queue after the enqueing.
 uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_buf);
 
@@ -47,6 +47,7 @@
 #include <hardware/bt_sock.h>
 
 #include "bt_utils.h"
+#include "bta/include/bta_gatt_api.h"
 #include "bta/include/bta_hearing_aid_api.h"
 #include "bta/include/bta_hf_client_api.h"
 #include "btif/avrcp/avrcp_service.h"
@@ -69,8 +70,12 @@
 #include "osi/include/allocation_tracker.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/pool_allocator.h"
 #include "osi/include/wakelock.h"
 #include "stack/gatt/connection_manager.h"
+#include "stack/include/btm_api.h"
+#include "stack/include/btu.h"
+#include "stack/include/l2c_api.h"
 #include "stack_manager.h"
 
 using bluetooth::hearing_aid::HearingAidInterface;
@@ -317,7 +322,12 @@ static void dump(int fd, const char** arguments) {
   BTA_HfClientDumpStatistics(fd);
   wakelock_debug_dump(fd);
   osi_allocator_debug_dump(fd);
+  osi_pool_allocator_debug_dump(fd);
   alarm_debug_dump(fd);
+  btu_hci_batch_debug_dump(fd);
+  BTM_DebugDump(fd);
+  L2CA_DebugDump(fd);
+  BTA_GATTC_DebugDump(fd);
   HearingAid::DebugDump(fd);
   connection_manager::dump(fd);
   bluetooth::bqr::DebugDump(fd);
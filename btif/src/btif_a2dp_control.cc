@@ -370,6 +370,9 @@ static void btif_a2dp_data_cb(UNUSED_ATTR tUIPC_CH_ID ch_id,
                  reinterpret_cast<void*>(A2DP_DATA_READ_POLL_MS));
 
       if (btif_av_get_peer_sep() == AVDT_TSEP_SNK) {
+        /* The audio HAL output stream sets up a shared memory ring */
+        UIPC_Ioctl(*a2dp_uipc, UIPC_CH_ID_AV_AUDIO, UIPC_REG_RX_RING, NULL);
+
         /* Start the media task to encode the audio */
         btif_a2dp_source_start_audio_req();
       }
@@ -0,0 +1,98 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_btif_a2dp_encode_ahead"
+
+#include "btif_a2dp_encode_ahead.h"
+
+#include "osi/include/allocator.h"
+#include "osi/include/log.h"
+
+BtifA2dpEncodeAhead::BtifA2dpEncodeAhead(uint8_t ahead_ticks,
+                                         size_t max_packets)
+    : ahead_ticks_(ahead_ticks),
+      max_packets_(max_packets),
+      pending_(0),
+      encoding_tick_(0) {}
+
+BtifA2dpEncodeAhead::~BtifA2dpEncodeAhead() { FreePackets(); }
+
+void BtifA2dpEncodeAhead::EncodePosted(bool posted) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (posted) {
+    pending_++;
+  } else {
+    pending_--;
+    if (pending_ == 0) idle_.notify_all();
+  }
+}
+
+void BtifA2dpEncodeAhead::EncodeStarted(uint64_t tick) {
+  encoding_tick_ = tick;
+}
+
+void BtifA2dpEncodeAhead::EncodeDone() { EncodePosted(false); }
+
+bool BtifA2dpEncodeAhead::Enqueue(BT_HDR* p_buf, size_t frames_n,
+                                  uint32_t bytes_read) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (packets_.size() >= max_packets_) {
+    LOG_WARN(LOG_TAG, "%s: encoded ahead queue full, dropping a packet",
+             __func__);
+    osi_free(p_buf);
+    return false;
+  }
+  packets_.push_back(Packet{p_buf, frames_n, bytes_read, encoding_tick_});
+  return true;
+}
+
+void BtifA2dpEncodeAhead::Handoff(uint64_t tick, SendCallback send) {
+  while (true) {
+    Packet packet;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (packets_.empty() || packets_.front().tick + ahead_ticks_ > tick)
+        break;
+      packet = packets_.front();
+      packets_.pop_front();
+    }
+    // Sent without the lock, so the encoder is not blocked meanwhile
+    send(packet.p_buf, packet.frames_n, packet.bytes_read);
+  }
+}
+
+void BtifA2dpEncodeAhead::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void BtifA2dpEncodeAhead::Flush() {
+  WaitIdle();
+  FreePackets();
+}
+
+size_t BtifA2dpEncodeAhead::Length() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return packets_.size();
+}
+
+void BtifA2dpEncodeAhead::FreePackets() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const Packet& packet : packets_) osi_free(packet.p_buf);
+  packets_.clear();
+}
@@ -0,0 +1,415 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_btif_a2dp_jitter_buffer"
+
+#include "btif_a2dp_jitter_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+
+#include "a2dp_api.h"
+#include "osi/include/allocator.h"
+#include "osi/include/log.h"
+
+namespace {
+
+constexpr uint64_t kTickUs = BTIF_SINK_MEDIA_TIME_TICK_MS * 1000;
+
+// The target depth covers the peak delay, one packet and one tick, within
+// these bounds
+constexpr uint64_t kMinTargetDepthUs = 2 * kTickUs;
+constexpr uint64_t kMaxTargetDepthUs = 300 * 1000;
+
+// The oldest packets are dropped when the depth is that much over the target
+constexpr uint64_t kOverflowDepthUs = 150 * 1000;
+
+// Peak delay assumed before any is measured, so playout starts about as late
+// as it did after the 5 packets buffered before there was a jitter buffer
+constexpr uint64_t kInitialPeakDelayUs = 80 * 1000;
+
+// The peak delay decays by 1/kPeakDelayDecay at each packet, and the base
+// transit time follows later arrivals by 1/kBaseTransitWeight so it tracks
+// the drift of the peer clock.
+constexpr uint64_t kPeakDelayDecay = 512;
+constexpr int64_t kBaseTransitWeight = 1024;
+
+// Gain of the interarrival jitter estimator, from RFC 3550
+constexpr int64_t kJitterWeight = 16;
+
+// The depth is averaged over about kDepthWeight ticks, and the playout rate
+// corrected by 1 ppm per kDriftGainUs that average is off the target.
+constexpr int64_t kDepthWeight = 32;
+constexpr int64_t kDriftGainUs = 20;
+constexpr int64_t kMaxDriftPpm = 1000;
+
+// Timestamps are checked to advance at the sample rate, within 1/4, over
+// the first kClockCheckUs of a stream.
+constexpr uint64_t kClockCheckUs = 2 * 1000 * 1000;
+
+// Timestamps not advancing over that many packets in a row play untimed. A
+// single repeat, such as a packet sent twice, is not enough.
+constexpr uint32_t kMaxRepeatedTimestamps = 4;
+
+// Timestamps jumping more than that restart the stream
+constexpr uint32_t kMaxTimestampJumpSeconds = 2;
+
+// Playout clock elapsed at most at each tick, when the thread was stalled
+constexpr uint64_t kMaxPlayoutStepUs = 1000 * 1000;
+
+// Untimed playout starts after kUntimedStartPackets packets and keeps at most
+// kUntimedMaxPackets.
+constexpr size_t kUntimedStartPackets = 5;
+constexpr size_t kUntimedMaxPackets = MAX_PCM_FRAME_NUM_PER_TICK * 2;
+
+constexpr uint64_t kPlayoutFractionUnit = 1000000ULL * 1000000ULL;
+constexpr int64_t kSlipUnit = 1000000;
+
+int32_t timestamp_diff(uint32_t a, uint32_t b) { return (int32_t)(a - b); }
+
+// Stores the mean of two PCM frames, or the second one unless the samples
+// are 16-bit.
+void blend_frames(uint8_t* p_dst, const uint8_t* p_a, const uint8_t* p_b,
+                  size_t frame_bytes, bool pcm_16bit) {
+  if (!pcm_16bit) {
+    memcpy(p_dst, p_b, frame_bytes);
+    return;
+  }
+  for (size_t i = 0; i + sizeof(int16_t) <= frame_bytes;
+       i += sizeof(int16_t)) {
+    int16_t a, b;
+    memcpy(&a, p_a + i, sizeof(a));
+    memcpy(&b, p_b + i, sizeof(b));
+    int16_t mean = (a + b) / 2;
+    memcpy(p_dst + i, &mean, sizeof(mean));
+  }
+}
+
+}  // namespace
+
+BtifA2dpJitterBuffer::BtifA2dpJitterBuffer()
+    : sample_rate_(0),
+      frame_bytes_(0),
+      pcm_16bit_(false),
+      timed_(false),
+      playing_(false),
+      has_newest_(false),
+      newest_timestamp_(0),
+      repeated_timestamps_(0),
+      frames_per_packet_(0),
+      has_released_(false),
+      released_timestamp_(0),
+      playout_timestamp_(0),
+      playout_fraction_(0),
+      last_playout_us_(0),
+      first_arrival_us_(0),
+      last_arrival_us_(0),
+      arrival_frames_(0),
+      base_transit_us_(0),
+      peak_delay_us_(kInitialPeakDelayUs),
+      jitter_us_(0),
+      clock_checked_(false),
+      smoothed_depth_us_(0),
+      slip_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+  SetFormat(0, 0, 0);
+}
+
+BtifA2dpJitterBuffer::~BtifA2dpJitterBuffer() { Flush(); }
+
+void BtifA2dpJitterBuffer::SetFormat(uint32_t sample_rate,
+                                     uint8_t channel_count,
+                                     uint8_t bits_per_sample) {
+  Flush();
+  sample_rate_ = sample_rate;
+  frame_bytes_ = channel_count * bits_per_sample / 8;
+  pcm_16bit_ = (bits_per_sample == 16);
+  timed_ = (sample_rate != 0);
+  frames_per_packet_ = 0;
+  peak_delay_us_ = kInitialPeakDelayUs;
+  jitter_us_ = 0;
+  clock_checked_ = false;
+  slip_ = 0;
+
+  stats_.timed = timed_;
+  stats_.jitter_us = 0;
+  stats_.drift_ppm = 0;
+  UpdateTarget();
+}
+
+void BtifA2dpJitterBuffer::Flush() {
+  for (const Packet& packet : packets_) osi_free(packet.p_pkt);
+  packets_.clear();
+  playing_ = false;
+  // The arrival of the next packet cannot be compared with the last one
+  has_newest_ = false;
+  has_released_ = false;
+  stats_.depth_us = 0;
+  stats_.drift_ppm = 0;
+}
+
+void BtifA2dpJitterBuffer::Enqueue(BT_HDR* p_pkt, uint32_t timestamp,
+                                   uint64_t now_us) {
+  stats_.total_packets++;
+
+  if (timed_) {
+    if (has_newest_ &&
+        (uint32_t)abs(timestamp_diff(timestamp, newest_timestamp_)) >
+            kMaxTimestampJumpSeconds * sample_rate_) {
+      LOG_WARN(LOG_TAG, "%s: timestamp jumped from %u to %u, restarting",
+               __func__, newest_timestamp_, timestamp);
+      Flush();
+    }
+    if (has_released_ && timestamp_diff(timestamp, released_timestamp_) <= 0) {
+      stats_.late_packets++;
+      osi_free(p_pkt);
+      return;
+    }
+    UpdateArrival(timestamp, now_us);
+  }
+
+  if (!timed_) {
+    if (packets_.size() >= kUntimedMaxPackets) DropOldest();
+    packets_.push_back({p_pkt, timestamp});
+    if (packets_.size() >= kUntimedStartPackets) playing_ = true;
+    return;
+  }
+
+  // Keep the packets in timestamp order
+  auto it = packets_.end();
+  while (it != packets_.begin() &&
+         timestamp_diff(timestamp, std::prev(it)->timestamp) < 0) {
+    --it;
+  }
+  packets_.insert(it, {p_pkt, timestamp});
+  UpdateDepth();
+
+  if (!playing_) {
+    if (stats_.depth_us >= stats_.target_depth_us) StartPlayout(now_us);
+    return;
+  }
+
+  // Skip ahead to the target depth when a burst overflows the buffer
+  if (stats_.depth_us <= stats_.target_depth_us + kOverflowDepthUs) return;
+  LOG_WARN(LOG_TAG, "%s: depth %llu us over target %llu us", __func__,
+           (unsigned long long)stats_.depth_us,
+           (unsigned long long)stats_.target_depth_us);
+  while (packets_.size() > 1 && stats_.depth_us > stats_.target_depth_us) {
+    DropOldest();
+    playout_timestamp_ = packets_.front().timestamp;
+    playout_fraction_ = 0;
+    UpdateDepth();
+  }
+  smoothed_depth_us_ = stats_.depth_us;
+}
+
+BT_HDR* BtifA2dpJitterBuffer::Dequeue(uint64_t now_us) {
+  if (!playing_) return nullptr;
+
+  if (!timed_) {
+    if (packets_.empty()) return nullptr;
+    BT_HDR* p_pkt = packets_.front().p_pkt;
+    packets_.pop_front();
+    return p_pkt;
+  }
+
+  if (now_us > last_playout_us_) {
+    uint64_t elapsed_us =
+        std::min(now_us - last_playout_us_, kMaxPlayoutStepUs);
+    last_playout_us_ = now_us;
+    uint64_t units = playout_fraction_ +
+                     elapsed_us * sample_rate_ *
+                         (uint64_t)(1000000 + stats_.drift_ppm);
+    playout_timestamp_ += units / kPlayoutFractionUnit;
+    playout_fraction_ = units % kPlayoutFractionUnit;
+    UpdateDepth();
+    UpdateDrift();
+  }
+
+  if (!packets_.empty() &&
+      timestamp_diff(packets_.front().timestamp, playout_timestamp_) <= 0) {
+    Packet packet = packets_.front();
+    packets_.pop_front();
+    has_released_ = true;
+    released_timestamp_ = packet.timestamp;
+    return packet.p_pkt;
+  }
+
+  if (packets_.empty() && stats_.depth_us == 0) {
+    LOG_DEBUG(LOG_TAG, "%s: underrun at timestamp %u", __func__,
+              playout_timestamp_);
+    stats_.underruns++;
+    playing_ = false;
+    stats_.drift_ppm = 0;
+  }
+  return nullptr;
+}
+
+const uint8_t* BtifA2dpJitterBuffer::AdjustPcm(const uint8_t* p_data,
+                                               uint32_t* p_len) {
+  int64_t ppm = stats_.drift_ppm;
+  if (frame_bytes_ == 0 || ppm == 0) return p_data;
+
+  size_t frames = *p_len / frame_bytes_;
+  int64_t slip = slip_ + (int64_t)frames * ppm;
+  if (slip < kSlipUnit && slip > -kSlipUnit) {
+    slip_ = slip;
+    return p_data;
+  }
+
+  // Playing faster drops a frame, blended into the previous one. Playing
+  // slower repeats the mean of two frames between them.
+  pcm_.clear();
+  size_t next = 0;  // First frame not copied yet
+  for (size_t i = 0; i < frames; i++) {
+    slip_ += ppm;
+    if (i == 0 || (slip_ < kSlipUnit && slip_ > -kSlipUnit)) continue;
+    const uint8_t* p_prev = p_data + (i - 1) * frame_bytes_;
+    const uint8_t* p_frame = p_data + i * frame_bytes_;
+    pcm_.insert(pcm_.end(), p_data + next * frame_bytes_, p_frame);
+    if (slip_ > 0) {
+      blend_frames(&pcm_[pcm_.size() - frame_bytes_], p_prev, p_frame,
+                   frame_bytes_, pcm_16bit_);
+      next = i + 1;
+      slip_ -= kSlipUnit;
+    } else {
+      pcm_.resize(pcm_.size() + frame_bytes_);
+      blend_frames(&pcm_[pcm_.size() - frame_bytes_], p_prev, p_frame,
+                   frame_bytes_, pcm_16bit_);
+      next = i;
+      slip_ += kSlipUnit;
+    }
+  }
+  pcm_.insert(pcm_.end(), p_data + next * frame_bytes_, p_data + *p_len);
+  *p_len = pcm_.size();
+  return pcm_.data();
+}
+
+void BtifA2dpJitterBuffer::StartPlayout(uint64_t now_us) {
+  playing_ = true;
+  playout_timestamp_ = packets_.front().timestamp;
+  playout_fraction_ = 0;
+  last_playout_us_ = now_us;
+  UpdateDepth();
+  smoothed_depth_us_ = stats_.depth_us;
+}
+
+void BtifA2dpJitterBuffer::UpdateArrival(uint32_t timestamp,
+                                         uint64_t now_us) {
+  if (!has_newest_) {
+    has_newest_ = true;
+    newest_timestamp_ = timestamp;
+    repeated_timestamps_ = 0;
+    first_arrival_us_ = now_us;
+    last_arrival_us_ = now_us;
+    arrival_frames_ = 0;
+    base_transit_us_ = now_us;
+    return;
+  }
+
+  // Packets out of order are accounted for when they are late
+  int32_t frames = timestamp_diff(timestamp, newest_timestamp_);
+  if (frames < 0) return;
+  if (frames == 0) {
+    if (++repeated_timestamps_ >= kMaxRepeatedTimestamps)
+      SetUntimed("timestamps do not advance");
+    return;
+  }
+  repeated_timestamps_ = 0;
+  newest_timestamp_ = timestamp;
+  frames_per_packet_ = frames;
+  arrival_frames_ += frames;
+
+  int64_t d =
+      (int64_t)(now_us - last_arrival_us_) - (int64_t)MediaToUs(frames);
+  jitter_us_ += ((d < 0 ? -d : d) - jitter_us_) / kJitterWeight;
+  last_arrival_us_ = now_us;
+
+  // Delay relative to the quickest transit seen
+  int64_t transit_us =
+      (int64_t)now_us - (int64_t)MediaToUs(arrival_frames_);
+  if (transit_us < base_transit_us_) {
+    base_transit_us_ = transit_us;
+  } else {
+    base_transit_us_ += (transit_us - base_transit_us_) / kBaseTransitWeight;
+  }
+  peak_delay_us_ = std::max((uint64_t)(transit_us - base_transit_us_),
+                            peak_delay_us_ - peak_delay_us_ / kPeakDelayDecay);
+
+  stats_.jitter_us = jitter_us_;
+  UpdateTarget();
+
+  if (!clock_checked_ && now_us - first_arrival_us_ >= kClockCheckUs) {
+    clock_checked_ = true;
+    uint64_t rate = arrival_frames_ * 1000000 / (now_us - first_arrival_us_);
+    if (rate < sample_rate_ * 3 / 4 || rate > sample_rate_ * 5 / 4) {
+      LOG_WARN(LOG_TAG, "%s: timestamps advance at %llu Hz, not %u Hz",
+               __func__, (unsigned long long)rate, sample_rate_);
+      SetUntimed("timestamps do not follow the sample rate");
+    }
+  }
+}
+
+void BtifA2dpJitterBuffer::UpdateTarget() {
+  uint64_t target_us = kTickUs + peak_delay_us_;
+  if (sample_rate_ != 0) target_us += MediaToUs(frames_per_packet_);
+  stats_.target_depth_us =
+      std::min(std::max(target_us, kMinTargetDepthUs), kMaxTargetDepthUs);
+}
+
+void BtifA2dpJitterBuffer::UpdateDepth() {
+  int32_t frames = 0;
+  if (has_newest_ && (playing_ || !packets_.empty())) {
+    uint32_t start = playing_ ? playout_timestamp_ : packets_.front().timestamp;
+    frames = timestamp_diff(newest_timestamp_ + frames_per_packet_, start);
+  }
+  stats_.depth_us = (frames > 0) ? MediaToUs(frames) : 0;
+  stats_.max_depth_us = std::max(stats_.max_depth_us, stats_.depth_us);
+}
+
+void BtifA2dpJitterBuffer::UpdateDrift() {
+  smoothed_depth_us_ +=
+      ((int64_t)stats_.depth_us - smoothed_depth_us_) / kDepthWeight;
+  int64_t ppm =
+      (smoothed_depth_us_ - (int64_t)stats_.target_depth_us) / kDriftGainUs;
+  stats_.drift_ppm = std::min(std::max(ppm, -kMaxDriftPpm), kMaxDriftPpm);
+}
+
+void BtifA2dpJitterBuffer::SetUntimed(const char* reason) {
+  LOG_WARN(LOG_TAG, "%s: %s, playing untimed", __func__, reason);
+  timed_ = false;
+  stats_.timed = false;
+  stats_.depth_us = 0;
+  stats_.drift_ppm = 0;
+  if (packets_.size() >= kUntimedStartPackets) playing_ = true;
+}
+
+void BtifA2dpJitterBuffer::DropOldest() {
+  Packet packet = packets_.front();
+  packets_.pop_front();
+  has_released_ = true;
+  released_timestamp_ = packet.timestamp;
+  osi_free(packet.p_pkt);
+  stats_.dropped_packets++;
+}
+
+uint64_t BtifA2dpJitterBuffer::MediaToUs(uint64_t frames) const {
+  return frames * 1000000 / sample_rate_;
+}
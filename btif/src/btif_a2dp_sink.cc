@@ -29,29 +29,20 @@
 
 #include "bt_common.h"
 #include "btif_a2dp.h"
+#include "btif_a2dp_jitter_buffer.h"
 #include "btif_a2dp_sink.h"
 #include "btif_av.h"
 #include "btif_av_co.h"
 #include "btif_avrcp_audio_track.h"
 #include "btif_util.h"
 #include "common/message_loop_thread.h"
-#include "osi/include/fixed_queue.h"
+#include "common/time_util.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 
 using bluetooth::common::MessageLoopThread;
 using LockGuard = std::lock_guard<std::mutex>;
 
-/**
- * The receiving queue buffer size.
- */
-#define MAX_INPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
-
-#define BTIF_SINK_MEDIA_TIME_TICK_MS 20
-
-/* In case of A2DP Sink, we will delay start by 5 AVDTP Packets */
-#define MAX_A2DP_DELAYED_START_FRAME_COUNT 5
-
 enum {
   BTIF_A2DP_SINK_STATE_OFF,
   BTIF_A2DP_SINK_STATE_STARTING_UP,
@@ -82,7 +73,6 @@ class BtifA2dpSinkControlBlock {
  public:
   explicit BtifA2dpSinkControlBlock(const std::string& thread_name)
       : worker_thread(thread_name),
-        rx_audio_queue(nullptr),
         rx_flush(false),
         decode_alarm(nullptr),
         sample_rate(0),
@@ -97,8 +87,7 @@ class BtifA2dpSinkControlBlock {
       BtifAvrcpAudioTrackDelete(audio_track);
     }
     audio_track = nullptr;
-    fixed_queue_free(rx_audio_queue, nullptr);
-    rx_audio_queue = nullptr;
+    jitter_buffer.SetFormat(0, 0, 0);
     alarm_free(decode_alarm);
     decode_alarm = nullptr;
     rx_flush = false;
@@ -109,7 +98,7 @@ class BtifA2dpSinkControlBlock {
   }
 
   MessageLoopThread worker_thread;
-  fixed_queue_t* rx_audio_queue;
+  BtifA2dpJitterBuffer jitter_buffer;
   bool rx_flush; /* discards any incoming data when true */
   alarm_t* decode_alarm;
   tA2DP_SAMPLE_RATE sample_rate;
@@ -182,8 +171,6 @@ bool btif_a2dp_sink_init() {
     return false;
   }
 
-  btif_a2dp_sink_cb.rx_audio_queue = fixed_queue_new(SIZE_MAX);
-
   /* Schedule the rest of the operations */
   if (!btif_a2dp_sink_cb.worker_thread.EnableRealTimeScheduling()) {
     LOG(FATAL) << __func__
@@ -323,8 +310,7 @@ static void btif_a2dp_sink_cleanup_delayed() {
   LOG_INFO(LOG_TAG, "%s", __func__);
   LockGuard lock(g_mutex);
 
-  fixed_queue_free(btif_a2dp_sink_cb.rx_audio_queue, nullptr);
-  btif_a2dp_sink_cb.rx_audio_queue = nullptr;
+  btif_a2dp_sink_cb.jitter_buffer.Flush();
   btif_a2dp_sink_state = BTIF_A2DP_SINK_STATE_OFF;
 }
 
@@ -415,10 +401,10 @@ static void btif_a2dp_sink_audio_handle_stop_decoding() {
   {
     LockGuard lock(g_mutex);
     btif_a2dp_sink_cb.rx_flush = true;
-    btif_a2dp_sink_audio_rx_flush_req();
     old_alarm = btif_a2dp_sink_cb.decode_alarm;
     btif_a2dp_sink_cb.decode_alarm = nullptr;
   }
+  btif_a2dp_sink_audio_rx_flush_req();
 
   // Drop the lock here, btif_decode_alarm_cb may in the process of being called
   // while we alarm free leading to deadlock.
@@ -470,10 +456,12 @@ static void btif_a2dp_sink_audio_handle_start_decoding() {
             btif_decode_alarm_cb, nullptr);
 }
 
+// Must be called while locked.
 static void btif_a2dp_sink_on_decode_complete(uint8_t* data, uint32_t len) {
 #ifndef OS_GENERIC
+  const uint8_t* pcm = btif_a2dp_sink_cb.jitter_buffer.AdjustPcm(data, &len);
   BtifAvrcpAudioTrackWriteData(btif_a2dp_sink_cb.audio_track,
-                               reinterpret_cast<void*>(data), len);
+                               const_cast<uint8_t*>(pcm), len);
 #endif
 }
 
@@ -495,11 +483,6 @@ static void btif_a2dp_sink_avk_handle_timer() {
   LockGuard lock(g_mutex);
 
   BT_HDR* p_msg;
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
-    APPL_TRACE_DEBUG("%s: empty queue", __func__);
-    return;
-  }
-
   /* Don't do anything in case of focus not granted */
   if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_NOT_GRANTED) {
     APPL_TRACE_DEBUG("%s: skipping frames since focus is not present",
@@ -508,18 +491,20 @@ static void btif_a2dp_sink_avk_handle_timer() {
   }
   /* Play only in BTIF_A2DP_SINK_FOCUS_GRANTED case */
   if (btif_a2dp_sink_cb.rx_flush) {
-    fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_cb.jitter_buffer.Flush();
     return;
   }
 
+  // Even with no packet queued, the jitter buffer accounts for the underrun
   APPL_TRACE_DEBUG("%s: process frames begin", __func__);
+  uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
   while (true) {
-    p_msg = (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue);
+    p_msg = btif_a2dp_sink_cb.jitter_buffer.Dequeue(now_us);
     if (p_msg == NULL) {
       break;
     }
     APPL_TRACE_DEBUG("%s: number of packets in queue %zu", __func__,
-                     fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue));
+                     btif_a2dp_sink_cb.jitter_buffer.Length());
 
     /* Queue packet has less frames */
     btif_a2dp_sink_handle_inc_media(p_msg);
@@ -540,7 +525,7 @@ static void btif_a2dp_sink_audio_rx_flush_event() {
   LOG_INFO(LOG_TAG, "%s", __func__);
   LockGuard lock(g_mutex);
   // Flush all received encoded audio buffers
-  fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+  btif_a2dp_sink_cb.jitter_buffer.Flush();
 }
 
 static void btif_a2dp_sink_decoder_update_event(
@@ -575,6 +560,8 @@ static void btif_a2dp_sink_decoder_update_event(
   btif_a2dp_sink_cb.sample_rate = sample_rate;
   btif_a2dp_sink_cb.bits_per_sample = bits_per_sample;
   btif_a2dp_sink_cb.channel_count = channel_count;
+  btif_a2dp_sink_cb.jitter_buffer.SetFormat(sample_rate, channel_count,
+                                            bits_per_sample);
 
   btif_a2dp_sink_cb.rx_flush = false;
   APPL_TRACE_DEBUG("%s: reset to Sink role", __func__);
@@ -608,35 +595,33 @@ static void btif_a2dp_sink_decoder_update_event(
 uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
   LockGuard lock(g_mutex);
   if (btif_a2dp_sink_cb.rx_flush) /* Flush enabled, do not enqueue */
-    return fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
-
-  if (fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) ==
-      MAX_INPUT_A2DP_FRAME_QUEUE_SZ) {
-    uint8_t ret = fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
-    osi_free(fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue));
-    return ret;
-  }
+    return btif_a2dp_sink_cb.jitter_buffer.Length();
 
   BTIF_TRACE_VERBOSE("%s +", __func__);
+  // The RTP timestamp is stored ahead of the payload by bta_av_sink_data_cback
+  uint32_t timestamp = *((uint32_t*)(p_pkt + 1));
+
   /* Allocate and queue this buffer */
   BT_HDR* p_msg =
       reinterpret_cast<BT_HDR*>(osi_malloc(sizeof(*p_msg) + p_pkt->len));
   memcpy(p_msg, p_pkt, sizeof(*p_msg));
   p_msg->offset = 0;
   memcpy(p_msg->data, p_pkt->data + p_pkt->offset, p_pkt->len);
-  fixed_queue_enqueue(btif_a2dp_sink_cb.rx_audio_queue, p_msg);
-  if (fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) ==
-      MAX_A2DP_DELAYED_START_FRAME_COUNT) {
+  btif_a2dp_sink_cb.jitter_buffer.Enqueue(
+      p_msg, timestamp, bluetooth::common::time_get_os_boottime_us());
+  if (btif_a2dp_sink_cb.decode_alarm == nullptr &&
+      btif_a2dp_sink_cb.jitter_buffer.IsPlaying()) {
     BTIF_TRACE_DEBUG("%s: Initiate decoding", __func__);
     btif_a2dp_sink_audio_handle_start_decoding();
   }
 
-  return fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
+  return btif_a2dp_sink_cb.jitter_buffer.Length();
 }
 
 void btif_a2dp_sink_audio_rx_flush_req() {
   LOG_INFO(LOG_TAG, "%s", __func__);
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
+  LockGuard lock(g_mutex);
+  if (btif_a2dp_sink_cb.jitter_buffer.Length() == 0) {
     /* Queue is already empty */
     return;
   }
@@ -647,8 +632,42 @@ void btif_a2dp_sink_audio_rx_flush_req() {
       FROM_HERE, base::BindOnce(btif_a2dp_sink_command_ready, p_buf));
 }
 
-void btif_a2dp_sink_debug_dump(UNUSED_ATTR int fd) {
-  // Nothing to do
+void btif_a2dp_sink_debug_dump(int fd) {
+  LockGuard lock(g_mutex);
+  const BtifA2dpJitterBuffer& jitter_buffer = btif_a2dp_sink_cb.jitter_buffer;
+  const BtifA2dpJitterBuffer::Stats& stats = jitter_buffer.GetStats();
+
+  dprintf(fd, "\nA2DP Sink State:\n");
+  dprintf(fd, "  RxQueue:\n");
+
+  dprintf(fd,
+          "  Playout clock                                           : %s\n",
+          stats.timed ? "RTP timestamps" : "untimed");
+
+  dprintf(fd,
+          "  Packets queued                                          : %zu\n",
+          jitter_buffer.Length());
+
+  dprintf(fd,
+          "  Depth in ms (current/target/max)                        : %llu / "
+          "%llu / %llu\n",
+          (unsigned long long)stats.depth_us / 1000,
+          (unsigned long long)stats.target_depth_us / 1000,
+          (unsigned long long)stats.max_depth_us / 1000);
+
+  dprintf(fd,
+          "  Counts (received/late/dropped/underruns)                : %zu / "
+          "%zu / %zu / %zu\n",
+          stats.total_packets, stats.late_packets, stats.dropped_packets,
+          stats.underruns);
+
+  dprintf(fd,
+          "  Interarrival jitter in us                               : %llu\n",
+          (unsigned long long)stats.jitter_us);
+
+  dprintf(fd,
+          "  Playout rate correction in ppm                          : %d\n",
+          stats.drift_ppm);
 }
 
 void btif_a2dp_sink_set_focus_state_req(btif_a2dp_sink_focus_state_t state) {
@@ -670,7 +689,7 @@ static void btif_a2dp_sink_set_focus_state_event(
   APPL_TRACE_DEBUG("%s: setting focus state to %d", __func__, state);
   btif_a2dp_sink_cb.rx_focus_state = state;
   if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_NOT_GRANTED) {
-    fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_cb.jitter_buffer.Flush();
     btif_a2dp_sink_cb.rx_flush = true;
   } else if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_GRANTED) {
     btif_a2dp_sink_cb.rx_flush = false;
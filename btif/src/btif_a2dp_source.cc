@@ -28,6 +28,9 @@
 #include <limits.h>
 #include <string.h>
 #include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
 
 #include "audio_a2dp_hw/include/audio_a2dp_hw.h"
 #include "audio_hal_interface/a2dp_encoding.h"
@@ -36,6 +39,7 @@
 #include "btif_a2dp.h"
 #include "btif_a2dp_audio_interface.h"
 #include "btif_a2dp_control.h"
+#include "btif_a2dp_encode_ahead.h"
 #include "btif_a2dp_source.h"
 #include "btif_av.h"
 #include "btif_av_co.h"
@@ -47,6 +51,7 @@
 #include "osi/include/fixed_queue.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "osi/include/wakelock.h"
 #include "uipc.h"
 
@@ -63,6 +68,19 @@ extern std::unique_ptr<tUIPC_STATE> a2dp_uipc;
  */
 #define MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
 
+/**
+ * Number of media ticks the encoding runs ahead of the transmission. When
+ * set, a worker thread encodes the audio read on a tick and the media
+ * packets are handed to the transmit queue that many ticks later, so the
+ * encoding time does not delay the tick. 0 encodes on the tick itself.
+ */
+#define A2DP_SOURCE_ENCODE_AHEAD_PROP "persist.bluetooth.a2dp_encode_ahead"
+#define A2DP_SOURCE_MAX_ENCODE_AHEAD_TICKS 2
+
+/* Media packets encoded ahead and not handed to the transmit queue yet */
+#define MAX_ENCODED_AHEAD_QUEUE_SZ \
+  (MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ * (A2DP_SOURCE_MAX_ENCODE_AHEAD_TICKS + 1))
+
 class SchedulingStats {
  public:
   SchedulingStats() { Reset(); }
@@ -77,6 +95,9 @@ class SchedulingStats {
     max_premature_scheduling_delta_us = 0;
     exact_scheduling_count = 0;
     total_scheduling_time_us = 0;
+    processing_count = 0;
+    total_processing_time_us = 0;
+    max_processing_time_us = 0;
   }
 
   // Counter for total updates
@@ -108,6 +129,15 @@ class SchedulingStats {
 
   // Accumulated and counted scheduling time (in us)
   uint64_t total_scheduling_time_us;
+
+  // Number of times the scheduled work was timed
+  size_t processing_count;
+
+  // Accumulated time spent in the scheduled work (in us)
+  uint64_t total_processing_time_us;
+
+  // Max. time spent in the scheduled work (in us)
+  uint64_t max_processing_time_us;
 };
 
 class BtifMediaStats {
@@ -118,6 +148,7 @@ class BtifMediaStats {
     session_end_us = 0;
     tx_queue_enqueue_stats.Reset();
     tx_queue_dequeue_stats.Reset();
+    tx_queue_encode_stats.Reset();
     tx_queue_total_frames = 0;
     tx_queue_max_frames_per_packet = 0;
     tx_queue_total_queueing_time_us = 0;
@@ -141,6 +172,7 @@ class BtifMediaStats {
 
   SchedulingStats tx_queue_enqueue_stats;
   SchedulingStats tx_queue_dequeue_stats;
+  SchedulingStats tx_queue_encode_stats;
 
   size_t tx_queue_total_frames;
   size_t tx_queue_max_frames_per_packet;
@@ -166,6 +198,26 @@ class BtifMediaStats {
   int codec_index = -1;
 };
 
+// The statistics updated by the encoder, on the encoder thread when encoding
+// ahead. They are merged into BtifMediaStats on the media thread.
+class BtifEncoderStats {
+ public:
+  BtifEncoderStats() { Reset(); }
+  void Reset() {
+    tx_queue_encode_stats.Reset();
+    media_read_total_underflow_bytes = 0;
+    media_read_total_underflow_count = 0;
+    media_read_last_underflow_us = 0;
+  }
+
+  SchedulingStats tx_queue_encode_stats;
+
+  size_t media_read_total_underflow_bytes;
+  size_t media_read_total_underflow_count;
+  uint64_t media_read_last_underflow_us;
+};
+
+
 class BtifA2dpSource {
  public:
   enum RunState {
@@ -178,6 +230,7 @@ class BtifA2dpSource {
   BtifA2dpSource()
       : tx_audio_queue(nullptr),
         tx_flush(false),
+        tick_count(0),
         encoder_interface(nullptr),
         encoder_interval_ms(0),
         state_(kStateOff) {}
@@ -185,13 +238,19 @@ class BtifA2dpSource {
   void Reset() {
     fixed_queue_free(tx_audio_queue, nullptr);
     tx_audio_queue = nullptr;
+    encode_ahead.reset();
     tx_flush = false;
+    tick_count = 0;
     media_alarm.CancelAndWait();
     wakelock_release();
     encoder_interface = nullptr;
     encoder_interval_ms = 0;
     stats.Reset();
     accumulated_stats.Reset();
+    {
+      std::lock_guard<std::mutex> lock(encoder_stats_mutex);
+      encoder_stats.Reset();
+    }
     state_ = kStateOff;
   }
 
@@ -212,12 +271,17 @@ class BtifA2dpSource {
   void SetState(BtifA2dpSource::RunState state) { state_ = state; }
 
   fixed_queue_t* tx_audio_queue;
-  bool tx_flush; /* Discards any outgoing data when true */
+  /* Packets encoded ahead, null when encoding on the media tick */
+  std::unique_ptr<BtifA2dpEncodeAhead> encode_ahead;
+  bool tx_flush;       /* Discards any outgoing data when true */
+  uint64_t tick_count; /* Media ticks since the start */
   RepeatingTimer media_alarm;
   const tA2DP_ENCODER_INTERFACE* encoder_interface;
   uint64_t encoder_interval_ms; /* Local copy of the encoder interval */
   BtifMediaStats stats;
   BtifMediaStats accumulated_stats;
+  std::mutex encoder_stats_mutex; /* Protects encoder_stats */
+  BtifEncoderStats encoder_stats; /* Not merged into stats yet */
 
  private:
   BtifA2dpSource::RunState state_;
@@ -225,6 +289,10 @@ class BtifA2dpSource {
 
 static bluetooth::common::MessageLoopThread btif_a2dp_source_thread(
     "bt_a2dp_source_worker_thread");
+// Encodes ahead of the media tick when A2DP_SOURCE_ENCODE_AHEAD_PROP is set.
+// It keeps the default priority, so the real time media tick preempts it.
+static bluetooth::common::MessageLoopThread btif_a2dp_source_encoder_thread(
+    "bt_a2dp_source_encoder_thread");
 static BtifA2dpSource btif_a2dp_source_cb;
 
 static void btif_a2dp_source_init_delayed(void);
@@ -251,12 +319,22 @@ static void btif_a2dp_source_audio_feeding_update_event(
     const btav_a2dp_codec_config_t& codec_audio_config);
 static bool btif_a2dp_source_audio_tx_flush_req(void);
 static void btif_a2dp_source_audio_handle_timer(void);
+static void btif_a2dp_source_encode(uint64_t timestamp_us,
+                                    size_t transmit_queue_length);
+static void btif_a2dp_source_encode_ahead(uint64_t tick, uint64_t timestamp_us,
+                                          size_t transmit_queue_length);
+static void btif_a2dp_source_merge_encoder_stats(void);
+static void btif_a2dp_source_encoder_wait_idle(void);
 static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len);
 static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
                                               uint32_t bytes_read);
+static bool btif_a2dp_source_enqueue_packet(BT_HDR* p_buf, size_t frames_n,
+                                            uint32_t bytes_read);
 static void log_tstamps_us(const char* comment, uint64_t timestamp_us);
 static void update_scheduling_stats(SchedulingStats* stats, uint64_t now_us,
                                     uint64_t expected_delta);
+static void update_processing_stats(SchedulingStats* stats,
+                                    uint64_t processing_time_us);
 // Update the A2DP Source related metrics.
 // This function should be called before collecting the metrics.
 static void btif_a2dp_source_update_metrics(void);
@@ -283,6 +361,10 @@ void btif_a2dp_source_accumulate_scheduling_stats(SchedulingStats* src,
                src->max_premature_scheduling_delta_us);
   dst->exact_scheduling_count += src->exact_scheduling_count;
   dst->total_scheduling_time_us += src->total_scheduling_time_us;
+  dst->processing_count += src->processing_count;
+  dst->total_processing_time_us += src->total_processing_time_us;
+  dst->max_processing_time_us =
+      std::max(dst->max_processing_time_us, src->max_processing_time_us);
 }
 
 void btif_a2dp_source_accumulate_stats(BtifMediaStats* src,
@@ -312,6 +394,8 @@ void btif_a2dp_source_accumulate_stats(BtifMediaStats* src,
                                                &dst->tx_queue_enqueue_stats);
   btif_a2dp_source_accumulate_scheduling_stats(&src->tx_queue_dequeue_stats,
                                                &dst->tx_queue_dequeue_stats);
+  btif_a2dp_source_accumulate_scheduling_stats(&src->tx_queue_encode_stats,
+                                               &dst->tx_queue_encode_stats);
   src->Reset();
 }
 
@@ -364,6 +448,18 @@ static void btif_a2dp_source_startup_delayed() {
       btif_a2dp_control_init();
     }
   }
+
+  int32_t encode_ahead_ticks =
+      osi_property_get_int32(A2DP_SOURCE_ENCODE_AHEAD_PROP, 0);
+  if (encode_ahead_ticks > 0 && !btif_av_is_a2dp_offload_enabled()) {
+    btif_a2dp_source_cb.encode_ahead.reset(new BtifA2dpEncodeAhead(
+        std::min(encode_ahead_ticks,
+                 (int32_t)A2DP_SOURCE_MAX_ENCODE_AHEAD_TICKS),
+        MAX_ENCODED_AHEAD_QUEUE_SZ));
+    btif_a2dp_source_encoder_thread.StartUp();
+    LOG_INFO(LOG_TAG, "%s: encoding %d media ticks ahead", __func__,
+             btif_a2dp_source_cb.encode_ahead->AheadTicks());
+  }
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateRunning);
 }
 
@@ -499,6 +595,12 @@ static void btif_a2dp_source_shutdown_delayed(void) {
   btif_a2dp_source_cb.media_alarm.CancelAndWait();
   wakelock_release();
 
+  // Stop encoding ahead, once the encodings posted are done
+  btif_a2dp_source_encoder_wait_idle();
+  if (btif_a2dp_source_encoder_thread.IsRunning())
+    btif_a2dp_source_encoder_thread.ShutDown();
+  btif_a2dp_source_cb.encode_ahead.reset();
+
   if (bluetooth::audio::a2dp::is_hal_2_0_enabled()) {
     bluetooth::audio::a2dp::cleanup();
   } else if (btif_av_is_a2dp_offload_enabled()) {
@@ -573,6 +675,7 @@ static void btif_a2dp_source_setup_codec_delayed(
               __func__, peer_address.ToString().c_str());
     return;
   }
+  btif_a2dp_source_encoder_wait_idle();
   btif_a2dp_source_cb.encoder_interface = bta_av_co_get_encoder_interface();
   if (btif_a2dp_source_cb.encoder_interface == nullptr) {
     LOG_ERROR(LOG_TAG, "%s: Cannot stream audio: no source encoder interface",
@@ -633,6 +736,7 @@ static void btif_a2dp_source_encoder_user_config_update_event(
   LOG_INFO(LOG_TAG, "%s: peer_address=%s state=%s", __func__,
            peer_address.ToString().c_str(),
            btif_a2dp_source_cb.StateStr().c_str());
+  btif_a2dp_source_encoder_wait_idle();
   if (!bta_av_co_set_codec_user_config(peer_address, codec_user_config)) {
     LOG_ERROR(LOG_TAG, "%s: cannot update codec user configuration", __func__);
   }
@@ -651,6 +755,7 @@ static void btif_a2dp_source_audio_feeding_update_event(
     const btav_a2dp_codec_config_t& codec_audio_config) {
   LOG_INFO(LOG_TAG, "%s: state=%s", __func__,
            btif_a2dp_source_cb.StateStr().c_str());
+  btif_a2dp_source_encoder_wait_idle();
   if (!bta_av_co_set_codec_audio_config(codec_audio_config)) {
     LOG_ERROR(LOG_TAG, "%s: cannot update codec audio feeding parameters",
               __func__);
@@ -752,7 +857,9 @@ static void btif_a2dp_source_audio_tx_start_event(void) {
 
   /* Reset the media feeding state */
   CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
+  btif_a2dp_source_encoder_wait_idle();
   btif_a2dp_source_cb.encoder_interface->feeding_reset();
+  btif_a2dp_source_cb.tick_count = 0;
 
   APPL_TRACE_EVENT(
       "%s: starting timer %" PRIu64 " ms", __func__,
@@ -766,6 +873,10 @@ static void btif_a2dp_source_audio_tx_start_event(void) {
           btif_a2dp_source_cb.encoder_interface->get_encoder_interval_ms()));
 
   btif_a2dp_source_cb.stats.Reset();
+  {
+    std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.encoder_stats_mutex);
+    btif_a2dp_source_cb.encoder_stats.Reset();
+  }
   // Assign session_start_us to 1 when
   // bluetooth::common::time_get_os_boottime_us() is 0 to indicate
   // btif_a2dp_source_start_audio_req() has been called
@@ -790,6 +901,10 @@ static void btif_a2dp_source_audio_tx_stop_event(void) {
 
   if (btif_av_is_a2dp_offload_enabled()) return;
 
+  // The encoder may still be encoding the last tick
+  btif_a2dp_source_encoder_wait_idle();
+  btif_a2dp_source_merge_encoder_stats();
+
   btif_a2dp_source_cb.stats.session_end_us =
       bluetooth::common::time_get_os_boottime_us();
   btif_a2dp_source_update_metrics();
@@ -812,6 +927,10 @@ static void btif_a2dp_source_audio_tx_stop_event(void) {
   btif_a2dp_source_cb.media_alarm.CancelAndWait();
   wakelock_release();
 
+  /* Audio encoded ahead would be sent after the stream is stopped */
+  if (btif_a2dp_source_cb.encode_ahead)
+    btif_a2dp_source_cb.encode_ahead->Flush();
+
   if (bluetooth::audio::a2dp::is_hal_2_0_enabled()) {
     bluetooth::audio::a2dp::ack_stream_suspended(A2DP_CTRL_ACK_SUCCESS);
   } else if (a2dp_uipc != nullptr) {
@@ -853,21 +972,100 @@ static void btif_a2dp_source_audio_handle_timer(void) {
     return;
   }
   CHECK(btif_a2dp_source_cb.encoder_interface != nullptr);
+  BtifA2dpEncodeAhead* encode_ahead = btif_a2dp_source_cb.encode_ahead.get();
+  uint64_t tick = ++btif_a2dp_source_cb.tick_count;
+  // Send what was encoded on earlier ticks, and encode this one meanwhile
+  if (encode_ahead != nullptr)
+    encode_ahead->Handoff(tick, btif_a2dp_source_enqueue_packet);
+
+  // The packets encoded ahead are still to be sent, so the encoder counts
+  // them with the transmit queue
   size_t transmit_queue_length =
       fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+  if (encode_ahead != nullptr) transmit_queue_length += encode_ahead->Length();
 #ifndef OS_GENERIC
   ATRACE_INT("btif TX queue", transmit_queue_length);
 #endif
+  if (encode_ahead == nullptr) {
+    btif_a2dp_source_encode(timestamp_us, transmit_queue_length);
+  } else {
+    encode_ahead->EncodePosted();
+    if (!btif_a2dp_source_encoder_thread.DoInThread(
+            FROM_HERE, base::Bind(&btif_a2dp_source_encode_ahead, tick,
+                                  timestamp_us, transmit_queue_length))) {
+      encode_ahead->EncodePosted(false);
+    }
+  }
+  btif_a2dp_source_merge_encoder_stats();
+  bta_av_ci_src_data_ready(BTA_AV_CHNL_AUDIO);
+  update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
+                          timestamp_us,
+                          btif_a2dp_source_cb.encoder_interval_ms * 1000);
+  update_processing_stats(
+      &btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
+      bluetooth::common::time_get_os_boottime_us() - timestamp_us);
+}
+
+// Reads and encodes the audio of a media tick, on the media tick or ahead of
+// it on the encoder thread.
+static void btif_a2dp_source_encode(uint64_t timestamp_us,
+                                    size_t transmit_queue_length) {
+  uint64_t start_us = bluetooth::common::time_get_os_boottime_us();
+  SchedulingStats* encode_stats =
+      &btif_a2dp_source_cb.encoder_stats.tx_queue_encode_stats;
+  {
+    std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.encoder_stats_mutex);
+    update_scheduling_stats(encode_stats, start_us,
+                            btif_a2dp_source_cb.encoder_interval_ms * 1000);
+  }
+
   if (btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length !=
       nullptr) {
     btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length(
         transmit_queue_length);
   }
+  // The tick time paces the encoder, not the time the encoding starts
   btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
-  bta_av_ci_src_data_ready(BTA_AV_CHNL_AUDIO);
-  update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
-                          timestamp_us,
-                          btif_a2dp_source_cb.encoder_interval_ms * 1000);
+
+  uint64_t end_us = bluetooth::common::time_get_os_boottime_us();
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.encoder_stats_mutex);
+  update_processing_stats(encode_stats, end_us - start_us);
+}
+
+// Encodes the audio of media tick |tick| on the encoder thread.
+static void btif_a2dp_source_encode_ahead(uint64_t tick, uint64_t timestamp_us,
+                                          size_t transmit_queue_length) {
+  btif_a2dp_source_cb.encode_ahead->EncodeStarted(tick);
+  btif_a2dp_source_encode(timestamp_us, transmit_queue_length);
+  btif_a2dp_source_cb.encode_ahead->EncodeDone();
+}
+
+// Merges the statistics updated by the encoder into the media statistics.
+// Called on the media thread, which owns btif_a2dp_source_cb.stats.
+static void btif_a2dp_source_merge_encoder_stats(void) {
+  std::lock_guard<std::mutex> lock(btif_a2dp_source_cb.encoder_stats_mutex);
+  BtifEncoderStats* src = &btif_a2dp_source_cb.encoder_stats;
+  BtifMediaStats* dst = &btif_a2dp_source_cb.stats;
+  btif_a2dp_source_accumulate_scheduling_stats(&src->tx_queue_encode_stats,
+                                               &dst->tx_queue_encode_stats);
+  dst->media_read_total_underflow_bytes +=
+      src->media_read_total_underflow_bytes;
+  dst->media_read_total_underflow_count +=
+      src->media_read_total_underflow_count;
+  if (src->media_read_total_underflow_count > 0)
+    dst->media_read_last_underflow_us = src->media_read_last_underflow_us;
+  // The next encoding is scheduled relative to the last one
+  uint64_t last_update_us = src->tx_queue_encode_stats.last_update_us;
+  src->Reset();
+  src->tx_queue_encode_stats.last_update_us = last_update_us;
+}
+
+// Waits for the encoder thread to be done with the ticks it was given, so
+// the encoder can be used on the media thread. No other tick is given to it
+// meanwhile, as the media tick runs on the media thread.
+static void btif_a2dp_source_encoder_wait_idle(void) {
+  if (btif_a2dp_source_cb.encode_ahead)
+    btif_a2dp_source_cb.encode_ahead->WaitIdle();
 }
 
 static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
@@ -883,11 +1081,15 @@ static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
   if (bytes_read < len) {
     LOG_WARN(LOG_TAG, "%s: UNDERFLOW: ONLY READ %d BYTES OUT OF %d", __func__,
              bytes_read, len);
-    btif_a2dp_source_cb.stats.media_read_total_underflow_bytes +=
-        (len - bytes_read);
-    btif_a2dp_source_cb.stats.media_read_total_underflow_count++;
-    btif_a2dp_source_cb.stats.media_read_last_underflow_us =
-        bluetooth::common::time_get_os_boottime_us();
+    {
+      std::lock_guard<std::mutex> lock(
+          btif_a2dp_source_cb.encoder_stats_mutex);
+      btif_a2dp_source_cb.encoder_stats.media_read_total_underflow_bytes +=
+          (len - bytes_read);
+      btif_a2dp_source_cb.encoder_stats.media_read_total_underflow_count++;
+      btif_a2dp_source_cb.encoder_stats.media_read_last_underflow_us =
+          bluetooth::common::time_get_os_boottime_us();
+    }
     bluetooth::common::LogA2dpAudioUnderrunEvent(
         btif_av_source_active_peer(), btif_a2dp_source_cb.encoder_interval_ms,
         len - bytes_read);
@@ -898,6 +1100,16 @@ static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
 
 static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
                                               uint32_t bytes_read) {
+  if (btif_a2dp_source_cb.encode_ahead == nullptr)
+    return btif_a2dp_source_enqueue_packet(p_buf, frames_n, bytes_read);
+
+  // On the encoder thread: keep the packet for its media tick
+  return btif_a2dp_source_cb.encode_ahead->Enqueue(p_buf, frames_n,
+                                                   bytes_read);
+}
+
+static bool btif_a2dp_source_enqueue_packet(BT_HDR* p_buf, size_t frames_n,
+                                            uint32_t bytes_read) {
   uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
   btif_a2dp_control_log_bytes_read(bytes_read);
 
@@ -997,8 +1209,11 @@ static void btif_a2dp_source_audio_tx_flush_event(void) {
            btif_a2dp_source_cb.StateStr().c_str());
   if (btif_av_is_a2dp_offload_enabled()) return;
 
+  btif_a2dp_source_encoder_wait_idle();
   if (btif_a2dp_source_cb.encoder_interface != nullptr)
     btif_a2dp_source_cb.encoder_interface->feeding_flush();
+  if (btif_a2dp_source_cb.encode_ahead)
+    btif_a2dp_source_cb.encode_ahead->Flush();
 
   btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
       fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
@@ -1085,6 +1300,14 @@ static void update_scheduling_stats(SchedulingStats* stats, uint64_t now_us,
   }
 }
 
+static void update_processing_stats(SchedulingStats* stats,
+                                    uint64_t processing_time_us) {
+  stats->processing_count++;
+  stats->total_processing_time_us += processing_time_us;
+  stats->max_processing_time_us =
+      std::max(processing_time_us, stats->max_processing_time_us);
+}
+
 void btif_a2dp_source_debug_dump(int fd) {
   btif_a2dp_source_accumulate_stats(&btif_a2dp_source_cb.stats,
                                     &btif_a2dp_source_cb.accumulated_stats);
@@ -1092,6 +1315,7 @@ void btif_a2dp_source_debug_dump(int fd) {
   BtifMediaStats* accumulated_stats = &btif_a2dp_source_cb.accumulated_stats;
   SchedulingStats* enqueue_stats = &accumulated_stats->tx_queue_enqueue_stats;
   SchedulingStats* dequeue_stats = &accumulated_stats->tx_queue_dequeue_stats;
+  SchedulingStats* encode_stats = &accumulated_stats->tx_queue_encode_stats;
   size_t ave_size;
   uint64_t ave_time_us;
 
@@ -1211,6 +1435,75 @@ void btif_a2dp_source_debug_dump(int fd) {
           1000,
       (unsigned long long)ave_time_us / 1000);
 
+  // Time spent on the media tick, reading and encoding included unless the
+  // encoding is done ahead
+  ave_time_us = 0;
+  if (enqueue_stats->processing_count != 0) {
+    ave_time_us = enqueue_stats->total_processing_time_us /
+                  enqueue_stats->processing_count;
+  }
+  dprintf(
+      fd,
+      "  Enqueue tick handling time in us (total/max/ave)        : %llu / %llu "
+      "/ %llu\n",
+      (unsigned long long)enqueue_stats->total_processing_time_us,
+      (unsigned long long)enqueue_stats->max_processing_time_us,
+      (unsigned long long)ave_time_us);
+
+  //
+  // Encoding stats
+  //
+  dprintf(fd,
+          "  Encoding ahead in media ticks                           : %u\n",
+          btif_a2dp_source_cb.encode_ahead
+              ? btif_a2dp_source_cb.encode_ahead->AheadTicks()
+              : 0);
+
+  dprintf(
+      fd,
+      "  Encode deviation counts (overdue/premature)             : %zu / %zu\n",
+      encode_stats->overdue_scheduling_count,
+      encode_stats->premature_scheduling_count);
+
+  ave_time_us = 0;
+  if (encode_stats->overdue_scheduling_count != 0) {
+    ave_time_us = encode_stats->total_overdue_scheduling_delta_us /
+                  encode_stats->overdue_scheduling_count;
+  }
+  dprintf(
+      fd,
+      "  Encode overdue scheduling time in us (total/max/ave)    : %llu / %llu "
+      "/ %llu\n",
+      (unsigned long long)encode_stats->total_overdue_scheduling_delta_us,
+      (unsigned long long)encode_stats->max_overdue_scheduling_delta_us,
+      (unsigned long long)ave_time_us);
+
+  ave_time_us = 0;
+  if (encode_stats->premature_scheduling_count != 0) {
+    ave_time_us = encode_stats->total_premature_scheduling_delta_us /
+                  encode_stats->premature_scheduling_count;
+  }
+  dprintf(
+      fd,
+      "  Encode premature scheduling time in us (total/max/ave)  : %llu / %llu "
+      "/ %llu\n",
+      (unsigned long long)encode_stats->total_premature_scheduling_delta_us,
+      (unsigned long long)encode_stats->max_premature_scheduling_delta_us,
+      (unsigned long long)ave_time_us);
+
+  ave_time_us = 0;
+  if (encode_stats->processing_count != 0) {
+    ave_time_us = encode_stats->total_processing_time_us /
+                  encode_stats->processing_count;
+  }
+  dprintf(
+      fd,
+      "  Encode time in us (total/max/ave)                       : %llu / %llu "
+      "/ %llu\n",
+      (unsigned long long)encode_stats->total_processing_time_us,
+      (unsigned long long)encode_stats->max_processing_time_us,
+      (unsigned long long)ave_time_us);
+
   //
   // TxQueue dequeue stats
   //
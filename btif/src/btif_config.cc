@@ -101,7 +101,9 @@ static std::string btif_convert_to_unencrypt_key(
 static bool btif_in_encrypt_key_name_list(std::string key);
 static bool btif_is_key_encrypted(int key_from_config_size,
                                   std::string key_type_string);
+static bool btif_config_section_is_persistent(const section_t& section);
 static std::string hash_file(const char* filename);
+static std::string hash_buffer(const std::string& buffer);
 static std::string read_checksum_file(const char* filename);
 static void write_checksum_file(const char* filename, const std::string& hash);
 
@@ -186,6 +188,8 @@ static void read_or_set_metrics_salt() {
 }
 
 static std::recursive_mutex config_lock;  // protects operations on |config|.
+// Serializes writers of the config files, which run without |config_lock|.
+static std::mutex config_write_lock;
 static std::unique_ptr<config_t> config;
 static alarm_t* config_timer;
 
@@ -228,8 +232,12 @@ static future_t* init(void) {
     file_source = "Empty";
   }
 
-  if (!file_source.empty())
+  if (!file_source.empty()) {
     config_set_string(config.get(), INFO_SECTION, FILE_SOURCE, file_source);
+    // The primary file is missing or invalid, so write it out even if the
+    // config did not change since it was loaded.
+    config->dirty = true;
+  }
 
   btif_config_remove_unpaired(config.get());
 
@@ -607,6 +615,11 @@ void btif_config_flush(void) {
   CHECK(config_timer != NULL);
 
   alarm_cancel(config_timer);
+  {
+    // A flush always writes the file, even if nothing changed.
+    std::unique_lock<std::recursive_mutex> lock(config_lock);
+    config->dirty = true;
+  }
   btif_config_write(0, NULL);
 }
 
@@ -616,6 +629,7 @@ bool btif_config_clear(void) {
 
   alarm_cancel(config_timer);
 
+  std::unique_lock<std::mutex> write_lock(config_write_lock);
   std::unique_lock<std::recursive_mutex> lock(config_lock);
 
   config = config_new_empty();
@@ -644,19 +658,49 @@ static void btif_config_write(UNUSED_ATTR uint16_t event,
   CHECK(config != NULL);
   CHECK(config_timer != NULL);
 
-  std::unique_lock<std::recursive_mutex> lock(config_lock);
+  std::unique_lock<std::mutex> write_lock(config_write_lock);
+
+  // Only the serialization needs the live config. Unchanged sections reuse
+  // their cached text, and the file I/O below runs without |config_lock| so
+  // that callers on other threads are not blocked behind fsync.
+  std::string serialized;
+  {
+    std::unique_lock<std::recursive_mutex> lock(config_lock);
+    if (!config->dirty) return;
+    serialized =
+        config_serialize(config.get(), btif_config_section_is_persistent);
+    config->dirty = false;
+  }
+
   rename(CONFIG_FILE_PATH, CONFIG_BACKUP_PATH);
   rename(CONFIG_FILE_CHECKSUM_PATH, CONFIG_BACKUP_CHECKSUM_PATH);
-  std::unique_ptr<config_t> config_paired = config_new_clone(*config);
-  btif_config_remove_unpaired(config_paired.get());
-  config_save(*config_paired, CONFIG_FILE_PATH);
+  if (!config_save_buffer(serialized, CONFIG_FILE_PATH)) {
+    // Make sure the next write tries again.
+    std::unique_lock<std::recursive_mutex> lock(config_lock);
+    config->dirty = true;
+    return;
+  }
   // Save hash
-  std::string current_hash = hash_file(CONFIG_FILE_PATH);
+  std::string current_hash = hash_buffer(serialized);
   if (!current_hash.empty()) {
     write_checksum_file(CONFIG_FILE_CHECKSUM_PATH, current_hash);
   }
 }
 
+// Returns false for the sections of devices that were discovered but never
+// paired. They are only cached in memory and are not written to disk.
+static bool btif_config_section_is_persistent(const section_t& section) {
+  if (!RawAddress::IsValidAddress(section.name)) return true;
+
+  static const char* const kPairingKeys[] = {
+      "LinkKey",      "LE_KEY_PENC", "LE_KEY_PID",
+      "LE_KEY_PCSRK", "LE_KEY_LENC", "LE_KEY_LCSRK"};
+  for (const char* key : kPairingKeys) {
+    if (section.entry_index.count(key) != 0) return true;
+  }
+  return false;
+}
+
 static void btif_config_remove_unpaired(config_t* conf) {
   CHECK(conf != NULL);
   int paired_devices = 0;
@@ -665,17 +709,9 @@ static void btif_config_remove_unpaired(config_t* conf) {
   // discovered devices during regular inquiry scans.
   // We remove these now and cache them in memory instead.
   for (auto it = conf->sections.begin(); it != conf->sections.end();) {
-    std::string& section = it->name;
-    if (RawAddress::IsValidAddress(section)) {
-      // TODO: config_has_key loop thorugh all data, maybe just make it so we
-      // loop just once ?
-      if (!config_has_key(*conf, section, "LinkKey") &&
-          !config_has_key(*conf, section, "LE_KEY_PENC") &&
-          !config_has_key(*conf, section, "LE_KEY_PID") &&
-          !config_has_key(*conf, section, "LE_KEY_PCSRK") &&
-          !config_has_key(*conf, section, "LE_KEY_LENC") &&
-          !config_has_key(*conf, section, "LE_KEY_LCSRK")) {
-        it = conf->sections.erase(it);
+    if (RawAddress::IsValidAddress(it->name)) {
+      if (!btif_config_section_is_persistent(*it)) {
+        it = config_remove_section(conf, it);
         continue;
       }
       paired_devices++;
@@ -730,7 +766,7 @@ static void btif_config_remove_restricted(config_t* config) {
         config_has_key(*config, section, "Restricted")) {
       BTIF_TRACE_DEBUG("%s: Removing restricted device %s", __func__,
                        section.c_str());
-      it = config->sections.erase(it);
+      it = config_remove_section(config, it);
       continue;
     }
     it++;
@@ -751,6 +787,14 @@ static void delete_config_files(void) {
   osi_property_set("persist.bluetooth.factoryreset", "false");
 }
 
+static std::string hash_to_string(const uint8_t hash[SHA256_DIGEST_LENGTH]) {
+  std::stringstream ss;
+  for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+    ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+  }
+  return ss.str();
+}
+
 static std::string hash_file(const char* filename) {
   if (!btif_is_niap_mode()) {
     LOG(INFO) << __func__ << ": Disabled for multi-user";
@@ -771,12 +815,18 @@ static std::string hash_file(const char* filename) {
     SHA256_Update(&sha256, buffer.data(), bytes_read);
   }
   SHA256_Final(hash, &sha256);
-  std::stringstream ss;
-  for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-    ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-  }
   fclose(fp);
-  return ss.str();
+  return hash_to_string(hash);
+}
+
+static std::string hash_buffer(const std::string& buffer) {
+  if (!btif_is_niap_mode()) {
+    LOG(INFO) << __func__ << ": Disabled for multi-user";
+    return DISABLED;
+  }
+  uint8_t hash[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size(), hash);
+  return hash_to_string(hash);
 }
 
 static std::string read_checksum_file(const char* checksum_filename) {
@@ -0,0 +1,176 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "btif/include/btif_a2dp_encode_ahead.h"
+#include "osi/include/allocator.h"
+#include "osi/test/AllocationTestHarness.h"
+
+namespace {
+
+constexpr uint8_t kAheadTicks = 2;
+constexpr size_t kMaxPackets = 4;
+
+// Packet ids in the order they were sent
+std::vector<uint16_t> sent_ids;
+
+bool Send(BT_HDR* p_buf, size_t /* frames_n */, uint32_t /* bytes_read */) {
+  sent_ids.push_back(p_buf->layer_specific);
+  osi_free(p_buf);
+  return true;
+}
+
+BT_HDR* NewPacket(uint16_t id) {
+  BT_HDR* p_buf = reinterpret_cast<BT_HDR*>(osi_malloc(sizeof(BT_HDR)));
+  p_buf->layer_specific = id;
+  return p_buf;
+}
+
+class BtifA2dpEncodeAheadTest : public AllocationTestHarness {
+ protected:
+  void SetUp() override {
+    AllocationTestHarness::SetUp();
+    sent_ids.clear();
+    encode_ahead_ = new BtifA2dpEncodeAhead(kAheadTicks, kMaxPackets);
+  }
+
+  void TearDown() override {
+    delete encode_ahead_;
+    AllocationTestHarness::TearDown();
+  }
+
+  // Encodes |ids| on media tick |tick| as the encoder thread does
+  void Encode(uint64_t tick, const std::vector<uint16_t>& ids) {
+    encode_ahead_->EncodePosted();
+    encode_ahead_->EncodeStarted(tick);
+    for (uint16_t id : ids) encode_ahead_->Enqueue(NewPacket(id), 1, 0);
+    encode_ahead_->EncodeDone();
+  }
+
+  BtifA2dpEncodeAhead* encode_ahead_;
+};
+
+}  // namespace
+
+TEST_F(BtifA2dpEncodeAheadTest, test_handoff_by_tick_in_order) {
+  Encode(1, {1, 2});
+  Encode(2, {3});
+  EXPECT_EQ(3u, encode_ahead_->Length());
+
+  // Nothing is due before |kAheadTicks| ticks have passed
+  encode_ahead_->Handoff(1, Send);
+  encode_ahead_->Handoff(2, Send);
+  EXPECT_TRUE(sent_ids.empty());
+
+  encode_ahead_->Handoff(3, Send);
+  EXPECT_EQ(std::vector<uint16_t>({1, 2}), sent_ids);
+
+  encode_ahead_->Handoff(4, Send);
+  EXPECT_EQ(std::vector<uint16_t>({1, 2, 3}), sent_ids);
+  EXPECT_EQ(0u, encode_ahead_->Length());
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_late_handoff_sends_all_due) {
+  Encode(1, {1});
+  Encode(2, {2});
+  Encode(3, {3});
+
+  encode_ahead_->Handoff(10, Send);
+  EXPECT_EQ(std::vector<uint16_t>({1, 2, 3}), sent_ids);
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_flush_drops_packets_encoded_ahead) {
+  Encode(1, {1, 2});
+  encode_ahead_->Flush();
+  EXPECT_EQ(0u, encode_ahead_->Length());
+
+  encode_ahead_->Handoff(10, Send);
+  EXPECT_TRUE(sent_ids.empty());
+
+  // Encoding goes on after a flush
+  Encode(11, {3});
+  encode_ahead_->Handoff(13, Send);
+  EXPECT_EQ(std::vector<uint16_t>({3}), sent_ids);
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_stop_frees_packets_encoded_ahead) {
+  Encode(1, {1, 2});
+  delete encode_ahead_;
+  encode_ahead_ = nullptr;
+  EXPECT_TRUE(sent_ids.empty());
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_full_queue_frees_packet) {
+  encode_ahead_->EncodePosted();
+  encode_ahead_->EncodeStarted(1);
+  for (uint16_t id = 0; id < kMaxPackets; id++)
+    EXPECT_TRUE(encode_ahead_->Enqueue(NewPacket(id), 1, 0));
+  EXPECT_FALSE(encode_ahead_->Enqueue(NewPacket(kMaxPackets), 1, 0));
+  encode_ahead_->EncodeDone();
+  EXPECT_EQ(kMaxPackets, encode_ahead_->Length());
+
+  encode_ahead_->Handoff(1 + kAheadTicks, Send);
+  EXPECT_EQ(kMaxPackets, sent_ids.size());
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_wait_idle_waits_for_encoding) {
+  std::atomic<bool> encoded(false);
+  encode_ahead_->EncodePosted();
+  std::thread encoder([this, &encoded] {
+    usleep(50 * 1000);
+    encode_ahead_->EncodeStarted(1);
+    encode_ahead_->Enqueue(NewPacket(1), 1, 0);
+    encoded = true;
+    encode_ahead_->EncodeDone();
+  });
+
+  encode_ahead_->WaitIdle();
+  EXPECT_TRUE(encoded);
+  EXPECT_EQ(1u, encode_ahead_->Length());
+  encoder.join();
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_flush_waits_for_encoding) {
+  encode_ahead_->EncodePosted();
+  std::thread encoder([this] {
+    usleep(50 * 1000);
+    encode_ahead_->EncodeStarted(1);
+    encode_ahead_->Enqueue(NewPacket(1), 1, 0);
+    encode_ahead_->EncodeDone();
+  });
+
+  // The packet encoded during the flush is dropped, not sent after it
+  encode_ahead_->Flush();
+  encoder.join();
+  EXPECT_EQ(0u, encode_ahead_->Length());
+  encode_ahead_->Handoff(10, Send);
+  EXPECT_TRUE(sent_ids.empty());
+}
+
+TEST_F(BtifA2dpEncodeAheadTest, test_failed_post_is_not_waited_for) {
+  encode_ahead_->EncodePosted();
+  encode_ahead_->EncodePosted(false);
+  encode_ahead_->WaitIdle();
+  encode_ahead_->Flush();
+}
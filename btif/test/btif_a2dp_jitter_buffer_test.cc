@@ -0,0 +1,296 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "btif/include/btif_a2dp_jitter_buffer.h"
+#include "osi/include/allocator.h"
+
+namespace {
+
+constexpr uint32_t kSampleRate = 44100;
+constexpr uint32_t kPacketFrames = 640;
+constexpr uint64_t kTickUs = BTIF_SINK_MEDIA_TIME_TICK_MS * 1000;
+// Each packet decodes to a ramp, the right channel above the left one
+constexpr int16_t kRampStep = 4;
+constexpr int16_t kRightOffset = 8000;
+
+class BtifA2dpJitterBufferTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    buffer_.SetFormat(kSampleRate, 2, 16);
+    rng_.seed(1);
+  }
+
+  void Send(uint32_t timestamp, uint64_t now_us) {
+    BT_HDR* p_pkt = reinterpret_cast<BT_HDR*>(
+        osi_malloc(sizeof(BT_HDR) + sizeof(uint32_t)));
+    memcpy(p_pkt->data, &timestamp, sizeof(timestamp));
+    buffer_.Enqueue(p_pkt, timestamp, now_us);
+  }
+
+  // Decodes the packets due at |now_us|, each into kPacketFrames frames
+  void Tick(uint64_t now_us) {
+    BT_HDR* p_pkt;
+    while ((p_pkt = buffer_.Dequeue(now_us)) != nullptr) {
+      uint32_t timestamp;
+      memcpy(&timestamp, p_pkt->data, sizeof(timestamp));
+      decoded_.push_back(timestamp);
+      osi_free(p_pkt);
+
+      std::vector<int16_t> pcm(kPacketFrames * 2);
+      for (uint32_t i = 0; i < kPacketFrames; i++) {
+        pcm[i * 2] = i * kRampStep;
+        pcm[i * 2 + 1] = kRightOffset + i * kRampStep;
+      }
+      uint32_t len = pcm.size() * sizeof(int16_t);
+      const uint8_t* p_out = buffer_.AdjustPcm(
+          reinterpret_cast<const uint8_t*>(pcm.data()), &len);
+      ASSERT_EQ(0u, len % 4);
+      std::vector<int16_t> out(len / sizeof(int16_t));
+      memcpy(out.data(), p_out, len);
+
+      // A dropped frame is blended into the one before it, and a repeated
+      // frame is the mean of its neighbours, so the ramp moves by half, one
+      // or one and a half steps between frames, and the ends by half a step
+      ASSERT_LE(out.front(), kRampStep / 2);
+      ASSERT_GE(out[out.size() - 2], pcm[pcm.size() - 2] - kRampStep / 2);
+      for (size_t i = 0; i < out.size(); i += 2) {
+        ASSERT_EQ(kRightOffset, out[i + 1] - out[i]);
+        if (i == 0) continue;
+        int step = out[i] - out[i - 2];
+        ASSERT_TRUE(step == kRampStep / 2 || step == kRampStep ||
+                    step == kRampStep * 3 / 2)
+            << "step " << step << " at frame " << i / 2;
+      }
+      played_frames_ += len / 4;
+    }
+  }
+
+  // Streams from |start_us| for |duration_us|, carrying on from previous
+  // calls, with the clock of the peer off by |drift_ppm| and each packet
+  // delayed by up to |max_delay_us|. Packets arrive in order, as over L2CAP.
+  uint64_t Stream(uint64_t start_us, uint64_t duration_us, int drift_ppm,
+                  uint64_t max_delay_us) {
+    std::uniform_int_distribution<uint64_t> delay(0, max_delay_us);
+    uint64_t arrival_us = start_us;
+    uint64_t now_us = start_us;
+    for (; now_us < start_us + duration_us; now_us += 1000) {
+      while (true) {
+        uint64_t send_us = (uint64_t)sent_ * kPacketFrames * 1000000 /
+                           kSampleRate * 1000000 / (1000000 + drift_ppm);
+        if (send_us > now_us) break;
+        arrival_us = std::max(arrival_us, send_us + delay(rng_));
+        pending_.push_back(arrival_us);
+        sent_++;
+      }
+      while (!pending_.empty() && pending_.front() <= now_us) {
+        Send(timestamp_ + received_ * kPacketFrames, now_us);
+        pending_.erase(pending_.begin());
+        received_++;
+      }
+      if (now_us % kTickUs == 0) Tick(now_us);
+    }
+    return now_us;
+  }
+
+  BtifA2dpJitterBuffer buffer_;
+  std::mt19937 rng_;
+  uint32_t timestamp_ = 0xfffff000;  // Wraps around soon
+  uint32_t sent_ = 0;
+  uint32_t received_ = 0;
+  std::vector<uint64_t> pending_;
+  std::vector<uint32_t> decoded_;
+  uint64_t played_frames_ = 0;
+};
+
+}  // namespace
+
+TEST_F(BtifA2dpJitterBufferTest, test_untimed_without_sample_rate) {
+  buffer_.SetFormat(0, 2, 16);
+  for (uint32_t i = 0; i < 4; i++) Send(i * kPacketFrames, 0);
+  EXPECT_FALSE(buffer_.IsPlaying());
+  Send(4 * kPacketFrames, 0);
+  EXPECT_TRUE(buffer_.IsPlaying());
+  Tick(0);
+  EXPECT_EQ(5u, decoded_.size());
+  EXPECT_FALSE(buffer_.GetStats().timed);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_playout_starts_at_target_depth) {
+  for (uint32_t i = 0; !buffer_.IsPlaying(); i++) {
+    Send(i * kPacketFrames, i * 1000);
+    ASSERT_LT(i, 100u);
+  }
+  uint64_t target_us = buffer_.GetStats().target_depth_us;
+  EXPECT_GE(buffer_.GetStats().depth_us, target_us);
+  EXPECT_LT(buffer_.GetStats().depth_us,
+            target_us + (uint64_t)kPacketFrames * 1000000 / kSampleRate);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_jittery_stream_plays_without_underrun) {
+  uint64_t end_us = Stream(0, 30 * 1000000ULL, 0, 30000);
+  const BtifA2dpJitterBuffer::Stats& stats = buffer_.GetStats();
+  EXPECT_TRUE(stats.timed);
+  EXPECT_EQ(0u, stats.underruns);
+  EXPECT_EQ(0u, stats.late_packets);
+  EXPECT_EQ(0u, stats.dropped_packets);
+  EXPECT_GT(stats.jitter_us, 0u);
+  // The target covers the delays but not much more
+  EXPECT_GT(stats.target_depth_us, 40000u);
+  EXPECT_LT(stats.target_depth_us, 80000u);
+  EXPECT_EQ(received_, decoded_.size() + buffer_.Length());
+  for (size_t i = 1; i < decoded_.size(); i++)
+    ASSERT_EQ(kPacketFrames, decoded_[i] - decoded_[i - 1]);
+  EXPECT_GT(played_frames_, (end_us - 200000) * kSampleRate / 1000000);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_target_follows_delays) {
+  Stream(0, 20 * 1000000ULL, 0, 0);
+  uint64_t steady_target_us = buffer_.GetStats().target_depth_us;
+  EXPECT_LT(steady_target_us, 45000u);
+  Stream(20 * 1000000ULL, 1000000, 0, 100000);
+  EXPECT_GT(buffer_.GetStats().target_depth_us, steady_target_us + 50000);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_drift_is_compensated) {
+  // The peer clock is 300 ppm fast: without correction the depth would grow
+  // by 54 ms over the run
+  uint64_t end_us = Stream(0, 180 * 1000000ULL, 300, 5000);
+  const BtifA2dpJitterBuffer::Stats& stats = buffer_.GetStats();
+  EXPECT_EQ(0u, stats.underruns);
+  EXPECT_EQ(0u, stats.dropped_packets);
+  EXPECT_NEAR(300, stats.drift_ppm, 100);
+  EXPECT_LT(stats.depth_us, stats.target_depth_us + 2 * kTickUs);
+  // The output plays at the local sample rate
+  uint64_t expected_frames = end_us * kSampleRate / 1000000;
+  EXPECT_NEAR(expected_frames, played_frames_, kSampleRate / 5);
+  EXPECT_GT(decoded_.size() * kPacketFrames, played_frames_);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_slow_peer_is_compensated) {
+  uint64_t end_us = Stream(0, 180 * 1000000ULL, -300, 5000);
+  const BtifA2dpJitterBuffer::Stats& stats = buffer_.GetStats();
+  EXPECT_EQ(0u, stats.underruns);
+  EXPECT_NEAR(-300, stats.drift_ppm, 100);
+  uint64_t expected_frames = end_us * kSampleRate / 1000000;
+  EXPECT_NEAR(expected_frames, played_frames_, kSampleRate / 5);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_underrun_rebuffers) {
+  uint64_t now_us = Stream(0, 2 * 1000000ULL, 0, 0);
+  // The peer stops sending for 200 ms
+  for (uint64_t end_us = now_us + 200000; now_us < end_us; now_us += kTickUs)
+    Tick(now_us);
+  EXPECT_EQ(1u, buffer_.GetStats().underruns);
+  EXPECT_FALSE(buffer_.IsPlaying());
+
+  // The packets held up arrive, late for playout but not dropped, and raise
+  // the target depth
+  size_t decoded = decoded_.size();
+  uint64_t target_us = buffer_.GetStats().target_depth_us;
+  Send(timestamp_ + received_++ * kPacketFrames, now_us);
+  Tick(now_us + kTickUs);
+  EXPECT_EQ(decoded, decoded_.size());
+  EXPECT_GT(buffer_.GetStats().target_depth_us, target_us + 100000);
+  while (!buffer_.IsPlaying()) {
+    Send(timestamp_ + received_++ * kPacketFrames, now_us + kTickUs);
+    ASSERT_LT(received_, 1000u);
+  }
+  EXPECT_EQ(0u, buffer_.GetStats().late_packets);
+  Tick(now_us + 2 * kTickUs);
+  EXPECT_LT(decoded, decoded_.size());
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_packets_are_reordered) {
+  const uint32_t order[] = {0, 2, 1, 3, 5, 4, 6, 7, 8, 9, 10, 11, 12, 13};
+  for (uint32_t i : order) Send(i * kPacketFrames, 0);
+  ASSERT_TRUE(buffer_.IsPlaying());
+  Tick(1000000);
+  ASSERT_EQ(14u, decoded_.size());
+  for (uint32_t i = 0; i < 14; i++) EXPECT_EQ(i * kPacketFrames, decoded_[i]);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_late_packets_are_dropped) {
+  for (uint32_t i = 0; i < 14; i++)
+    if (i != 3) Send(i * kPacketFrames, 0);
+  Tick(200000);
+  size_t decoded = decoded_.size();
+  ASSERT_GT(decoded, 4u);
+  Send(3 * kPacketFrames, 200000);
+  EXPECT_EQ(1u, buffer_.GetStats().late_packets);
+  Tick(1000000);
+  EXPECT_EQ(13u, decoded_.size());
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_overflow_skips_to_target) {
+  uint64_t now_us = Stream(0, 5 * 1000000ULL, 0, 0);
+  // A second of audio arrives at once
+  for (int i = 0; i < 70; i++)
+    Send(timestamp_ + received_++ * kPacketFrames, now_us);
+  const BtifA2dpJitterBuffer::Stats& stats = buffer_.GetStats();
+  EXPECT_GT(stats.dropped_packets, 40u);
+  EXPECT_LT(stats.depth_us, 300000u);
+  EXPECT_EQ(received_, decoded_.size() + buffer_.Length() +
+                           stats.dropped_packets);
+  // Playout goes on from the packets kept
+  size_t decoded = decoded_.size();
+  Tick(now_us + kTickUs);
+  EXPECT_LT(decoded, decoded_.size());
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_constant_timestamps_play_untimed) {
+  for (int i = 0; i < 5; i++) Send(1000, i * 10000);
+  EXPECT_FALSE(buffer_.GetStats().timed);
+  EXPECT_TRUE(buffer_.IsPlaying());
+  Tick(50000);
+  EXPECT_EQ(5u, decoded_.size());
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_repeated_timestamp_stays_timed) {
+  uint64_t now_us = Stream(0, 1000000, 0, 0);
+  // The last packet is received again
+  Send(timestamp_ + (received_ - 1) * kPacketFrames, now_us);
+  EXPECT_TRUE(buffer_.GetStats().timed);
+  Stream(now_us, 1000000, 0, 0);
+  EXPECT_TRUE(buffer_.GetStats().timed);
+  EXPECT_EQ(0u, buffer_.GetStats().underruns);
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_timestamps_at_wrong_rate_play_untimed) {
+  // Timestamps in SBC frames rather than samples
+  for (uint64_t now_us = 0; now_us <= 3000000; now_us += 10000)
+    Send(now_us / 10000 * 5, now_us);
+  EXPECT_FALSE(buffer_.GetStats().timed);
+  EXPECT_TRUE(buffer_.IsPlaying());
+}
+
+TEST_F(BtifA2dpJitterBufferTest, test_timestamp_jump_restarts) {
+  uint64_t now_us = Stream(0, 1000000, 0, 0);
+  timestamp_ += 10 * kSampleRate;
+  Send(timestamp_ + received_ * kPacketFrames, now_us);
+  EXPECT_FALSE(buffer_.IsPlaying());
+  EXPECT_EQ(1u, buffer_.Length());
+  EXPECT_EQ(0u, buffer_.GetStats().late_packets);
+}
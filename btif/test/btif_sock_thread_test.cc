@@ -0,0 +1,208 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "bt_trace.h"
+#include "bt_types.h"
+#include "btif/include/btif_sock_thread.h"
+
+uint8_t appl_trace_level = BT_TRACE_LEVEL_WARNING;
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+namespace {
+
+struct Signal {
+  int fd;
+  int type;
+  int flags;
+  uint32_t user_id;
+};
+
+std::mutex signals_mutex;
+std::condition_variable signals_cv;
+std::vector<Signal> signals;
+
+void sock_signaled(int fd, int type, int flags, uint32_t user_id) {
+  std::lock_guard<std::mutex> lock(signals_mutex);
+  signals.push_back({fd, type, flags, user_id});
+  signals_cv.notify_all();
+}
+
+// Waits for |count| signals, and a little longer to catch extra ones
+std::vector<Signal> wait_for_signals(size_t count) {
+  std::unique_lock<std::mutex> lock(signals_mutex);
+  signals_cv.wait_for(lock, std::chrono::seconds(5),
+                      [count] { return signals.size() >= count; });
+  signals_cv.wait_for(lock, std::chrono::milliseconds(50),
+                      [count] { return signals.size() > count; });
+  std::vector<Signal> result;
+  result.swap(signals);
+  return result;
+}
+
+}  // namespace
+
+class BtifSockThreadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    btsock_thread_init();
+    handle_ = btsock_thread_create(sock_signaled, nullptr);
+    ASSERT_GE(handle_, 0);
+    signals.clear();
+  }
+
+  void TearDown() override {
+    EXPECT_TRUE(btsock_thread_exit(handle_));
+    for (int fd : fds_) close(fd);
+  }
+
+  // Returns our end of a new socket pair, and its peer in |*peer_fd|
+  int OpenSocket(int* peer_fd) {
+    int fds[2];
+    EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    fds_.push_back(fds[0]);
+    fds_.push_back(fds[1]);
+    *peer_fd = fds[1];
+    return fds[0];
+  }
+
+  int handle_ = -1;
+  std::vector<int> fds_;
+};
+
+TEST_F(BtifSockThreadTest, test_more_sockets_than_poll_batch) {
+  constexpr int kNumSockets = 300;
+  std::vector<int> our_fds(kNumSockets);
+  std::vector<int> peer_fds(kNumSockets);
+  for (int i = 0; i < kNumSockets; i++) {
+    our_fds[i] = OpenSocket(&peer_fds[i]);
+    EXPECT_TRUE(btsock_thread_add_fd(handle_, our_fds[i], BTSOCK_RFCOMM,
+                                     SOCK_THREAD_FD_RD, i));
+  }
+  for (int fd : peer_fds) ASSERT_EQ(1, write(fd, "", 1));
+
+  std::vector<Signal> result = wait_for_signals(kNumSockets);
+  ASSERT_EQ(static_cast<size_t>(kNumSockets), result.size());
+  std::vector<bool> seen(kNumSockets);
+  for (const Signal& signal : result) {
+    ASSERT_LT(signal.user_id, static_cast<uint32_t>(kNumSockets));
+    EXPECT_FALSE(seen[signal.user_id]);
+    seen[signal.user_id] = true;
+    EXPECT_EQ(our_fds[signal.user_id], signal.fd);
+    EXPECT_EQ(BTSOCK_RFCOMM, signal.type);
+    EXPECT_EQ(SOCK_THREAD_FD_RD, signal.flags);
+  }
+}
+
+TEST_F(BtifSockThreadTest, test_signaled_flags_need_rearming) {
+  int peer_fd;
+  int fd = OpenSocket(&peer_fd);
+  EXPECT_TRUE(btsock_thread_add_fd(handle_, fd, BTSOCK_L2CAP,
+                                   SOCK_THREAD_FD_RD, 7));
+  ASSERT_EQ(1, write(peer_fd, "", 1));
+  ASSERT_EQ(1u, wait_for_signals(1).size());
+
+  // Unread and newly written data is only reported once rearmed
+  ASSERT_EQ(1, write(peer_fd, "", 1));
+  EXPECT_EQ(0u, wait_for_signals(0).size());
+
+  EXPECT_TRUE(btsock_thread_add_fd(handle_, fd, BTSOCK_L2CAP,
+                                   SOCK_THREAD_FD_RD, 7));
+  std::vector<Signal> result = wait_for_signals(1);
+  ASSERT_EQ(1u, result.size());
+  EXPECT_EQ(fd, result[0].fd);
+  EXPECT_EQ(7u, result[0].user_id);
+  EXPECT_EQ(SOCK_THREAD_FD_RD, result[0].flags);
+}
+
+TEST_F(BtifSockThreadTest, test_flags_are_signaled_separately) {
+  int peer_fd;
+  int fd = OpenSocket(&peer_fd);
+  EXPECT_TRUE(
+      btsock_thread_add_fd(handle_, fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_WR, 1));
+  std::vector<Signal> result = wait_for_signals(1);
+  ASSERT_EQ(1u, result.size());
+  EXPECT_EQ(SOCK_THREAD_FD_WR, result[0].flags);
+
+  // Still watched for reading after the write flag was signaled
+  EXPECT_TRUE(
+      btsock_thread_add_fd(handle_, fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_RD, 1));
+  EXPECT_EQ(0u, wait_for_signals(0).size());
+  ASSERT_EQ(1, write(peer_fd, "", 1));
+  result = wait_for_signals(1);
+  ASSERT_EQ(1u, result.size());
+  EXPECT_EQ(SOCK_THREAD_FD_RD, result[0].flags);
+}
+
+TEST_F(BtifSockThreadTest, test_peer_close_is_an_exception) {
+  int peer_fd;
+  int fd = OpenSocket(&peer_fd);
+  EXPECT_TRUE(btsock_thread_add_fd(handle_, fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_EXCEPTION, 3));
+  EXPECT_EQ(0u, wait_for_signals(0).size());
+
+  shutdown(peer_fd, SHUT_RDWR);
+  std::vector<Signal> result = wait_for_signals(1);
+  ASSERT_EQ(1u, result.size());
+  EXPECT_EQ(fd, result[0].fd);
+  EXPECT_TRUE(result[0].flags & SOCK_THREAD_FD_EXCEPTION);
+}
+
+TEST_F(BtifSockThreadTest, test_reused_fd_is_watched) {
+  int peer_fd;
+  int fd = OpenSocket(&peer_fd);
+  EXPECT_TRUE(btsock_thread_add_fd(handle_, fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  EXPECT_EQ(0u, wait_for_signals(0).size());
+
+  // The owner closes the socket without removing it, and the fd is reused
+  fds_.erase(fds_.begin(), fds_.begin() + 2);
+  close(fd);
+  close(peer_fd);
+  int new_fd = OpenSocket(&peer_fd);
+  ASSERT_EQ(fd, new_fd);
+  EXPECT_TRUE(btsock_thread_add_fd(handle_, new_fd, BTSOCK_L2CAP,
+                                   SOCK_THREAD_FD_WR, 2));
+  std::vector<Signal> result = wait_for_signals(1);
+  ASSERT_EQ(1u, result.size());
+  EXPECT_EQ(BTSOCK_L2CAP, result[0].type);
+  EXPECT_EQ(SOCK_THREAD_FD_WR, result[0].flags);
+  EXPECT_EQ(2u, result[0].user_id);
+}
+
+TEST_F(BtifSockThreadTest, test_remove_fd_and_close) {
+  int peer_fd;
+  int fd = OpenSocket(&peer_fd);
+  fds_.erase(fds_.begin());
+  EXPECT_TRUE(btsock_thread_add_fd(handle_, fd, BTSOCK_RFCOMM,
+                                   SOCK_THREAD_FD_RD, 1));
+  EXPECT_TRUE(btsock_thread_remove_fd_and_close(handle_, fd));
+  EXPECT_EQ(0u, wait_for_signals(0).size());
+
+  // The peer sees the socket closed
+  char byte;
+  EXPECT_EQ(0, read(peer_fd, &byte, 1));
+}
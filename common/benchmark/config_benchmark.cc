@@ -0,0 +1,161 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "osi/include/config.h"
+
+using ::benchmark::State;
+
+#define NUM_DEVICES 1000
+
+namespace {
+
+// Keys of a typical bonded device section in bt_config.conf
+const char* kDeviceKeys[] = {
+    "Name",         "DevClass",      "DevType",      "AddrType",
+    "Manufacturer", "LmpVer",        "LmpSubVer",    "Timestamp",
+    "LinkKeyType",  "PinLength",     "LinkKey",      "LE_KEY_PENC",
+    "LE_KEY_PID",   "LE_KEY_LENC",   "Service",      "AvrcpCtVersion",
+    "AvrcpFeatures"};
+const size_t kNumDeviceKeys = sizeof(kDeviceKeys) / sizeof(kDeviceKeys[0]);
+
+std::string DeviceAddress(int index) {
+  char address[18];
+  snprintf(address, sizeof(address), "00:11:22:%02x:%02x:%02x",
+           (index >> 16) & 0xff, (index >> 8) & 0xff, index & 0xff);
+  return address;
+}
+
+std::string TempDirectory() {
+  return access("/data/local/tmp", W_OK) == 0 ? "/data/local/tmp" : "/tmp";
+}
+
+// Writes a synthetic bt_config.conf with |NUM_DEVICES| bonded devices
+std::string WriteSyntheticConfig() {
+  std::string filename = TempDirectory() + "/config_benchmark.conf";
+  FILE* fp = fopen(filename.c_str(), "wt");
+  CHECK(fp != nullptr);
+  fprintf(fp, "[Info]\nFileSource = Benchmark\n\n");
+  fprintf(fp, "[Adapter]\nAddress = 00:11:22:33:44:55\nName = bench\n\n");
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    fprintf(fp, "[%s]\n", DeviceAddress(i).c_str());
+    for (size_t k = 0; k < kNumDeviceKeys; k++)
+      fprintf(fp, "%s = %s%d\n", kDeviceKeys[k], "value-", i);
+    fprintf(fp, "\n");
+  }
+  fclose(fp);
+  return filename;
+}
+
+}  // namespace
+
+class BM_Config : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    filename_ = WriteSyntheticConfig();
+    config_ = config_new(filename_.c_str());
+    CHECK(config_ != nullptr);
+    for (int i = 0; i < NUM_DEVICES; i++) addresses_.push_back(DeviceAddress(i));
+  }
+
+  void TearDown(State& st) override {
+    config_.reset();
+    addresses_.clear();
+    unlink(filename_.c_str());
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::string filename_;
+  std::unique_ptr<config_t> config_;
+  std::vector<std::string> addresses_;
+};
+
+BENCHMARK_F(BM_Config, load)(State& state) {
+  for (auto _ : state) {
+    std::unique_ptr<config_t> config = config_new(filename_.c_str());
+    benchmark::DoNotOptimize(config.get());
+  }
+}
+
+// Looks up the last key of every device, the worst case for a linear scan
+BENCHMARK_F(BM_Config, get)(State& state) {
+  const std::string key = kDeviceKeys[kNumDeviceKeys - 1];
+  for (auto _ : state) {
+    for (const std::string& address : addresses_) {
+      benchmark::DoNotOptimize(
+          config_get_string(*config_, address, key, nullptr));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_DEVICES);
+}
+
+BENCHMARK_F(BM_Config, set)(State& state) {
+  int value = 0;
+  for (auto _ : state) {
+    for (const std::string& address : addresses_) {
+      config_set_int(config_.get(), address, "Timestamp", value++);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_DEVICES);
+}
+
+BENCHMARK_F(BM_Config, save)(State& state) {
+  const std::string filename = TempDirectory() + "/config_benchmark_save.conf";
+  for (auto _ : state) {
+    CHECK(config_save(*config_, filename));
+  }
+  unlink(filename.c_str());
+}
+
+// Serializes the whole config after a single device changed, which is what a
+// typical deferred bt_config write does.
+BENCHMARK_F(BM_Config, serialize_one_dirty)(State& state) {
+  config_serialize(config_.get(), nullptr);
+  int value = 0;
+  for (auto _ : state) {
+    config_set_int(config_.get(), addresses_[value % NUM_DEVICES], "Timestamp",
+                   value);
+    value++;
+    benchmark::DoNotOptimize(config_serialize(config_.get(), nullptr));
+  }
+}
+
+BENCHMARK_F(BM_Config, serialize_all_dirty)(State& state) {
+  for (auto _ : state) {
+    for (section_t& section : config_->sections) section.dirty = true;
+    benchmark::DoNotOptimize(config_serialize(config_.get(), nullptr));
+  }
+}
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
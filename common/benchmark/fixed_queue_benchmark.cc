@@ -0,0 +1,158 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <future>
+#include <memory>
+
+#include "osi/include/fixed_queue.h"
+#include "osi/include/thread.h"
+
+using ::benchmark::State;
+
+#define NUM_MESSAGES_TO_SEND 100000
+#define QUEUE_CAPACITY 1024
+
+enum QueueMode { LIST_QUEUE = 0, RING_QUEUE = 1 };
+
+static volatile int g_counter = 0;
+static std::unique_ptr<std::promise<void>> g_counter_promise = nullptr;
+
+static fixed_queue_t* new_queue(int64_t mode) {
+  fixed_queue_t* queue = (mode == RING_QUEUE)
+                             ? fixed_queue_new_ring(QUEUE_CAPACITY)
+                             : fixed_queue_new(QUEUE_CAPACITY);
+  CHECK(queue != nullptr);
+  return queue;
+}
+
+static void callback_batch(fixed_queue_t* queue, void* context) {
+  fixed_queue_dequeue(queue);
+  g_counter++;
+  if (g_counter >= NUM_MESSAGES_TO_SEND) {
+    g_counter_promise->set_value();
+  }
+}
+
+static void callback_drain(fixed_queue_t* queue, void* context) {
+  int before = g_counter;
+  while (fixed_queue_try_dequeue(queue) != nullptr) {
+    g_counter++;
+  }
+  if (before < NUM_MESSAGES_TO_SEND && g_counter >= NUM_MESSAGES_TO_SEND) {
+    g_counter_promise->set_value();
+  }
+}
+
+static void producer(void* context) {
+  auto queue = static_cast<fixed_queue_t*>(context);
+  for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+    fixed_queue_enqueue(queue, (void*)&g_counter);
+  }
+}
+
+class BM_FixedQueue : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    benchmark::Fixture::SetUp(st);
+    queue_ = new_queue(st.range(0));
+    g_counter = 0;
+  }
+  void TearDown(State& st) override {
+    fixed_queue_free(queue_, nullptr);
+    queue_ = nullptr;
+    g_counter_promise.reset(nullptr);
+    benchmark::Fixture::TearDown(st);
+  }
+  fixed_queue_t* queue_ = nullptr;
+};
+
+// Enqueue and dequeue on the same thread: the uncontended per-element cost.
+BENCHMARK_DEFINE_F(BM_FixedQueue, same_thread)(State& state) {
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_MESSAGES_TO_SEND; i++) {
+      fixed_queue_enqueue(queue_, (void*)&g_counter);
+      benchmark::DoNotOptimize(fixed_queue_dequeue(queue_));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_MESSAGES_TO_SEND);
+}
+BENCHMARK_REGISTER_F(BM_FixedQueue, same_thread)
+    ->Arg(LIST_QUEUE)
+    ->Arg(RING_QUEUE);
+
+class BM_FixedQueueReactor : public BM_FixedQueue {
+ protected:
+  void SetUp(State& st) override {
+    BM_FixedQueue::SetUp(st);
+    consumer_thread_ = thread_new("BM_FixedQueue consumer thread");
+    producer_thread_ = thread_new("BM_FixedQueue producer thread");
+  }
+  void TearDown(State& st) override {
+    fixed_queue_unregister_dequeue(queue_);
+    thread_free(producer_thread_);
+    producer_thread_ = nullptr;
+    thread_free(consumer_thread_);
+    consumer_thread_ = nullptr;
+    BM_FixedQueue::TearDown(st);
+  }
+  void Run(State& state, fixed_queue_cb ready_cb) {
+    fixed_queue_register_dequeue(queue_, thread_get_reactor(consumer_thread_),
+                                 ready_cb, nullptr);
+    for (auto _ : state) {
+      g_counter = 0;
+      g_counter_promise = std::make_unique<std::promise<void>>();
+      std::future<void> counter_future = g_counter_promise->get_future();
+      thread_post(producer_thread_, producer, queue_);
+      counter_future.wait();
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_MESSAGES_TO_SEND);
+  }
+  thread_t* consumer_thread_ = nullptr;
+  thread_t* producer_thread_ = nullptr;
+};
+
+// Cross-thread hand-off with one element dequeued per reactor callback, the
+// way most stack queues are consumed.
+BENCHMARK_DEFINE_F(BM_FixedQueueReactor, dequeue_one)(State& state) {
+  Run(state, callback_batch);
+}
+BENCHMARK_REGISTER_F(BM_FixedQueueReactor, dequeue_one)
+    ->Arg(LIST_QUEUE)
+    ->Arg(RING_QUEUE)
+    ->UseRealTime();
+
+// Cross-thread hand-off with the consumer draining the queue on each wakeup.
+BENCHMARK_DEFINE_F(BM_FixedQueueReactor, dequeue_all)(State& state) {
+  Run(state, callback_drain);
+}
+BENCHMARK_REGISTER_F(BM_FixedQueueReactor, dequeue_all)
+    ->Arg(LIST_QUEUE)
+    ->Arg(RING_QUEUE)
+    ->UseRealTime();
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <string.h>
+#include <thread>
+
+#include "osi/include/allocator.h"
+#include "osi/include/fixed_queue.h"
+#include "osi/include/pool_allocator.h"
+
+using ::benchmark::State;
+
+#define NUM_MEDIA_PACKETS 10000
+#define QUEUE_CAPACITY 64
+
+// Sizes of the buffers on the A2DP source path: BT_HDR plus the L2CAP/AVDTP
+// headroom reserved in front of each encoded media packet, the encoded media
+// payload, and the HCI ACL fragments sent to the controller.
+#define BT_HDR_SIZE 8
+#define MEDIA_OFFSET 23
+#define MEDIA_PAYLOAD_MIN 600
+#define MEDIA_PAYLOAD_MAX 895
+#define ACL_PAYLOAD_SIZE 1021
+#define HCI_ACL_PREAMBLE_SIZE 4
+
+enum AllocatorType { MALLOC_ALLOCATOR = 0, POOL_ALLOCATOR = 1 };
+
+static const allocator_t* get_allocator(int64_t type) {
+  return (type == POOL_ALLOCATOR) ? &allocator_pool : &allocator_malloc;
+}
+
+static size_t media_packet_size(int index) {
+  return BT_HDR_SIZE + MEDIA_OFFSET + MEDIA_PAYLOAD_MIN +
+         (index * 37) % (MEDIA_PAYLOAD_MAX - MEDIA_PAYLOAD_MIN);
+}
+
+// Encoder thread: allocates media packets and hands them to the next layer
+static void encode_media_packets(const allocator_t* allocator,
+                                 fixed_queue_t* queue) {
+  for (int i = 0; i < NUM_MEDIA_PACKETS; i++) {
+    size_t size = media_packet_size(i);
+    uint8_t* packet = static_cast<uint8_t*>(allocator->alloc(size));
+    memset(packet, i, BT_HDR_SIZE + MEDIA_OFFSET);
+    fixed_queue_enqueue(queue, packet);
+  }
+}
+
+// Sends each media packet as an HCI ACL fragment and frees both, as the
+// HCI layer does once the controller has accepted the fragment.
+static void send_media_packets(const allocator_t* allocator,
+                               fixed_queue_t* queue) {
+  for (int i = 0; i < NUM_MEDIA_PACKETS; i++) {
+    uint8_t* packet = static_cast<uint8_t*>(fixed_queue_dequeue(queue));
+    size_t payload_size = media_packet_size(i) - BT_HDR_SIZE;
+    uint8_t* fragment = static_cast<uint8_t*>(
+        allocator->alloc(BT_HDR_SIZE + HCI_ACL_PREAMBLE_SIZE + payload_size));
+    memcpy(fragment + BT_HDR_SIZE + HCI_ACL_PREAMBLE_SIZE,
+           packet + BT_HDR_SIZE, payload_size);
+    allocator->free(packet);
+    benchmark::DoNotOptimize(fragment[BT_HDR_SIZE]);
+    allocator->free(fragment);
+  }
+}
+
+// Simulated A2DP source stream: media packets are allocated on the encoder
+// thread and freed on the HCI thread.
+static void BM_A2dpStream(State& state) {
+  const allocator_t* allocator = get_allocator(state.range(0));
+  fixed_queue_t* queue = fixed_queue_new(QUEUE_CAPACITY);
+  for (auto _ : state) {
+    std::thread encoder(encode_media_packets, allocator, queue);
+    send_media_packets(allocator, queue);
+    encoder.join();
+  }
+  fixed_queue_free(queue, nullptr);
+  state.SetItemsProcessed(state.iterations() * NUM_MEDIA_PACKETS);
+}
+BENCHMARK(BM_A2dpStream)
+    ->Arg(MALLOC_ALLOCATOR)
+    ->Arg(POOL_ALLOCATOR)
+    ->UseRealTime();
+
+// Bursts of packet buffers allocated and freed on the same thread, as when
+// reassembling and dispatching incoming ACL data.
+static void BM_AllocFreeBurst(State& state) {
+  static const size_t sizes[] = {BT_HDR_SIZE + 27,
+                                 BT_HDR_SIZE + 251,
+                                 BT_HDR_SIZE + ACL_PAYLOAD_SIZE,
+                                 BT_HDR_SIZE + MEDIA_PAYLOAD_MAX};
+  const allocator_t* allocator = get_allocator(state.range(0));
+  void* buffers[32];
+  for (auto _ : state) {
+    for (int i = 0; i < 32; i++) buffers[i] = allocator->alloc(sizes[i % 4]);
+    for (int i = 0; i < 32; i++) allocator->free(buffers[i]);
+  }
+  state.SetItemsProcessed(state.iterations() * 32);
+}
+BENCHMARK(BM_AllocFreeBurst)->Arg(MALLOC_ALLOCATOR)->Arg(POOL_ALLOCATOR);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
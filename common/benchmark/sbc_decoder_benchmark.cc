@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes the stream the A2DP source sends for the high quality SBC
+// configuration, with the C kernels and with the ones picked for the CPU.
+
+#include <benchmark/benchmark.h>
+#include <math.h>
+#include <vector>
+
+#include "embdrv/sbc/encoder/include/sbc_encoder.h"
+
+extern "C" {
+#include "oi_codec_sbc_private.h"
+}
+
+using ::benchmark::State;
+
+#define NUM_FRAMES 256
+#define NUM_SUBBANDS 8
+#define NUM_BLOCKS 16
+#define NUM_CHANNELS 2
+#define SAMPLES_PER_FRAME (NUM_SUBBANDS * NUM_BLOCKS * NUM_CHANNELS)
+#define BIT_RATE_KBPS 328
+
+static std::vector<uint8_t> make_stream(int16_t sampling_freq,
+                                        int sample_rate) {
+  SBC_ENC_PARAMS params = {};
+  params.s16SamplingFreq = sampling_freq;
+  params.s16ChannelMode = SBC_JOINT_STEREO;
+  params.s16NumOfSubBands = NUM_SUBBANDS;
+  params.s16NumOfBlocks = NUM_BLOCKS;
+  params.s16AllocationMethod = SBC_LOUDNESS;
+  params.u16BitRate = BIT_RATE_KBPS;
+  SBC_Encoder_Init(&params);
+
+  std::vector<int16_t> pcm(SAMPLES_PER_FRAME);
+  std::vector<uint8_t> stream;
+  uint8_t output[512];
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    for (int n = 0; n < SAMPLES_PER_FRAME / NUM_CHANNELS; n++) {
+      double t = static_cast<double>(i * SAMPLES_PER_FRAME / NUM_CHANNELS + n) /
+                 sample_rate;
+      double left = sin(2 * M_PI * 440 * t) + 0.5 * sin(2 * M_PI * 3520 * t);
+      double right = sin(2 * M_PI * 440 * t) + 0.3 * sin(2 * M_PI * 9000 * t);
+      pcm[n * 2] = static_cast<int16_t>(left * 12000);
+      pcm[n * 2 + 1] = static_cast<int16_t>(right * 12000);
+    }
+    uint32_t len = SBC_Encode(&params, pcm.data(), output);
+    stream.insert(stream.end(), output, output + len);
+  }
+  return stream;
+}
+
+static void BM_SbcDecodeJointStereo(State& state, int16_t sampling_freq,
+                                    int sample_rate,
+                                    const OI_CODEC_SBC_KERNELS* kernels) {
+  std::vector<uint8_t> stream = make_stream(sampling_freq, sample_rate);
+  OI_CODEC_SBC_DECODER_CONTEXT context;
+  static uint32_t context_data[CODEC_DATA_WORDS(
+      NUM_CHANNELS, SBC_CODEC_FAST_FILTER_BUFFERS)];
+  OI_CODEC_SBC_DecoderReset(&context, context_data, sizeof(context_data),
+                            NUM_CHANNELS, NUM_CHANNELS, false);
+  context.kernels = kernels;
+
+  int16_t pcm[SAMPLES_PER_FRAME];
+  for (auto _ : state) {
+    const OI_BYTE* data = stream.data();
+    uint32_t bytes = stream.size();
+    while (bytes > 0) {
+      uint32_t pcm_bytes = sizeof(pcm);
+      benchmark::DoNotOptimize(
+          OI_CODEC_SBC_DecodeFrame(&context, &data, &bytes, pcm, &pcm_bytes));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_FRAMES);
+}
+
+static void BM_SbcDecode44100JointStereoGeneric(State& state) {
+  BM_SbcDecodeJointStereo(state, SBC_sf44100, 44100, &OI_SBC_GenericKernels);
+}
+BENCHMARK(BM_SbcDecode44100JointStereoGeneric);
+
+static void BM_SbcDecode44100JointStereo(State& state) {
+  BM_SbcDecodeJointStereo(state, SBC_sf44100, 44100, OI_SBC_SelectKernels());
+}
+BENCHMARK(BM_SbcDecode44100JointStereo);
+
+static void BM_SbcDecode48000JointStereoGeneric(State& state) {
+  BM_SbcDecodeJointStereo(state, SBC_sf48000, 48000, &OI_SBC_GenericKernels);
+}
+BENCHMARK(BM_SbcDecode48000JointStereoGeneric);
+
+static void BM_SbcDecode48000JointStereo(State& state) {
+  BM_SbcDecodeJointStereo(state, SBC_sf48000, 48000, OI_SBC_SelectKernels());
+}
+BENCHMARK(BM_SbcDecode48000JointStereo);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <math.h>
+#include <vector>
+
+#include "embdrv/sbc/encoder/include/sbc_encoder.h"
+
+using ::benchmark::State;
+
+#define NUM_FRAMES 256
+#define NUM_SUBBANDS 8
+#define NUM_BLOCKS 16
+#define NUM_CHANNELS 2
+#define SAMPLES_PER_FRAME (NUM_SUBBANDS * NUM_BLOCKS * NUM_CHANNELS)
+// Bit rate used by the A2DP source for the high quality SBC configuration
+#define BIT_RATE_KBPS 328
+
+// Interleaved stereo PCM with a different mix of tones on each channel, so
+// that joint stereo decisions vary between subbands and frames.
+static std::vector<int16_t> make_pcm(int sample_rate) {
+  std::vector<int16_t> pcm(NUM_FRAMES * SAMPLES_PER_FRAME);
+  for (size_t i = 0; i < pcm.size() / NUM_CHANNELS; i++) {
+    double t = static_cast<double>(i) / sample_rate;
+    double left = sin(2 * M_PI * 440 * t) + 0.5 * sin(2 * M_PI * 3520 * t);
+    double right = sin(2 * M_PI * 440 * t) + 0.3 * sin(2 * M_PI * 9000 * t);
+    pcm[i * 2] = static_cast<int16_t>(left * 12000);
+    pcm[i * 2 + 1] = static_cast<int16_t>(right * 12000);
+  }
+  return pcm;
+}
+
+static void BM_SbcEncodeJointStereo(State& state, int16_t sampling_freq,
+                                    int sample_rate) {
+  SBC_ENC_PARAMS params = {};
+  params.s16SamplingFreq = sampling_freq;
+  params.s16ChannelMode = SBC_JOINT_STEREO;
+  params.s16NumOfSubBands = NUM_SUBBANDS;
+  params.s16NumOfBlocks = NUM_BLOCKS;
+  params.s16AllocationMethod = SBC_LOUDNESS;
+  params.u16BitRate = BIT_RATE_KBPS;
+  SBC_Encoder_Init(&params);
+
+  std::vector<int16_t> pcm = make_pcm(sample_rate);
+  uint8_t output[512];
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_FRAMES; i++) {
+      benchmark::DoNotOptimize(
+          SBC_Encode(&params, &pcm[i * SAMPLES_PER_FRAME], output));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_FRAMES);
+}
+
+static void BM_SbcEncode44100JointStereo(State& state) {
+  BM_SbcEncodeJointStereo(state, SBC_sf44100, 44100);
+}
+BENCHMARK(BM_SbcEncode44100JointStereo);
+
+static void BM_SbcEncode48000JointStereo(State& state) {
+  BM_SbcEncodeJointStereo(state, SBC_sf48000, 48000);
+}
+BENCHMARK(BM_SbcEncode48000JointStereo);
+
+BENCHMARK_MAIN();
@@ -19,6 +19,7 @@
 #include <base/threading/thread.h>
 #include <benchmark/benchmark.h>
 #include <future>
+#include <vector>
 
 #include "common/message_loop_thread.h"
 #include "common/once_timer.h"
@@ -46,6 +47,8 @@ int g_task_counter;
 
 void TimerFire(void*) { g_promise->set_value(); }
 
+void AlarmNoop(void*) {}
+
 void AlarmSleepAndCountDelayedTime(void*) {
   auto end_time_us = time_get_os_boottime_us();
   auto time_after_start_ms = (end_time_us - g_start_time) / 1000;
@@ -268,6 +271,53 @@ BENCHMARK_REGISTER_F(BM_AlarmTaskPeriodicTimer, periodic_accuracy)
     ->Iterations(1)
     ->UseRealTime();
 
+// Measures the cost of |alarm_set| followed by |alarm_cancel| while many
+// other alarms are pending, as with many connections each owning several
+// protocol timers. The cost should not grow with the number of alarms.
+class BM_OsiAlarmSetCancel : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    auto pending_count = static_cast<int>(st.range(0));
+    for (int i = 0; i < pending_count; i++) {
+      alarm_t* alarm = alarm_new("osi_alarm_pending");
+      // Spread deadlines over 10 to 60 minutes so none fires while measuring
+      alarm_set(alarm, 600000 + (i * 3000000LL) / pending_count, &AlarmNoop,
+                nullptr);
+      pending_alarms_.push_back(alarm);
+    }
+    alarm_ = alarm_new("osi_alarm_set_cancel");
+  }
+
+  void TearDown(State& st) override {
+    alarm_free(alarm_);
+    for (alarm_t* alarm : pending_alarms_) alarm_free(alarm);
+    pending_alarms_.clear();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::vector<alarm_t*> pending_alarms_;
+  alarm_t* alarm_ = nullptr;
+};
+
+BENCHMARK_DEFINE_F(BM_OsiAlarmSetCancel, set_cancel)(State& state) {
+  auto pending_count = static_cast<int>(state.range(0));
+  int i = 0;
+  for (auto _ : state) {
+    // Land between the pending deadlines rather than in front of them
+    alarm_set(alarm_, 600000 + (i++ * 3000000LL) / (pending_count + 1),
+              &AlarmNoop, nullptr);
+    alarm_cancel(alarm_);
+    if (i > pending_count) i = 0;
+  }
+};
+
+BENCHMARK_REGISTER_F(BM_OsiAlarmSetCancel, set_cancel)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(5000);
+
 int main(int argc, char** argv) {
   // Disable LOG() output from libchrome
   logging::LoggingSettings log_settings;
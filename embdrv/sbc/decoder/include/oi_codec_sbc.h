@@ -230,9 +230,21 @@ typedef struct {
     (sizeof(uint32_t) - 1)) /                                                  \
    sizeof(uint32_t))
 
+/** Used internally. Decoding kernels, picked for the CPU when the decoder is
+ * reset. */
+typedef struct {
+  /** Windows the synthesis filter buffer of 8 subbands into 8 PCM samples. */
+  void (*synthWindow80)(int16_t* pcm, SBC_BUFFER_T const* buffer,
+                        OI_UINT strideShift);
+  /** Dequantizes the raw subband samples of a frame in place, and undoes the
+   * mid/side coding of the joint stereo subbands when joint is TRUE. */
+  void (*dequantFrame)(OI_CODEC_SBC_COMMON_CONTEXT* common, OI_BOOL joint);
+} OI_CODEC_SBC_KERNELS;
+
 /** Opaque parameter to decoding functions; maintains decoder context. */
 typedef struct {
   OI_CODEC_SBC_COMMON_CONTEXT common;
+  const OI_CODEC_SBC_KERNELS* kernels;
   /* Boolean, set by OI_CODEC_SBC_DecoderLimit() */
   uint8_t limitFrameFormat;
   uint8_t restrictSubbands;
@@ -215,11 +215,39 @@ PRIVATE void OI_SBC_SynthFrame(OI_CODEC_SBC_DECODER_CONTEXT* context,
                                int16_t* pcm, OI_UINT start_block,
                                OI_UINT nrof_blocks);
 INLINE int32_t OI_SBC_Dequant(uint32_t raw, OI_UINT scale_factor, OI_UINT bits);
+PRIVATE void OI_SBC_DequantFrame(OI_CODEC_SBC_COMMON_CONTEXT* common,
+                                 OI_BOOL joint);
 PRIVATE OI_BOOL OI_SBC_ExamineCommandPacket(
     OI_CODEC_SBC_DECODER_CONTEXT* context, const OI_BYTE* data, uint32_t len);
 PRIVATE void OI_SBC_GenerateTestSignal(int16_t pcmData[][2],
                                        uint32_t sampleCount);
 
+/* Decoding kernels */
+
+/** Per subband constants of OI_SBC_Dequant() for a frame, so that the
+ * subbands of a block can be dequantized at once:
+ * dequant = (int32_t)((raw * 2 + 1) * mul - offset) >> shift */
+typedef struct {
+  uint32_t mul[SBC_MAX_CHANNELS * SBC_MAX_BANDS];
+  uint32_t offset[SBC_MAX_CHANNELS * SBC_MAX_BANDS];
+  int32_t shift[SBC_MAX_CHANNELS * SBC_MAX_BANDS];
+  int32_t jointMask[SBC_MAX_BANDS]; /**< -1 for the mid/side subbands */
+} OI_SBC_DEQUANT_PARAMS;
+
+PRIVATE void OI_SBC_GetDequantParams(OI_CODEC_SBC_COMMON_CONTEXT* common,
+                                     OI_BOOL joint,
+                                     OI_SBC_DEQUANT_PARAMS* params);
+
+PRIVATE void SynthWindow80_generated(int16_t* pcm,
+                                     SBC_BUFFER_T const* RESTRICT buffer,
+                                     OI_UINT strideShift);
+
+/** The plain C kernels, which the vectorized ones are bit exact with. */
+extern const OI_CODEC_SBC_KERNELS OI_SBC_GenericKernels;
+
+/** Returns the fastest kernels the CPU supports. */
+PRIVATE const OI_CODEC_SBC_KERNELS* OI_SBC_SelectKernels(void);
+
 PRIVATE void OI_SBC_ExpandFrameFields(OI_CODEC_SBC_FRAME_INFO* frame);
 PRIVATE OI_STATUS OI_CODEC_SBC_Alloc(OI_CODEC_SBC_COMMON_CONTEXT* common,
                                      uint32_t* codecDataAligned,
@@ -53,6 +53,7 @@ INLINE OI_STATUS internal_DecoderReset(OI_CODEC_SBC_DECODER_CONTEXT* context,
   for (i = 0; i < sizeof(*context); i++) {
     ((char*)context)[i] = 0;
   }
+  context->kernels = OI_SBC_SelectKernels();
 
 #ifdef SBC_ENHANCED
   context->enhancedEnabled = enhanced ? TRUE : FALSE;
@@ -174,7 +175,8 @@ PRIVATE void OI_SBC_ReadScalefactors(OI_CODEC_SBC_COMMON_CONTEXT* common,
   }
 }
 
-/** Read quantized subband samples from the input bitstream and expand them. */
+/** Read quantized subband samples from the input bitstream. They are stored
+ * raw, to be dequantized by the dequantFrame kernel. */
 PRIVATE void OI_SBC_ReadSamples(OI_CODEC_SBC_DECODER_CONTEXT* context,
                                 OI_BITSTREAM* global_bs) {
   OI_CODEC_SBC_COMMON_CONTEXT* common = &context->common;
@@ -189,33 +191,23 @@ PRIVATE void OI_SBC_ReadSamples(OI_CODEC_SBC_DECODER_CONTEXT* context,
   do {
     OI_UINT i;
     for (i = 0; i < iter_count; ++i) {
-      uint32_t sf_by4 = ((uint32_t*)common->scale_factor)[i];
       uint32_t bits_by4 = common->bits.uint32[i];
       OI_UINT n;
       for (n = 0; n < 4; ++n) {
-        int32_t dequant;
+        uint32_t raw = 0;
         OI_UINT bits;
-        OI_INT sf;
 
         if (OI_CPU_BYTE_ORDER == OI_LITTLE_ENDIAN_BYTE_ORDER) {
           bits = bits_by4 & 0xFF;
           bits_by4 >>= 8;
-          sf = sf_by4 & 0xFF;
-          sf_by4 >>= 8;
         } else {
           bits = (bits_by4 >> 24) & 0xFF;
           bits_by4 <<= 8;
-          sf = (sf_by4 >> 24) & 0xFF;
-          sf_by4 <<= 8;
         }
         if (bits) {
-          uint32_t raw;
           OI_BITSTREAM_READUINT(raw, bits, ptr, value, bitPtr);
-          dequant = OI_SBC_Dequant(raw, sf, bits);
-        } else {
-          dequant = 0;
         }
-        *s++ = dequant;
+        *s++ = (int32_t)raw;
       }
     }
   } while (--nrof_blocks);
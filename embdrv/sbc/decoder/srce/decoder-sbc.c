@@ -136,6 +136,10 @@ static OI_STATUS DecodeBody(OI_CODEC_SBC_DECODER_CONTEXT* context,
       OI_SBC_ReadSamples(context, &bs);
     }
 
+    TRACE(("Dequantizing samples"));
+    context->kernels->dequantFrame(
+        &context->common, context->common.frameInfo.mode == SBC_JOINT_STEREO);
+
     context->bufferedBlocks = context->common.frameInfo.nrof_blocks;
   }
 
@@ -433,7 +437,7 @@ uint8_t OI_CODEC_SBC_FrameCount(OI_BYTE* frameData, uint32_t frameBytes) {
   return frameCount;
 }
 
-/** Read quantized subband samples from the input bitstream and expand them. */
+/** Read quantized subband samples from the input bitstream. */
 
 #ifdef SPECIALIZE_READ_SAMPLES_JOINT
 
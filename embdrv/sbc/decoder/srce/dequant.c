@@ -180,6 +180,77 @@ INLINE int32_t OI_SBC_Dequant(uint32_t raw, OI_UINT scale_factor,
   return result >> (15 - scale_factor);
 }
 
+/** Returns whether subband sb of a joint stereo frame is mid/side coded. */
+INLINE OI_BOOL OI_SBC_IsJointSubband(OI_CODEC_SBC_COMMON_CONTEXT* common,
+                                     OI_UINT sb) {
+  OI_UINT nrof_subbands = common->frameInfo.nrof_subbands;
+
+  return (common->frameInfo.join >> (nrof_subbands - 1 - sb)) & 1;
+}
+
+/**
+ Dequantizes the raw subband samples that OI_SBC_ReadSamples() and
+ OI_SBC_ReadSamplesJoint() stored in common->subdata, one OI_SBC_Dequant() at a
+ time. This is the reference for the vectorized versions.
+ */
+PRIVATE void OI_SBC_DequantFrame(OI_CODEC_SBC_COMMON_CONTEXT* common,
+                                 OI_BOOL joint) {
+  OI_UINT nrof_subbands = common->frameInfo.nrof_subbands;
+  OI_UINT nrof_channels = common->frameInfo.nrof_channels;
+  OI_UINT bl = common->frameInfo.nrof_blocks;
+  int32_t* RESTRICT s = common->subdata;
+
+  do {
+    OI_UINT i;
+    OI_UINT sb;
+
+    for (i = 0; i < nrof_channels * nrof_subbands; i++) {
+      s[i] = OI_SBC_Dequant((uint32_t)s[i], common->scale_factor[i],
+                            common->bits.uint8[i]);
+    }
+    if (joint) {
+      for (sb = 0; sb < nrof_subbands; sb++) {
+        if (OI_SBC_IsJointSubband(common, sb)) {
+          int32_t mid = s[sb];
+          int32_t side = s[nrof_subbands + sb];
+          s[sb] = mid + side;
+          s[nrof_subbands + sb] = mid - side;
+        }
+      }
+    }
+    s += nrof_channels * nrof_subbands;
+  } while (--bl);
+}
+
+PRIVATE void OI_SBC_GetDequantParams(OI_CODEC_SBC_COMMON_CONTEXT* common,
+                                     OI_BOOL joint,
+                                     OI_SBC_DEQUANT_PARAMS* params) {
+  OI_UINT nrof_subbands = common->frameInfo.nrof_subbands;
+  OI_UINT nrof_channels = common->frameInfo.nrof_channels;
+  OI_UINT i;
+
+  for (i = 0; i < nrof_channels * nrof_subbands; i++) {
+    OI_UINT bits = common->bits.uint8[i];
+
+    OI_ASSERT(common->scale_factor[i] <= 15);
+    OI_ASSERT(bits <= 16);
+
+    /* OI_SBC_Dequant() returns 0 for these, which a null multiplier and
+     * offset give as well */
+    if (bits <= 1) {
+      params->mul[i] = 0;
+      params->offset[i] = 0;
+    } else {
+      params->mul[i] = dequant_long_scaled[bits];
+      params->offset[i] = SBC_DEQUANT_LONG_SCALED_OFFSET;
+    }
+    params->shift[i] = 15 - common->scale_factor[i];
+  }
+  for (i = 0; i < nrof_subbands; i++) {
+    params->jointMask[i] = (joint && OI_SBC_IsJointSubband(common, i)) ? -1 : 0;
+  }
+}
+
 /* This version of Dequant does not incorporate the scaling factor of 1.38. It
  * is intended for use with implementations of the filterbank which are
  * hard-coded into a DSP. Output is Q16.4 format, so that after joint stereo
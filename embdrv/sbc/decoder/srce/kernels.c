@@ -0,0 +1,313 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/** @file
+
+Vectorized versions of the decoding kernels that dominate the decoding time
+once the bitstream is read: the dequantization of the subband samples and the
+8-subband synthesis window. They give the same output as the C versions, bit
+for bit.
+
+Both need a shift that differs from one lane to the next, which neither SSE2
+nor SSE4.1 have. On ARM the NEON kernels are used whenever the target has
+NEON. On x86 the AVX2 kernels are built whatever the target, and are used
+when the CPU turns out to have AVX2. Otherwise the C kernels are used.
+
+The synthesis window computes the 8 PCM samples of SynthWindow80_generated()
+together. For the group of 16 values m = 0..4 of the filter buffer, sample n
+sums the products of 2 of them:
+@code
+    A[m][n] * buffer[16 * m + 4 + n] + B[m][n] * buffer[16 * m + 12 - n]
+@endcode
+each product shifted the way SynthWindow80_generated() shifts it. So the
+first terms of the 8 samples come from 8 consecutive values of the buffer, and
+the second terms from the next 8 values, reversed. The left shifts of the
+generated code are folded in the coefficients below, which multiply the
+samples in 32 bits so the products are the same.
+
+@ingroup codec_internal
+*/
+
+/**
+@addtogroup codec_internal
+@{
+*/
+
+#include "oi_codec_sbc_private.h"
+
+#if !defined(SBC_NO_VECTOR_KERNELS)
+#if defined(__ARM_NEON)
+#define SBC_NEON_KERNELS
+#include <arm_neon.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define SBC_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+#endif /* SBC_NO_VECTOR_KERNELS */
+
+const OI_CODEC_SBC_KERNELS OI_SBC_GenericKernels = {SynthWindow80_generated,
+                                                    OI_SBC_DequantFrame};
+
+#if defined(SBC_NEON_KERNELS) || defined(SBC_AVX2_KERNELS)
+
+/* A[m][n] and B[m][n], and the right shifts of their products */
+static const int32_t synthCoefA[5][8] = {
+    {0, -3263, -10385, -16457, 10445, -8443, -10337, -6087},
+    {-23167, -5229, -4944, -23641, -10594, -9632, -30605, -23144},
+    {-34794, -54042, -46126, -51556, 89196, 41020, 38212, 36110},
+    {34794, 34638, 18472, 24211, 10603, 9405, 16383, 3494},
+    {23167, 4555, 6239, 21223, 9539, 26189, 8603, 8721},
+};
+static const int32_t synthShiftA[5][8] = {
+    {0, 5, 6, 6, 4, 7, 4, 2}, {3, 0, 0, 2, 0, 0, 1, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 1, 0, 1, 2, 0},
+    {3, 1, 3, 8, 4, 7, 6, 7},
+};
+static const int32_t synthCoefB[5][8] = {
+    {8235, 29293, 24995, 19083, 0, 16913, 11167, 9293},
+    {26479, 30835, 9161, -29015, 0, 7374, 7668, 9976},
+    {75192, 63266, 55122, 49160, 0, 61788, 66536, 94684},
+    {26479, 26663, 12705, 23469, 0, -18233, 22117, 11537},
+    {8235, 12419, 9251, 26913, 0, 1499, 7543, 1370},
+};
+static const int32_t synthShiftB[5][8] = {
+    {3, 5, 5, 5, 0, 5, 4, 3}, {2, 3, 3, 4, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 0}, {2, 2, 1, 2, 0, 3, 4, 1},
+    {3, 4, 4, 6, 0, 1, 3, 0},
+};
+
+INLINE void StorePcm8(int16_t* pcm, const int16_t samples[8],
+                      OI_UINT strideShift) {
+  OI_UINT i;
+
+  for (i = 0; i < 8; i++) {
+    pcm[i << strideShift] = samples[i];
+  }
+}
+
+#endif /* SBC_NEON_KERNELS || SBC_AVX2_KERNELS */
+
+#if defined(SBC_NEON_KERNELS)
+
+/* Divides by 32768, rounding toward zero as the C division does, and clips
+ * to 16 bits */
+INLINE int16x4_t DivideAndClip_neon(int32x4_t x) {
+  uint32x4_t bias = vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(x, 31)), 17);
+
+  x = vaddq_s32(x, vreinterpretq_s32_u32(bias));
+  return vqmovn_s32(vshrq_n_s32(x, 15));
+}
+
+PRIVATE void SynthWindow80_neon(int16_t* pcm, SBC_BUFFER_T const* buffer,
+                                OI_UINT strideShift) {
+  int32x4_t lo = vdupq_n_s32(0);
+  int32x4_t hi = vdupq_n_s32(0);
+  int16x8_t out;
+  OI_UINT m;
+
+  for (m = 0; m < 5; m++) {
+    int16x8_t a = vld1q_s16(buffer + 16 * m + 4);
+    int16x8_t b = vrev64q_s16(vld1q_s16(buffer + 16 * m + 5));
+
+    b = vcombine_s16(vget_high_s16(b), vget_low_s16(b));
+    lo = vaddq_s32(
+        lo, vshlq_s32(vmulq_s32(vmovl_s16(vget_low_s16(a)),
+                                vld1q_s32(synthCoefA[m])),
+                      vnegq_s32(vld1q_s32(synthShiftA[m]))));
+    hi = vaddq_s32(
+        hi, vshlq_s32(vmulq_s32(vmovl_s16(vget_high_s16(a)),
+                                vld1q_s32(synthCoefA[m] + 4)),
+                      vnegq_s32(vld1q_s32(synthShiftA[m] + 4))));
+    lo = vaddq_s32(
+        lo, vshlq_s32(vmulq_s32(vmovl_s16(vget_low_s16(b)),
+                                vld1q_s32(synthCoefB[m])),
+                      vnegq_s32(vld1q_s32(synthShiftB[m]))));
+    hi = vaddq_s32(
+        hi, vshlq_s32(vmulq_s32(vmovl_s16(vget_high_s16(b)),
+                                vld1q_s32(synthCoefB[m] + 4)),
+                      vnegq_s32(vld1q_s32(synthShiftB[m] + 4))));
+  }
+
+  out = vcombine_s16(DivideAndClip_neon(lo), DivideAndClip_neon(hi));
+  if (strideShift == 0) {
+    vst1q_s16(pcm, out);
+  } else {
+    int16_t samples[8];
+    vst1q_s16(samples, out);
+    StorePcm8(pcm, samples, strideShift);
+  }
+}
+
+PRIVATE void OI_SBC_DequantFrame_neon(OI_CODEC_SBC_COMMON_CONTEXT* common,
+                                      OI_BOOL joint) {
+  OI_UINT nrof_subbands = common->frameInfo.nrof_subbands;
+  OI_UINT lanes = common->frameInfo.nrof_channels * nrof_subbands;
+  OI_UINT bl = common->frameInfo.nrof_blocks;
+  int32_t* RESTRICT s = common->subdata;
+  OI_SBC_DEQUANT_PARAMS params;
+  OI_UINT i;
+
+  OI_SBC_GetDequantParams(common, joint, &params);
+  for (i = 0; i < lanes; i++) {
+    params.shift[i] = -params.shift[i];
+  }
+
+  do {
+    for (i = 0; i < lanes; i += 4) {
+      uint32x4_t d = vreinterpretq_u32_s32(vld1q_s32(s + i));
+
+      d = vaddq_u32(vshlq_n_u32(d, 1), vdupq_n_u32(1));
+      d = vsubq_u32(vmulq_u32(d, vld1q_u32(params.mul + i)),
+                    vld1q_u32(params.offset + i));
+      vst1q_s32(s + i, vshlq_s32(vreinterpretq_s32_u32(d),
+                                 vld1q_s32(params.shift + i)));
+    }
+    if (joint) {
+      for (i = 0; i < nrof_subbands; i += 4) {
+        int32x4_t mid = vld1q_s32(s + i);
+        int32x4_t side = vld1q_s32(s + nrof_subbands + i);
+        uint32x4_t mask =
+            vreinterpretq_u32_s32(vld1q_s32(params.jointMask + i));
+
+        vst1q_s32(s + i, vbslq_s32(mask, vaddq_s32(mid, side), mid));
+        vst1q_s32(s + nrof_subbands + i,
+                  vbslq_s32(mask, vsubq_s32(mid, side), side));
+      }
+    }
+    s += lanes;
+  } while (--bl);
+}
+
+static const OI_CODEC_SBC_KERNELS neonKernels = {SynthWindow80_neon,
+                                                 OI_SBC_DequantFrame_neon};
+
+#endif /* SBC_NEON_KERNELS */
+
+#if defined(SBC_AVX2_KERNELS)
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION PRIVATE void SynthWindow80_avx2(int16_t* pcm,
+                                              SBC_BUFFER_T const* buffer,
+                                              OI_UINT strideShift) {
+  const __m128i reverse =
+      _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+  __m256i acc = _mm256_setzero_si256();
+  __m128i out;
+  OI_UINT m;
+
+  for (m = 0; m < 5; m++) {
+    __m256i a = _mm256_cvtepi16_epi32(
+        _mm_loadu_si128((const __m128i*)(buffer + 16 * m + 4)));
+    __m256i b = _mm256_cvtepi16_epi32(_mm_shuffle_epi8(
+        _mm_loadu_si128((const __m128i*)(buffer + 16 * m + 5)), reverse));
+
+    a = _mm256_mullo_epi32(
+        a, _mm256_loadu_si256((const __m256i*)synthCoefA[m]));
+    b = _mm256_mullo_epi32(
+        b, _mm256_loadu_si256((const __m256i*)synthCoefB[m]));
+    acc = _mm256_add_epi32(
+        acc, _mm256_srav_epi32(
+                 a, _mm256_loadu_si256((const __m256i*)synthShiftA[m])));
+    acc = _mm256_add_epi32(
+        acc, _mm256_srav_epi32(
+                 b, _mm256_loadu_si256((const __m256i*)synthShiftB[m])));
+  }
+
+  /* Divide by 32768, rounding toward zero as the C division does, and clip to
+   * 16 bits */
+  acc = _mm256_add_epi32(acc,
+                         _mm256_srli_epi32(_mm256_srai_epi32(acc, 31), 17));
+  acc = _mm256_srai_epi32(acc, 15);
+  out = _mm_packs_epi32(_mm256_castsi256_si128(acc),
+                        _mm256_extracti128_si256(acc, 1));
+  if (strideShift == 0) {
+    _mm_storeu_si128((__m128i*)pcm, out);
+  } else {
+    int16_t samples[8];
+    _mm_storeu_si128((__m128i*)samples, out);
+    StorePcm8(pcm, samples, strideShift);
+  }
+}
+
+AVX2_FUNCTION PRIVATE void OI_SBC_DequantFrame_avx2(
+    OI_CODEC_SBC_COMMON_CONTEXT* common, OI_BOOL joint) {
+  OI_UINT nrof_subbands = common->frameInfo.nrof_subbands;
+  OI_UINT lanes = common->frameInfo.nrof_channels * nrof_subbands;
+  OI_UINT bl = common->frameInfo.nrof_blocks;
+  int32_t* RESTRICT s = common->subdata;
+  const __m128i one = _mm_set1_epi32(1);
+  OI_SBC_DEQUANT_PARAMS params;
+  OI_UINT i;
+
+  OI_SBC_GetDequantParams(common, joint, &params);
+
+  do {
+    for (i = 0; i < lanes; i += 4) {
+      __m128i d = _mm_loadu_si128((const __m128i*)(s + i));
+
+      d = _mm_add_epi32(_mm_slli_epi32(d, 1), one);
+      d = _mm_mullo_epi32(d,
+                          _mm_loadu_si128((const __m128i*)(params.mul + i)));
+      d = _mm_sub_epi32(d,
+                        _mm_loadu_si128((const __m128i*)(params.offset + i)));
+      d = _mm_srav_epi32(d,
+                         _mm_loadu_si128((const __m128i*)(params.shift + i)));
+      _mm_storeu_si128((__m128i*)(s + i), d);
+    }
+    if (joint) {
+      for (i = 0; i < nrof_subbands; i += 4) {
+        __m128i mid = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i side =
+            _mm_loadu_si128((const __m128i*)(s + nrof_subbands + i));
+        __m128i mask =
+            _mm_loadu_si128((const __m128i*)(params.jointMask + i));
+
+        _mm_storeu_si128((__m128i*)(s + i),
+                         _mm_add_epi32(mid, _mm_and_si128(mask, side)));
+        _mm_storeu_si128(
+            (__m128i*)(s + nrof_subbands + i),
+            _mm_blendv_epi8(side, _mm_sub_epi32(mid, side), mask));
+      }
+    }
+    s += lanes;
+  } while (--bl);
+}
+
+static const OI_CODEC_SBC_KERNELS avx2Kernels = {SynthWindow80_avx2,
+                                                 OI_SBC_DequantFrame_avx2};
+
+#endif /* SBC_AVX2_KERNELS */
+
+PRIVATE const OI_CODEC_SBC_KERNELS* OI_SBC_SelectKernels(void) {
+#if defined(SBC_NEON_KERNELS)
+  return &neonKernels;
+#else
+#if defined(SBC_AVX2_KERNELS)
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2Kernels;
+  }
+#endif
+  return &OI_SBC_GenericKernels;
+#endif
+}
+
+/**
+@}
+*/
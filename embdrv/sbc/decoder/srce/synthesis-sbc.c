@@ -243,9 +243,6 @@ INLINE int32_t default_mul_16s_32s_hi(int16_t u, int32_t v) {
 
 #define LONG_MULT_DCT(K, sample) (MUL_16S_32S_HI(K, sample) << 2)
 
-PRIVATE void SynthWindow80_generated(int16_t* pcm,
-                                     SBC_BUFFER_T const* RESTRICT buffer,
-                                     OI_UINT strideShift);
 PRIVATE void SynthWindow112_generated(int16_t* pcm,
                                       SBC_BUFFER_T const* RESTRICT buffer,
                                       OI_UINT strideShift);
@@ -265,8 +262,9 @@ typedef void (*SYNTH_FRAME)(OI_CODEC_SBC_DECODER_CONTEXT* context, int16_t* pcm,
 #define DCT2_8(dst, src) dct2_8(dst, src)
 #endif
 
+/* Uses the kernel picked for the CPU, context is the decoder context. */
 #ifndef SYNTH80
-#define SYNTH80 SynthWindow80_generated
+#define SYNTH80 (*context->kernels->synthWindow80)
 #endif
 
 #ifndef SYNTH112
@@ -0,0 +1,196 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+// The decoding kernels picked for the CPU must be bit exact with the C ones.
+// Where the CPU has no vectorized kernels, both are the same.
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "embdrv/sbc/encoder/include/sbc_encoder.h"
+
+extern "C" {
+#include "oi_codec_sbc_private.h"
+}
+
+namespace {
+
+constexpr size_t kNumFrames = 64;
+
+std::vector<int16_t> make_pcm(size_t samples, int channels, int sample_rate) {
+  std::vector<int16_t> pcm(samples * channels);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> noise(-3000, 3000);
+  for (size_t i = 0; i < samples; i++) {
+    double t = static_cast<double>(i) / sample_rate;
+    // Loud enough to clip after decoding, so the saturation is compared too
+    double left = sin(2 * M_PI * 440 * t) + 0.3 * sin(2 * M_PI * 5000 * t);
+    double right = sin(2 * M_PI * 440 * t) + 0.3 * sin(2 * M_PI * 9000 * t);
+    pcm[i * channels] = static_cast<int16_t>(left * 24000);
+    if (channels == 2)
+      pcm[i * channels + 1] = static_cast<int16_t>(right * 22000 + noise(rng));
+  }
+  return pcm;
+}
+
+// Encodes kNumFrames frames of the given format
+std::vector<uint8_t> encode(int16_t channel_mode, int16_t subbands,
+                            int16_t blocks, int16_t allocation,
+                            uint16_t bit_rate, int channels) {
+  SBC_ENC_PARAMS params = {};
+  params.s16SamplingFreq = SBC_sf44100;
+  params.s16ChannelMode = channel_mode;
+  params.s16NumOfSubBands = subbands;
+  params.s16NumOfBlocks = blocks;
+  params.s16AllocationMethod = allocation;
+  params.u16BitRate = bit_rate;
+  SBC_Encoder_Init(&params);
+
+  size_t frame_samples = subbands * blocks;
+  std::vector<int16_t> pcm =
+      make_pcm(kNumFrames * frame_samples, channels, 44100);
+  std::vector<uint8_t> stream;
+  uint8_t output[512];
+  for (size_t i = 0; i < kNumFrames; i++) {
+    uint32_t len =
+        SBC_Encode(&params, &pcm[i * frame_samples * channels], output);
+    stream.insert(stream.end(), output, output + len);
+  }
+  return stream;
+}
+
+std::vector<int16_t> decode(const std::vector<uint8_t>& stream, int channels,
+                            const OI_CODEC_SBC_KERNELS* kernels) {
+  // The decoder does not clear the filter history it is given
+  OI_CODEC_SBC_DECODER_CONTEXT context;
+  uint32_t context_data[CODEC_DATA_WORDS(2, SBC_CODEC_FAST_FILTER_BUFFERS)] =
+      {};
+  EXPECT_EQ(OI_OK, OI_CODEC_SBC_DecoderReset(&context, context_data,
+                                             sizeof(context_data), channels,
+                                             channels, false));
+  context.kernels = kernels;
+
+  std::vector<int16_t> pcm;
+  const OI_BYTE* data = stream.data();
+  uint32_t bytes = stream.size();
+  while (bytes > 0) {
+    int16_t frame[SBC_MAX_SAMPLES_PER_FRAME * SBC_MAX_CHANNELS];
+    uint32_t pcm_bytes = sizeof(frame);
+    OI_STATUS status =
+        OI_CODEC_SBC_DecodeFrame(&context, &data, &bytes, frame, &pcm_bytes);
+    EXPECT_EQ(OI_OK, status);
+    if (status != OI_OK) break;
+    pcm.insert(pcm.end(), frame, frame + pcm_bytes / sizeof(int16_t));
+  }
+  return pcm;
+}
+
+}  // namespace
+
+TEST(SbcDecoderTest, test_synth_window_is_bit_exact) {
+  const OI_CODEC_SBC_KERNELS* kernels = OI_SBC_SelectKernels();
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> sample(INT16_MIN, INT16_MAX);
+  SBC_BUFFER_T buffer[80];
+
+  for (int i = 0; i < 10000; i++) {
+    for (SBC_BUFFER_T& value : buffer) {
+      // Extreme values now and then, which saturate the output
+      value = (i % 4 == 0) ? (sample(rng) < 0 ? INT16_MIN : INT16_MAX)
+                           : sample(rng) >> (i % 8);
+    }
+    for (OI_UINT stride_shift = 0; stride_shift <= 1; stride_shift++) {
+      int16_t expected[16] = {};
+      int16_t actual[16] = {};
+      SynthWindow80_generated(expected, buffer, stride_shift);
+      kernels->synthWindow80(actual, buffer, stride_shift);
+      for (int n = 0; n < 16; n++)
+        ASSERT_EQ(expected[n], actual[n]) << "sample " << n << " run " << i;
+    }
+  }
+}
+
+TEST(SbcDecoderTest, test_dequant_is_bit_exact) {
+  const OI_CODEC_SBC_KERNELS* kernels = OI_SBC_SelectKernels();
+  std::mt19937 rng(1);
+  int32_t expected[SBC_MAX_BLOCKS * SBC_MAX_CHANNELS * SBC_MAX_BANDS];
+  int32_t actual[SBC_MAX_BLOCKS * SBC_MAX_CHANNELS * SBC_MAX_BANDS];
+  OI_CODEC_SBC_COMMON_CONTEXT common = {};
+
+  for (int i = 0; i < 4000; i++) {
+    OI_CODEC_SBC_FRAME_INFO* frame = &common.frameInfo;
+    frame->nrof_subbands = (i & 1) ? 8 : 4;
+    frame->nrof_channels = (i & 2) ? 2 : 1;
+    frame->nrof_blocks = 4 * (1 + i % 4);
+    frame->join = rng() & ((1 << frame->nrof_subbands) - 1);
+    OI_BOOL joint = frame->nrof_channels == 2 && (i & 4);
+
+    size_t lanes = frame->nrof_channels * frame->nrof_subbands;
+    for (size_t n = 0; n < lanes; n++) {
+      common.bits.uint8[n] = rng() % 17;
+      common.scale_factor[n] = rng() % 16;
+    }
+    for (size_t n = 0; n < frame->nrof_blocks * lanes; n++) {
+      uint32_t max_raw = (1u << common.bits.uint8[n % lanes]) - 1;
+      expected[n] = actual[n] = rng() % (max_raw + 1);
+    }
+
+    common.subdata = expected;
+    OI_SBC_DequantFrame(&common, joint);
+    common.subdata = actual;
+    kernels->dequantFrame(&common, joint);
+    for (size_t n = 0; n < frame->nrof_blocks * lanes; n++)
+      ASSERT_EQ(expected[n], actual[n]) << "sample " << n << " run " << i;
+  }
+}
+
+TEST(SbcDecoderTest, test_decoding_is_bit_exact) {
+  struct {
+    int16_t channel_mode;
+    int16_t subbands;
+    int16_t blocks;
+    int16_t allocation;
+    uint16_t bit_rate;
+    int channels;
+  } formats[] = {
+      {SBC_JOINT_STEREO, 8, 16, SBC_LOUDNESS, 328, 2},
+      {SBC_JOINT_STEREO, 8, 16, SBC_LOUDNESS, 512, 2},
+      {SBC_JOINT_STEREO, 4, 8, SBC_SNR, 229, 2},
+      {SBC_STEREO, 8, 12, SBC_LOUDNESS, 345, 2},
+      {SBC_DUAL, 8, 16, SBC_SNR, 345, 2},
+      {SBC_MONO, 8, 16, SBC_LOUDNESS, 127, 1},
+      {SBC_MONO, 4, 16, SBC_SNR, 96, 1},
+  };
+
+  for (const auto& format : formats) {
+    std::vector<uint8_t> stream =
+        encode(format.channel_mode, format.subbands, format.blocks,
+               format.allocation, format.bit_rate, format.channels);
+    std::vector<int16_t> expected =
+        decode(stream, format.channels, &OI_SBC_GenericKernels);
+    std::vector<int16_t> actual =
+        decode(stream, format.channels, OI_SBC_SelectKernels());
+    EXPECT_EQ(kNumFrames * format.subbands * format.blocks * format.channels,
+              expected.size());
+    EXPECT_EQ(expected, actual) << "mode " << format.channel_mode
+                                << " subbands " << format.subbands;
+  }
+}
@@ -113,6 +113,21 @@
 #define SBC_IS_64_MULT_IN_WINDOW_ACCU FALSE
 #endif /*SBC_IS_64_MULT_IN_WINDOW_ACCU */
 
+/* Set SBC_VECTOR_WINDOW_OPT to TRUE to compute the 8 subband windowing with
+ * NEON or SSE2 intrinsics. The output is bit exact with the scalar windowing.
+ * Only applies to the SBC_IPAQ_OPT windowing with 32 bit accumulation; by
+ * default it is enabled whenever the target has either instruction set.
+ */
+#ifndef SBC_VECTOR_WINDOW_OPT
+#if ((SBC_IPAQ_OPT == TRUE) && (SBC_ARM_ASM_OPT == FALSE) && \
+     (SBC_IS_64_MULT_IN_WINDOW_ACCU == FALSE) &&             \
+     (defined(__ARM_NEON) || defined(__SSE2__)))
+#define SBC_VECTOR_WINDOW_OPT TRUE
+#else
+#define SBC_VECTOR_WINDOW_OPT FALSE
+#endif
+#endif /* SBC_VECTOR_WINDOW_OPT */
+
 /* Set SBC_IS_64_MULT_IN_IDCT to TRUE to use 64 bits multiplication in the DCT
  * of Matrixing
  */
@@ -25,6 +25,14 @@
 #include <string.h>
 #include "sbc_enc_func_declare.h"
 #include "sbc_encoder.h"
+
+#if (SBC_VECTOR_WINDOW_OPT == TRUE)
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#else
+#include <emmintrin.h>
+#endif
+#endif
 /*#include <math.h>*/
 
 #if (SBC_IS_64_MULT_IN_WINDOW_ACCU == TRUE)
@@ -1185,6 +1193,96 @@ static int16_t* s16X =
 #endif
 #endif
 
+#if (SBC_VECTOR_WINDOW_OPT == TRUE)
+/* Window coefficients for 8 subbands: s32DCTY[j] is the sum over m of
+ * as16WindowCoeff8[m][j] * s16X[ChOffset + 16 * m + j]. These are the
+ * coefficients of the WINDOW_ACCU_8_* macros, with the terms that those
+ * macros factor out (for s32DCTY[0] and s32DCTY[8]) expanded again, which
+ * gives the same result in 32 bit arithmetic. */
+static const int16_t as16WindowCoeff8[5][16] = {
+    {0, WIND_8_SUBBANDS_1_0, WIND_8_SUBBANDS_2_0, WIND_8_SUBBANDS_3_0,
+     WIND_8_SUBBANDS_4_0, WIND_8_SUBBANDS_5_0, WIND_8_SUBBANDS_6_0,
+     WIND_8_SUBBANDS_7_0, WIND_8_SUBBANDS_8_0, WIND_8_SUBBANDS_7_4,
+     WIND_8_SUBBANDS_6_4, WIND_8_SUBBANDS_5_4, WIND_8_SUBBANDS_4_4,
+     WIND_8_SUBBANDS_3_4, WIND_8_SUBBANDS_2_4, WIND_8_SUBBANDS_1_4},
+    {WIND_8_SUBBANDS_0_1, WIND_8_SUBBANDS_1_1, WIND_8_SUBBANDS_2_1,
+     WIND_8_SUBBANDS_3_1, WIND_8_SUBBANDS_4_1, WIND_8_SUBBANDS_5_1,
+     WIND_8_SUBBANDS_6_1, WIND_8_SUBBANDS_7_1, WIND_8_SUBBANDS_8_1,
+     WIND_8_SUBBANDS_7_3, WIND_8_SUBBANDS_6_3, WIND_8_SUBBANDS_5_3,
+     WIND_8_SUBBANDS_4_3, WIND_8_SUBBANDS_3_3, WIND_8_SUBBANDS_2_3,
+     WIND_8_SUBBANDS_1_3},
+    {WIND_8_SUBBANDS_0_2, WIND_8_SUBBANDS_1_2, WIND_8_SUBBANDS_2_2,
+     WIND_8_SUBBANDS_3_2, WIND_8_SUBBANDS_4_2, WIND_8_SUBBANDS_5_2,
+     WIND_8_SUBBANDS_6_2, WIND_8_SUBBANDS_7_2, WIND_8_SUBBANDS_8_2,
+     WIND_8_SUBBANDS_7_2, WIND_8_SUBBANDS_6_2, WIND_8_SUBBANDS_5_2,
+     WIND_8_SUBBANDS_4_2, WIND_8_SUBBANDS_3_2, WIND_8_SUBBANDS_2_2,
+     WIND_8_SUBBANDS_1_2},
+    {-WIND_8_SUBBANDS_0_2, WIND_8_SUBBANDS_1_3, WIND_8_SUBBANDS_2_3,
+     WIND_8_SUBBANDS_3_3, WIND_8_SUBBANDS_4_3, WIND_8_SUBBANDS_5_3,
+     WIND_8_SUBBANDS_6_3, WIND_8_SUBBANDS_7_3, WIND_8_SUBBANDS_8_1,
+     WIND_8_SUBBANDS_7_1, WIND_8_SUBBANDS_6_1, WIND_8_SUBBANDS_5_1,
+     WIND_8_SUBBANDS_4_1, WIND_8_SUBBANDS_3_1, WIND_8_SUBBANDS_2_1,
+     WIND_8_SUBBANDS_1_1},
+    {-WIND_8_SUBBANDS_0_1, WIND_8_SUBBANDS_1_4, WIND_8_SUBBANDS_2_4,
+     WIND_8_SUBBANDS_3_4, WIND_8_SUBBANDS_4_4, WIND_8_SUBBANDS_5_4,
+     WIND_8_SUBBANDS_6_4, WIND_8_SUBBANDS_7_4, WIND_8_SUBBANDS_8_0,
+     WIND_8_SUBBANDS_7_0, WIND_8_SUBBANDS_6_0, WIND_8_SUBBANDS_5_0,
+     WIND_8_SUBBANDS_4_0, WIND_8_SUBBANDS_3_0, WIND_8_SUBBANDS_2_0,
+     WIND_8_SUBBANDS_1_0},
+};
+
+/* Computes s32DCTY[0..15] from the 80 samples at ps16X, 16 subband sums at a
+ * time. */
+static void SbcWindow8(const int16_t* ps16X, int32_t* ps32DCTY) {
+  int32_t m;
+#if defined(__ARM_NEON)
+  int32x4_t acc0 = vdupq_n_s32(0), acc1 = vdupq_n_s32(0);
+  int32x4_t acc2 = vdupq_n_s32(0), acc3 = vdupq_n_s32(0);
+
+  for (m = 0; m < 5; m++) {
+    int16x8_t x0 = vld1q_s16(ps16X + 16 * m);
+    int16x8_t x1 = vld1q_s16(ps16X + 16 * m + 8);
+    int16x8_t c0 = vld1q_s16(as16WindowCoeff8[m]);
+    int16x8_t c1 = vld1q_s16(as16WindowCoeff8[m] + 8);
+
+    acc0 = vmlal_s16(acc0, vget_low_s16(x0), vget_low_s16(c0));
+    acc1 = vmlal_s16(acc1, vget_high_s16(x0), vget_high_s16(c0));
+    acc2 = vmlal_s16(acc2, vget_low_s16(x1), vget_low_s16(c1));
+    acc3 = vmlal_s16(acc3, vget_high_s16(x1), vget_high_s16(c1));
+  }
+
+  vst1q_s32(ps32DCTY, acc0);
+  vst1q_s32(ps32DCTY + 4, acc1);
+  vst1q_s32(ps32DCTY + 8, acc2);
+  vst1q_s32(ps32DCTY + 12, acc3);
+#else
+  __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+  __m128i acc2 = _mm_setzero_si128(), acc3 = _mm_setzero_si128();
+
+  for (m = 0; m < 5; m++) {
+    __m128i x0 = _mm_loadu_si128((const __m128i*)(ps16X + 16 * m));
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(ps16X + 16 * m + 8));
+    __m128i c0 = _mm_loadu_si128((const __m128i*)as16WindowCoeff8[m]);
+    __m128i c1 = _mm_loadu_si128((const __m128i*)(as16WindowCoeff8[m] + 8));
+
+    /* 16x16 -> 32 bit products from the low and high halves */
+    __m128i lo0 = _mm_mullo_epi16(x0, c0), hi0 = _mm_mulhi_epi16(x0, c0);
+    __m128i lo1 = _mm_mullo_epi16(x1, c1), hi1 = _mm_mulhi_epi16(x1, c1);
+
+    acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(lo0, hi0));
+    acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(lo0, hi0));
+    acc2 = _mm_add_epi32(acc2, _mm_unpacklo_epi16(lo1, hi1));
+    acc3 = _mm_add_epi32(acc3, _mm_unpackhi_epi16(lo1, hi1));
+  }
+
+  _mm_storeu_si128((__m128i*)ps32DCTY, acc0);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 4), acc1);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 8), acc2);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 12), acc3);
+#endif
+}
+#endif /* SBC_VECTOR_WINDOW_OPT */
+
 static int16_t ShiftCounter = 0;
 extern int16_t EncMaxShiftCounter;
 /****************************************************************************
@@ -1296,7 +1394,7 @@ void SbcAnalysisFilter8(SBC_ENC_PARAMS* pstrEncParams, int16_t* input) {
 #if (SBC_IPAQ_OPT == TRUE)
 #if (SBC_IS_64_MULT_IN_WINDOW_ACCU == TRUE)
   register int64_t s64Temp, s64Temp2;
-#else
+#elif (SBC_VECTOR_WINDOW_OPT == FALSE)
   register int32_t s32Temp, s32Temp2;
 #endif
 #else
@@ -1370,7 +1468,11 @@ void SbcAnalysisFilter8(SBC_ENC_PARAMS* pstrEncParams, int16_t* input) {
     for (s32Ch = 0; s32Ch < s32NumOfChannels; s32Ch++) {
       ChOffset = s32Ch * Offset2 + Offset;
 
+#if (SBC_VECTOR_WINDOW_OPT == TRUE)
+      SbcWindow8(s16X + ChOffset, s32DCTY);
+#else
       WINDOW_PARTIAL_8
+#endif
 
       SBC_FastIDCT8(s32DCTY, ps32SbBuf);
 
@@ -39,6 +39,14 @@
 #else
 #define Mult32(s32In1, s32In2, s32OutLow) \
   s32OutLow = (int32_t)(s32In1) * (int32_t)(s32In2);
+#if (SBC_IPAQ_OPT == TRUE)
+#define Mult64(s32In1, s32In2, s32OutLow, s32OutHi)  \
+  {                                                  \
+    s64Temp = (int64_t)(s32In1) * (int64_t)(s32In2); \
+    (s32OutLow) = (int32_t)s64Temp;                  \
+    (s32OutHi) = (int32_t)(s64Temp >> 32);           \
+  }
+#else
 #define Mult64(s32In1, s32In2, s32OutLow, s32OutHi)                   \
   {                                                                   \
     (s32OutLow) = ((int32_t)(uint16_t)(s32In1) * (uint16_t)(s32In2)); \
@@ -50,6 +58,7 @@
     (s32OutHi) = (s32TempVal2 >> 16) + s32Carry;                      \
   }
 #endif
+#endif
 
 /* return number of bytes written to output */
 uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
@@ -61,11 +70,12 @@ uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
   int32_t s32PresentBit; /* represents bit to be stored*/
   /*int32_t s32LoopCountI;                       loop counter*/
   int32_t s32LoopCountJ; /* loop counter*/
-  uint32_t u32QuantizedSbValue,
-      u32QuantizedSbValue0; /* temp variable to store quantized sb val*/
-  int32_t s32LoopCount;     /* loop counter*/
-  uint8_t u8XoredVal;       /* to store XORed value in CRC calculation*/
-  uint8_t u8CRC;            /* to store CRC value*/
+  uint32_t u32QuantizedSbValue0; /* temp variable to store quantized sb val*/
+  uint32_t u32BitBuf;            /* bits packed but not yet written out*/
+  int32_t s32BitCount;           /* number of bits in u32BitBuf*/
+  int32_t s32LoopCount;          /* loop counter*/
+  uint8_t u8XoredVal;            /* to store XORed value in CRC calculation*/
+  uint8_t u8CRC;                 /* to store CRC value*/
   int16_t* ps16GenPtr;
   int32_t s32NumOfBlocks;
   int32_t s32NumOfSubBands = pstrEncParams->s16NumOfSubBands;
@@ -77,7 +87,12 @@ uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
   int32_t s32Temp1;   /*used in 64-bit multiplication*/
   int32_t s32Low;     /*used in 64-bit multiplication*/
 #if (SBC_IS_64_MULT_IN_QUANTIZER == TRUE)
-  int32_t s32Hi1, s32Low1, s32Carry, s32TempVal2, s32Hi, s32Temp2;
+  int32_t s32Hi1, s32Low1, s32Hi, s32Temp2;
+#if (SBC_ARM_ASM_OPT == FALSE && SBC_IPAQ_OPT == TRUE)
+  int64_t s64Temp;
+#elif (SBC_ARM_ASM_OPT == FALSE)
+  int32_t s32Carry, s32TempVal2;
+#endif
 #endif
 
   pu8PacketPtr = output;           /*Initialize the ptr*/
@@ -127,7 +142,10 @@ uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
 
   /* Pack samples */
   ps32SbPtr = pstrEncParams->s32SbBuffer;
-  /*Temp=*pu8PacketPtr;*/
+  /* the bits that are not written out yet are the s32BitCount lsbs of
+  u32BitBuf, starting with the ones left over from the scale factors */
+  u32BitBuf = Temp;
+  s32BitCount = 8 - s32PresentBit;
   s32NumOfBlocks = pstrEncParams->s16NumOfBlocks;
   for (s32Blk = s32NumOfBlocks - 1; s32Blk >= 0; s32Blk--) {
     ps16GenPtr = pstrEncParams->as16Bits;
@@ -162,42 +180,14 @@ uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
         s32Low >>= (*ps16ScfPtr + 1);
         u32QuantizedSbValue0 = (uint16_t)s32Low;
 #endif
-        /*store the number of bits required and the quantized s32Sb
-        sample to ease the coding*/
-        u32QuantizedSbValue = u32QuantizedSbValue0;
-
-        if (s32PresentBit >= s32LoopCount) {
-          Temp <<= s32LoopCount;
-          Temp |= u32QuantizedSbValue;
-          s32PresentBit -= s32LoopCount;
-        } else {
-          while (s32PresentBit < s32LoopCount) {
-            s32LoopCount -= s32PresentBit;
-            u32QuantizedSbValue >>= s32LoopCount;
-
-            /*remove the unwanted msbs*/
-            /*u32QuantizedSbValue <<= 16 - s32PresentBit;
-            u32QuantizedSbValue >>= 16 - s32PresentBit;*/
-
-            Temp <<= s32PresentBit;
-
-            Temp |= u32QuantizedSbValue;
-            /*restore the original*/
-            u32QuantizedSbValue = u32QuantizedSbValue0;
-
-            *(pu8PacketPtr++) = Temp;
-            Temp = 0;
-            s32PresentBit = 8;
-          }
-          Temp <<= s32LoopCount;
-
-          /* remove the unwanted msbs */
-          /*u32QuantizedSbValue <<= 16 - s32LoopCount;
-          u32QuantizedSbValue >>= 16 - s32LoopCount;*/
-
-          Temp |= u32QuantizedSbValue;
-
-          s32PresentBit -= s32LoopCount;
+        /* append the quantized sample to the bit buffer; a byte is only
+        written out once the bits that follow it are known, so that the
+        last byte is always written below */
+        u32BitBuf = (u32BitBuf << s32LoopCount) | u32QuantizedSbValue0;
+        s32BitCount += s32LoopCount;
+        while (s32BitCount > 8) {
+          s32BitCount -= 8;
+          *(pu8PacketPtr++) = (uint8_t)(u32BitBuf >> s32BitCount);
         }
       }
       ps16ScfPtr++;
@@ -205,7 +195,7 @@ uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
     }
   }
 
-  Temp <<= s32PresentBit;
+  Temp = (uint8_t)(u32BitBuf << (8 - s32BitCount));
   *pu8PacketPtr = Temp;
   uint32_t u16PacketLength = pu8PacketPtr - output + 1;
   /*find CRC*/
@@ -0,0 +1,127 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+// The encoder must stay bit exact with the scalar windowing and bit-by-bit
+// packing it was optimized from. The expected digests were produced by that
+// encoder, so they hold whichever windowing the target compiles in.
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <vector>
+
+#include "embdrv/sbc/encoder/include/sbc_encoder.h"
+
+namespace {
+
+constexpr int kNumFrames = 16;
+
+// Integer only, so that the input does not depend on the math library:
+// a square wave and a sawtooth, noise, and full scale bursts that saturate
+std::vector<int16_t> make_pcm(size_t samples, int channels, uint32_t seed) {
+  std::vector<int16_t> pcm(samples * channels);
+  uint32_t noise = seed;
+  for (size_t i = 0; i < samples; i++) {
+    for (int ch = 0; ch < channels; ch++) {
+      noise = noise * 1664525u + 1013904223u;
+      int32_t square = ((i / (37 + 11 * ch)) & 1) ? 9000 : -9000;
+      int32_t saw = static_cast<int32_t>((i * (211 + 97 * ch)) % 16384) - 8192;
+      int32_t value = square + saw + static_cast<int16_t>(noise >> 16) / 8;
+      if ((i / 256) % 7 == 3) value = (noise & 0x80000000u) ? -32768 : 32767;
+      if (value > INT16_MAX) value = INT16_MAX;
+      if (value < INT16_MIN) value = INT16_MIN;
+      pcm[i * channels + ch] = static_cast<int16_t>(value);
+    }
+  }
+  return pcm;
+}
+
+// FNV-1a
+void digest_update(uint32_t* digest, const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    *digest ^= data[i];
+    *digest *= 16777619u;
+  }
+}
+
+// Encodes kNumFrames frames for every sampling frequency, block count,
+// allocation method and bit rate with the given channel mode and subband
+// count, and returns the digest of all the frames.
+uint32_t encode_all(int16_t channel_mode, int16_t subbands) {
+  const int16_t frequencies[] = {SBC_sf16000, SBC_sf32000, SBC_sf44100,
+                                 SBC_sf48000};
+  const int16_t blocks[] = {SBC_BLOCK_0, SBC_BLOCK_1, SBC_BLOCK_2,
+                            SBC_BLOCK_3};
+  const int16_t allocations[] = {SBC_LOUDNESS, SBC_SNR};
+  const uint16_t bit_rates[] = {64, 229, 345};
+  int channels = (channel_mode == SBC_MONO) ? 1 : 2;
+
+  uint32_t digest = 2166136261u;
+  uint32_t seed = 1;
+  for (int16_t frequency : frequencies) {
+    for (int16_t block_count : blocks) {
+      for (int16_t allocation : allocations) {
+        for (uint16_t bit_rate : bit_rates) {
+          SBC_ENC_PARAMS params = {};
+          params.s16SamplingFreq = frequency;
+          params.s16ChannelMode = channel_mode;
+          params.s16NumOfSubBands = subbands;
+          params.s16NumOfBlocks = block_count;
+          params.s16AllocationMethod = allocation;
+          params.u16BitRate = bit_rate;
+          SBC_Encoder_Init(&params);
+
+          size_t frame_samples = subbands * block_count;
+          std::vector<int16_t> pcm =
+              make_pcm(kNumFrames * frame_samples, channels, seed++);
+          uint8_t output[1024];
+          for (int i = 0; i < kNumFrames; i++) {
+            uint32_t len =
+                SBC_Encode(&params, &pcm[i * frame_samples * channels], output);
+            EXPECT_GT(len, 0u);
+            EXPECT_LE(len, sizeof(output));
+            digest_update(&digest, output, len);
+          }
+        }
+      }
+    }
+  }
+  return digest;
+}
+
+}  // namespace
+
+TEST(SbcEncoderTest, test_mono_is_bit_exact) {
+  EXPECT_EQ(0xd316dbfdu, encode_all(SBC_MONO, SUB_BANDS_4));
+  EXPECT_EQ(0xbb8d9df0u, encode_all(SBC_MONO, SUB_BANDS_8));
+}
+
+TEST(SbcEncoderTest, test_dual_channel_is_bit_exact) {
+  EXPECT_EQ(0xd4538b3cu, encode_all(SBC_DUAL, SUB_BANDS_4));
+  EXPECT_EQ(0x786806d0u, encode_all(SBC_DUAL, SUB_BANDS_8));
+}
+
+TEST(SbcEncoderTest, test_stereo_is_bit_exact) {
+  EXPECT_EQ(0x7e7591dfu, encode_all(SBC_STEREO, SUB_BANDS_4));
+  EXPECT_EQ(0x5c5650e1u, encode_all(SBC_STEREO, SUB_BANDS_8));
+}
+
+TEST(SbcEncoderTest, test_joint_stereo_is_bit_exact) {
+  EXPECT_EQ(0xc6d858cfu, encode_all(SBC_JOINT_STEREO, SUB_BANDS_4));
+  EXPECT_EQ(0xefba97a2u, encode_all(SBC_JOINT_STEREO, SUB_BANDS_8));
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "btcore/include/module.h"
+#include "hci/include/btsnoop.h"
+#include "hci_internals.h"
+#include "hci_layer.h"
+#include "osi/include/properties.h"
+#include "stack/l2cap/l2c_int.h"
+
+using ::benchmark::State;
+
+// Only used to whitelist RFCOMM channels in filtered mode
+tL2C_CCB* l2cu_find_ccb_by_cid(tL2C_LCB* p_lcb, uint16_t local_cid) {
+  return nullptr;
+}
+
+extern const module_t btsnoop_module;
+
+#define BTSNOOP_LOG_MODE_PROPERTY "persist.bluetooth.btsnooplogmode"
+#define BTSNOOP_PATH_PROPERTY "persist.bluetooth.btsnooppath"
+#define BTSNOOP_ASYNC_PROPERTY "persist.bluetooth.btsnoopasync"
+#define BENCHMARK_BTSNOOP_PATH "/data/local/tmp/btsnoop_benchmark.log"
+
+// A2DP media packets as sent to the controller: 2-DH5 sized ACL fragments.
+// They are captured in bursts with a pause long enough for the asynchronous
+// writer to catch up in between, as the controller's flow control would.
+#define ACL_PAYLOAD_SIZE 679
+#define NUM_PACKETS 128
+#define BURST_INTERVAL_MS 25
+
+enum SnoopMode { SNOOP_OFF = 0, SNOOP_SYNC = 1, SNOOP_ASYNC = 2 };
+
+// Sets the snoop log properties for |mode| and restores the previous values
+// when it goes out of scope.
+class ScopedSnoopMode {
+ public:
+  explicit ScopedSnoopMode(int64_t mode) {
+    Save(BTSNOOP_LOG_MODE_PROPERTY, "");
+    Save(BTSNOOP_PATH_PROPERTY, "");
+    Save(BTSNOOP_ASYNC_PROPERTY, "");
+    osi_property_set(BTSNOOP_LOG_MODE_PROPERTY,
+                     mode == SNOOP_OFF ? "disabled" : "full");
+    osi_property_set(BTSNOOP_PATH_PROPERTY, BENCHMARK_BTSNOOP_PATH);
+    osi_property_set(BTSNOOP_ASYNC_PROPERTY,
+                     mode == SNOOP_ASYNC ? "true" : "false");
+    btsnoop_module.start_up();
+  }
+
+  ~ScopedSnoopMode() {
+    btsnoop_module.shut_down();
+    for (const auto& property : saved_)
+      osi_property_set(property.first.c_str(), property.second.c_str());
+  }
+
+ private:
+  void Save(const char* key, const char* default_value) {
+    char value[PROPERTY_VALUE_MAX];
+    osi_property_get(key, value, default_value);
+    saved_.emplace_back(key, value);
+  }
+
+  std::vector<std::pair<std::string, std::string>> saved_;
+};
+
+// Time spent in capture() by the HCI thread for each outgoing ACL packet,
+// with snoop logging disabled, written synchronously and written by the
+// asynchronous writer thread.
+static void BM_CaptureAclPacket(State& state) {
+  ScopedSnoopMode snoop_mode(state.range(0));
+  const btsnoop_t* btsnoop = btsnoop_get_interface();
+
+  std::vector<uint8_t> buffer(sizeof(BT_HDR) + HCI_ACL_PREAMBLE_SIZE +
+                              ACL_PAYLOAD_SIZE);
+  BT_HDR* packet = reinterpret_cast<BT_HDR*>(buffer.data());
+  packet->event = MSG_STACK_TO_HC_HCI_ACL;
+  packet->len = HCI_ACL_PREAMBLE_SIZE + ACL_PAYLOAD_SIZE;
+  packet->offset = 0;
+  packet->data[0] = 0x01;
+  packet->data[1] = 0x20;
+  packet->data[2] = ACL_PAYLOAD_SIZE & 0xff;
+  packet->data[3] = ACL_PAYLOAD_SIZE >> 8;
+
+  std::vector<double> latencies_us;
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_PACKETS; i++) {
+      auto start = std::chrono::steady_clock::now();
+      btsnoop->capture(packet, false);
+      latencies_us.push_back(std::chrono::duration<double, std::micro>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count());
+    }
+    state.PauseTiming();
+    std::this_thread::sleep_for(std::chrono::milliseconds(BURST_INTERVAL_MS));
+    state.ResumeTiming();
+  }
+
+  std::sort(latencies_us.begin(), latencies_us.end());
+  state.counters["p50_us"] = latencies_us[latencies_us.size() / 2];
+  state.counters["p99_us"] = latencies_us[latencies_us.size() * 99 / 100];
+  state.counters["max_us"] = latencies_us.back();
+  state.SetItemsProcessed(state.iterations() * NUM_PACKETS);
+}
+BENCHMARK(BM_CaptureAclPacket)
+    ->Arg(SNOOP_OFF)
+    ->Arg(SNOOP_SYNC)
+    ->Arg(SNOOP_ASYNC)
+    ->Iterations(200);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
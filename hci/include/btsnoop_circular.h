@@ -0,0 +1,62 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// A btsnoop log of fixed size that always holds the most recent records. The
+// file is memory mapped, so appending a record is a copy into the page cache:
+// there is no rotation and no system call per record. Because the mapping is
+// shared, everything appended survives a crash of the process. It does not
+// survive a power loss or a kernel crash: the log is never synced, so the
+// records still in the page cache are lost then.
+//
+// File layout, all fields little endian:
+//
+//   offset  0: magic "btsnpcir"
+//   offset  8: uint32_t version (1)
+//   offset 12: uint32_t data_offset, where the record area starts
+//   offset 16: uint64_t data_size, the size of the record area
+//   offset 24: uint64_t head, end of the newest complete record
+//   offset 32: uint64_t tail, start of the oldest complete record
+//
+// The record area holds standard btsnoop records (24 byte header followed by
+// the packet) back to back. |head| and |tail| count bytes appended since the
+// file was created; a record at position |pos| starts at byte
+// |data_offset + pos % data_size| of the file and may wrap around the end of
+// the record area. tools/scripts/btsnoop_linearize.py turns the file back
+// into a standard btsnoop log.
+
+typedef struct btsnoop_circular_t btsnoop_circular_t;
+
+// Opens the circular log at |path| with |data_size| bytes for records. An
+// existing log of the same size is continued, anything else is replaced.
+// Returns NULL on failure.
+btsnoop_circular_t* btsnoop_circular_open(const char* path, size_t data_size);
+
+// Unmaps and closes |log|. Safe to call with NULL.
+void btsnoop_circular_close(btsnoop_circular_t* log);
+
+// Appends one btsnoop record, split over |iovcnt| buffers of |iov|, dropping
+// the oldest records to make room. Records larger than the log are dropped.
+// Not thread safe.
+void btsnoop_circular_append(btsnoop_circular_t* log, const struct iovec* iov,
+                             int iovcnt);
@@ -21,3 +21,8 @@
 #include "osi/include/allocator.h"
 
 const allocator_t* buffer_allocator_get_interface();
+
+// Like |buffer_allocator_get_interface|, but backed by the osi pool
+// allocator. Buffers must be released through the returned interface's
+// |free|, never with |osi_free|.
+const allocator_t* buffer_allocator_pool_get_interface();
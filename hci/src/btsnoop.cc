@@ -33,15 +33,22 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/prctl.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "bt_types.h"
 #include "common/time_util.h"
 #include "hci/include/btsnoop.h"
+#include "hci/include/btsnoop_circular.h"
 #include "hci/include/btsnoop_mem.h"
 #include "hci_layer.h"
 #include "internal_include/bt_trace.h"
@@ -69,6 +76,22 @@
 #define BTSNOOP_PATH_PROPERTY "persist.bluetooth.btsnooppath"
 #define DEFAULT_BTSNOOP_PATH "/data/misc/bluetooth/logs/btsnoop_hci.log"
 #define BTSNOOP_MAX_PACKETS_PROPERTY "persist.bluetooth.btsnoopsize"
+#define BTSNOOP_ASYNC_PROPERTY "persist.bluetooth.btsnoopasync"
+// Size in bytes of the circular "flight recorder" log. When set, the most
+// recent records are kept in a single memory-mapped file instead of rotating
+// through |packets_per_file| sized files.
+#define BTSNOOP_CIRCULAR_SIZE_PROPERTY "persist.bluetooth.btsnoopcircularsize"
+
+// In asynchronous mode capture() copies each record into a ring owned by the
+// calling thread, without taking a lock or touching the log file. A writer
+// thread periodically merges the rings by timestamp and appends them to the
+// log with a few large writev() calls. Records that do not fit in a full ring
+// are dropped and counted in the dropped_packets field of later records.
+#define BTSNOOP_RING_SIZE (256 * 1024)
+#define BTSNOOP_MAX_RINGS 8
+#define BTSNOOP_WRITER_PERIOD_MS 20
+#define BTSNOOP_WRITER_MAX_IOVECS 256
+#define BTSNOOP_WRITER_THREAD_NAME "bt_snoop_writer"
 
 typedef enum {
   kCommandPacket = 1,
@@ -90,12 +113,62 @@ static const size_t RFC_EVENT_OFFSET = 9;
 // a filtered packet.
 static const uint32_t L2C_HEADER_SIZE = 9;
 
+// The log file state below is guarded by |btsnoop_mutex|, except while the
+// writer thread runs: it then belongs to the writer thread alone. Every other
+// path changing it holds |btsnoop_mutex| and either runs before
+// start_writer_thread() or after stop_writer_thread().
 static int logfile_fd = INVALID_FD;
+static btsnoop_circular_t* circular_log;
 static std::mutex btsnoop_mutex;
 
 static int32_t packets_per_file;
 static int32_t packet_counter;
 
+typedef struct {
+  uint32_t length_original;
+  uint32_t length_captured;
+  uint32_t flags;
+  uint32_t dropped_packets;
+  uint64_t timestamp;
+  uint8_t type;
+} __attribute__((__packed__)) btsnoop_header_t;
+
+// Records are stored back to back exactly as they go into the log, so the
+// writer can hand them to writev() in place. |head| and |tail| only grow;
+// a record may wrap around the end of |data|.
+typedef struct {
+  std::atomic<size_t> head;   // Only written by the producer thread
+  std::atomic<size_t> tail;   // Only written by the writer thread
+  std::atomic<bool> in_use;   // Whether a producer thread owns this ring
+  uint8_t data[BTSNOOP_RING_SIZE];
+} btsnoop_ring_t;
+
+// Gives the ring back when its producer thread exits. The records it left
+// behind are still written out, and the next thread to claim the ring appends
+// after them.
+struct btsnoop_ring_owner_t {
+  btsnoop_ring_t* ring = nullptr;
+
+  ~btsnoop_ring_owner_t() {
+    if (ring) ring->in_use = false;
+  }
+};
+
+// Rings are allocated on first use and live as long as the process.
+static btsnoop_ring_t* rings[BTSNOOP_MAX_RINGS];
+static std::mutex rings_mutex;
+static thread_local btsnoop_ring_owner_t ring_owner;
+
+static std::atomic<bool> is_btsnoop_async(false);
+// Packets being queued, stop_writer_thread() waits for them to be in a ring
+static std::atomic<int> async_queueing(0);
+static std::atomic<uint32_t> async_dropped_packets(0);
+static std::thread writer_thread;
+static std::mutex writer_mutex;
+static std::condition_variable writer_cv;
+static bool writer_running;
+static std::atomic<bool> writer_wakeup(false);
+
 // Channel tracking variables for filtering.
 
 // Keeps track of L2CAP channels that need to be filtered out of the snoop
@@ -168,9 +241,14 @@ void btsnoop_net_write(const void* data, size_t length);
 static void delete_btsnoop_files(bool filtered);
 static std::string get_btsnoop_log_path(bool filtered);
 static std::string get_btsnoop_last_log_path(std::string log_path);
+static std::string get_btsnoop_circular_log_path(std::string log_path);
 static void open_next_snoop_file();
 static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
                                  bool is_received, uint64_t timestamp_us);
+static void btsnoop_queue_packet(packet_type_t type, uint8_t* packet,
+                                 bool is_received, uint64_t timestamp_us);
+static void start_writer_thread();
+static void stop_writer_thread();
 
 // Module lifecycle functions
 
@@ -212,10 +290,24 @@ static future_t* start_up() {
   }
 
   if (is_btsnoop_enabled) {
-    open_next_snoop_file();
+    int32_t circular_size =
+        osi_property_get_int32(BTSNOOP_CIRCULAR_SIZE_PROPERTY, 0);
+    if (circular_size > 0) {
+      auto circular_log_path = get_btsnoop_circular_log_path(
+          get_btsnoop_log_path(is_btsnoop_filtered));
+      LOG(INFO) << __func__ << ": Snoop Logs kept in the last "
+                << circular_size << " bytes of " << circular_log_path;
+      circular_log =
+          btsnoop_circular_open(circular_log_path.c_str(), circular_size);
+    }
+    if (!circular_log) open_next_snoop_file();
     packets_per_file = osi_property_get_int32(BTSNOOP_MAX_PACKETS_PROPERTY,
                                               DEFAULT_BTSNOOP_SIZE);
     btsnoop_net_open();
+    if (osi_property_get_bool(BTSNOOP_ASYNC_PROPERTY, false)) {
+      LOG(INFO) << __func__ << ": Snoop Logs written asynchronously";
+      start_writer_thread();
+    }
   }
 
   return NULL;
@@ -224,6 +316,9 @@ static future_t* start_up() {
 static future_t* shut_down(void) {
   std::lock_guard<std::mutex> lock(btsnoop_mutex);
 
+  // Flush the records still queued before the log file is closed
+  stop_writer_thread();
+
   if (is_btsnoop_enabled) {
     if (is_btsnoop_filtered) {
       delete_btsnoop_files(false);
@@ -235,8 +330,11 @@ static future_t* shut_down(void) {
     delete_btsnoop_files(false);
   }
 
+  // The writer thread is stopped, the log file is ours again
   if (logfile_fd != INVALID_FD) close(logfile_fd);
   logfile_fd = INVALID_FD;
+  btsnoop_circular_close(circular_log);
+  circular_log = NULL;
 
   if (is_btsnoop_enabled) btsnoop_net_close();
 
@@ -255,7 +353,7 @@ EXPORT_SYMBOL extern const module_t btsnoop_module = {
 static void capture(const BT_HDR* buffer, bool is_received) {
   uint8_t* p = const_cast<uint8_t*>(buffer->data + buffer->offset);
 
-  std::lock_guard<std::mutex> lock(btsnoop_mutex);
+  std::unique_lock<std::mutex> lock(btsnoop_mutex);
 
   struct timespec ts_now = {};
   clock_gettime(CLOCK_REALTIME, &ts_now);
@@ -264,24 +362,36 @@ static void capture(const BT_HDR* buffer, bool is_received) {
 
   btsnoop_mem_capture(buffer, timestamp_us);
 
-  if (logfile_fd == INVALID_FD) return;
+  // The log file belongs to the writer thread in asynchronous mode
+  auto write_packet = btsnoop_write_packet;
+  bool queueing = is_btsnoop_async;
+  if (queueing) {
+    // Counted before the lock is released, so that stop_writer_thread()
+    // does not drain the rings before this packet is in one
+    async_queueing++;
+    lock.unlock();
+    write_packet = btsnoop_queue_packet;
+  } else if (logfile_fd == INVALID_FD && !circular_log) {
+    return;
+  }
 
   switch (buffer->event & MSG_EVT_MASK) {
     case MSG_HC_TO_STACK_HCI_EVT:
-      btsnoop_write_packet(kEventPacket, p, false, timestamp_us);
+      write_packet(kEventPacket, p, false, timestamp_us);
       break;
     case MSG_HC_TO_STACK_HCI_ACL:
     case MSG_STACK_TO_HC_HCI_ACL:
-      btsnoop_write_packet(kAclPacket, p, is_received, timestamp_us);
+      write_packet(kAclPacket, p, is_received, timestamp_us);
       break;
     case MSG_HC_TO_STACK_HCI_SCO:
     case MSG_STACK_TO_HC_HCI_SCO:
-      btsnoop_write_packet(kScoPacket, p, is_received, timestamp_us);
+      write_packet(kScoPacket, p, is_received, timestamp_us);
       break;
     case MSG_STACK_TO_HC_HCI_CMD:
-      btsnoop_write_packet(kCommandPacket, p, true, timestamp_us);
+      write_packet(kCommandPacket, p, true, timestamp_us);
       break;
   }
+  if (queueing) async_queueing--;
 }
 
 static void whitelist_l2c_channel(uint16_t conn_handle, uint16_t local_cid,
@@ -340,6 +450,7 @@ static void delete_btsnoop_files(bool filtered) {
   auto log_path = get_btsnoop_log_path(filtered);
   remove(log_path.c_str());
   remove(get_btsnoop_last_log_path(log_path).c_str());
+  remove(get_btsnoop_circular_log_path(log_path).c_str());
 }
 
 std::string get_btsnoop_log_path(bool filtered) {
@@ -355,6 +466,11 @@ std::string get_btsnoop_last_log_path(std::string btsnoop_path) {
   return btsnoop_path.append(".last");
 }
 
+std::string get_btsnoop_circular_log_path(std::string btsnoop_path) {
+  return btsnoop_path.append(".circular");
+}
+
+// Called with |btsnoop_mutex| held, or on the writer thread while it runs.
 static void open_next_snoop_file() {
   packet_counter = 0;
 
@@ -383,15 +499,6 @@ static void open_next_snoop_file() {
   write(logfile_fd, "btsnoop\0\0\0\0\1\0\0\x3\xea", 16);
 }
 
-typedef struct {
-  uint32_t length_original;
-  uint32_t length_captured;
-  uint32_t flags;
-  uint32_t dropped_packets;
-  uint64_t timestamp;
-  uint8_t type;
-} __attribute__((__packed__)) btsnoop_header_t;
-
 static uint64_t htonll(uint64_t ll) {
   const uint32_t l = 1;
   if (*(reinterpret_cast<const uint8_t*>(&l)) == 1)
@@ -427,8 +534,11 @@ static bool should_filter_log(bool is_received, uint8_t* packet) {
   return false;
 }
 
-static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
-                                 bool is_received, uint64_t timestamp_us) {
+// Fills in |header| for |packet| and returns the number of bytes of |packet|
+// that follow it in the log.
+static size_t btsnoop_fill_header(packet_type_t type, uint8_t* packet,
+                                  bool is_received, uint64_t timestamp_us,
+                                  btsnoop_header_t* header) {
   uint32_t length_he = 0;
   uint32_t flags = 0;
 
@@ -451,24 +561,33 @@ static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
       break;
   }
 
-  btsnoop_header_t header;
-  header.length_original = htonl(length_he);
+  header->length_original = htonl(length_he);
 
   bool blacklisted = false;
   if (is_btsnoop_filtered && type == kAclPacket) {
     blacklisted = should_filter_log(is_received, packet);
   }
 
-  header.length_captured =
-      blacklisted ? htonl(L2C_HEADER_SIZE) : header.length_original;
+  header->length_captured =
+      blacklisted ? htonl(L2C_HEADER_SIZE) : header->length_original;
   if (blacklisted) length_he = L2C_HEADER_SIZE;
-  header.flags = htonl(flags);
-  header.dropped_packets = 0;
-  header.timestamp = htonll(timestamp_us + BTSNOOP_EPOCH_DELTA);
-  header.type = type;
+  header->flags = htonl(flags);
+  header->dropped_packets = 0;
+  header->timestamp = htonll(timestamp_us + BTSNOOP_EPOCH_DELTA);
+  header->type = type;
+
+  return length_he - 1;
+}
+
+// Called with |btsnoop_mutex| held, when the writer thread is not running.
+static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
+                                 bool is_received, uint64_t timestamp_us) {
+  btsnoop_header_t header;
+  size_t length =
+      btsnoop_fill_header(type, packet, is_received, timestamp_us, &header);
 
   btsnoop_net_write(&header, sizeof(btsnoop_header_t));
-  btsnoop_net_write(packet, length_he - 1);
+  btsnoop_net_write(packet, length);
 
   if (logfile_fd != INVALID_FD) {
     packet_counter++;
@@ -477,7 +596,214 @@ static void btsnoop_write_packet(packet_type_t type, uint8_t* packet,
     }
 
     iovec iov[] = {{&header, sizeof(btsnoop_header_t)},
-                   {reinterpret_cast<void*>(packet), length_he - 1}};
+                   {reinterpret_cast<void*>(packet), length}};
     TEMP_FAILURE_RETRY(writev(logfile_fd, iov, 2));
+  } else if (circular_log) {
+    iovec iov[] = {{&header, sizeof(btsnoop_header_t)},
+                   {reinterpret_cast<void*>(packet), length}};
+    btsnoop_circular_append(circular_log, iov, 2);
+  }
+}
+
+// Returns the ring of the calling thread, or NULL if all rings are taken.
+static btsnoop_ring_t* get_thread_ring() {
+  if (ring_owner.ring) return ring_owner.ring;
+
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (size_t i = 0; i < BTSNOOP_MAX_RINGS; i++) {
+    if (!rings[i]) {
+      rings[i] = new btsnoop_ring_t();
+    } else if (rings[i]->in_use) {
+      continue;
+    }
+    rings[i]->in_use = true;
+    ring_owner.ring = rings[i];
+    return rings[i];
+  }
+  return NULL;
+}
+
+static void ring_copy_in(btsnoop_ring_t* ring, size_t pos, const void* src,
+                         size_t len) {
+  size_t offset = pos % BTSNOOP_RING_SIZE;
+  size_t first = std::min(len, BTSNOOP_RING_SIZE - offset);
+  memcpy(ring->data + offset, src, first);
+  memcpy(ring->data, static_cast<const uint8_t*>(src) + first, len - first);
+}
+
+static void ring_copy_out(const btsnoop_ring_t* ring, size_t pos, void* dst,
+                          size_t len) {
+  size_t offset = pos % BTSNOOP_RING_SIZE;
+  size_t first = std::min(len, BTSNOOP_RING_SIZE - offset);
+  memcpy(dst, ring->data + offset, first);
+  memcpy(static_cast<uint8_t*>(dst) + first, ring->data, len - first);
+}
+
+static void wake_writer_thread() {
+  writer_wakeup = true;
+  writer_cv.notify_one();
+}
+
+static void btsnoop_queue_packet(packet_type_t type, uint8_t* packet,
+                                 bool is_received, uint64_t timestamp_us) {
+  btsnoop_header_t header;
+  size_t length =
+      btsnoop_fill_header(type, packet, is_received, timestamp_us, &header);
+  size_t record_size = sizeof(btsnoop_header_t) + length;
+
+  btsnoop_ring_t* ring = get_thread_ring();
+  if (!ring) {
+    async_dropped_packets++;
+    return;
+  }
+
+  size_t head = ring->head.load(std::memory_order_relaxed);
+  size_t used = head - ring->tail.load(std::memory_order_acquire);
+  if (record_size > BTSNOOP_RING_SIZE - used) {
+    async_dropped_packets++;
+    wake_writer_thread();
+    return;
+  }
+
+  header.dropped_packets = htonl(async_dropped_packets.load());
+  ring_copy_in(ring, head, &header, sizeof(btsnoop_header_t));
+  ring_copy_in(ring, head + sizeof(btsnoop_header_t), packet, length);
+  ring->head.store(head + record_size, std::memory_order_release);
+
+  if (used + record_size > BTSNOOP_RING_SIZE / 2) wake_writer_thread();
+}
+
+static void write_iovecs(iovec* iov, int iovcnt) {
+  if (iovcnt == 0) return;
+
+  for (int i = 0; i < iovcnt; i++)
+    btsnoop_net_write(iov[i].iov_base, iov[i].iov_len);
+  if (logfile_fd != INVALID_FD)
+    TEMP_FAILURE_RETRY(writev(logfile_fd, iov, iovcnt));
+}
+
+// Writes out every record queued in the rings so far, oldest first. Only
+// called on the writer thread, which owns the log file while it runs.
+static void write_queued_packets() {
+  btsnoop_ring_t* queued[BTSNOOP_MAX_RINGS];
+  size_t num_rings = 0;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (size_t i = 0; i < BTSNOOP_MAX_RINGS && rings[i]; i++)
+      queued[num_rings++] = rings[i];
+  }
+
+  size_t head[BTSNOOP_MAX_RINGS];
+  size_t pos[BTSNOOP_MAX_RINGS];
+  for (size_t i = 0; i < num_rings; i++) {
+    head[i] = queued[i]->head.load(std::memory_order_acquire);
+    pos[i] = queued[i]->tail.load(std::memory_order_relaxed);
+  }
+
+  iovec iov[BTSNOOP_WRITER_MAX_IOVECS];
+  int iovcnt = 0;
+  while (true) {
+    // Each ring is in order, so the oldest record is at the front of one
+    size_t next = num_rings;
+    uint64_t next_timestamp = 0;
+    btsnoop_header_t next_header;
+    for (size_t i = 0; i < num_rings; i++) {
+      if (pos[i] == head[i]) continue;
+      btsnoop_header_t header;
+      ring_copy_out(queued[i], pos[i], &header, sizeof(btsnoop_header_t));
+      uint64_t timestamp = htonll(header.timestamp);
+      if (next == num_rings || timestamp < next_timestamp) {
+        next = i;
+        next_timestamp = timestamp;
+        next_header = header;
+      }
+    }
+    if (next == num_rings) break;
+
+    if (logfile_fd != INVALID_FD) {
+      packet_counter++;
+      if (packet_counter > packets_per_file) {
+        write_iovecs(iov, iovcnt);
+        iovcnt = 0;
+        open_next_snoop_file();
+      }
+    }
+
+    size_t record_size =
+        sizeof(btsnoop_header_t) + ntohl(next_header.length_captured) - 1;
+    size_t offset = pos[next] % BTSNOOP_RING_SIZE;
+    size_t first = std::min(record_size, BTSNOOP_RING_SIZE - offset);
+    iovec* record = &iov[iovcnt];
+    iov[iovcnt++] = {queued[next]->data + offset, first};
+    if (first < record_size)
+      iov[iovcnt++] = {queued[next]->data, record_size - first};
+    pos[next] += record_size;
+
+    if (circular_log)
+      btsnoop_circular_append(circular_log, record, &iov[iovcnt] - record);
+
+    if (iovcnt > BTSNOOP_WRITER_MAX_IOVECS - 2) {
+      write_iovecs(iov, iovcnt);
+      iovcnt = 0;
+    }
+  }
+  write_iovecs(iov, iovcnt);
+
+  // Only now that the records are written may they be overwritten
+  for (size_t i = 0; i < num_rings; i++)
+    queued[i]->tail.store(pos[i], std::memory_order_release);
+}
+
+static void writer_thread_main() {
+  prctl(PR_SET_NAME, (unsigned long)BTSNOOP_WRITER_THREAD_NAME, 0, 0, 0);
+
+  bool running = true;
+  while (running) {
+    {
+      std::unique_lock<std::mutex> lock(writer_mutex);
+      writer_cv.wait_for(
+          lock, std::chrono::milliseconds(BTSNOOP_WRITER_PERIOD_MS),
+          [] { return !writer_running || writer_wakeup; });
+      writer_wakeup = false;
+      running = writer_running;
+    }
+    write_queued_packets();
+  }
+}
+
+// Must be called with |btsnoop_mutex| held, after the log file is opened.
+static void start_writer_thread() {
+  // Records left over from a previous session belong to an older log file
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (size_t i = 0; i < BTSNOOP_MAX_RINGS && rings[i]; i++)
+      rings[i]->tail = rings[i]->head.load();
+  }
+
+  async_dropped_packets = 0;
+  writer_running = true;
+  writer_thread = std::thread(writer_thread_main);
+  is_btsnoop_async = true;
+}
+
+// Must be called with |btsnoop_mutex| held, so that no packet is written
+// synchronously before the writer thread is done with the log file.
+static void stop_writer_thread() {
+  if (!writer_thread.joinable()) return;
+
+  is_btsnoop_async = false;
+  // A packet may have been let through just before, its final drain below
+  // must include it. Queueing never blocks, so this does not take long.
+  while (async_queueing > 0) std::this_thread::yield();
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    writer_running = false;
+  }
+  writer_cv.notify_one();
+  writer_thread.join();
+
+  if (async_dropped_packets > 0) {
+    LOG(WARNING) << __func__ << ": dropped " << async_dropped_packets
+                 << " packets from the snoop log";
   }
 }
@@ -0,0 +1,186 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_snoop_circular"
+
+#include "hci/include/btsnoop_circular.h"
+
+#include <arpa/inet.h>
+#include <base/logging.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+#include "osi/include/allocator.h"
+#include "osi/include/osi.h"
+
+static const char BTSNOOP_CIRCULAR_MAGIC[8] = {'b', 't', 's', 'n',
+                                               'p', 'c', 'i', 'r'};
+static const uint32_t BTSNOOP_CIRCULAR_VERSION = 1;
+// The record area starts on its own page
+static const uint32_t BTSNOOP_CIRCULAR_DATA_OFFSET = 4096;
+
+// Size of the btsnoop record header, and where the big endian captured
+// length is found in it.
+static const size_t RECORD_HEADER_SIZE = 24;
+static const size_t RECORD_LENGTH_OFFSET = 4;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t data_offset;
+  uint64_t data_size;
+  uint64_t head;
+  uint64_t tail;
+} __attribute__((__packed__)) btsnoop_circular_header_t;
+
+struct btsnoop_circular_t {
+  int fd;
+  uint8_t* map;
+  size_t map_size;
+  btsnoop_circular_header_t* header;
+  uint8_t* data;
+  size_t data_size;
+};
+
+static bool header_is_valid(const btsnoop_circular_header_t* header,
+                            size_t data_size) {
+  return memcmp(header->magic, BTSNOOP_CIRCULAR_MAGIC,
+                sizeof(BTSNOOP_CIRCULAR_MAGIC)) == 0 &&
+         le32toh(header->version) == BTSNOOP_CIRCULAR_VERSION &&
+         le32toh(header->data_offset) == BTSNOOP_CIRCULAR_DATA_OFFSET &&
+         le64toh(header->data_size) == data_size &&
+         le64toh(header->tail) <= le64toh(header->head) &&
+         le64toh(header->head) - le64toh(header->tail) <= data_size;
+}
+
+btsnoop_circular_t* btsnoop_circular_open(const char* path, size_t data_size) {
+  CHECK(path != NULL);
+  CHECK(data_size > 0);
+
+  mode_t prevmask = umask(0);
+  int fd = open(path, O_RDWR | O_CREAT,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+  umask(prevmask);
+  if (fd == INVALID_FD) {
+    LOG(ERROR) << __func__ << ": unable to open '" << path
+               << "' : " << strerror(errno);
+    return NULL;
+  }
+
+  size_t map_size = BTSNOOP_CIRCULAR_DATA_OFFSET + data_size;
+  struct stat st;
+  bool resized = fstat(fd, &st) != 0 || (size_t)st.st_size != map_size;
+  if (resized && ftruncate(fd, map_size) != 0) {
+    LOG(ERROR) << __func__ << ": unable to resize '" << path
+               << "' : " << strerror(errno);
+    close(fd);
+    return NULL;
+  }
+
+  void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    LOG(ERROR) << __func__ << ": unable to map '" << path
+               << "' : " << strerror(errno);
+    close(fd);
+    return NULL;
+  }
+
+  btsnoop_circular_t* log =
+      static_cast<btsnoop_circular_t*>(osi_calloc(sizeof(btsnoop_circular_t)));
+  log->fd = fd;
+  log->map = static_cast<uint8_t*>(map);
+  log->map_size = map_size;
+  log->header = reinterpret_cast<btsnoop_circular_header_t*>(map);
+  log->data = log->map + BTSNOOP_CIRCULAR_DATA_OFFSET;
+  log->data_size = data_size;
+
+  if (resized || !header_is_valid(log->header, data_size)) {
+    memset(log->header, 0, sizeof(btsnoop_circular_header_t));
+    memcpy(log->header->magic, BTSNOOP_CIRCULAR_MAGIC,
+           sizeof(BTSNOOP_CIRCULAR_MAGIC));
+    log->header->version = htole32(BTSNOOP_CIRCULAR_VERSION);
+    log->header->data_offset = htole32(BTSNOOP_CIRCULAR_DATA_OFFSET);
+    log->header->data_size = htole64(data_size);
+  }
+
+  return log;
+}
+
+void btsnoop_circular_close(btsnoop_circular_t* log) {
+  if (!log) return;
+
+  msync(log->map, log->map_size, MS_ASYNC);
+  munmap(log->map, log->map_size);
+  close(log->fd);
+  osi_free(log);
+}
+
+static void copy_in(btsnoop_circular_t* log, uint64_t pos, const void* src,
+                    size_t len) {
+  size_t offset = pos % log->data_size;
+  size_t first = std::min(len, log->data_size - offset);
+  memcpy(log->data + offset, src, first);
+  memcpy(log->data, static_cast<const uint8_t*>(src) + first, len - first);
+}
+
+static void copy_out(const btsnoop_circular_t* log, uint64_t pos, void* dst,
+                     size_t len) {
+  size_t offset = pos % log->data_size;
+  size_t first = std::min(len, log->data_size - offset);
+  memcpy(dst, log->data + offset, first);
+  memcpy(static_cast<uint8_t*>(dst) + first, log->data, len - first);
+}
+
+void btsnoop_circular_append(btsnoop_circular_t* log, const struct iovec* iov,
+                             int iovcnt) {
+  CHECK(log != NULL);
+
+  size_t length = 0;
+  for (int i = 0; i < iovcnt; i++) length += iov[i].iov_len;
+  if (length > log->data_size) return;
+
+  uint64_t head = le64toh(log->header->head);
+  uint64_t tail = le64toh(log->header->tail);
+  while (head + length - tail > log->data_size) {
+    uint32_t captured_length;
+    copy_out(log, tail + RECORD_LENGTH_OFFSET, &captured_length,
+             sizeof(captured_length));
+    tail += RECORD_HEADER_SIZE + ntohl(captured_length);
+    // Only a corrupted record can claim to extend past the newest one
+    if (tail > head) tail = head;
+  }
+
+  // The tail moves past the records about to be overwritten before they are
+  // touched, and the head only moves once the new record is complete, so the
+  // file is consistent whenever the process dies.
+  log->header->tail = htole64(tail);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int i = 0; i < iovcnt; i++) {
+    copy_in(log, head, iov[i].iov_base, iov[i].iov_len);
+    head += iov[i].iov_len;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  log->header->head = htole64(head);
+}
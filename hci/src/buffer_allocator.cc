@@ -20,12 +20,23 @@
 
 #include "bt_common.h"
 #include "buffer_allocator.h"
+#include "osi/include/pool_allocator.h"
 
 static void* buffer_alloc(size_t size) {
   CHECK(size <= BT_DEFAULT_BUFFER_SIZE);
   return osi_malloc(size);
 }
 
+static void* buffer_pool_alloc(size_t size) {
+  CHECK(size <= BT_DEFAULT_BUFFER_SIZE);
+  return osi_pool_malloc(size);
+}
+
 static const allocator_t interface = {buffer_alloc, osi_free};
+static const allocator_t pool_interface = {buffer_pool_alloc, osi_pool_free};
 
 const allocator_t* buffer_allocator_get_interface() { return &interface; }
+
+const allocator_t* buffer_allocator_pool_get_interface() {
+  return &pool_interface;
+}
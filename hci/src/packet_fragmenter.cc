@@ -49,13 +49,18 @@ static const allocator_t* buffer_allocator;
 static const controller_t* controller;
 static const packet_fragmenter_callbacks_t* callbacks;
 
+// L2CAP PDUs that are still being received. Each is a buffer sized for the
+// whole PDU, with |len| the expected length and |offset| the length received.
 static std::unordered_map<uint16_t /* handle */, BT_HDR*> partial_packets;
 
 static void init(const packet_fragmenter_callbacks_t* result_callbacks) {
   callbacks = result_callbacks;
 }
 
-static void cleanup() { partial_packets.clear(); }
+static void cleanup() {
+  for (auto& entry : partial_packets) buffer_allocator->free(entry.second);
+  partial_packets.clear();
+}
 
 static void fragment_and_dispatch(BT_HDR* packet) {
   CHECK(packet != NULL);
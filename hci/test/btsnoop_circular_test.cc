@@ -0,0 +1,195 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "AllocationTestHarness.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "hci/include/btsnoop_circular.h"
+
+static const size_t DATA_OFFSET = 4096;
+static const size_t RECORD_HEADER_SIZE = 24;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t data_offset;
+  uint64_t data_size;
+  uint64_t head;
+  uint64_t tail;
+} __attribute__((__packed__)) file_header_t;
+
+class BtsnoopCircularTest : public AllocationTestHarness {
+ protected:
+  void SetUp() override {
+    AllocationTestHarness::SetUp();
+    char path[] = "/data/local/tmp/btsnoop_circular_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+      char tmp_path[] = "/tmp/btsnoop_circular_XXXXXX";
+      fd = mkstemp(tmp_path);
+      path_ = tmp_path;
+    } else {
+      path_ = path;
+    }
+    ASSERT_NE(fd, -1);
+    close(fd);
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+    AllocationTestHarness::TearDown();
+  }
+
+  // Appends a record with |length| bytes of packet data filled with |id|,
+  // split into a header and a data buffer.
+  void AppendRecord(btsnoop_circular_t* log, uint8_t id, size_t length) {
+    uint8_t header[RECORD_HEADER_SIZE] = {};
+    uint32_t length_be = htonl(length);
+    memcpy(header, &length_be, sizeof(length_be));
+    memcpy(header + 4, &length_be, sizeof(length_be));
+    std::vector<uint8_t> data(length, id);
+    struct iovec iov[] = {{header, sizeof(header)}, {data.data(), length}};
+    btsnoop_circular_append(log, iov, 2);
+  }
+
+  std::vector<uint8_t> ReadFile() {
+    std::vector<uint8_t> contents;
+    FILE* file = fopen(path_.c_str(), "rb");
+    uint8_t buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+      contents.insert(contents.end(), buf, buf + len);
+    fclose(file);
+    return contents;
+  }
+
+  // Returns the ids of the records in the log, oldest first
+  std::vector<uint8_t> ReadRecordIds() {
+    std::vector<uint8_t> contents = ReadFile();
+    file_header_t header;
+    memcpy(&header, contents.data(), sizeof(header));
+    auto byte_at = [&](uint64_t pos) {
+      return contents[header.data_offset + pos % header.data_size];
+    };
+
+    std::vector<uint8_t> ids;
+    uint64_t pos = header.tail;
+    while (pos < header.head) {
+      uint32_t length = 0;
+      for (int i = 0; i < 4; i++) length = (length << 8) | byte_at(pos + 4 + i);
+      EXPECT_GT(length, 0u);
+      uint8_t id = byte_at(pos + RECORD_HEADER_SIZE);
+      for (uint32_t i = 0; i < length; i++)
+        EXPECT_EQ(id, byte_at(pos + RECORD_HEADER_SIZE + i));
+      ids.push_back(id);
+      pos += RECORD_HEADER_SIZE + length;
+    }
+    EXPECT_EQ(pos, header.head);
+    return ids;
+  }
+
+  std::string path_;
+};
+
+TEST_F(BtsnoopCircularTest, test_new_log_is_empty) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 1024);
+  ASSERT_NE(log, nullptr);
+  btsnoop_circular_close(log);
+
+  std::vector<uint8_t> contents = ReadFile();
+  ASSERT_EQ(contents.size(), DATA_OFFSET + 1024);
+  file_header_t header;
+  memcpy(&header, contents.data(), sizeof(header));
+  EXPECT_EQ(0, memcmp(header.magic, "btsnpcir", 8));
+  EXPECT_EQ(1u, header.version);
+  EXPECT_EQ(DATA_OFFSET, header.data_offset);
+  EXPECT_EQ(1024u, header.data_size);
+  EXPECT_EQ(0u, header.head);
+  EXPECT_EQ(0u, header.tail);
+}
+
+TEST_F(BtsnoopCircularTest, test_append_keeps_records_in_order) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 1024);
+  for (uint8_t id = 1; id <= 5; id++) AppendRecord(log, id, 10 * id);
+  btsnoop_circular_close(log);
+
+  EXPECT_EQ(ReadRecordIds(), std::vector<uint8_t>({1, 2, 3, 4, 5}));
+}
+
+TEST_F(BtsnoopCircularTest, test_wrap_drops_oldest_records) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 1000);
+  // 100 byte records, so later records wrap around the end of the log
+  for (uint8_t id = 1; id <= 25; id++) AppendRecord(log, id, 76);
+  btsnoop_circular_close(log);
+
+  std::vector<uint8_t> expected;
+  for (uint8_t id = 16; id <= 25; id++) expected.push_back(id);
+  EXPECT_EQ(ReadRecordIds(), expected);
+}
+
+TEST_F(BtsnoopCircularTest, test_wrap_with_uneven_records) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 997);
+  for (uint8_t id = 1; id <= 200; id++) AppendRecord(log, id, 1 + id % 150);
+  btsnoop_circular_close(log);
+
+  std::vector<uint8_t> ids = ReadRecordIds();
+  ASSERT_FALSE(ids.empty());
+  EXPECT_EQ(200, ids.back());
+  for (size_t i = 1; i < ids.size(); i++) EXPECT_EQ(ids[i - 1] + 1, ids[i]);
+}
+
+TEST_F(BtsnoopCircularTest, test_oversized_record_is_dropped) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 256);
+  AppendRecord(log, 1, 100);
+  AppendRecord(log, 2, 300);
+  btsnoop_circular_close(log);
+
+  EXPECT_EQ(ReadRecordIds(), std::vector<uint8_t>({1}));
+}
+
+TEST_F(BtsnoopCircularTest, test_reopen_continues_log) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 1024);
+  AppendRecord(log, 1, 100);
+  btsnoop_circular_close(log);
+
+  log = btsnoop_circular_open(path_.c_str(), 1024);
+  AppendRecord(log, 2, 100);
+  btsnoop_circular_close(log);
+
+  EXPECT_EQ(ReadRecordIds(), std::vector<uint8_t>({1, 2}));
+}
+
+TEST_F(BtsnoopCircularTest, test_reopen_with_new_size_starts_over) {
+  btsnoop_circular_t* log = btsnoop_circular_open(path_.c_str(), 1024);
+  AppendRecord(log, 1, 100);
+  btsnoop_circular_close(log);
+
+  log = btsnoop_circular_open(path_.c_str(), 2048);
+  AppendRecord(log, 2, 100);
+  btsnoop_circular_close(log);
+
+  EXPECT_EQ(ReadFile().size(), DATA_OFFSET + 2048);
+  EXPECT_EQ(ReadRecordIds(), std::vector<uint8_t>({2}));
+}
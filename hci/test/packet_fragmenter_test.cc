@@ -32,7 +32,7 @@
 DECLARE_TEST_MODES(init, set_data_sizes, no_fragmentation, fragmentation,
                    ble_no_fragmentation, ble_fragmentation,
                    non_acl_passthrough_fragmentation, no_reassembly, reassembly,
-                   non_acl_passthrough_reassembly);
+                   non_acl_passthrough_reassembly, partial_reassembly);
 
 #define LOCAL_BLE_CONTROLLER_ID 1
 
@@ -176,6 +176,25 @@ static void manufacture_packet_and_then_reassemble(uint16_t event,
   }
 }
 
+// Sends only the start fragment of an L2CAP PDU that claims to be
+// |l2cap_length| bytes long.
+static void send_start_fragment_only(uint16_t l2cap_length) {
+  const uint16_t acl_length = 10;
+  BT_HDR* packet = (BT_HDR*)osi_malloc(acl_length + 4 + sizeof(BT_HDR));
+  packet->len = acl_length + 4;
+  packet->offset = 0;
+  packet->event = MSG_HC_TO_STACK_HCI_ACL;
+  packet->layer_specific = 0;
+
+  uint8_t* packet_data = packet->data;
+  UINT16_TO_STREAM(packet_data, test_handle_start);
+  UINT16_TO_STREAM(packet_data, acl_length);
+  UINT16_TO_STREAM(packet_data, l2cap_length);
+  memset(packet_data, 0, acl_length - 2);
+
+  fragmenter->reassemble_and_dispatch(packet);
+}
+
 static void expect_packet_reassembled(uint16_t event, BT_HDR* packet,
                                       const char* expected_data) {
   uint16_t expected_data_length = strlen(expected_data);
@@ -253,6 +272,11 @@ DURING(non_acl_passthrough_reassembly) AT_CALL(0) {
   return;
 }
 
+DURING(partial_reassembly) AT_CALL(0) {
+  expect_packet_reassembled(MSG_HC_TO_STACK_HCI_ACL, packet, sample_data);
+  return;
+}
+
 UNEXPECTED_CALL;
 }
 
@@ -394,3 +418,27 @@ TEST_F(PacketFragmenterTest, test_non_acl_passthrough_reasseembly) {
   EXPECT_EQ(strlen(sample_data), data_size_sum);
   EXPECT_CALL_COUNT(reassembled_callback, 1);
 }
+
+TEST_F(PacketFragmenterTest, test_start_packet_drops_unfinished_reassembly) {
+  reset_for(partial_reassembly);
+  send_start_fragment_only(200);
+  EXPECT_CALL_COUNT(reassembled_callback, 0);
+
+  manufacture_packet_and_then_reassemble(MSG_HC_TO_STACK_HCI_ACL, 42,
+                                         sample_data);
+
+  EXPECT_EQ(strlen(sample_data), data_size_sum);
+  EXPECT_CALL_COUNT(reassembled_callback, 1);
+}
+
+TEST_F(PacketFragmenterTest, test_cleanup_frees_unfinished_reassembly) {
+  reset_for(partial_reassembly);
+  send_start_fragment_only(200);
+  manufacture_packet_and_then_reassemble(MSG_HC_TO_STACK_HCI_ACL, 42,
+                                         sample_data);
+  send_start_fragment_only(200);
+
+  // The partial PDU still held is released by cleanup() in TearDown, which
+  // the allocation test harness checks for leaks.
+  EXPECT_CALL_COUNT(reassembled_callback, 1);
+}
@@ -78,11 +78,6 @@
  ******************************************************************************/
 static const hci_t* hci;
 
-/*******************************************************************************
- *  Externs
- ******************************************************************************/
-extern void btu_hci_msg_process(BT_HDR* p_msg);
-
 /*******************************************************************************
  *  Static functions
  ******************************************************************************/
@@ -91,17 +86,15 @@ extern void btu_hci_msg_process(BT_HDR* p_msg);
  *
  * Function         post_to_hci_message_loop
  *
- * Description      Post an HCI event to the main thread
+ * Description      Post an HCI event to the main thread. Events that arrive
+ *                  while earlier ones are still waiting are handed over in
+ *                  the same batch.
  *
  * Returns          None
  *
  *****************************************************************************/
 void post_to_main_message_loop(const base::Location& from_here, BT_HDR* p_msg) {
-  if (do_in_main_thread(from_here, base::Bind(&btu_hci_msg_process, p_msg)) !=
-      BT_STATUS_SUCCESS) {
-    LOG(ERROR) << __func__ << ": do_in_main_thread failed from "
-               << from_here.ToString();
-  }
+  btu_hci_msg_enqueue(from_here, p_msg);
 }
 
 /******************************************************************************
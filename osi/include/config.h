@@ -20,6 +20,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 // The default section name to use if a key/value pair is not defined within
 // a section.
@@ -30,15 +31,50 @@ struct entry_t {
   std::string value;
 };
 
+// |entries| and |sections| keep insertion order, which is the order used by
+// |config_save|. The |*_index| maps point into those lists so lookups by name
+// don't have to scan them; they are kept in sync by the config_* functions,
+// so never add or erase list elements directly. Both types can be moved but
+// not copied, since a copied index would point into the original lists.
 struct section_t {
+  section_t() = default;
+  explicit section_t(const std::string& name) : name(name) {}
+  section_t(section_t&&) = default;
+  section_t& operator=(section_t&&) = default;
+  section_t(const section_t&) = delete;
+  section_t& operator=(const section_t&) = delete;
+
   std::string name;
   std::list<entry_t> entries;
+  std::unordered_map<std::string, std::list<entry_t>::iterator> entry_index;
+
+  // Text of this section as last produced by |config_serialize|. Only valid
+  // while |dirty| is false; any change to the section sets |dirty|. It adds
+  // about a quarter to the memory of a parsed config.
+  std::string serialized;
+  bool dirty = true;
 };
 
 struct config_t {
+  config_t() = default;
+  config_t(config_t&&) = default;
+  config_t& operator=(config_t&&) = default;
+  config_t(const config_t&) = delete;
+  config_t& operator=(const config_t&) = delete;
+
   std::list<section_t> sections;
+  std::unordered_map<std::string, std::list<section_t>::iterator>
+      section_index;
+
+  // Set by every change to the config. A config freshly loaded by
+  // |config_new| is clean; owners that persist the config clear it once the
+  // contents have been handed to |config_save_buffer|.
+  bool dirty = false;
 };
 
+// Returns true for the sections that |config_serialize| should write out.
+typedef bool (*config_section_filter_t)(const section_t& section);
+
 // Creates a new config object with no entries (i.e. not backed by a file).
 // This function returns a unique pointer to config object.
 std::unique_ptr<config_t> config_new_empty(void);
@@ -122,6 +158,12 @@ void config_set_string(config_t* config, const std::string& section,
 // |config| may be NULL.
 bool config_remove_section(config_t* config, const std::string& section);
 
+// Removes the section at |section| from |config|, which must be a valid
+// iterator into |config->sections|. Returns the iterator following the
+// removed section, so sections can be removed while iterating.
+std::list<section_t>::iterator config_remove_section(
+    config_t* config, std::list<section_t>::iterator section);
+
 // Removes one specific |key| residing in |section| of the |config|. Returns
 // true
 // if the section and key were found and the key was removed, false otherwise.
@@ -137,6 +179,18 @@ bool config_remove_key(config_t* config, const std::string& section,
 // be lost. Neither |config| nor |filename| may be NULL.
 bool config_save(const config_t& config, const std::string& filename);
 
+// Serializes the sections of |config| accepted by |filter| (all sections if
+// |filter| is NULL) in the format written by |config_save|. Sections that did
+// not change since the previous call reuse their cached text, so the cost of
+// repeated calls is dominated by the sections that actually changed. Does not
+// modify |config->dirty|. |config| must not be NULL.
+std::string config_serialize(config_t* config, config_section_filter_t filter);
+
+// Atomically replaces the file given by |filename| with |buffer|, as produced
+// by |config_serialize|. Returns true on success. This does not access any
+// config_t, so callers can release the lock protecting their config first.
+bool config_save_buffer(const std::string& buffer, const std::string& filename);
+
 // Saves the encrypted |checksum| of config file to a given |filename| Note
 // that this could be a destructive operation: if |filename| already exists,
 // it will be overwritten.
@@ -36,6 +36,25 @@ typedef void (*fixed_queue_cb)(fixed_queue_t* queue, void* context);
 // the returned queue with |fixed_queue_free|.
 fixed_queue_t* fixed_queue_new(size_t capacity);
 
+// Largest |capacity| accepted by |fixed_queue_new_ring|.
+#define FIXED_QUEUE_RING_MAX_CAPACITY ((size_t)1 << 20)
+
+// Creates a new fixed queue backed by a preallocated lock-free ring that
+// supports multiple producers and a single consumer. |capacity| is rounded up
+// to the next power of two and must be between 1 and
+// |FIXED_QUEUE_RING_MAX_CAPACITY|. Returns NULL on failure. The caller must
+// free the returned queue with |fixed_queue_free|.
+//
+// Enqueue and dequeue do not allocate or take a lock on the fast path, and
+// the dequeue fd is only signalled when the queue goes from empty to
+// non-empty. All dequeue-side calls (|fixed_queue_dequeue|,
+// |fixed_queue_try_dequeue|, |fixed_queue_try_peek_first|, |fixed_queue_flush|
+// and the registered dequeue callback) must come from a single thread.
+// |fixed_queue_try_peek_last|, |fixed_queue_try_remove_from_queue|,
+// |fixed_queue_get_list| and |fixed_queue_get_enqueue_fd| are not supported
+// on such a queue.
+fixed_queue_t* fixed_queue_new_ring(size_t capacity);
+
 // Frees a queue and (optionally) the enqueued elements.
 // |queue| is the queue to free. If the |free_cb| callback is not null,
 // it is called on each queue element to free it.
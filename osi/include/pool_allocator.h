@@ -0,0 +1,51 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "osi/include/allocator.h"
+
+// A size-class pool allocator for packet buffers. Requests are rounded up to
+// one of a small set of size classes tuned for BT_HDR buffers on the HCI,
+// L2CAP and AVDTP paths. Freed blocks are kept on a per-thread cache and
+// spill over to a shared pool per size class; new blocks are carved out of
+// larger slabs that are never returned to the system. Requests larger than
+// the largest size class fall through to malloc.
+//
+// Memory returned by |osi_pool_malloc| must be freed with |osi_pool_free|
+// (and never with |osi_free|), so the pool is only suitable for code that
+// allocates and frees through the same |allocator_t|.
+//
+// All functions are thread safe. Allocations are reported to the allocation
+// tracker, so leaks and overruns are caught by |AllocationTestHarness|.
+
+// allocator_t abstraction for |osi_pool_malloc| and |osi_pool_free|.
+extern const allocator_t allocator_pool;
+
+// Allocates |size| bytes from the pool. Never returns NULL.
+void* osi_pool_malloc(size_t size);
+
+// Returns |ptr|, obtained from |osi_pool_malloc|, to the pool. Safe to call
+// with NULL. May be called from any thread.
+void osi_pool_free(void* ptr);
+
+// Dump pool occupancy for each size class to the |fd| file descriptor, in
+// user-readable text format. The |fd| must be valid.
+void osi_pool_allocator_debug_dump(int fd);
@@ -0,0 +1,106 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A hierarchical timing wheel with millisecond resolution. Each level has
+// |TIMER_WHEEL_SLOTS| slots and each slot of level N spans
+// TIMER_WHEEL_SLOTS^N milliseconds, so any 64-bit deadline can be stored.
+// Insertion and removal are O(1); entries are moved to lower levels in
+// amortized O(1) as the wheel's current time advances towards them.
+//
+// Entries are intrusive: callers embed a |timer_wheel_node_t| in their own
+// structure, point its |data| at that structure, and get it back from
+// |timer_wheel_first|.
+//
+// NOTE: None of the functions below are thread safe. Callers must protect
+// the wheel separately.
+
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS \
+  ((64 + TIMER_WHEEL_SLOT_BITS - 1) / TIMER_WHEEL_SLOT_BITS)
+
+typedef struct timer_wheel_node_t {
+  void* data;  // Owned by the caller, never touched by the wheel
+
+  struct timer_wheel_node_t* prev;
+  struct timer_wheel_node_t* next;
+  uint64_t deadline_ms;
+  uint8_t level;
+  uint8_t slot;
+  bool pending;
+} timer_wheel_node_t;
+
+typedef struct timer_wheel_t timer_wheel_t;
+
+typedef struct {
+  size_t entries;
+  size_t occupied_slots;
+} timer_wheel_level_stats_t;
+
+typedef struct {
+  size_t count;
+  uint64_t now_ms;
+  uint64_t cascaded_count;
+  timer_wheel_level_stats_t levels[TIMER_WHEEL_LEVELS];
+} timer_wheel_stats_t;
+
+// Creates a new, empty timing wheel whose current time is |now_ms|. Returns
+// NULL on failure. The returned wheel must be freed with |timer_wheel_free|.
+timer_wheel_t* timer_wheel_new(uint64_t now_ms);
+
+// Frees |wheel|. Entries still in the wheel are not touched. Safe to call
+// with NULL.
+void timer_wheel_free(timer_wheel_t* wheel);
+
+// Returns true if |node| is currently in a wheel. Zero-initialized nodes are
+// not pending.
+bool timer_wheel_node_is_pending(const timer_wheel_node_t* node);
+
+// Inserts |node| with the given |deadline_ms| into |wheel|, after any other
+// entries with the same deadline. |now_ms| is the current time; it lets the
+// wheel advance so that entries stay close to level 0. |node| must not
+// already be pending. Deadlines in the past are accepted and are treated as
+// expiring immediately.
+void timer_wheel_insert(timer_wheel_t* wheel, timer_wheel_node_t* node,
+                        uint64_t deadline_ms, uint64_t now_ms);
+
+// Removes |node| from |wheel|. Does nothing if |node| is not pending.
+void timer_wheel_remove(timer_wheel_t* wheel, timer_wheel_node_t* node);
+
+// Returns the pending node with the earliest deadline, or NULL if |wheel| is
+// empty.
+timer_wheel_node_t* timer_wheel_first(const timer_wheel_t* wheel);
+
+// Returns the number of pending nodes in |wheel|.
+size_t timer_wheel_length(const timer_wheel_t* wheel);
+
+// Calls |cb| for every pending node in |wheel|, in no particular order. |cb|
+// must not modify the wheel.
+void timer_wheel_foreach(const timer_wheel_t* wheel,
+                         void (*cb)(timer_wheel_node_t* node, void* context),
+                         void* context);
+
+// Fills |stats| with the current occupancy of |wheel|.
+void timer_wheel_get_stats(const timer_wheel_t* wheel,
+                           timer_wheel_stats_t* stats);
@@ -36,15 +36,17 @@
 
 #include <hardware/bluetooth.h>
 
+#include <algorithm>
 #include <mutex>
+#include <vector>
 
 #include "osi/include/allocator.h"
 #include "osi/include/fixed_queue.h"
-#include "osi/include/list.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/semaphore.h"
 #include "osi/include/thread.h"
+#include "osi/include/timer_wheel.h"
 #include "osi/include/wakelock.h"
 #include "stack/include/btu.h"
 
@@ -105,6 +107,8 @@ struct alarm_t {
 
   bool for_msg_loop;  // True, if the alarm should be processed on message loop
   CancelableClosureInStruct closure;  // posted to message loop for processing
+
+  timer_wheel_node_t wheel_node;  // Links the alarm into |alarms| while set
 };
 
 // If the next wakeup time is less than this threshold, we should acquire
@@ -116,9 +120,9 @@ static const clockid_t CLOCK_ID = CLOCK_BOOTTIME;
 
 // This mutex ensures that the |alarm_set|, |alarm_cancel|, and alarm callback
 // functions execute serially and not concurrently. As a result, this mutex
-// also protects the |alarms| list.
+// also protects the |alarms| wheel.
 static std::mutex alarms_mutex;
-static list_t* alarms;
+static timer_wheel_t* alarms;
 static timer_t timer;
 static timer_t wakeup_timer;
 static bool timer_set;
@@ -142,6 +146,7 @@ static void alarm_cancel_internal(alarm_t* alarm);
 static void remove_pending_alarm(alarm_t* alarm);
 static void schedule_next_instance(alarm_t* alarm);
 static void reschedule_root_alarm(void);
+static alarm_t* first_pending_alarm(void);
 static void alarm_queue_ready(fixed_queue_t* queue, void* context);
 static void timer_callback(void* data);
 static void callback_dispatch(void* context);
@@ -178,6 +183,7 @@ static alarm_t* alarm_new_internal(const char* name, bool is_periodic) {
   ret->callback_mutex = ptr;
   ret->is_periodic = is_periodic;
   ret->stats.name = osi_strdup(name);
+  ret->wheel_node.data = ret;
 
   ret->for_msg_loop = false;
   // placement new
@@ -260,8 +266,7 @@ void alarm_cancel(alarm_t* alarm) {
 // Internal implementation of canceling an alarm.
 // The caller must hold the |alarms_mutex|
 static void alarm_cancel_internal(alarm_t* alarm) {
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (first_pending_alarm() == alarm);
 
   remove_pending_alarm(alarm);
 
@@ -301,7 +306,7 @@ void alarm_cleanup(void) {
   semaphore_free(alarm_expired);
   alarm_expired = NULL;
 
-  list_free(alarms);
+  timer_wheel_free(alarms);
   alarms = NULL;
 }
 
@@ -315,9 +320,10 @@ static bool lazy_initialize(void) {
 
   std::lock_guard<std::mutex> lock(alarms_mutex);
 
-  alarms = list_new(NULL);
+  // The wheel catches up with the current time on the first insertion.
+  alarms = timer_wheel_new(0);
   if (!alarms) {
-    LOG_ERROR(LOG_TAG, "%s unable to allocate alarm list.", __func__);
+    LOG_ERROR(LOG_TAG, "%s unable to allocate alarm wheel.", __func__);
     goto error;
   }
 
@@ -382,7 +388,7 @@ error:
 
   if (timer_initialized) timer_delete(timer);
 
-  list_free(alarms);
+  timer_wheel_free(alarms);
   alarms = NULL;
 
   return false;
@@ -401,10 +407,17 @@ static uint64_t now_ms(void) {
   return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000LL);
 }
 
-// Remove alarm from internal alarm list and the processing queue
+// Returns the pending alarm with the earliest deadline, or NULL if there is
+// none. The caller must hold the |alarms_mutex|
+static alarm_t* first_pending_alarm(void) {
+  timer_wheel_node_t* node = timer_wheel_first(alarms);
+  return node ? static_cast<alarm_t*>(node->data) : NULL;
+}
+
+// Remove alarm from internal alarm wheel and the processing queue
 // The caller must hold the |alarms_mutex|
 static void remove_pending_alarm(alarm_t* alarm) {
-  list_remove(alarms, alarm);
+  timer_wheel_remove(alarms, &alarm->wheel_node);
 
   if (alarm->for_msg_loop) {
     alarm->closure.i.Cancel();
@@ -419,10 +432,9 @@ static void remove_pending_alarm(alarm_t* alarm) {
 
 // Must be called with |alarms_mutex| held
 static void schedule_next_instance(alarm_t* alarm) {
-  // If the alarm is currently set and it's at the start of the list,
+  // If the alarm is currently set and it's the earliest pending one,
   // we'll need to re-schedule since we've adjusted the earliest deadline.
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (first_pending_alarm() == alarm);
   if (alarm->callback) remove_pending_alarm(alarm);
 
   // Calculate the next deadline for this alarm
@@ -433,26 +445,13 @@ static void schedule_next_instance(alarm_t* alarm) {
         ((just_now_ms - alarm->creation_time_ms) % alarm->period_ms);
   alarm->deadline_ms = just_now_ms + (alarm->period_ms - ms_into_period);
 
-  // Add it into the timer list sorted by deadline (earliest deadline first).
-  if (list_is_empty(alarms) ||
-      ((alarm_t*)list_front(alarms))->deadline_ms > alarm->deadline_ms) {
-    list_prepend(alarms, alarm);
-  } else {
-    for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-         node = list_next(node)) {
-      list_node_t* next = list_next(node);
-      if (next == list_end(alarms) ||
-          ((alarm_t*)list_node(next))->deadline_ms > alarm->deadline_ms) {
-        list_insert_after(alarms, node, alarm);
-        break;
-      }
-    }
-  }
+  // Add it into the timer wheel, after any alarm with the same deadline.
+  timer_wheel_insert(alarms, &alarm->wheel_node, alarm->deadline_ms,
+                     just_now_ms);
 
   // If the new alarm has the earliest deadline, we need to re-evaluate our
   // schedule.
-  if (needs_reschedule ||
-      (!list_is_empty(alarms) && list_front(alarms) == alarm)) {
+  if (needs_reschedule || first_pending_alarm() == alarm) {
     reschedule_root_alarm();
   }
 }
@@ -469,9 +468,9 @@ static void reschedule_root_alarm(void) {
   struct itimerspec timer_time;
   memset(&timer_time, 0, sizeof(timer_time));
 
-  if (list_is_empty(alarms)) goto done;
+  next = first_pending_alarm();
+  if (next == NULL) goto done;
 
-  next = static_cast<alarm_t*>(list_front(alarms));
   next_expiration = next->deadline_ms - now_ms();
   if (next_expiration < TIMER_INTERVAL_FOR_WAKELOCK_IN_MS) {
     if (!timer_set) {
@@ -532,7 +531,7 @@ done:
   // milliseconds) and the timer expired normally before we called
   // |timer_gettime|. Worst case, |alarm_expired| is signaled twice for that
   // alarm. Nothing bad should happen in that case though since the callback
-  // dispatch function checks to make sure the timer at the head of the list
+  // dispatch function checks to make sure the earliest pending timer
   // actually expired.
   if (timer_set) {
     struct itimerspec time_to_expire;
@@ -633,14 +632,13 @@ static void callback_dispatch(UNUSED_ATTR void* context) {
     // Take into account that the alarm may get cancelled before we get to it.
     // We're done here if there are no alarms or the alarm at the front is in
     // the future. Exit right away since there's nothing left to do.
-    if (list_is_empty(alarms) ||
-        (alarm = static_cast<alarm_t*>(list_front(alarms)))->deadline_ms >
-            now_ms()) {
+    if ((alarm = first_pending_alarm()) == NULL ||
+        alarm->deadline_ms > now_ms()) {
       reschedule_root_alarm();
       continue;
     }
 
-    list_remove(alarms, alarm);
+    timer_wheel_remove(alarms, &alarm->wheel_node);
 
     if (alarm->is_periodic) {
       alarm->prev_deadline_ms = alarm->deadline_ms;
@@ -728,50 +726,78 @@ static void dump_stat(int fd, stat_t* stat, const char* description) {
           (unsigned long long)average_time_ms);
 }
 
-void alarm_debug_dump(int fd) {
-  dprintf(fd, "\nBluetooth Alarms Statistics:\n");
+static void collect_alarm(timer_wheel_node_t* node, void* context) {
+  static_cast<std::vector<alarm_t*>*>(context)->push_back(
+      static_cast<alarm_t*>(node->data));
+}
 
-  std::lock_guard<std::mutex> lock(alarms_mutex);
+static void dump_alarm(int fd, alarm_t* alarm, uint64_t just_now_ms) {
+  alarm_stats_t* stats = &alarm->stats;
 
-  if (alarms == NULL) {
-    dprintf(fd, "  None\n");
-    return;
-  }
+  dprintf(fd, "  Alarm : %s (%s)\n", stats->name,
+          (alarm->is_periodic) ? "PERIODIC" : "SINGLE");
 
-  uint64_t just_now_ms = now_ms();
+  dprintf(fd, "%-51s: %zu / %zu / %zu / %zu\n",
+          "    Action counts (sched/resched/exec/cancel)",
+          stats->scheduled_count, stats->rescheduled_count,
+          stats->total_updates, stats->canceled_count);
 
-  dprintf(fd, "  Total Alarms: %zu\n\n", list_length(alarms));
+  dprintf(fd, "%-51s: %zu / %zu\n", "    Deviation counts (overdue/premature)",
+          stats->overdue_scheduling.count, stats->premature_scheduling.count);
 
-  // Dump info for each alarm
-  for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-       node = list_next(node)) {
-    alarm_t* alarm = (alarm_t*)list_node(node);
-    alarm_stats_t* stats = &alarm->stats;
+  dprintf(fd, "%-51s: %llu / %llu / %lld\n",
+          "    Time in ms (since creation/interval/remaining)",
+          (unsigned long long)(just_now_ms - alarm->creation_time_ms),
+          (unsigned long long)alarm->period_ms,
+          (long long)(alarm->deadline_ms - just_now_ms));
 
-    dprintf(fd, "  Alarm : %s (%s)\n", stats->name,
-            (alarm->is_periodic) ? "PERIODIC" : "SINGLE");
+  dump_stat(fd, &stats->overdue_scheduling,
+            "    Overdue scheduling time in ms (total/max/avg)");
 
-    dprintf(fd, "%-51s: %zu / %zu / %zu / %zu\n",
-            "    Action counts (sched/resched/exec/cancel)",
-            stats->scheduled_count, stats->rescheduled_count,
-            stats->total_updates, stats->canceled_count);
+  dump_stat(fd, &stats->premature_scheduling,
+            "    Premature scheduling time in ms (total/max/avg)");
 
-    dprintf(fd, "%-51s: %zu / %zu\n",
-            "    Deviation counts (overdue/premature)",
-            stats->overdue_scheduling.count, stats->premature_scheduling.count);
+  dprintf(fd, "\n");
+}
 
-    dprintf(fd, "%-51s: %llu / %llu / %lld\n",
-            "    Time in ms (since creation/interval/remaining)",
-            (unsigned long long)(just_now_ms - alarm->creation_time_ms),
-            (unsigned long long)alarm->period_ms,
-            (long long)(alarm->deadline_ms - just_now_ms));
+static void dump_wheel(int fd) {
+  timer_wheel_stats_t stats;
+  timer_wheel_get_stats(alarms, &stats);
+
+  dprintf(fd, "  Timer wheel (cascaded entries: %llu)\n",
+          (unsigned long long)stats.cascaded_count);
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    if (stats.levels[level].entries == 0) continue;
+    dprintf(fd, "    Level %d: %zu alarms in %zu / %d slots\n", level,
+            stats.levels[level].entries, stats.levels[level].occupied_slots,
+            TIMER_WHEEL_SLOTS);
+  }
+  dprintf(fd, "\n");
+}
 
-    dump_stat(fd, &stats->overdue_scheduling,
-              "    Overdue scheduling time in ms (total/max/avg)");
+void alarm_debug_dump(int fd) {
+  dprintf(fd, "\nBluetooth Alarms Statistics:\n");
 
-    dump_stat(fd, &stats->premature_scheduling,
-              "    Premature scheduling time in ms (total/max/avg)");
+  std::lock_guard<std::mutex> lock(alarms_mutex);
 
-    dprintf(fd, "\n");
+  if (alarms == NULL) {
+    dprintf(fd, "  None\n");
+    return;
   }
+
+  dprintf(fd, "  Total Alarms: %zu\n\n", timer_wheel_length(alarms));
+  dump_wheel(fd);
+
+  // Dump info for each alarm, the next one to expire first. The timer wheel
+  // only keeps them ordered within a slot.
+  std::vector<alarm_t*> sorted;
+  sorted.reserve(timer_wheel_length(alarms));
+  timer_wheel_foreach(alarms, collect_alarm, &sorted);
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const alarm_t* a, const alarm_t* b) {
+                     return a->deadline_ms < b->deadline_ms;
+                   });
+
+  uint64_t just_now_ms = now_ms();
+  for (alarm_t* alarm : sorted) dump_alarm(fd, alarm, just_now_ms);
 }
@@ -30,34 +30,30 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <sstream>
-#include <type_traits>
 
 // Empty definition; this type is aliased to list_node_t.
 struct config_section_iter_t {};
 
 static bool config_parse(FILE* fp, config_t* config);
 
-template <typename T,
-          class = typename std::enable_if<std::is_same<
-              config_t, typename std::remove_const<T>::type>::value>>
-static auto section_find(T& config, const std::string& section) {
-  return std::find_if(
-      config.sections.begin(), config.sections.end(),
-      [&section](const section_t& sec) { return sec.name == section; });
+static section_t* section_find(const config_t& config,
+                               const std::string& section) {
+  auto it = config.section_index.find(section);
+  if (it == config.section_index.end()) return nullptr;
+
+  return &*it->second;
 }
 
 static const entry_t* entry_find(const config_t& config,
                                  const std::string& section,
                                  const std::string& key) {
-  auto sec = section_find(config, section);
-  if (sec == config.sections.end()) return nullptr;
+  const section_t* sec = section_find(config, section);
+  if (!sec) return nullptr;
 
-  for (const entry_t& entry : sec->entries) {
-    if (entry.key == key) return &entry;
-  }
+  auto it = sec->entry_index.find(key);
+  if (it == sec->entry_index.end()) return nullptr;
 
-  return nullptr;
+  return &*it->second;
 }
 
 std::unique_ptr<config_t> config_new_empty(void) {
@@ -78,6 +74,8 @@ std::unique_ptr<config_t> config_new(const char* filename) {
 
   if (!config_parse(fp, config.get())) {
     config.reset();
+  } else {
+    config->dirty = false;
   }
 
   fclose(fp);
@@ -110,7 +108,7 @@ std::unique_ptr<config_t> config_new_clone(const config_t& src) {
 }
 
 bool config_has_section(const config_t& config, const std::string& section) {
-  return (section_find(config, section) != config.sections.end());
+  return (section_find(config, section) != nullptr);
 }
 
 bool config_has_key(const config_t& config, const std::string& section,
@@ -178,10 +176,12 @@ void config_set_string(config_t* config, const std::string& section,
                        const std::string& key, const std::string& value) {
   CHECK(config);
 
-  auto sec = section_find(*config, section);
-  if (sec == config->sections.end()) {
-    config->sections.emplace_back(section_t{.name = section});
-    sec = std::prev(config->sections.end());
+  section_t* sec = section_find(*config, section);
+  if (!sec) {
+    config->sections.emplace_back(section);
+    config->section_index[section] = std::prev(config->sections.end());
+    sec = &config->sections.back();
+    config->dirty = true;
   }
 
   std::string value_no_newline;
@@ -193,44 +193,96 @@ void config_set_string(config_t* config, const std::string& section,
     value_no_newline = value;
   }
 
-  for (entry_t& entry : sec->entries) {
-    if (entry.key == key) {
-      entry.value = value_no_newline;
-      return;
-    }
+  auto it = sec->entry_index.find(key);
+  if (it != sec->entry_index.end()) {
+    if (it->second->value == value_no_newline) return;
+    it->second->value = value_no_newline;
+  } else {
+    sec->entries.emplace_back(entry_t{.key = key, .value = value_no_newline});
+    sec->entry_index[key] = std::prev(sec->entries.end());
   }
 
-  sec->entries.emplace_back(entry_t{.key = key, .value = value_no_newline});
+  sec->dirty = true;
+  config->dirty = true;
 }
 
 bool config_remove_section(config_t* config, const std::string& section) {
   CHECK(config);
 
-  auto sec = section_find(*config, section);
-  if (sec == config->sections.end()) return false;
+  auto it = config->section_index.find(section);
+  if (it == config->section_index.end()) return false;
 
-  config->sections.erase(sec);
+  config->sections.erase(it->second);
+  config->section_index.erase(it);
+  config->dirty = true;
   return true;
 }
 
+std::list<section_t>::iterator config_remove_section(
+    config_t* config, std::list<section_t>::iterator section) {
+  CHECK(config);
+
+  config->section_index.erase(section->name);
+  config->dirty = true;
+  return config->sections.erase(section);
+}
+
 bool config_remove_key(config_t* config, const std::string& section,
                        const std::string& key) {
   CHECK(config);
-  auto sec = section_find(*config, section);
-  if (sec == config->sections.end()) return false;
-
-  for (auto entry = sec->entries.begin(); entry != sec->entries.end();
-       ++entry) {
-    if (entry->key == key) {
-      sec->entries.erase(entry);
-      return true;
+  section_t* sec = section_find(*config, section);
+  if (!sec) return false;
+
+  auto it = sec->entry_index.find(key);
+  if (it == sec->entry_index.end()) return false;
+
+  sec->entries.erase(it->second);
+  sec->entry_index.erase(it);
+  sec->dirty = true;
+  config->dirty = true;
+  return true;
+}
+
+static void serialize_section(const section_t& section, std::string* out) {
+  out->append("[").append(section.name).append("]\n");
+  for (const entry_t& entry : section.entries)
+    out->append(entry.key).append(" = ").append(entry.value).append("\n");
+  out->append("\n");
+}
+
+std::string config_serialize(config_t* config, config_section_filter_t filter) {
+  CHECK(config);
+
+  size_t size = 0;
+  for (section_t& section : config->sections) {
+    if (filter && !filter(section)) continue;
+    if (section.dirty) {
+      section.serialized.clear();
+      serialize_section(section, &section.serialized);
+      section.dirty = false;
     }
+    size += section.serialized.size();
   }
 
-  return false;
+  std::string buffer;
+  buffer.reserve(size);
+  for (const section_t& section : config->sections) {
+    if (filter && !filter(section)) continue;
+    buffer.append(section.serialized);
+  }
+  return buffer;
 }
 
 bool config_save(const config_t& config, const std::string& filename) {
+  std::string buffer;
+  for (const section_t& section : config.sections)
+    serialize_section(section, &buffer);
+
+  return config_save_buffer(buffer, filename);
+}
+
+bool config_save_buffer(const std::string& buffer,
+                        const std::string& filename) {
   CHECK(!filename.empty());
 
   // Steps to ensure content of config file gets to disk:
@@ -244,7 +296,6 @@ bool config_save(const config_t& config, const std::string& filename) {
   //    This ensures directory entries are up-to-date.
   int dir_fd = -1;
   FILE* fp = nullptr;
-  std::stringstream serialized;
 
   // Build temp config file based on config file (e.g. bt_config.conf.new).
   const std::string temp_filename = filename + ".new";
@@ -271,16 +322,7 @@ bool config_save(const config_t& config, const std::string& filename) {
     goto error;
   }
 
-  for (const section_t& section : config.sections) {
-    serialized << "[" << section.name << "]" << std::endl;
-
-    for (const entry_t& entry : section.entries)
-      serialized << entry.key << " = " << entry.value << std::endl;
-
-    serialized << std::endl;
-  }
-
-  if (fprintf(fp, "%s", serialized.str().c_str()) < 0) {
+  if (fwrite(buffer.data(), 1, buffer.size(), fp) != buffer.size()) {
     LOG(ERROR) << __func__ << ": unable to write to file '" << temp_filename
                << "': " << strerror(errno);
     goto error;
@@ -17,8 +17,14 @@
  ******************************************************************************/
 
 #include <base/logging.h>
+#include <poll.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 #include "osi/include/allocator.h"
@@ -28,7 +34,38 @@
 #include "osi/include/reactor.h"
 #include "osi/include/semaphore.h"
 
+// A preallocated bounded multi-producer/single-consumer ring, based on the
+// per-slot sequence number scheme by Dmitry Vyukov. Each slot's |sequence|
+// tells a producer whether the slot is free for position |pos| and tells the
+// consumer whether the slot holds the element for position |pos|.
+typedef struct {
+  std::atomic<size_t> sequence;
+  void* data;
+} ring_slot_t;
+
+typedef struct {
+  ring_slot_t* slots;
+  size_t mask;
+
+  alignas(64) std::atomic<size_t> enqueue_pos;
+  alignas(64) std::atomic<size_t> dequeue_pos;
+  // Number of published elements. Producers signal |dequeue_fd| only when
+  // they move it from zero to one. A producer counts its element after
+  // publishing it, so the consumer may take it first and wrap |count| for a
+  // moment: use ring_length() and ring_is_empty() to observe the ring.
+  alignas(64) std::atomic<size_t> count;
+
+  // Slow path for producers blocked on a full ring.
+  std::atomic<size_t> blocked_producers;
+  std::mutex full_mutex;
+  std::condition_variable not_full;
+
+  int dequeue_fd;
+} ring_t;
+
 typedef struct fixed_queue_t {
+  ring_t* ring;
+
   list_t* list;
   semaphore_t* enqueue_sem;
   semaphore_t* dequeue_sem;
@@ -42,6 +79,15 @@ typedef struct fixed_queue_t {
 
 static void internal_dequeue_ready(void* context);
 
+static bool ring_try_enqueue(ring_t* ring, void* data);
+static void* ring_try_dequeue(ring_t* ring);
+static void* ring_dequeue(ring_t* ring);
+static void ring_enqueue(ring_t* ring, void* data);
+static void ring_free(ring_t* ring);
+static bool ring_disarm_if_empty(ring_t* ring);
+static bool ring_is_empty(ring_t* ring);
+static size_t ring_length(ring_t* ring);
+
 fixed_queue_t* fixed_queue_new(size_t capacity) {
   fixed_queue_t* ret =
       static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
@@ -65,11 +111,53 @@ error:
   return NULL;
 }
 
+fixed_queue_t* fixed_queue_new_ring(size_t capacity) {
+  if (capacity == 0 || capacity > FIXED_QUEUE_RING_MAX_CAPACITY) return NULL;
+
+  size_t slot_count = 1;
+  while (slot_count < capacity) slot_count <<= 1;
+
+  fixed_queue_t* ret =
+      static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
+  ret->capacity = slot_count;
+
+  ring_t* ring = new ring_t;
+  ret->ring = ring;
+  ring->slots =
+      static_cast<ring_slot_t*>(osi_calloc(sizeof(ring_slot_t) * slot_count));
+  ring->mask = slot_count - 1;
+  for (size_t i = 0; i < slot_count; i++)
+    ring->slots[i].sequence.store(i, std::memory_order_relaxed);
+  ring->enqueue_pos.store(0, std::memory_order_relaxed);
+  ring->dequeue_pos.store(0, std::memory_order_relaxed);
+  ring->count.store(0, std::memory_order_relaxed);
+  ring->blocked_producers.store(0, std::memory_order_relaxed);
+
+  ring->dequeue_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (ring->dequeue_fd == INVALID_FD) goto error;
+
+  return ret;
+
+error:
+  fixed_queue_free(ret, NULL);
+  return NULL;
+}
+
 void fixed_queue_free(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
   if (!queue) return;
 
   fixed_queue_unregister_dequeue(queue);
 
+  if (queue->ring) {
+    if (free_cb) {
+      void* data;
+      while ((data = ring_try_dequeue(queue->ring)) != NULL) free_cb(data);
+    }
+    ring_free(queue->ring);
+    osi_free(queue);
+    return;
+  }
+
   if (free_cb)
     for (const list_node_t* node = list_begin(queue->list);
          node != list_end(queue->list); node = list_next(node))
@@ -96,6 +184,8 @@ void fixed_queue_flush(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
 bool fixed_queue_is_empty(fixed_queue_t* queue) {
   if (queue == NULL) return true;
 
+  if (queue->ring) return ring_is_empty(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list);
 }
@@ -103,6 +193,8 @@ bool fixed_queue_is_empty(fixed_queue_t* queue) {
 size_t fixed_queue_length(fixed_queue_t* queue) {
   if (queue == NULL) return 0;
 
+  if (queue->ring) return ring_length(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_length(queue->list);
 }
@@ -117,6 +209,11 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) {
+    ring_enqueue(queue->ring, data);
+    return;
+  }
+
   semaphore_wait(queue->enqueue_sem);
 
   {
@@ -130,6 +227,8 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_dequeue(fixed_queue_t* queue) {
   CHECK(queue != NULL);
 
+  if (queue->ring) return ring_dequeue(queue->ring);
+
   semaphore_wait(queue->dequeue_sem);
 
   void* ret = NULL;
@@ -148,6 +247,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) return ring_try_enqueue(queue->ring, data);
+
   if (!semaphore_try_wait(queue->enqueue_sem)) return false;
 
   {
@@ -162,6 +263,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_try_dequeue(queue->ring);
+
   if (!semaphore_try_wait(queue->dequeue_sem)) return NULL;
 
   void* ret = NULL;
@@ -179,12 +282,22 @@ void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
 void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) {
+    // Only valid from the single consumer, which owns |dequeue_pos|.
+    ring_t* ring = queue->ring;
+    size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+    ring_slot_t* slot = &ring->slots[pos & ring->mask];
+    if (slot->sequence.load(std::memory_order_acquire) != pos + 1) return NULL;
+    return slot->data;
+  }
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_front(queue->list);
 }
 
 void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
+  CHECK(queue->ring == NULL);
 
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_back(queue->list);
@@ -192,6 +305,7 @@ void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
 
 void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
   if (queue == NULL) return NULL;
+  CHECK(queue->ring == NULL);
 
   bool removed = false;
   {
@@ -212,6 +326,7 @@ void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
 
 list_t* fixed_queue_get_list(fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  CHECK(queue->ring == NULL);
 
   // NOTE: Using the list in this way is not thread-safe.
   // Using this list in any context where threads can call other functions
@@ -221,11 +336,13 @@ list_t* fixed_queue_get_list(fixed_queue_t* queue) {
 
 int fixed_queue_get_dequeue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  if (queue->ring) return queue->ring->dequeue_fd;
   return semaphore_get_fd(queue->dequeue_sem);
 }
 
 int fixed_queue_get_enqueue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  CHECK(queue->ring == NULL);
   return semaphore_get_fd(queue->enqueue_sem);
 }
 
@@ -258,5 +375,123 @@ static void internal_dequeue_ready(void* context) {
   CHECK(context != NULL);
 
   fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
+  if (queue->ring && ring_disarm_if_empty(queue->ring)) return;
   queue->dequeue_ready(queue, queue->dequeue_context);
 }
+
+static void ring_free(ring_t* ring) {
+  if (ring->dequeue_fd != INVALID_FD) close(ring->dequeue_fd);
+  osi_free(ring->slots);
+  delete ring;
+}
+
+// Returns whether the element at the head of the ring is published.
+static bool ring_is_empty(ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load();
+  ring_slot_t* slot = &ring->slots[pos & ring->mask];
+  return slot->sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+// Returns the number of positions claimed by producers and not yet consumed.
+// |dequeue_pos| is read first as it never passes |enqueue_pos|; the two are
+// not read atomically, so the result is clamped to the ring bounds.
+static size_t ring_length(ring_t* ring) {
+  size_t dequeue_pos = ring->dequeue_pos.load();
+  size_t enqueue_pos = ring->enqueue_pos.load();
+  intptr_t length = (intptr_t)(enqueue_pos - dequeue_pos);
+  if (length <= 0) return 0;
+  return std::min((size_t)length, ring->mask + 1);
+}
+
+// Clears the dequeue fd if the ring is empty, re-arming it if a producer
+// published in between so that the wakeup is not lost. A producer may still
+// signal after its element was already consumed, so the fd can be readable
+// while the ring is empty; callers treat that as a spurious wakeup. Returns
+// true if the ring was left empty and the fd cleared.
+static bool ring_disarm_if_empty(ring_t* ring) {
+  if (ring->count.load() != 0) return false;
+
+  eventfd_t value;
+  eventfd_read(ring->dequeue_fd, &value);
+  if (ring->count.load() == 0) return true;
+
+  eventfd_write(ring->dequeue_fd, 1ULL);
+  return false;
+}
+
+static bool ring_try_enqueue(ring_t* ring, void* data) {
+  ring_slot_t* slot;
+  size_t pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff == 0) {
+      if (ring->enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // The consumer has not released this slot yet: the ring is full.
+      return false;
+    } else {
+      pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->data = data;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  // Only the empty -> non-empty transition needs to wake up the consumer.
+  if (ring->count.fetch_add(1) == 0) {
+    if (eventfd_write(ring->dequeue_fd, 1ULL) == -1)
+      LOG(ERROR) << __func__
+                 << ": unable to signal dequeue fd: " << strerror(errno);
+  }
+  return true;
+}
+
+static void* ring_try_dequeue(ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  ring_slot_t* slot = &ring->slots[pos & ring->mask];
+  if (slot->sequence.load(std::memory_order_acquire) != pos + 1) return NULL;
+
+  void* data = slot->data;
+  ring->dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+  // Sequentially consistent so that the |blocked_producers| check below
+  // cannot be ordered before the slot is released (see ring_enqueue).
+  slot->sequence.store(pos + ring->mask + 1);
+
+  if (ring->count.fetch_sub(1) == 1) ring_disarm_if_empty(ring);
+
+  if (ring->blocked_producers.load() != 0) {
+    std::lock_guard<std::mutex> lock(ring->full_mutex);
+    ring->not_full.notify_all();
+  }
+
+  return data;
+}
+
+static void ring_enqueue(ring_t* ring, void* data) {
+  if (ring_try_enqueue(ring, data)) return;
+
+  std::unique_lock<std::mutex> lock(ring->full_mutex);
+  ring->blocked_producers.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!ring_try_enqueue(ring, data)) ring->not_full.wait(lock);
+  ring->blocked_producers.fetch_sub(1);
+}
+
+static void* ring_dequeue(ring_t* ring) {
+  for (;;) {
+    void* data = ring_try_dequeue(ring);
+    if (data != NULL) return data;
+    if (!ring_disarm_if_empty(ring)) continue;
+
+    struct pollfd pfd = {.fd = ring->dequeue_fd, .events = POLLIN};
+    int ret;
+    OSI_NO_INTR(ret = poll(&pfd, 1, -1));
+    if (ret == -1)
+      LOG(ERROR) << __func__
+                 << ": unable to wait on dequeue fd: " << strerror(errno);
+  }
+}
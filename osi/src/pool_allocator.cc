@@ -0,0 +1,219 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_osi_pool_allocator"
+
+#include "osi/include/pool_allocator.h"
+
+#include <base/logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+
+#include "osi/include/allocation_tracker.h"
+
+static const allocator_id_t pool_allocator_id = 43;
+
+// Usable bytes of each size class, including room for the allocation
+// tracker's canaries. 1088 fits a full BR/EDR ACL packet (1021 bytes plus
+// the BT_HDR and HCI headers) and 4224 fits BT_DEFAULT_BUFFER_SIZE.
+static const size_t size_classes[] = {64, 128, 256, 512, 1088, 2048, 4224};
+#define NUM_SIZE_CLASSES (sizeof(size_classes) / sizeof(size_classes[0]))
+#define LARGE_SIZE_CLASS NUM_SIZE_CLASSES
+
+static const size_t slab_size = 64 * 1024;
+// Number of free blocks a thread may cache per size class before handing
+// |batch_size| of them back to the shared pool.
+static const size_t thread_cache_max = 64;
+static const size_t batch_size = 32;
+
+static const uint32_t block_magic = 0xb10cb10c;
+
+// Every block starts with this header; the caller's memory follows it.
+typedef union block_t {
+  union block_t* next;  // While the block is free
+  struct {
+    uint32_t size_class;
+    uint32_t magic;
+  } header;  // While the block is allocated
+  max_align_t align;
+} block_t;
+
+typedef struct {
+  std::mutex lock;
+  block_t* free_list;
+  size_t free_count;
+  size_t block_count;
+  size_t slab_count;
+} shared_pool_t;
+
+static shared_pool_t shared_pools[NUM_SIZE_CLASSES];
+// Allocations too large for the pools, currently in use
+static std::atomic<size_t> large_alloc_count(0);
+
+static void shared_pool_put(size_t size_class, block_t* head, block_t* tail,
+                            size_t count);
+
+struct thread_cache_t {
+  block_t* free_list[NUM_SIZE_CLASSES] = {};
+  size_t count[NUM_SIZE_CLASSES] = {};
+
+  ~thread_cache_t() {
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+      if (!free_list[i]) continue;
+      block_t* tail = free_list[i];
+      while (tail->next) tail = tail->next;
+      shared_pool_put(i, free_list[i], tail, count[i]);
+    }
+  }
+};
+
+static thread_local thread_cache_t thread_cache;
+
+static size_t block_stride(size_t size_class) {
+  size_t size = sizeof(block_t) + size_classes[size_class];
+  return (size + sizeof(block_t) - 1) / sizeof(block_t) * sizeof(block_t);
+}
+
+static size_t size_class_for(size_t size) {
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+    if (size <= size_classes[i]) return i;
+  }
+  return LARGE_SIZE_CLASS;
+}
+
+static void shared_pool_put(size_t size_class, block_t* head, block_t* tail,
+                            size_t count) {
+  shared_pool_t* pool = &shared_pools[size_class];
+  std::lock_guard<std::mutex> lock(pool->lock);
+  tail->next = pool->free_list;
+  pool->free_list = head;
+  pool->free_count += count;
+}
+
+// Moves up to |batch_size| blocks of |size_class| from the shared pool to
+// |*head|, carving a new slab if the pool is empty. Returns the number of
+// blocks moved.
+static size_t shared_pool_take(size_t size_class, block_t** head) {
+  shared_pool_t* pool = &shared_pools[size_class];
+  std::lock_guard<std::mutex> lock(pool->lock);
+
+  if (pool->free_count == 0) {
+    size_t stride = block_stride(size_class);
+    size_t count = slab_size / stride;
+    if (count == 0) count = 1;
+
+    uint8_t* slab = static_cast<uint8_t*>(malloc(count * stride));
+    CHECK(slab);
+    for (size_t i = 0; i < count; i++) {
+      block_t* block = reinterpret_cast<block_t*>(slab + i * stride);
+      block->next = pool->free_list;
+      pool->free_list = block;
+    }
+    pool->free_count = count;
+    pool->block_count += count;
+    pool->slab_count++;
+  }
+
+  size_t count = 1;
+  block_t* tail = pool->free_list;
+  while (count < batch_size && tail->next) {
+    tail = tail->next;
+    count++;
+  }
+  *head = pool->free_list;
+  pool->free_list = tail->next;
+  pool->free_count -= count;
+  tail->next = NULL;
+  return count;
+}
+
+void* osi_pool_malloc(size_t size) {
+  size_t real_size = allocation_tracker_resize_for_canary(size);
+  size_t size_class = size_class_for(real_size);
+
+  block_t* block;
+  if (size_class == LARGE_SIZE_CLASS) {
+    block = static_cast<block_t*>(malloc(sizeof(block_t) + real_size));
+    CHECK(block);
+    large_alloc_count++;
+  } else {
+    thread_cache_t& cache = thread_cache;
+    if (!cache.free_list[size_class]) {
+      cache.count[size_class] =
+          shared_pool_take(size_class, &cache.free_list[size_class]);
+    }
+    block = cache.free_list[size_class];
+    cache.free_list[size_class] = block->next;
+    cache.count[size_class]--;
+  }
+
+  block->header.size_class = size_class;
+  block->header.magic = block_magic;
+  return allocation_tracker_notify_alloc(pool_allocator_id, block + 1, size);
+}
+
+void osi_pool_free(void* ptr) {
+  if (!ptr) return;
+
+  block_t* block = static_cast<block_t*>(
+                       allocation_tracker_notify_free(pool_allocator_id, ptr)) -
+                   1;
+  CHECK(block->header.magic == block_magic);
+
+  size_t size_class = block->header.size_class;
+  if (size_class == LARGE_SIZE_CLASS) {
+    free(block);
+    large_alloc_count--;
+    return;
+  }
+  CHECK(size_class < NUM_SIZE_CLASSES);
+
+  thread_cache_t& cache = thread_cache;
+  block->next = cache.free_list[size_class];
+  cache.free_list[size_class] = block;
+  if (++cache.count[size_class] <= thread_cache_max) return;
+
+  // Hand a batch back so that blocks freed on a different thread than the
+  // one that allocated them do not pile up in this thread's cache.
+  block_t* head = cache.free_list[size_class];
+  block_t* tail = head;
+  for (size_t i = 1; i < batch_size; i++) tail = tail->next;
+  cache.free_list[size_class] = tail->next;
+  cache.count[size_class] -= batch_size;
+  shared_pool_put(size_class, head, tail, batch_size);
+}
+
+const allocator_t allocator_pool = {osi_pool_malloc, osi_pool_free};
+
+void osi_pool_allocator_debug_dump(int fd) {
+  dprintf(fd, "\nBluetooth Pool Allocator Statistics:\n");
+
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+    shared_pool_t* pool = &shared_pools[i];
+    std::lock_guard<std::mutex> lock(pool->lock);
+    dprintf(fd,
+            "  Size class %4zu octets : %zu blocks in %zu slabs, %zu in "
+            "shared pool\n",
+            size_classes[i], pool->block_count, pool->slab_count,
+            pool->free_count);
+  }
+  dprintf(fd, "  Allocations larger than %zu octets in use : %zu\n",
+          size_classes[NUM_SIZE_CLASSES - 1], large_alloc_count.load());
+}
@@ -0,0 +1,224 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "osi/include/timer_wheel.h"
+
+#include <base/logging.h>
+
+#include "osi/include/allocator.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+// Invariant: every pending node is stored relative to |now_ms|. A node whose
+// deadline first differs from |now_ms| in slot-sized bit group N lives in
+// level N, in the slot given by that bit group. All nodes in level 0 thus
+// expire within the current TIMER_WHEEL_SLOTS milliseconds, and every node
+// in level N expires before any node in level N + 1.
+struct timer_wheel_t {
+  uint64_t now_ms;
+  size_t count;
+  uint64_t cascaded_count;
+  timer_wheel_node_t* first;  // Cached earliest node
+
+  uint64_t occupied[TIMER_WHEEL_LEVELS];  // Bitmap of non-empty slots
+  size_t level_count[TIMER_WHEEL_LEVELS];
+  timer_wheel_node_t* heads[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+  timer_wheel_node_t* tails[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+static void link_node(timer_wheel_t* wheel, timer_wheel_node_t* node);
+static void unlink_node(timer_wheel_t* wheel, timer_wheel_node_t* node);
+static void advance(timer_wheel_t* wheel, uint64_t now_ms);
+static timer_wheel_node_t* find_first(const timer_wheel_t* wheel);
+
+timer_wheel_t* timer_wheel_new(uint64_t now_ms) {
+  timer_wheel_t* wheel =
+      static_cast<timer_wheel_t*>(osi_calloc(sizeof(timer_wheel_t)));
+  wheel->now_ms = now_ms;
+  return wheel;
+}
+
+void timer_wheel_free(timer_wheel_t* wheel) { osi_free(wheel); }
+
+bool timer_wheel_node_is_pending(const timer_wheel_node_t* node) {
+  CHECK(node != NULL);
+  return node->pending;
+}
+
+void timer_wheel_insert(timer_wheel_t* wheel, timer_wheel_node_t* node,
+                        uint64_t deadline_ms, uint64_t now_ms) {
+  CHECK(wheel != NULL);
+  CHECK(node != NULL);
+  CHECK(!node->pending);
+
+  advance(wheel, now_ms);
+
+  node->deadline_ms = deadline_ms;
+  node->pending = true;
+  link_node(wheel, node);
+  wheel->count++;
+
+  if (wheel->first == NULL || deadline_ms < wheel->first->deadline_ms)
+    wheel->first = node;
+}
+
+void timer_wheel_remove(timer_wheel_t* wheel, timer_wheel_node_t* node) {
+  CHECK(wheel != NULL);
+  CHECK(node != NULL);
+
+  if (!node->pending) return;
+
+  unlink_node(wheel, node);
+  node->pending = false;
+  wheel->count--;
+
+  if (wheel->first == node) wheel->first = find_first(wheel);
+}
+
+timer_wheel_node_t* timer_wheel_first(const timer_wheel_t* wheel) {
+  CHECK(wheel != NULL);
+  return wheel->first;
+}
+
+size_t timer_wheel_length(const timer_wheel_t* wheel) {
+  CHECK(wheel != NULL);
+  return wheel->count;
+}
+
+void timer_wheel_foreach(const timer_wheel_t* wheel,
+                         void (*cb)(timer_wheel_node_t* node, void* context),
+                         void* context) {
+  CHECK(wheel != NULL);
+  CHECK(cb != NULL);
+
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    uint64_t occupied = wheel->occupied[level];
+    while (occupied) {
+      int slot = __builtin_ctzll(occupied);
+      occupied &= occupied - 1;
+      for (timer_wheel_node_t* node = wheel->heads[level][slot]; node != NULL;
+           node = node->next)
+        cb(node, context);
+    }
+  }
+}
+
+void timer_wheel_get_stats(const timer_wheel_t* wheel,
+                           timer_wheel_stats_t* stats) {
+  CHECK(wheel != NULL);
+  CHECK(stats != NULL);
+
+  stats->count = wheel->count;
+  stats->now_ms = wheel->now_ms;
+  stats->cascaded_count = wheel->cascaded_count;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    stats->levels[level].entries = wheel->level_count[level];
+    stats->levels[level].occupied_slots =
+        __builtin_popcountll(wheel->occupied[level]);
+  }
+}
+
+// Appends |node| to the slot matching its deadline relative to the wheel's
+// current time. Deadlines in the past are stored in the current slot.
+static void link_node(timer_wheel_t* wheel, timer_wheel_node_t* node) {
+  uint64_t deadline_ms = node->deadline_ms;
+  if (deadline_ms < wheel->now_ms) deadline_ms = wheel->now_ms;
+
+  uint64_t diff = deadline_ms ^ wheel->now_ms;
+  int level = diff ? (63 - __builtin_clzll(diff)) / TIMER_WHEEL_SLOT_BITS : 0;
+  int slot = (deadline_ms >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK;
+
+  node->level = level;
+  node->slot = slot;
+  node->next = NULL;
+  node->prev = wheel->tails[level][slot];
+  if (node->prev)
+    node->prev->next = node;
+  else
+    wheel->heads[level][slot] = node;
+  wheel->tails[level][slot] = node;
+
+  wheel->occupied[level] |= (1ULL << slot);
+  wheel->level_count[level]++;
+}
+
+static void unlink_node(timer_wheel_t* wheel, timer_wheel_node_t* node) {
+  int level = node->level;
+  int slot = node->slot;
+
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    wheel->heads[level][slot] = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    wheel->tails[level][slot] = node->prev;
+  node->prev = NULL;
+  node->next = NULL;
+
+  if (wheel->heads[level][slot] == NULL)
+    wheel->occupied[level] &= ~(1ULL << slot);
+  wheel->level_count[level]--;
+}
+
+// Moves the wheel's current time forward to |now_ms|, but never past the
+// earliest pending deadline. Only the slot that the new time falls into can
+// hold nodes that now belong to a lower level, so one slot per level is
+// re-distributed.
+static void advance(timer_wheel_t* wheel, uint64_t now_ms) {
+  if (wheel->first && wheel->first->deadline_ms < now_ms)
+    now_ms = wheel->first->deadline_ms;
+  if (now_ms <= wheel->now_ms) return;
+
+  wheel->now_ms = now_ms;
+  for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+    int slot = (now_ms >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK;
+    timer_wheel_node_t* node = wheel->heads[level][slot];
+    if (node == NULL) continue;
+
+    wheel->heads[level][slot] = NULL;
+    wheel->tails[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ULL << slot);
+    while (node != NULL) {
+      timer_wheel_node_t* next = node->next;
+      wheel->level_count[level]--;
+      link_node(wheel, node);
+      wheel->cascaded_count++;
+      node = next;
+    }
+  }
+}
+
+// The earliest node is in the lowest occupied slot of the lowest occupied
+// level. Slots above level 0 cover a range of deadlines, so that slot is
+// scanned; among equal deadlines the first inserted one wins.
+static timer_wheel_node_t* find_first(const timer_wheel_t* wheel) {
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    if (wheel->occupied[level] == 0) continue;
+
+    int slot = __builtin_ctzll(wheel->occupied[level]);
+    timer_wheel_node_t* first = wheel->heads[level][slot];
+    for (timer_wheel_node_t* node = first->next; node != NULL;
+         node = node->next) {
+      if (node->deadline_ms < first->deadline_ms) first = node;
+    }
+    return first;
+  }
+  return NULL;
+}
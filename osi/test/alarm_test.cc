@@ -19,6 +19,9 @@
 #include <base/message_loop/message_loop.h>
 #include <base/run_loop.h>
 #include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <string>
 
 #include "AlarmTestHarness.h"
 
@@ -358,3 +361,36 @@ TEST_F(AlarmTest, test_delete_during_callback) {
   }
   alarm_cleanup();
 }
+
+TEST_F(AlarmTest, test_debug_dump_sorted_by_deadline) {
+  // Deadlines on different levels of the timer wheel, set out of order
+  const uint64_t interval_ms[] = {60000, 100, 5000, 100000, 1000};
+  const char* names[] = {"alarm_test.dump_4", "alarm_test.dump_0",
+                         "alarm_test.dump_2", "alarm_test.dump_5",
+                         "alarm_test.dump_1"};
+  alarm_t* alarms[5];
+  for (int i = 0; i < 5; i++) {
+    alarms[i] = alarm_new(names[i]);
+    alarm_set(alarms[i], interval_ms[i], cb, NULL);
+  }
+
+  FILE* dump = tmpfile();
+  alarm_debug_dump(fileno(dump));
+  rewind(dump);
+  std::string contents;
+  char buf[256];
+  while (fgets(buf, sizeof(buf), dump)) contents += buf;
+  fclose(dump);
+
+  size_t pos = 0;
+  for (const char* name : {"alarm_test.dump_0", "alarm_test.dump_1",
+                           "alarm_test.dump_2", "alarm_test.dump_4",
+                           "alarm_test.dump_5"}) {
+    size_t found = contents.find(name);
+    ASSERT_NE(std::string::npos, found) << contents;
+    EXPECT_LT(pos, found) << name << " out of order in\n" << contents;
+    pos = found;
+  }
+
+  for (int i = 0; i < 5; i++) alarm_free(alarms[i]);
+}
@@ -195,3 +195,115 @@ TEST_F(ConfigTest, checksum_save) {
 
   EXPECT_TRUE(base::PathExists(file_path));
 }
+
+TEST_F(ConfigTest, config_index_tracks_remove_and_readd) {
+  std::unique_ptr<config_t> config = config_new_empty();
+  config_set_string(config.get(), "A", "key", "1");
+  config_set_string(config.get(), "B", "key", "2");
+  config_set_string(config.get(), "A", "other", "3");
+
+  EXPECT_TRUE(config_remove_key(config.get(), "A", "key"));
+  EXPECT_FALSE(config_has_key(*config, "A", "key"));
+  EXPECT_FALSE(config_remove_key(config.get(), "A", "key"));
+  EXPECT_TRUE(config_has_key(*config, "A", "other"));
+
+  EXPECT_TRUE(config_remove_section(config.get(), "A"));
+  EXPECT_FALSE(config_has_section(*config, "A"));
+  EXPECT_FALSE(config_has_key(*config, "A", "other"));
+
+  // Re-adding a removed section and key goes through the index again
+  config_set_string(config.get(), "A", "key", "4");
+  EXPECT_EQ(config_get_int(*config, "A", "key", 0), 4);
+  config_set_int(config.get(), "A", "key", 5);
+  EXPECT_EQ(config_get_int(*config, "A", "key", 0), 5);
+  EXPECT_EQ(config->sections.back().entries.size(), 1u);
+
+  // Removing through an iterator keeps the index in sync as well
+  auto it = config_remove_section(config.get(), config->sections.begin());
+  EXPECT_EQ(it->name, "A");
+  EXPECT_FALSE(config_has_section(*config, "B"));
+  EXPECT_TRUE(config_has_section(*config, "A"));
+}
+
+TEST_F(ConfigTest, config_save_keeps_insertion_order) {
+  std::unique_ptr<config_t> config = config_new_empty();
+  config_set_string(config.get(), "Z", "b", "1");
+  config_set_string(config.get(), "M", "x", "2");
+  config_set_string(config.get(), "Z", "a", "3");
+  config_set_string(config.get(), "A", "k", "4");
+  config_set_string(config.get(), "Z", "b", "5");
+  EXPECT_TRUE(config_save(*config, CONFIG_FILE));
+
+  std::string content;
+  EXPECT_TRUE(base::ReadFileToString(base::FilePath(CONFIG_FILE), &content));
+  EXPECT_EQ(content,
+            "[Z]\nb = 5\na = 3\n\n"
+            "[M]\nx = 2\n\n"
+            "[A]\nk = 4\n\n");
+
+  std::unique_ptr<config_t> loaded = config_new(CONFIG_FILE);
+  ASSERT_TRUE(loaded.get() != NULL);
+  EXPECT_EQ(loaded->sections.front().name, "Z");
+  EXPECT_EQ(config_get_int(*loaded, "Z", "a", 0), 3);
+}
+
+TEST_F(ConfigTest, config_dirty_tracks_changes) {
+  std::unique_ptr<config_t> config = config_new(CONFIG_FILE);
+  ASSERT_TRUE(config.get() != NULL);
+  EXPECT_FALSE(config->dirty);
+
+  // Writing a value that is already there is not a change
+  config_set_string(config.get(), "DID", "version", "0x1436");
+  EXPECT_FALSE(config->dirty);
+
+  config_set_string(config.get(), "DID", "version", "0x1437");
+  EXPECT_TRUE(config->dirty);
+
+  config->dirty = false;
+  EXPECT_FALSE(config_remove_key(config.get(), "DID", "missing"));
+  EXPECT_FALSE(config->dirty);
+  EXPECT_TRUE(config_remove_key(config.get(), "DID", "version"));
+  EXPECT_TRUE(config->dirty);
+
+  config->dirty = false;
+  EXPECT_TRUE(config_remove_section(config.get(), "DID"));
+  EXPECT_TRUE(config->dirty);
+}
+
+static bool skip_section_b(const section_t& section) {
+  return section.name != "B";
+}
+
+TEST_F(ConfigTest, config_serialize_matches_save) {
+  std::unique_ptr<config_t> config = config_new(CONFIG_FILE);
+  ASSERT_TRUE(config.get() != NULL);
+  EXPECT_TRUE(config_save(*config, CONFIG_FILE));
+
+  std::string content;
+  EXPECT_TRUE(base::ReadFileToString(base::FilePath(CONFIG_FILE), &content));
+  EXPECT_EQ(config_serialize(config.get(), NULL), content);
+
+  EXPECT_TRUE(config_save_buffer(content, CONFIG_FILE));
+  std::unique_ptr<config_t> loaded = config_new(CONFIG_FILE);
+  ASSERT_TRUE(loaded.get() != NULL);
+  EXPECT_EQ(config_serialize(loaded.get(), NULL), content);
+}
+
+TEST_F(ConfigTest, config_serialize_refreshes_changed_sections) {
+  std::unique_ptr<config_t> config = config_new_empty();
+  config_set_string(config.get(), "A", "key", "1");
+  config_set_string(config.get(), "B", "key", "2");
+  config_set_string(config.get(), "C", "key", "3");
+
+  EXPECT_EQ(config_serialize(config.get(), NULL),
+            "[A]\nkey = 1\n\n[B]\nkey = 2\n\n[C]\nkey = 3\n\n");
+  EXPECT_FALSE(config->sections.front().dirty);
+
+  config_set_string(config.get(), "A", "key", "4");
+  config_remove_key(config.get(), "C", "key");
+  config_set_string(config.get(), "D", "key", "5");
+  EXPECT_EQ(config_serialize(config.get(), skip_section_b),
+            "[A]\nkey = 4\n\n[C]\n\n[D]\nkey = 5\n\n");
+  EXPECT_EQ(config_serialize(config.get(), NULL),
+            "[A]\nkey = 4\n\n[B]\nkey = 2\n\n[C]\n\n[D]\nkey = 5\n\n");
+}
@@ -348,3 +348,131 @@ TEST_F(FixedQueueTest, test_fixed_queue_register_dequeue) {
   thread_free(worker_thread);
   fixed_queue_free(queue, NULL);
 }
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_new_free) {
+  // A ring must have some capacity, and not more than the maximum
+  EXPECT_TRUE(fixed_queue_new_ring(0) == NULL);
+  EXPECT_TRUE(fixed_queue_new_ring(FIXED_QUEUE_RING_MAX_CAPACITY + 1) == NULL);
+
+  // The capacity is rounded up to a power of two
+  fixed_queue_t* queue = fixed_queue_new_ring(TEST_QUEUE_SIZE);
+  ASSERT_TRUE(queue != NULL);
+  EXPECT_EQ(16u, fixed_queue_capacity(queue));
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  fixed_queue_free(queue, NULL);
+
+  // Free a non-empty ring with a callback to free entries
+  test_queue_entry_free_counter = 0;
+  queue = fixed_queue_new_ring(TEST_QUEUE_SIZE);
+  ASSERT_TRUE(queue != NULL);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  fixed_queue_free(queue, test_queue_entry_free_cb);
+  EXPECT_EQ(2, test_queue_entry_free_counter);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_enqueue_dequeue) {
+  fixed_queue_t* queue = fixed_queue_new_ring(4);
+  ASSERT_TRUE(queue != NULL);
+
+  // Elements come out in FIFO order
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING3));
+  EXPECT_EQ(3u, fixed_queue_length(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_try_peek_first(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_dequeue(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING2, fixed_queue_try_dequeue(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING3, fixed_queue_dequeue(queue));
+  EXPECT_TRUE(fixed_queue_try_dequeue(queue) == NULL);
+  EXPECT_TRUE(fixed_queue_try_peek_first(queue) == NULL);
+
+  // A full ring rejects further non-blocking enqueues, across wrap-around
+  for (int round = 0; round < 3; round++) {
+    for (size_t i = 0; i < 4; i++)
+      EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+    EXPECT_FALSE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+    EXPECT_EQ(4u, fixed_queue_length(queue));
+    fixed_queue_flush(queue, NULL);
+    EXPECT_TRUE(fixed_queue_is_empty(queue));
+  }
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_dequeue_fd) {
+  fixed_queue_t* queue = fixed_queue_new_ring(TEST_QUEUE_SIZE);
+  ASSERT_TRUE(queue != NULL);
+
+  int dequeue_fd = fixed_queue_get_dequeue_fd(queue);
+  EXPECT_TRUE(dequeue_fd >= 0);
+  EXPECT_TRUE(dequeue_fd < FD_SETSIZE);
+
+  // The dequeue_fd is readable exactly while the ring is not empty
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  fixed_queue_dequeue(queue);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  fixed_queue_dequeue(queue);
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_register_dequeue) {
+  fixed_queue_t* queue = fixed_queue_new_ring(TEST_QUEUE_SIZE);
+  ASSERT_TRUE(queue != NULL);
+
+  thread_t* worker_thread = thread_new("test_fixed_queue_worker_thread");
+  ASSERT_TRUE(worker_thread != NULL);
+
+  fixed_queue_register_dequeue(queue, thread_get_reactor(worker_thread),
+                               fixed_queue_ready, NULL);
+
+  // Every message must be delivered, even though the fd is only signalled
+  // on the empty to non-empty transition
+  for (int i = 0; i < 100; i++) {
+    received_message_future = future_new();
+    ASSERT_TRUE(received_message_future != NULL);
+    fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+    const char* msg = (const char*)future_await(received_message_future);
+    EXPECT_EQ(DUMMY_DATA_STRING, msg);
+  }
+
+  fixed_queue_unregister_dequeue(queue);
+  thread_free(worker_thread);
+  fixed_queue_free(queue, NULL);
+}
+
+static void ring_producer(void* context) {
+  fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
+  for (size_t i = 1; i <= 10000; i++) fixed_queue_enqueue(queue, (void*)i);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_multiple_producers) {
+  // A small ring forces producers through the blocking slow path
+  fixed_queue_t* queue = fixed_queue_new_ring(8);
+  ASSERT_TRUE(queue != NULL);
+
+  const int kNumProducers = 4;
+  thread_t* producers[kNumProducers];
+  for (int i = 0; i < kNumProducers; i++) {
+    producers[i] = thread_new("test_fixed_queue_ring_producer");
+    ASSERT_TRUE(producers[i] != NULL);
+    thread_post(producers[i], ring_producer, queue);
+  }
+
+  // The length seen while producers race the consumer stays in bounds
+  size_t sum = 0;
+  for (int i = 0; i < kNumProducers * 10000; i++) {
+    sum += (size_t)fixed_queue_dequeue(queue);
+    ASSERT_LE(fixed_queue_length(queue), fixed_queue_capacity(queue));
+  }
+  EXPECT_EQ(kNumProducers * (10000u * 10001u / 2), sum);
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+
+  for (int i = 0; i < kNumProducers; i++) thread_free(producers[i]);
+  fixed_queue_free(queue, NULL);
+}
@@ -0,0 +1,98 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "AllocationTestHarness.h"
+
+#include "osi/include/allocation_tracker.h"
+#include "osi/include/fixed_queue.h"
+#include "osi/include/pool_allocator.h"
+
+class PoolAllocatorTest : public AllocationTestHarness {};
+
+TEST_F(PoolAllocatorTest, test_alloc_free) {
+  static const size_t sizes[] = {0, 1, 48, 64, 200, 1021, 1033, 4112, 8000};
+  std::vector<uint8_t*> buffers;
+  for (size_t size : sizes) {
+    uint8_t* buffer = static_cast<uint8_t*>(allocator_pool.alloc(size));
+    ASSERT_TRUE(buffer != NULL);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer) % sizeof(void*));
+    memset(buffer, 0xa5, size);
+    buffers.push_back(buffer);
+  }
+
+  // All blocks are distinct
+  std::set<uint8_t*> unique(buffers.begin(), buffers.end());
+  EXPECT_EQ(buffers.size(), unique.size());
+
+  for (uint8_t* buffer : buffers) allocator_pool.free(buffer);
+  osi_pool_free(NULL);
+}
+
+TEST_F(PoolAllocatorTest, test_reuses_freed_blocks) {
+  void* first = osi_pool_malloc(600);
+  osi_pool_free(first);
+  void* second = osi_pool_malloc(600);
+  EXPECT_EQ(first, second);
+  osi_pool_free(second);
+}
+
+TEST_F(PoolAllocatorTest, test_leak_is_tracked) {
+  void* buffer = osi_pool_malloc(100);
+  EXPECT_EQ(100u, allocation_tracker_expect_no_allocations());
+  osi_pool_free(buffer);
+  EXPECT_EQ(0u, allocation_tracker_expect_no_allocations());
+}
+
+TEST_F(PoolAllocatorTest, test_many_blocks) {
+  // Enough blocks to go through several slabs and thread cache spills
+  std::vector<void*> buffers;
+  for (int i = 0; i < 1000; i++) buffers.push_back(osi_pool_malloc(1000));
+  std::set<void*> unique(buffers.begin(), buffers.end());
+  EXPECT_EQ(buffers.size(), unique.size());
+  for (void* buffer : buffers) osi_pool_free(buffer);
+}
+
+// Blocks allocated on one thread and freed on another, as on the HCI and
+// A2DP paths
+TEST_F(PoolAllocatorTest, test_cross_thread_free) {
+  static const int num_buffers = 10000;
+  fixed_queue_t* queue = fixed_queue_new(64);
+
+  std::thread consumer([queue]() {
+    for (int i = 0; i < num_buffers; i++) {
+      uint8_t* buffer = static_cast<uint8_t*>(fixed_queue_dequeue(queue));
+      EXPECT_EQ(i & 0xff, buffer[0]);
+      osi_pool_free(buffer);
+    }
+  });
+
+  for (int i = 0; i < num_buffers; i++) {
+    uint8_t* buffer = static_cast<uint8_t*>(osi_pool_malloc(100 + i % 1000));
+    buffer[0] = i & 0xff;
+    fixed_queue_enqueue(queue, buffer);
+  }
+  consumer.join();
+
+  fixed_queue_free(queue, NULL);
+}
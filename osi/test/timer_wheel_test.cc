@@ -0,0 +1,188 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "AllocationTestHarness.h"
+
+#include "osi/include/timer_wheel.h"
+
+class TimerWheelTest : public AllocationTestHarness {};
+
+TEST_F(TimerWheelTest, test_new_free_empty) {
+  timer_wheel_t* wheel = timer_wheel_new(1000);
+  ASSERT_TRUE(wheel != NULL);
+  EXPECT_EQ(0u, timer_wheel_length(wheel));
+  EXPECT_TRUE(timer_wheel_first(wheel) == NULL);
+  timer_wheel_free(wheel);
+
+  timer_wheel_free(NULL);
+}
+
+TEST_F(TimerWheelTest, test_insert_remove) {
+  timer_wheel_t* wheel = timer_wheel_new(0);
+  timer_wheel_node_t a = {}, b = {}, c = {};
+
+  EXPECT_FALSE(timer_wheel_node_is_pending(&a));
+  timer_wheel_insert(wheel, &a, 5000, 0);
+  timer_wheel_insert(wheel, &b, 10, 0);
+  timer_wheel_insert(wheel, &c, 1000000, 0);
+  EXPECT_TRUE(timer_wheel_node_is_pending(&a));
+  EXPECT_EQ(3u, timer_wheel_length(wheel));
+  EXPECT_EQ(&b, timer_wheel_first(wheel));
+
+  timer_wheel_remove(wheel, &b);
+  EXPECT_FALSE(timer_wheel_node_is_pending(&b));
+  EXPECT_EQ(&a, timer_wheel_first(wheel));
+
+  // Removing a node that is not pending is a no-op
+  timer_wheel_remove(wheel, &b);
+  EXPECT_EQ(2u, timer_wheel_length(wheel));
+
+  timer_wheel_remove(wheel, &a);
+  EXPECT_EQ(&c, timer_wheel_first(wheel));
+  timer_wheel_remove(wheel, &c);
+  EXPECT_TRUE(timer_wheel_first(wheel) == NULL);
+  EXPECT_EQ(0u, timer_wheel_length(wheel));
+
+  timer_wheel_free(wheel);
+}
+
+TEST_F(TimerWheelTest, test_equal_deadlines_are_fifo) {
+  timer_wheel_t* wheel = timer_wheel_new(0);
+  timer_wheel_node_t nodes[4] = {};
+
+  // Insert while time advances so that the nodes sit on different levels
+  for (int i = 0; i < 4; i++)
+    timer_wheel_insert(wheel, &nodes[i], 100000, i * 30000);
+
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(&nodes[i], timer_wheel_first(wheel));
+    timer_wheel_remove(wheel, &nodes[i]);
+  }
+
+  timer_wheel_free(wheel);
+}
+
+TEST_F(TimerWheelTest, test_deadline_in_the_past) {
+  timer_wheel_t* wheel = timer_wheel_new(0);
+  timer_wheel_node_t late = {}, early = {};
+
+  timer_wheel_insert(wheel, &late, 2000, 1000);
+  timer_wheel_insert(wheel, &early, 500, 1000);
+  EXPECT_EQ(&early, timer_wheel_first(wheel));
+  EXPECT_EQ(500u, timer_wheel_first(wheel)->deadline_ms);
+
+  timer_wheel_remove(wheel, &early);
+  timer_wheel_remove(wheel, &late);
+  timer_wheel_free(wheel);
+}
+
+TEST_F(TimerWheelTest, test_stats_and_foreach) {
+  timer_wheel_t* wheel = timer_wheel_new(0);
+  timer_wheel_node_t nodes[3] = {};
+
+  timer_wheel_insert(wheel, &nodes[0], 1, 0);
+  timer_wheel_insert(wheel, &nodes[1], 2, 0);
+  timer_wheel_insert(wheel, &nodes[2], TIMER_WHEEL_SLOTS, 0);
+
+  timer_wheel_stats_t stats;
+  timer_wheel_get_stats(wheel, &stats);
+  EXPECT_EQ(3u, stats.count);
+  EXPECT_EQ(2u, stats.levels[0].entries);
+  EXPECT_EQ(2u, stats.levels[0].occupied_slots);
+  EXPECT_EQ(1u, stats.levels[1].entries);
+  EXPECT_EQ(1u, stats.levels[1].occupied_slots);
+
+  int visited = 0;
+  timer_wheel_foreach(wheel,
+                      [](timer_wheel_node_t* node, void* context) {
+                        (*static_cast<int*>(context))++;
+                      },
+                      &visited);
+  EXPECT_EQ(3, visited);
+
+  for (int i = 0; i < 3; i++) timer_wheel_remove(wheel, &nodes[i]);
+  timer_wheel_free(wheel);
+}
+
+// Drives the wheel and a sorted reference with the same random operations,
+// including expiring the earliest node the way the alarm dispatcher does.
+TEST_F(TimerWheelTest, test_matches_sorted_reference) {
+  const size_t kNumNodes = 2000;
+  std::mt19937_64 rng(42);
+  std::vector<timer_wheel_node_t> nodes(kNumNodes);
+  std::multimap<uint64_t, size_t> reference;
+  std::vector<std::multimap<uint64_t, size_t>::iterator> positions(
+      kNumNodes, reference.end());
+
+  uint64_t now_ms = 123456789;
+  timer_wheel_t* wheel = timer_wheel_new(now_ms);
+  for (int op = 0; op < 200000; op++) {
+    size_t i = rng() % kNumNodes;
+    timer_wheel_node_t* node = &nodes[i];
+    switch (rng() % 4) {
+      case 0:
+      case 1:
+        if (timer_wheel_node_is_pending(node)) {
+          timer_wheel_remove(wheel, node);
+          reference.erase(positions[i]);
+        }
+        {
+          // Mostly short timeouts, occasionally very long ones
+          uint64_t timeout_ms = (rng() % 8 == 0) ? rng() % (1ULL << 40)
+                                                 : rng() % 10000;
+          timer_wheel_insert(wheel, node, now_ms + timeout_ms, now_ms);
+          positions[i] = reference.emplace(now_ms + timeout_ms, i);
+        }
+        break;
+      case 2:
+        if (timer_wheel_node_is_pending(node)) {
+          timer_wheel_remove(wheel, node);
+          reference.erase(positions[i]);
+        }
+        break;
+      case 3:
+        now_ms += rng() % 200;
+        while (!reference.empty() && reference.begin()->first <= now_ms) {
+          timer_wheel_node_t* first = timer_wheel_first(wheel);
+          ASSERT_TRUE(first != NULL);
+          ASSERT_EQ(reference.begin()->first, first->deadline_ms);
+          ASSERT_EQ(&nodes[reference.begin()->second], first);
+          timer_wheel_remove(wheel, first);
+          reference.erase(reference.begin());
+        }
+        break;
+    }
+
+    ASSERT_EQ(reference.size(), timer_wheel_length(wheel));
+    if (reference.empty()) {
+      ASSERT_TRUE(timer_wheel_first(wheel) == NULL);
+    } else {
+      ASSERT_EQ(reference.begin()->first,
+                timer_wheel_first(wheel)->deadline_ms);
+    }
+  }
+
+  for (size_t i = 0; i < kNumNodes; i++) timer_wheel_remove(wheel, &nodes[i]);
+  timer_wheel_free(wheel);
+}
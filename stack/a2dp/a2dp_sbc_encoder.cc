@@ -26,7 +26,6 @@
 #include <string.h>
 
 #include "a2dp_sbc.h"
-#include "a2dp_sbc_up_sample.h"
 #include "bt_common.h"
 #include "common/time_util.h"
 #include "embdrv/sbc/encoder/include/sbc_encoder.h"
@@ -98,7 +97,6 @@
 
 typedef struct {
   uint32_t aa_frame_counter;
-  int32_t aa_feed_counter;
   int32_t aa_feed_residue;
   uint32_t counter;
   uint32_t bytes_per_tick; /* pcm bytes read each media task tick */
@@ -623,161 +621,35 @@ static void a2dp_sbc_encode_frames(uint8_t nb_frame) {
   }
 }
 
+/* The feeding sampling rate is the SBC sampling frequency: the audio HAL
+ * opens its stream with the codec configuration, so no resampling is
+ * needed here */
 static bool a2dp_sbc_read_feeding(uint32_t* bytes_read) {
   SBC_ENC_PARAMS* p_encoder_params = &a2dp_sbc_encoder_cb.sbc_encoder_params;
   uint16_t blocm_x_subband =
       p_encoder_params->s16NumOfSubBands * p_encoder_params->s16NumOfBlocks;
-  uint32_t read_size;
-  uint32_t sbc_sampling = 48000;
-  uint32_t src_samples;
   uint16_t bytes_needed = blocm_x_subband * p_encoder_params->s16NumOfChannels *
                           a2dp_sbc_encoder_cb.feeding_params.bits_per_sample /
                           8;
-  static uint16_t up_sampled_buffer[SBC_MAX_NUM_FRAME * SBC_MAX_NUM_OF_BLOCKS *
-                                    SBC_MAX_NUM_OF_CHANNELS *
-                                    SBC_MAX_NUM_OF_SUBBANDS * 2];
-  static uint16_t read_buffer[SBC_MAX_NUM_FRAME * SBC_MAX_NUM_OF_BLOCKS *
-                              SBC_MAX_NUM_OF_CHANNELS *
-                              SBC_MAX_NUM_OF_SUBBANDS];
-  uint32_t src_size_used;
-  uint32_t dst_size_used;
-  bool fract_needed;
-  int32_t fract_max;
-  int32_t fract_threshold;
+  uint32_t read_size =
+      bytes_needed - a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue;
   uint32_t nb_byte_read;
 
-  /* Get the SBC sampling rate */
-  switch (p_encoder_params->s16SamplingFreq) {
-    case SBC_sf48000:
-      sbc_sampling = 48000;
-      break;
-    case SBC_sf44100:
-      sbc_sampling = 44100;
-      break;
-    case SBC_sf32000:
-      sbc_sampling = 32000;
-      break;
-    case SBC_sf16000:
-      sbc_sampling = 16000;
-      break;
-  }
-
   a2dp_sbc_encoder_cb.stats.media_read_total_expected_reads_count++;
-  if (sbc_sampling == a2dp_sbc_encoder_cb.feeding_params.sample_rate) {
-    read_size =
-        bytes_needed - a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue;
-    a2dp_sbc_encoder_cb.stats.media_read_total_expected_read_bytes += read_size;
-    nb_byte_read = a2dp_sbc_encoder_cb.read_callback(
-        ((uint8_t*)a2dp_sbc_encoder_cb.pcmBuffer) +
-            a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue,
-        read_size);
-    a2dp_sbc_encoder_cb.stats.media_read_total_actual_read_bytes +=
-        nb_byte_read;
-
-    *bytes_read = nb_byte_read;
-    if (nb_byte_read != read_size) {
-      a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue += nb_byte_read;
-      return false;
-    }
-    a2dp_sbc_encoder_cb.stats.media_read_total_actual_reads_count++;
-    a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue = 0;
-    return true;
-  }
-
-  /*
-   * Some Feeding PCM frequencies require to split the number of sample
-   * to read.
-   * E.g 128 / 6 = 21.3333 => read 22 and 21 and 21 => max = 2; threshold = 0
-   */
-  fract_needed = false; /* Default */
-  switch (a2dp_sbc_encoder_cb.feeding_params.sample_rate) {
-    case 32000:
-    case 8000:
-      fract_needed = true;
-      fract_max = 2;       /* 0, 1 and 2 */
-      fract_threshold = 0; /* Add one for the first */
-      break;
-    case 16000:
-      fract_needed = true;
-      fract_max = 2;       /* 0, 1 and 2 */
-      fract_threshold = 1; /* Add one for the first two frames*/
-      break;
-  }
-
-  /* Compute number of sample to read from source */
-  src_samples = blocm_x_subband;
-  src_samples *= a2dp_sbc_encoder_cb.feeding_params.sample_rate;
-  src_samples /= sbc_sampling;
-
-  /* The previous division may have a remainder not null */
-  if (fract_needed) {
-    if (a2dp_sbc_encoder_cb.feeding_state.aa_feed_counter <= fract_threshold) {
-      src_samples++; /* for every read before threshold add one sample */
-    }
-
-    /* do nothing if counter >= threshold */
-    a2dp_sbc_encoder_cb.feeding_state.aa_feed_counter++; /* one more read */
-    if (a2dp_sbc_encoder_cb.feeding_state.aa_feed_counter > fract_max) {
-      a2dp_sbc_encoder_cb.feeding_state.aa_feed_counter = 0;
-    }
-  }
-
-  /* Compute number of bytes to read from source */
-  read_size = src_samples;
-  read_size *= a2dp_sbc_encoder_cb.feeding_params.channel_count;
-  read_size *= (a2dp_sbc_encoder_cb.feeding_params.bits_per_sample / 8);
   a2dp_sbc_encoder_cb.stats.media_read_total_expected_read_bytes += read_size;
-
-  /* Read Data from UIPC channel */
-  nb_byte_read =
-      a2dp_sbc_encoder_cb.read_callback((uint8_t*)read_buffer, read_size);
-  a2dp_sbc_encoder_cb.stats.media_read_total_actual_read_bytes += nb_byte_read;
-
-  if (nb_byte_read < read_size) {
-    if (nb_byte_read == 0) return false;
-
-    /* Fill the unfilled part of the read buffer with silence (0) */
-    memset(((uint8_t*)read_buffer) + nb_byte_read, 0, read_size - nb_byte_read);
-    nb_byte_read = read_size;
-  }
-  a2dp_sbc_encoder_cb.stats.media_read_total_actual_reads_count++;
-
-  /* Initialize PCM up-sampling engine */
-  a2dp_sbc_init_up_sample(a2dp_sbc_encoder_cb.feeding_params.sample_rate,
-                          sbc_sampling,
-                          a2dp_sbc_encoder_cb.feeding_params.bits_per_sample,
-                          a2dp_sbc_encoder_cb.feeding_params.channel_count);
-
-  /*
-   * Re-sample the read buffer.
-   * The output PCM buffer will be stereo, 16 bit per sample.
-   */
-  dst_size_used = a2dp_sbc_up_sample(
-      (uint8_t*)read_buffer,
-      (uint8_t*)up_sampled_buffer +
+  nb_byte_read = a2dp_sbc_encoder_cb.read_callback(
+      ((uint8_t*)a2dp_sbc_encoder_cb.pcmBuffer) +
           a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue,
-      nb_byte_read, sizeof(up_sampled_buffer) -
-                        a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue,
-      &src_size_used);
-
-  /* update the residue */
-  a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue += dst_size_used;
+      read_size);
+  a2dp_sbc_encoder_cb.stats.media_read_total_actual_read_bytes += nb_byte_read;
 
-  /* only copy the pcm sample when we have up-sampled enough PCM */
-  if (a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue < bytes_needed)
+  *bytes_read = nb_byte_read;
+  if (nb_byte_read != read_size) {
+    a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue += nb_byte_read;
     return false;
-
-  /* Copy the output pcm samples in SBC encoding buffer */
-  memcpy((uint8_t*)a2dp_sbc_encoder_cb.pcmBuffer, (uint8_t*)up_sampled_buffer,
-         bytes_needed);
-  /* update the residue */
-  a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue -= bytes_needed;
-
-  if (a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue != 0) {
-    memcpy((uint8_t*)up_sampled_buffer,
-           (uint8_t*)up_sampled_buffer + bytes_needed,
-           a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue);
   }
+  a2dp_sbc_encoder_cb.stats.media_read_total_actual_reads_count++;
+  a2dp_sbc_encoder_cb.feeding_state.aa_feed_residue = 0;
   return true;
 }
 
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Looks up every security device record by address and by ACL handle, as
+// HCI events do on connection heavy workloads, through the index and through
+// the linear scan of the list it replaced.
+
+#include <benchmark/benchmark.h>
+#include <vector>
+
+#include "device/include/controller.h"
+#include "osi/include/allocator.h"
+#include "osi/include/list.h"
+#include "stack/btm/btm_int.h"
+
+using ::benchmark::State;
+
+tBTM_CB btm_cb;
+
+// Dependencies of btm_dev.cc that are not exercised here
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+tBTM_INQ_INFO* BTM_InqDbRead(const RawAddress& p_bda) { return NULL; }
+uint16_t BTM_GetHCIConnHandle(const RawAddress& remote_bda,
+                              tBT_TRANSPORT transport) {
+  return BTM_SEC_INVALID_HANDLE;
+}
+bool BTM_IsAclConnectionUp(const RawAddress& remote_bda,
+                           tBT_TRANSPORT transport) {
+  return false;
+}
+void btm_sec_clear_ble_keys(tBTM_SEC_DEV_REC* p_dev_rec) {}
+tBTM_STATUS BTM_DeleteStoredLinkKey(const RawAddress* bd_addr,
+                                    tBTM_CMPL_CB* p_cb) {
+  return BTM_SUCCESS;
+}
+const controller_t* controller_get_interface() { return NULL; }
+bool btm_is_sco_active_by_bdaddr(const RawAddress& remote_bda) {
+  return false;
+}
+bool btm_ble_addr_resolvable(const RawAddress& rpa,
+                             tBTM_SEC_DEV_REC* p_dev_rec) {
+  return false;
+}
+
+static RawAddress make_address(int index) {
+  RawAddress address;
+  uint8_t octets[] = {0x00, 0x11, 0x22, (uint8_t)(index >> 16),
+                      (uint8_t)(index >> 8), (uint8_t)index};
+  address.FromOctets(octets);
+  return address;
+}
+
+static tBTM_SEC_DEV_REC* linear_find_by_address(const RawAddress& bd_addr) {
+  list_node_t* end = list_end(btm_cb.sec_dev_rec);
+  for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+       node = list_next(node)) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+    if (p_dev_rec->bd_addr == bd_addr ||
+        p_dev_rec->ble.pseudo_addr == bd_addr)
+      return p_dev_rec;
+  }
+  return NULL;
+}
+
+static tBTM_SEC_DEV_REC* linear_find_by_handle(uint16_t handle) {
+  list_node_t* end = list_end(btm_cb.sec_dev_rec);
+  for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+       node = list_next(node)) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+    if (p_dev_rec->hci_handle == handle || p_dev_rec->ble_hci_handle == handle)
+      return p_dev_rec;
+  }
+  return NULL;
+}
+
+static void BM_BtmFindDev(State& state, bool indexed) {
+  int num_devices = state.range(0);
+  btm_cb.sec_dev_rec = list_new(osi_free);
+  std::vector<RawAddress> addresses;
+  for (int i = 0; i < num_devices; i++) {
+    tBTM_SEC_DEV_REC* p_dev_rec = btm_sec_alloc_dev(make_address(i));
+    p_dev_rec->hci_handle = i;
+    btm_dev_index_update(p_dev_rec);
+    addresses.push_back(p_dev_rec->bd_addr);
+  }
+
+  for (auto _ : state) {
+    for (int i = 0; i < num_devices; i++) {
+      if (indexed) {
+        benchmark::DoNotOptimize(btm_find_dev(addresses[i]));
+        benchmark::DoNotOptimize(btm_find_dev_by_handle(i));
+      } else {
+        benchmark::DoNotOptimize(linear_find_by_address(addresses[i]));
+        benchmark::DoNotOptimize(linear_find_by_handle(i));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_devices * 2);
+
+  while (!list_is_empty(btm_cb.sec_dev_rec)) {
+    wipe_secrets_and_remove(
+        static_cast<tBTM_SEC_DEV_REC*>(list_front(btm_cb.sec_dev_rec)));
+  }
+  list_free(btm_cb.sec_dev_rec);
+  btm_cb.sec_dev_rec = NULL;
+}
+
+static void BM_BtmFindDevIndexed(State& state) { BM_BtmFindDev(state, true); }
+BENCHMARK(BM_BtmFindDevIndexed)->RangeMultiplier(4)->Range(16, 256);
+
+static void BM_BtmFindDevLinear(State& state) { BM_BtmFindDev(state, false); }
+BENCHMARK(BM_BtmFindDevLinear)->RangeMultiplier(4)->Range(16, 256);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <vector>
+
+#include "stack/crypto_toolbox/aes.h"
+#include "stack/crypto_toolbox/aes_fast.h"
+#include "stack/crypto_toolbox/crypto_toolbox.h"
+
+using ::benchmark::State;
+
+// Number of blocks per iteration, e.g. one prand checked against as many
+// IRKs when resolving a private address.
+#define NUM_BLOCKS 64
+// Length of the f4() message
+#define F4_MESSAGE_LEN 65
+
+static void fill_pattern(uint8_t* data, size_t length, uint8_t seed) {
+  for (size_t i = 0; i < length; i++) data[i] = seed + i * 29;
+}
+
+// The byte-oriented implementation in aes.cc, used before the engines
+static void BM_Aes128Reference(State& state) {
+  std::vector<uint8_t> keys(NUM_BLOCKS * AES_128_BLOCK_LEN);
+  std::vector<uint8_t> blocks(NUM_BLOCKS * AES_128_BLOCK_LEN);
+  fill_pattern(keys.data(), keys.size(), 1);
+  fill_pattern(blocks.data(), blocks.size(), 2);
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+      aes_context ctx;
+      aes_set_key(&keys[i * AES_128_BLOCK_LEN], AES_128_BLOCK_LEN, &ctx);
+      aes_encrypt(&blocks[i * AES_128_BLOCK_LEN],
+                  &blocks[i * AES_128_BLOCK_LEN], &ctx);
+    }
+    benchmark::DoNotOptimize(blocks[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_BLOCKS);
+}
+BENCHMARK(BM_Aes128Reference);
+
+// Key expansion and encryption of independent blocks, one at a time or all
+// at once.
+static void BM_Aes128Engine(State& state) {
+  crypto_toolbox::aes_engine_t engine =
+      static_cast<crypto_toolbox::aes_engine_t>(state.range(0));
+  bool batched = state.range(1);
+  if (!crypto_toolbox::aes_engine_supported(engine)) {
+    state.SkipWithError("engine not supported on this CPU");
+    return;
+  }
+
+  std::vector<uint8_t> keys(NUM_BLOCKS * AES_128_BLOCK_LEN);
+  std::vector<uint8_t> blocks(NUM_BLOCKS * AES_128_BLOCK_LEN);
+  std::vector<crypto_toolbox::aes_128_key_schedule_t> schedules(NUM_BLOCKS);
+  fill_pattern(keys.data(), keys.size(), 1);
+  fill_pattern(blocks.data(), blocks.size(), 2);
+  for (auto _ : state) {
+    if (batched) {
+      crypto_toolbox::aes_128_set_keys(engine, keys.data(), schedules.data(),
+                                       NUM_BLOCKS);
+      crypto_toolbox::aes_128_encrypt_blocks(engine, schedules.data(),
+                                             blocks.data(), blocks.data(),
+                                             NUM_BLOCKS);
+    } else {
+      for (int i = 0; i < NUM_BLOCKS; i++) {
+        crypto_toolbox::aes_128_set_keys(
+            engine, &keys[i * AES_128_BLOCK_LEN], &schedules[i], 1);
+        crypto_toolbox::aes_128_encrypt_blocks(
+            engine, &schedules[i], &blocks[i * AES_128_BLOCK_LEN],
+            &blocks[i * AES_128_BLOCK_LEN], 1);
+      }
+    }
+    benchmark::DoNotOptimize(blocks[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_BLOCKS);
+}
+BENCHMARK(BM_Aes128Engine)
+    ->Args({crypto_toolbox::AES_ENGINE_TTABLE, false})
+    ->Args({crypto_toolbox::AES_ENGINE_AESNI, false})
+    ->Args({crypto_toolbox::AES_ENGINE_AESNI, true});
+
+// The crypto_toolbox API, including the byte order conversions
+static void BM_Aes128(State& state) {
+  std::vector<Octet16> keys(NUM_BLOCKS), blocks(NUM_BLOCKS);
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    fill_pattern(keys[i].data(), OCTET16_LEN, i);
+    fill_pattern(blocks[i].data(), OCTET16_LEN, i + 1);
+  }
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_BLOCKS; i++)
+      blocks[i] = crypto_toolbox::aes_128(keys[i], blocks[i]);
+    benchmark::DoNotOptimize(blocks[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_BLOCKS);
+}
+BENCHMARK(BM_Aes128);
+
+static void BM_Aes128Batch(State& state) {
+  std::vector<Octet16> keys(NUM_BLOCKS), blocks(NUM_BLOCKS);
+  for (int i = 0; i < NUM_BLOCKS; i++) {
+    fill_pattern(keys[i].data(), OCTET16_LEN, i);
+    fill_pattern(blocks[i].data(), OCTET16_LEN, i + 1);
+  }
+  for (auto _ : state) {
+    crypto_toolbox::aes_128_batch(keys.data(), blocks.data(), blocks.data(),
+                                  NUM_BLOCKS);
+    benchmark::DoNotOptimize(blocks[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_BLOCKS);
+}
+BENCHMARK(BM_Aes128Batch);
+
+static void BM_AesCmac(State& state) {
+  std::vector<Octet16> keys(NUM_BLOCKS), signatures(NUM_BLOCKS);
+  uint8_t message[F4_MESSAGE_LEN];
+  fill_pattern(message, sizeof(message), 3);
+  for (int i = 0; i < NUM_BLOCKS; i++) fill_pattern(keys[i].data(), OCTET16_LEN, i);
+  for (auto _ : state) {
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+      signatures[i] =
+          crypto_toolbox::aes_cmac(keys[i], message, F4_MESSAGE_LEN);
+    }
+    benchmark::DoNotOptimize(signatures[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_BLOCKS);
+}
+BENCHMARK(BM_AesCmac);
+
+static void BM_AesCmacBatch(State& state) {
+  std::vector<Octet16> keys(NUM_BLOCKS), signatures(NUM_BLOCKS);
+  uint8_t message[F4_MESSAGE_LEN];
+  fill_pattern(message, sizeof(message), 3);
+  std::vector<const uint8_t*> messages(NUM_BLOCKS, message);
+  for (int i = 0; i < NUM_BLOCKS; i++) fill_pattern(keys[i].data(), OCTET16_LEN, i);
+  for (auto _ : state) {
+    crypto_toolbox::aes_cmac_batch(keys.data(), messages.data(),
+                                   F4_MESSAGE_LEN, signatures.data(),
+                                   NUM_BLOCKS);
+    benchmark::DoNotOptimize(signatures[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * NUM_BLOCKS);
+}
+BENCHMARK(BM_AesCmacBatch);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+
+#include "stack/btm/btm_int.h"
+#include "stack/gatt/gatt_int.h"
+#include "stack/include/l2c_api.h"
+
+using ::benchmark::State;
+using bluetooth::Uuid;
+
+// Dependencies of gatt_db.cc. Characteristic values and descriptors are
+// owned by the application and never read here.
+tGATT_CB gatt_cb;
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+uint8_t gatt_build_uuid_to_stream_len(const Uuid& uuid) {
+  return uuid.GetShortestRepresentationSize();
+}
+uint8_t gatt_build_uuid_to_stream(uint8_t** p_dst, const Uuid& uuid) {
+  return 0;
+}
+std::list<tGATT_SRV_LIST_ELEM>::iterator gatt_sr_find_i_rcb_by_handle(
+    uint16_t handle) {
+  return gatt_cb.srv_list_info->end();
+}
+uint32_t gatt_sr_enqueue_cmd(tGATT_TCB& tcb, uint8_t op_code,
+                             uint16_t handle) {
+  return 0;
+}
+void gatt_sr_update_cback_cnt(tGATT_TCB& tcb, tGATT_IF gatt_if, bool is_inc,
+                              bool is_reset_first) {}
+void gatt_sr_send_req_callback(uint16_t conn_id, uint32_t trans_id,
+                               uint8_t op_code, tGATTS_DATA* p_data) {}
+bool BTM_GetSecurityFlags(const RawAddress& bd_addr, uint8_t* p_sec_flags) {
+  return false;
+}
+tACL_CONN* btm_bda_to_acl(const RawAddress& bda, tBT_TRANSPORT transport) {
+  return nullptr;
+}
+tBTM_STATUS btm_ble_set_encryption(const RawAddress& bd_addr,
+                                   tBTM_BLE_SEC_ACT sec_act,
+                                   uint8_t link_role) {
+  return BTM_SUCCESS;
+}
+
+// Number of attributes in the server. Each service is a declaration followed
+// by characteristics with a 128 bit UUID value and a client configuration
+// descriptor: one or ten services make 1,000 attributes.
+#define NUM_ATTRIBUTES 1000
+
+static int chars_per_service(int num_services) {
+  return (NUM_ATTRIBUTES / num_services - 1) / 3;
+}
+
+static std::vector<std::unique_ptr<tGATT_SVC_DB>> build_server(
+    int num_services) {
+  std::vector<std::unique_ptr<tGATT_SVC_DB>> services;
+  uint16_t num_handles = 1 + chars_per_service(num_services) * 3;
+  uint16_t s_hdl = 1;
+  for (int i = 0; i < num_services; i++) {
+    std::unique_ptr<tGATT_SVC_DB> db(new tGATT_SVC_DB());
+    gatts_init_service_db(*db, Uuid::From16Bit(0x1800 + i), true, s_hdl,
+                          num_handles);
+    for (int j = 0; j < chars_per_service(num_services); j++) {
+      gatts_add_characteristic(*db, GATT_PERM_READ | GATT_PERM_WRITE,
+                               GATT_CHAR_PROP_BIT_READ |
+                                   GATT_CHAR_PROP_BIT_NOTIFY,
+                               Uuid::From32Bit(0x12340000 + i * 1024 + j));
+      gatts_add_char_descr(*db, GATT_PERM_READ | GATT_PERM_WRITE,
+                           Uuid::From16Bit(GATT_UUID_CHAR_CLIENT_CONFIG));
+    }
+    services.push_back(std::move(db));
+    s_hdl += num_handles;
+  }
+  return services;
+}
+
+// Discovers all characteristics of |db| with Read By Type requests, as a
+// client does, and returns the number found.
+static int discover_characteristics(tGATT_TCB& tcb, tGATT_SVC_DB& db,
+                                    BT_HDR* p_rsp) {
+  const Uuid char_uuid = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
+  uint16_t s_hdl = db.attr_list.front().handle;
+  uint16_t e_hdl = db.end_handle - 1;
+  int found = 0;
+  while (s_hdl <= e_hdl) {
+    p_rsp->len = 2;
+    p_rsp->offset = 0;
+    uint16_t buf_len = tcb.payload_size - 2;
+    uint16_t err_hdl = 0;
+    tGATT_STATUS status = gatts_db_read_attr_value_by_type(
+        tcb, &db, GATT_REQ_READ_BY_TYPE, p_rsp, s_hdl, e_hdl, char_uuid,
+        &buf_len, 0, 0, 0, &err_hdl);
+    if (status != GATT_SUCCESS && status != GATT_NO_RESOURCES) break;
+    if (p_rsp->offset == 0) break;
+
+    // Continue after the last declaration in the response
+    int count = (p_rsp->len - 2) / p_rsp->offset;
+    uint8_t* p = (uint8_t*)(p_rsp + 1) + L2CAP_MIN_OFFSET + 2 +
+                 (count - 1) * p_rsp->offset;
+    uint16_t last_hdl;
+    STREAM_TO_UINT16(last_hdl, p);
+    found += count;
+    s_hdl = last_hdl + 1;
+  }
+  return found;
+}
+
+// Full discovery: all characteristics of all services, then a permission
+// checked read of every attribute handle. Arguments are the MTU and the
+// number of services.
+static void BM_GattDbDiscovery(State& state) {
+  int num_services = state.range(1);
+  auto services = build_server(num_services);
+  tGATT_TCB tcb;
+  tcb.payload_size = state.range(0);
+  std::vector<uint8_t> buffer(sizeof(BT_HDR) + L2CAP_MIN_OFFSET +
+                              GATT_MAX_MTU_SIZE);
+  BT_HDR* p_rsp = reinterpret_cast<BT_HDR*>(buffer.data());
+
+  size_t num_attributes = 0;
+  for (auto& db : services) num_attributes += db->attr_list.size();
+
+  for (auto _ : state) {
+    int found = 0;
+    for (auto& db : services) {
+      found += discover_characteristics(tcb, *db, p_rsp);
+      for (const tGATT_ATTR& attr : db->attr_list) {
+        benchmark::DoNotOptimize(
+            gatts_read_attr_perm_check(db.get(), false, attr.handle, 0, 0));
+      }
+    }
+    if (found != num_services * chars_per_service(num_services)) {
+      state.SkipWithError("discovery missed characteristics");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_attributes);
+}
+BENCHMARK(BM_GattDbDiscovery)
+    ->Args({GATT_DEF_BLE_MTU_SIZE, 1})
+    ->Args({GATT_DEF_BLE_MTU_SIZE, 10})
+    ->Args({GATT_MAX_MTU_SIZE, 1})
+    ->Args({GATT_MAX_MTU_SIZE, 10});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <vector>
+
+#include "l2c_fcs.h"
+#include "l2cdefs.h"
+
+using ::benchmark::State;
+
+// Frame sizes: a minimal S-frame, the default ERTM MPS and the largest MPS
+// used for OBEX over L2CAP.
+#define FRAME_SIZE_ARGS ->Arg(4)->Arg(672)->Arg(1013)->Arg(65535)
+
+static std::vector<uint8_t> make_frame(size_t size) {
+  std::vector<uint8_t> frame(size);
+  for (size_t i = 0; i < size; i++) frame[i] = i * 31 + 7;
+  return frame;
+}
+
+static void BM_FcsBytewise(State& state) {
+  std::vector<uint8_t> frame = make_frame(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(l2c_fcs_calc_bytewise(
+        L2CAP_FCR_INIT_CRC, frame.data(), frame.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+BENCHMARK(BM_FcsBytewise) FRAME_SIZE_ARGS;
+
+static void BM_FcsSlicingBy8(State& state) {
+  std::vector<uint8_t> frame = make_frame(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        l2c_fcs_calc(L2CAP_FCR_INIT_CRC, frame.data(), frame.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+BENCHMARK(BM_FcsSlicingBy8) FRAME_SIZE_ARGS;
+
+BENCHMARK_MAIN();
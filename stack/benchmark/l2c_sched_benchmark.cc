@@ -0,0 +1,326 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Simulates an A2DP stream on one ACL link along with bulk RFCOMM transfers
+// on other links, sharing the ACL buffers of a controller. The controller
+// needs the air time of the 3-DHx packet that fits each buffer, and either
+// polls the links in turn or sends its buffers in the order it got them.
+// The test vendor controller completes every packet as soon as it gets it,
+// so it can't be used to see links contend for buffers.
+//
+// The legacy scheduler gives each link a fixed quota and, on Number Of
+// Completed Packets, only serves the link the packets completed on. The
+// deficit round robin scheduler guarantees the same quotas, lets the low
+// priority links borrow the buffers of idle links and serves all links
+// waiting whenever buffers are freed. The media channel of the A2DP link is
+// set to high priority, which weights both the guaranteed quota and the
+// turns of the link, and keeps its guaranteed quota free for its bursts.
+//
+// When the controller polls the links in turn, the A2DP latency is mostly
+// set by the air time of the links it alternates with. A controller sending
+// in order also shows the bulk packets the host queued ahead of the media.
+//
+// Reported counters: the A2DP packet latency from L2CAP to the air, average
+// and maximum, and the throughput of the bulk transfers.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "l2c_sched.h"
+
+using ::benchmark::State;
+
+namespace {
+
+constexpr int kNumAclBuffers = 8;
+constexpr int kHighPriQuota = 5; /* L2CAP_HIGH_PRI_MIN_XMIT_QUOTA */
+constexpr uint64_t kSlotUs = 625;
+// Controllers report completed packets in batches, and the event crosses
+// the HCI transport: the host sees a buffer freed some time after the air.
+constexpr uint64_t kNocpDelayUs = 10000;
+constexpr uint64_t kSimulatedUs = 10 * 1000 * 1000;
+
+// SBC at 345 kbit/s: a 660 byte media packet every 15 ms. The encoder sends
+// three at a time when it catches up after its timer was delayed.
+constexpr uint16_t kA2dpPacketLen = 660;
+constexpr uint64_t kA2dpIntervalUs = 45000;
+constexpr int kA2dpBurst = 3;
+constexpr uint16_t kBulkPacketLen = 1021;
+
+// 3-DH1, 3-DH3 or 3-DH5 and the slot of the reply
+uint64_t air_time_us(uint16_t len) {
+  if (len <= 367) return 2 * kSlotUs;
+  if (len <= 552) return 4 * kSlotUs;
+  return 6 * kSlotUs;
+}
+
+struct Packet {
+  uint16_t len;
+  uint64_t queued_us;
+  uint64_t sent_us; /* when handed to the controller */
+};
+
+struct Link {
+  bool high_pri = false;
+  bool a2dp = false; /* has the high priority media channel */
+  bool bulk = false;
+  int quota = 0;
+  int min_quota = 0;
+  int sent_not_acked = 0;
+  int32_t deficit = 0;
+  std::deque<Packet> host_q;
+  std::deque<Packet> controller_q;
+};
+
+class Simulation {
+ public:
+  Simulation(int num_bulk_links, int num_idle_links, bool a2dp_high_pri,
+             bool fifo, bool drr)
+      : fifo_(fifo), drr_(drr) {
+    links_.resize(1 + num_bulk_links + num_idle_links);
+    links_[0].high_pri = a2dp_high_pri;
+    links_[0].a2dp = true;
+    for (int i = 1; i <= num_bulk_links; i++) links_[i].bulk = true;
+    AdjustAllocation();
+  }
+
+  void Run() {
+    for (size_t i = 0; i < links_.size(); i++) CheckSendPkts(i);
+    StartAir();
+
+    uint64_t next_a2dp_us = 0;
+    while (now_us_ < kSimulatedUs) {
+      uint64_t next_air_us = (tx_link_ < 0) ? UINT64_MAX : tx_end_us_;
+      uint64_t next_nocp_us =
+          nocp_q_.empty() ? UINT64_MAX : nocp_q_.front().first;
+      if (next_a2dp_us <= std::min(next_air_us, next_nocp_us)) {
+        now_us_ = next_a2dp_us;
+        for (int i = 0; i < kA2dpBurst; i++)
+          links_[0].host_q.push_back({kA2dpPacketLen, now_us_, 0});
+        next_a2dp_us += kA2dpIntervalUs;
+        CheckSendPkts(0);
+      } else if (next_air_us <= next_nocp_us) {
+        now_us_ = next_air_us;
+        AirComplete();
+      } else {
+        now_us_ = next_nocp_us;
+        NumCompletedPackets();
+      }
+      if (tx_link_ < 0) StartAir();
+    }
+  }
+
+  double a2dp_latency_avg_ms() const {
+    return a2dp_sent_ ? a2dp_latency_us_ / 1000.0 / a2dp_sent_ : 0;
+  }
+  double a2dp_latency_max_ms() const { return a2dp_latency_max_us_ / 1000.0; }
+  double bulk_kbps() const { return bulk_bytes_ * 8.0 * 1000 / now_us_; }
+
+ private:
+  // As l2c_link_adjust_allocation(), the A2DP link has a high priority
+  // channel
+  void AdjustAllocation() {
+    int num_high = 0;
+    std::vector<uint8_t> weights;
+    for (const Link& link : links_) {
+      if (link.high_pri)
+        num_high++;
+      else
+        weights.push_back(Weight(link));
+    }
+    int low_quota = kNumAclBuffers - num_high * kHighPriQuota;
+    std::vector<uint16_t> quotas(weights.size());
+    l2c_sched_split_quota(weights.data(), quotas.data(), weights.size(),
+                          low_quota);
+    size_t low_index = 0;
+    for (Link& link : links_) {
+      if (link.high_pri) {
+        link.quota = link.min_quota = kHighPriQuota;
+      } else {
+        link.min_quota = quotas[low_index++];
+        link.quota = drr_ ? low_quota : link.min_quota;
+      }
+    }
+  }
+
+  // The legacy scheduler splits the buffers evenly
+  uint8_t Weight(const Link& link) const {
+    return (drr_ && link.a2dp) ? L2C_SCHED_HIGH_PRI_CHNL_WEIGHT : 1;
+  }
+
+  bool HasData(const Link& link) const {
+    return link.bulk || !link.host_q.empty();
+  }
+
+  void SendToLower(int index) {
+    Link& link = links_[index];
+    Packet packet = {kBulkPacketLen, now_us_, 0};
+    if (!link.host_q.empty()) {
+      packet = link.host_q.front();
+      link.host_q.pop_front();
+    }
+    packet.sent_us = now_us_;
+    l2c_sched_charge(&link.deficit, packet.len);
+    link.sent_not_acked++;
+    window_--;
+    link.controller_q.push_back(packet);
+  }
+
+  void CheckSendPkts(int index) {
+    if (drr_) {
+      SchedXmit();
+      return;
+    }
+
+    // The legacy l2c_link_check_send_pkts() for a link in quota mode
+    Link& link = links_[index];
+    while (window_ > 0 && link.sent_not_acked < link.quota && HasData(link))
+      SendToLower(index);
+  }
+
+  // As l2c_link_xmit_reserve()
+  int Reserve() const {
+    int reserve = 0;
+    for (const Link& link : links_) {
+      if (link.sent_not_acked >= link.min_quota) continue;
+      reserve += ((link.high_pri || link.a2dp) && HasData(link))
+                     ? link.min_quota - link.sent_not_acked
+                     : 1;
+    }
+    return reserve;
+  }
+
+  // As l2c_link_sched_xmit()
+  void SchedXmit() {
+    std::vector<tL2C_SCHED_FLOW> flows(links_.size());
+    while (window_ > 0) {
+      int reserve = Reserve();
+      for (size_t i = 0; i < links_.size(); i++) {
+        Link& link = links_[i];
+        flows[i].p_deficit = &link.deficit;
+        flows[i].quantum = 0;
+        if (!HasData(link)) continue;
+        if (link.sent_not_acked >= link.min_quota &&
+            (link.sent_not_acked >= link.quota || window_ <= reserve))
+          continue;
+        flows[i].quantum = l2c_sched_link_quantum(link.high_pri, link.a2dp);
+      }
+      int serve = l2c_sched_select(flows.data(), flows.size(), &turn_);
+      if (serve < 0) break;
+      SendToLower(serve);
+    }
+  }
+
+  // The controller polls the links with data in turn, or sends the packet
+  // it got first
+  void StartAir() {
+    uint64_t first_us = UINT64_MAX;
+    for (size_t i = 1; i <= links_.size(); i++) {
+      int index = (air_turn_ + i) % links_.size();
+      const std::deque<Packet>& controller_q = links_[index].controller_q;
+      if (controller_q.empty() || controller_q.front().sent_us >= first_us)
+        continue;
+      tx_link_ = index;
+      if (!fifo_) break;
+      first_us = controller_q.front().sent_us;
+    }
+    if (tx_link_ < 0) return;
+    air_turn_ = tx_link_;
+    tx_end_us_ =
+        now_us_ + air_time_us(links_[tx_link_].controller_q.front().len);
+  }
+
+  void AirComplete() {
+    Link& link = links_[tx_link_];
+    Packet packet = link.controller_q.front();
+    link.controller_q.pop_front();
+    if (link.bulk) {
+      bulk_bytes_ += packet.len;
+    } else {
+      uint64_t latency_us = now_us_ - packet.queued_us;
+      a2dp_latency_us_ += latency_us;
+      a2dp_latency_max_us_ = std::max(a2dp_latency_max_us_, latency_us);
+      a2dp_sent_++;
+    }
+    nocp_q_.push_back({now_us_ + kNocpDelayUs, tx_link_});
+    tx_link_ = -1;
+  }
+
+  void NumCompletedPackets() {
+    int index = nocp_q_.front().second;
+    nocp_q_.pop_front();
+    links_[index].sent_not_acked--;
+    window_++;
+    CheckSendPkts(index);
+  }
+
+  bool fifo_;
+  bool drr_;
+  std::vector<Link> links_;
+  int window_ = kNumAclBuffers;
+  uint8_t turn_ = 0;
+  uint64_t now_us_ = 0;
+  int tx_link_ = -1;
+  int air_turn_ = 0;
+  uint64_t tx_end_us_ = 0;
+  std::deque<std::pair<uint64_t, int>> nocp_q_;
+  uint64_t a2dp_latency_us_ = 0;
+  uint64_t a2dp_latency_max_us_ = 0;
+  uint64_t a2dp_sent_ = 0;
+  uint64_t bulk_bytes_ = 0;
+};
+
+void run_simulation(State& state, bool drr) {
+  Simulation* p_sim = nullptr;
+  for (auto _ : state) {
+    delete p_sim;
+    p_sim = new Simulation(state.range(0), state.range(1), state.range(2),
+                           state.range(3), drr);
+    p_sim->Run();
+  }
+  state.counters["a2dp_avg_ms"] = p_sim->a2dp_latency_avg_ms();
+  state.counters["a2dp_max_ms"] = p_sim->a2dp_latency_max_ms();
+  state.counters["bulk_kbps"] = p_sim->bulk_kbps();
+  delete p_sim;
+}
+
+}  // namespace
+
+// Arguments: links with a bulk transfer, idle links, A2DP link high priority,
+// controller sending in order
+static void scenario_args(benchmark::internal::Benchmark* b) {
+  const std::vector<std::vector<int64_t>> scenarios = {
+      {1, 0, 1}, {2, 0, 1}, {1, 1, 1}, {1, 0, 0},
+      {2, 0, 0}, {3, 0, 0}, {1, 1, 0}, {1, 2, 0}};
+  for (int fifo = 0; fifo < 2; fifo++) {
+    for (std::vector<int64_t> args : scenarios) {
+      args.push_back(fifo);
+      b->Args(args);
+    }
+  }
+  b->Unit(benchmark::kMillisecond);
+}
+
+static void BM_AclSchedLegacy(State& state) { run_simulation(state, false); }
+BENCHMARK(BM_AclSchedLegacy)->Apply(scenario_args);
+
+static void BM_AclSchedDrr(State& state) { run_simulation(state, true); }
+BENCHMARK(BM_AclSchedDrr)->Apply(scenario_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <string.h>
+
+#include "p_256_ecc_pp.h"
+
+using ::benchmark::State;
+
+// Private key and peer public key of sample 1 in Bluetooth Core Specification
+// Version 5.0 | Vol 2, Part G | 7.1.2
+static const uint32_t private_key[KEY_LENGTH_DWORDS_P256] = {
+    0xcd3c1abd, 0x5899b8a6, 0xeb40b799, 0x4aff607b,
+    0xd2103f50, 0x74c9b3e3, 0xa3c55f38, 0x3f49f6d4};
+static const uint32_t peer_x[KEY_LENGTH_DWORDS_P256] = {
+    0x2faaa190, 0x559077b2, 0x8615a69f, 0x47b58afd,
+    0xf19e4c00, 0x09592284, 0x1faf1d96, 0x1ea1f0f0};
+static const uint32_t peer_y[KEY_LENGTH_DWORDS_P256] = {
+    0x15b1214a, 0x5f89aff9, 0xe28e3676, 0x472d1130,
+    0x9ab85160, 0x7356703a, 0x429dad37, 0x4c55f33e};
+
+static Point peer_public_key() {
+  Point p;
+  memcpy(p.x, peer_x, sizeof(p.x));
+  memcpy(p.y, peer_y, sizeof(p.y));
+  multiprecision_init(p.z, KEY_LENGTH_DWORDS_P256);
+  p.z[0] = 1;
+  return p;
+}
+
+// Local public key generation, as in smp_process_private_key()
+static void BM_PublicKeyBinNaf(State& state) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  for (auto _ : state) {
+    Point q;
+    uint32_t n[KEY_LENGTH_DWORDS_P256];
+    memcpy(n, private_key, sizeof(n));
+    ECC_PointMult_Bin_NAF(&q, &curve_p256.G, n, KEY_LENGTH_DWORDS_P256);
+    benchmark::DoNotOptimize(q.x[0]);
+  }
+}
+BENCHMARK(BM_PublicKeyBinNaf);
+
+static void BM_PublicKeyP256(State& state) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  for (auto _ : state) {
+    Point q;
+    ECC_PointMult_P256(&q, &curve_p256.G, private_key);
+    benchmark::DoNotOptimize(q.x[0]);
+  }
+}
+BENCHMARK(BM_PublicKeyP256);
+
+// DHKey computation, as in smp_compute_dhkey()
+static void BM_DhKeyBinNaf(State& state) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  Point peer = peer_public_key();
+  for (auto _ : state) {
+    Point q;
+    uint32_t n[KEY_LENGTH_DWORDS_P256];
+    memcpy(n, private_key, sizeof(n));
+    ECC_PointMult_Bin_NAF(&q, &peer, n, KEY_LENGTH_DWORDS_P256);
+    benchmark::DoNotOptimize(q.x[0]);
+  }
+}
+BENCHMARK(BM_DhKeyBinNaf);
+
+static void BM_DhKeyP256(State& state) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  Point peer = peer_public_key();
+  for (auto _ : state) {
+    Point q;
+    ECC_PointMult_P256(&q, &peer, private_key);
+    benchmark::DoNotOptimize(q.x[0]);
+  }
+}
+BENCHMARK(BM_DhKeyP256);
+
+BENCHMARK_MAIN();
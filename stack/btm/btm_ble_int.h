@@ -138,6 +138,9 @@ extern void btm_gen_non_resolvable_private_addr(tBTM_BLE_ADDR_CBACK* p_cback,
                                                 void* p);
 extern tBTM_SEC_DEV_REC* btm_ble_resolve_random_addr(
     const RawAddress& random_bda);
+extern tBTM_SEC_DEV_REC* btm_ble_rpa_cache_resolve(const RawAddress& rpa);
+extern void btm_ble_rpa_cache_flush(void);
+extern void btm_ble_rpa_cache_debug_dump(int fd);
 extern void btm_gen_resolve_paddr_low(const RawAddress& address);
 
 /*  privacy function */
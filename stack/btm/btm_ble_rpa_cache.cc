@@ -0,0 +1,228 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the resolvable private address (RPA) resolution engine
+ *  used for advertising reports and incoming connections.
+ *
+ *  Resolving an RPA means computing ah(IRK, prand) for the IRK of every
+ *  bonded LE device. Peers keep the same RPA for several minutes and
+ *  advertise many times per second, so the outcome is cached per RPA in an
+ *  LRU. On a miss, all IRKs are evaluated in batches with
+ *  crypto_toolbox::aes_128_batch().
+ *
+ *  A cache entry holds the first record, in |btm_cb.sec_dev_rec| order,
+ *  whose IRK matches the RPA, or NULL if no IRK matches. Entries stay valid
+ *  while the set of records and their IRKs is unchanged: code removing a
+ *  record or storing a new IRK must call |btm_ble_rpa_cache_flush|.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bt_types.h"
+#include "btm_ble_int.h"
+#include "btm_int.h"
+#include "stack/crypto_toolbox/crypto_toolbox.h"
+
+/* Number of RPAs remembered, resolved or not */
+#define BTM_BLE_RPA_CACHE_SIZE 256
+/* Number of IRKs evaluated per call into the AES engine on a miss */
+#define BTM_BLE_RPA_IRK_BATCH 32
+
+struct RpaHash {
+  std::size_t operator()(const RawAddress& x) const {
+    const uint8_t* a = x.address;
+    return a[0] ^ (a[1] << 8) ^ (a[2] << 16) ^ (a[3] << 24) ^ a[4] ^
+           (a[5] << 8);
+  }
+};
+
+typedef std::list<std::pair<RawAddress, tBTM_SEC_DEV_REC*>> RpaLruList;
+
+static RpaLruList rpa_lru;
+static std::unordered_map<RawAddress, RpaLruList::iterator, RpaHash>
+    rpa_cache;
+
+/* Statistics, read from the dumpsys thread */
+static std::atomic<uint64_t> rpa_cache_hits(0);
+static std::atomic<uint64_t> rpa_cache_misses(0);
+static std::atomic<uint64_t> rpa_cache_evictions(0);
+static std::atomic<uint64_t> rpa_cache_flushes(0);
+static std::atomic<uint64_t> rpa_irks_evaluated(0);
+static std::atomic<size_t> rpa_cache_entries(0);
+
+static bool rpa_has_irk(const tBTM_SEC_DEV_REC* p_dev_rec) {
+  return p_dev_rec->ble.key_type & BTM_LE_KEY_PID;
+}
+
+/* A record is used for resolution only if it is an LE device with an IRK */
+static bool rpa_can_resolve(const tBTM_SEC_DEV_REC* p_dev_rec) {
+  return (p_dev_rec->device_type & BT_DEVICE_TYPE_BLE) &&
+         rpa_has_irk(p_dev_rec);
+}
+
+/* Evaluates the IRK of every record against |rpa|, in list order. Returns the
+ * first record that can resolve |rpa|; |*p_first_match| is set to the first
+ * record whose IRK matches, which may be a record that is not an LE device. */
+static tBTM_SEC_DEV_REC* rpa_evaluate_irks(const RawAddress& rpa,
+                                           tBTM_SEC_DEV_REC** p_first_match) {
+  static std::vector<tBTM_SEC_DEV_REC*> records;
+  static std::vector<Octet16> irks;
+  static std::vector<Octet16> messages;
+  static std::vector<Octet16> outputs;
+
+  /* prand is the 3 MSB of the address, the hash its 3 LSB */
+  Octet16 prand{0};
+  prand[0] = rpa.address[2];
+  prand[1] = rpa.address[1];
+  prand[2] = rpa.address[0];
+  const uint8_t hash[3] = {rpa.address[5], rpa.address[4], rpa.address[3]};
+
+  *p_first_match = nullptr;
+  list_node_t* end = list_end(btm_cb.sec_dev_rec);
+  list_node_t* node = list_begin(btm_cb.sec_dev_rec);
+  while (node != end) {
+    records.clear();
+    irks.clear();
+    for (; node != end && records.size() < BTM_BLE_RPA_IRK_BATCH;
+         node = list_next(node)) {
+      tBTM_SEC_DEV_REC* p_dev_rec =
+          static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+      if (!rpa_has_irk(p_dev_rec)) continue;
+      records.push_back(p_dev_rec);
+      irks.push_back(p_dev_rec->ble.keys.irk);
+    }
+    if (records.empty()) break;
+
+    messages.assign(records.size(), prand);
+    outputs.resize(records.size());
+    crypto_toolbox::aes_128_batch(irks.data(), messages.data(), outputs.data(),
+                                  records.size());
+    rpa_irks_evaluated += records.size();
+
+    for (size_t i = 0; i < records.size(); i++) {
+      if (memcmp(outputs[i].data(), hash, sizeof(hash)) != 0) continue;
+      if (*p_first_match == nullptr) *p_first_match = records[i];
+      if (rpa_can_resolve(records[i])) return records[i];
+    }
+  }
+  return nullptr;
+}
+
+static void rpa_cache_put(const RawAddress& rpa, tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto it = rpa_cache.find(rpa);
+  if (it != rpa_cache.end()) {
+    it->second->second = p_dev_rec;
+    rpa_lru.splice(rpa_lru.begin(), rpa_lru, it->second);
+    return;
+  }
+
+  if (rpa_cache.size() >= BTM_BLE_RPA_CACHE_SIZE) {
+    rpa_cache.erase(rpa_lru.back().first);
+    rpa_lru.pop_back();
+    rpa_cache_evictions++;
+  }
+  rpa_lru.emplace_front(rpa, p_dev_rec);
+  rpa_cache[rpa] = rpa_lru.begin();
+  rpa_cache_entries = rpa_cache.size();
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_ble_rpa_cache_resolve
+ *
+ * Description      Resolve the random address |rpa| against the IRKs of all
+ *                  security records.
+ *
+ * Returns          The first LE record whose IRK matches |rpa|, or NULL.
+ *
+ ******************************************************************************/
+tBTM_SEC_DEV_REC* btm_ble_rpa_cache_resolve(const RawAddress& rpa) {
+  auto it = rpa_cache.find(rpa);
+  if (it != rpa_cache.end()) {
+    tBTM_SEC_DEV_REC* p_dev_rec = it->second->second;
+    /* If the matching record stopped being an LE device with an IRK, a later
+     * record may match too; look again. */
+    if (p_dev_rec == nullptr || rpa_can_resolve(p_dev_rec)) {
+      rpa_lru.splice(rpa_lru.begin(), rpa_lru, it->second);
+      rpa_cache_hits++;
+      return p_dev_rec;
+    }
+  }
+
+  rpa_cache_misses++;
+  tBTM_SEC_DEV_REC* p_first_match;
+  tBTM_SEC_DEV_REC* p_dev_rec = rpa_evaluate_irks(rpa, &p_first_match);
+  rpa_cache_put(rpa, p_first_match);
+  return p_dev_rec;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_ble_rpa_cache_flush
+ *
+ * Description      Forget all cached resolutions. Must be called whenever a
+ *                  security record is removed or gets a new IRK.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_ble_rpa_cache_flush(void) {
+  if (rpa_cache.empty()) return;
+  rpa_cache.clear();
+  rpa_lru.clear();
+  rpa_cache_entries = 0;
+  rpa_cache_flushes++;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_ble_rpa_cache_debug_dump
+ *
+ * Description      Dump the RPA cache statistics to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_ble_rpa_cache_debug_dump(int fd) {
+  uint64_t hits = rpa_cache_hits;
+  uint64_t misses = rpa_cache_misses;
+  uint64_t lookups = hits + misses;
+
+  dprintf(fd, "\nBluetooth RPA Resolution Cache:\n");
+  dprintf(fd, "  Entries                : %zu / %d\n", rpa_cache_entries.load(),
+          BTM_BLE_RPA_CACHE_SIZE);
+  dprintf(fd, "  Hits                   : %llu (%llu%%)\n",
+          (unsigned long long)hits,
+          (unsigned long long)(lookups ? hits * 100 / lookups : 0));
+  dprintf(fd, "  Misses                 : %llu\n", (unsigned long long)misses);
+  dprintf(fd, "  IRKs evaluated         : %llu\n",
+          (unsigned long long)rpa_irks_evaluated.load());
+  dprintf(fd, "  Evictions              : %llu\n",
+          (unsigned long long)rpa_cache_evictions.load());
+  dprintf(fd, "  Flushes                : %llu\n",
+          (unsigned long long)rpa_cache_flushes.load());
+}
@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <map>
+#include <unordered_map>
 
 #include "bt_common.h"
 #include "bt_types.h"
@@ -37,6 +39,93 @@
 #include "hcimsgs.h"
 #include "l2c_api.h"
 
+/* Index of |btm_cb.sec_dev_rec| by address and by ACL handle. Each bucket
+ * holds the records sharing a key ordered by allocation sequence number, which
+ * is also their order in |btm_cb.sec_dev_rec|, so the first entry of a bucket
+ * is the record a linear search of the list would have found. Code changing
+ * the indexed fields of a record must call |btm_dev_index_update|. */
+struct DevRecKeys {
+  uint64_t seq;
+  RawAddress bd_addr;
+  RawAddress pseudo_addr;
+  uint16_t hci_handle;
+  uint16_t ble_hci_handle;
+};
+
+struct DevRecAddressHash {
+  std::size_t operator()(const RawAddress& x) const {
+    const uint8_t* a = x.address;
+    return a[0] ^ (a[1] << 8) ^ (a[2] << 16) ^ (a[3] << 24) ^ a[4] ^
+           (a[5] << 8);
+  }
+};
+
+typedef std::map<uint64_t, tBTM_SEC_DEV_REC*> DevRecBucket;
+
+static uint64_t dev_rec_seq = 0;
+static std::unordered_map<const tBTM_SEC_DEV_REC*, DevRecKeys> dev_rec_keys;
+static std::unordered_map<RawAddress, DevRecBucket, DevRecAddressHash>
+    dev_rec_by_address;
+static std::unordered_map<uint16_t, DevRecBucket> dev_rec_by_handle;
+
+template <typename Index, typename Key>
+static void dev_rec_bucket_erase(Index* index, const Key& key, uint64_t seq) {
+  auto it = index->find(key);
+  if (it == index->end()) return;
+  it->second.erase(seq);
+  if (it->second.empty()) index->erase(it);
+}
+
+static void dev_rec_index_erase(const DevRecKeys& keys) {
+  dev_rec_bucket_erase(&dev_rec_by_address, keys.bd_addr, keys.seq);
+  dev_rec_bucket_erase(&dev_rec_by_address, keys.pseudo_addr, keys.seq);
+  dev_rec_bucket_erase(&dev_rec_by_handle, keys.hci_handle, keys.seq);
+  dev_rec_bucket_erase(&dev_rec_by_handle, keys.ble_hci_handle, keys.seq);
+}
+
+static void dev_rec_index_insert(tBTM_SEC_DEV_REC* p_dev_rec, uint64_t seq) {
+  DevRecKeys keys = {
+      .seq = seq,
+      .bd_addr = p_dev_rec->bd_addr,
+      .pseudo_addr = p_dev_rec->ble.pseudo_addr,
+      .hci_handle = p_dev_rec->hci_handle,
+      .ble_hci_handle = p_dev_rec->ble_hci_handle,
+  };
+  dev_rec_by_address[keys.bd_addr][seq] = p_dev_rec;
+  dev_rec_by_address[keys.pseudo_addr][seq] = p_dev_rec;
+  dev_rec_by_handle[keys.hci_handle][seq] = p_dev_rec;
+  dev_rec_by_handle[keys.ble_hci_handle][seq] = p_dev_rec;
+  dev_rec_keys[p_dev_rec] = keys;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_dev_index_update
+ *
+ * Description      Re-index a device record after its bd_addr, pseudo_addr,
+ *                  hci_handle or ble_hci_handle changed.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_dev_index_update(tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto it = dev_rec_keys.find(p_dev_rec);
+  if (it == dev_rec_keys.end()) return;
+
+  const DevRecKeys& keys = it->second;
+  if (keys.bd_addr == p_dev_rec->bd_addr &&
+      keys.pseudo_addr == p_dev_rec->ble.pseudo_addr &&
+      keys.hci_handle == p_dev_rec->hci_handle &&
+      keys.ble_hci_handle == p_dev_rec->ble_hci_handle)
+    return;
+
+  // Erase all old keys before inserting the new ones; bd_addr and
+  // pseudo_addr can share a bucket.
+  uint64_t seq = keys.seq;
+  dev_rec_index_erase(keys);
+  dev_rec_index_insert(p_dev_rec, seq);
+}
+
 /*******************************************************************************
  *
  * Function         BTM_SecAddDevice
@@ -73,6 +162,7 @@ bool BTM_SecAddDevice(const RawAddress& bd_addr, DEV_CLASS dev_class,
 
     p_dev_rec->bd_addr = bd_addr;
     p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
+    btm_dev_index_update(p_dev_rec);
 
     /* use default value for background connection params */
     /* update conn params, use default value for background connection params */
@@ -152,6 +242,14 @@ bool BTM_SecAddDevice(const RawAddress& bd_addr, DEV_CLASS dev_class,
 void wipe_secrets_and_remove(tBTM_SEC_DEV_REC* p_dev_rec) {
   p_dev_rec->link_key.fill(0);
   memset(&p_dev_rec->ble.keys, 0, sizeof(tBTM_SEC_BLE_KEYS));
+
+  auto it = dev_rec_keys.find(p_dev_rec);
+  if (it != dev_rec_keys.end()) {
+    dev_rec_index_erase(it->second);
+    dev_rec_keys.erase(it);
+  }
+  btm_ble_rpa_cache_flush();
+
   list_remove(btm_cb.sec_dev_rec, p_dev_rec);
 }
 
@@ -260,6 +358,7 @@ tBTM_SEC_DEV_REC* btm_sec_alloc_dev(const RawAddress& bd_addr) {
 
   p_dev_rec->ble_hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_LE);
   p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
+  btm_dev_index_update(p_dev_rec);
 
   return (p_dev_rec);
 }
@@ -310,16 +409,6 @@ bool btm_dev_support_switch(const RawAddress& bd_addr) {
   return (false);
 }
 
-bool is_handle_equal(void* data, void* context) {
-  tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
-  uint16_t* handle = static_cast<uint16_t*>(context);
-
-  if (p_dev_rec->hci_handle == *handle || p_dev_rec->ble_hci_handle == *handle)
-    return false;
-
-  return true;
-}
-
 /*******************************************************************************
  *
  * Function         btm_find_dev_by_handle
@@ -331,21 +420,24 @@ bool is_handle_equal(void* data, void* context) {
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle) {
-  list_node_t* n = list_foreach(btm_cb.sec_dev_rec, is_handle_equal, &handle);
-  if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
+  auto it = dev_rec_by_handle.find(handle);
+  if (it == dev_rec_by_handle.end()) return NULL;
 
-  return NULL;
+  return it->second.begin()->second;
 }
 
-bool is_address_equal(void* data, void* context) {
-  tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
-  const RawAddress* bd_addr = ((RawAddress*)context);
+struct DevRecResolveSearch {
+  const RawAddress* bd_addr;
+  const tBTM_SEC_DEV_REC* p_match; /* Stop at this record */
+};
 
-  if (p_dev_rec->bd_addr == *bd_addr) return false;
-  // If a LE random address is looking for device record
-  if (p_dev_rec->ble.pseudo_addr == *bd_addr) return false;
+static bool is_address_resolvable(void* data, void* context) {
+  tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
+  const DevRecResolveSearch* search =
+      static_cast<const DevRecResolveSearch*>(context);
 
-  if (btm_ble_addr_resolvable(*bd_addr, p_dev_rec)) return false;
+  if (p_dev_rec == search->p_match) return false;
+  if (btm_ble_addr_resolvable(*search->bd_addr, p_dev_rec)) return false;
   return true;
 }
 
@@ -360,8 +452,18 @@ bool is_address_equal(void* data, void* context) {
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev(const RawAddress& bd_addr) {
+  // Matches on the identity or pseudo (LE random) address come from the index
+  tBTM_SEC_DEV_REC* p_match = NULL;
+  auto it = dev_rec_by_address.find(bd_addr);
+  if (it != dev_rec_by_address.end()) p_match = it->second.begin()->second;
+
+  if (!BTM_BLE_IS_RESOLVE_BDA(bd_addr)) return p_match;
+
+  // A record that resolves a resolvable private address with its IRK wins if
+  // it comes before the match in the list, as in a linear search of the list
+  DevRecResolveSearch search = {.bd_addr = &bd_addr, .p_match = p_match};
   list_node_t* n =
-      list_foreach(btm_cb.sec_dev_rec, is_address_equal, (void*)&bd_addr);
+      list_foreach(btm_cb.sec_dev_rec, is_address_resolvable, &search);
   if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
 
   return NULL;
@@ -408,6 +510,7 @@ void btm_consolidate_dev(tBTM_SEC_DEV_REC* p_target_rec) {
 
       /* remove the combined record */
       wipe_secrets_and_remove(p_dev_rec);
+      btm_dev_index_update(p_target_rec);
       // p_dev_rec gets freed in list_remove, we should not  access it further
       continue;
     }
@@ -514,6 +617,7 @@ tBTM_SEC_DEV_REC* btm_sec_allocate_dev_rec(void) {
   p_dev_rec =
       static_cast<tBTM_SEC_DEV_REC*>(osi_calloc(sizeof(tBTM_SEC_DEV_REC)));
   list_append(btm_cb.sec_dev_rec, p_dev_rec);
+  dev_rec_index_insert(p_dev_rec, dev_rec_seq++);
 
   // Initialize defaults
   p_dev_rec->sec_flags = BTM_SEC_IN_USE;
@@ -100,3 +100,6 @@ void btm_free(void) {
   alarm_free(btm_cb.pairing_timer);
   btm_cb.pairing_timer = NULL;
 }
+
+/** Dump BTM state to |fd| for dumpsys */
+void BTM_DebugDump(int fd) { btm_ble_rpa_cache_debug_dump(fd); }
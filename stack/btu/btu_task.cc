@@ -18,17 +18,24 @@
 
 #define LOG_TAG "bt_btu_task"
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
 #include "bta/sys/bta_sys.h"
 #include "btcore/include/module.h"
 #include "bte.h"
 #include "btif/include/btif_common.h"
 #include "common/message_loop_thread.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "stack/btm/btm_int.h"
 #include "stack/include/btu.h"
 #include "stack/l2cap/l2c_int.h"
@@ -45,6 +52,38 @@ uint8_t btu_trace_level = HCI_INITIAL_TRACE_LEVEL;
 
 static MessageLoopThread main_thread("bt_main_thread");
 
+// Inbound HCI packets are handed to the main thread in batches: the first
+// packet queued while no batch is pending posts a task, and that task only
+// processes the packets queued when it was posted, so that no packet runs
+// ahead of a main thread task posted before it arrived. Packets queued while
+// a task is pending go to the next one, posted once it runs. A batch stops
+// after BTU_HCI_BATCH_MAX_PACKETS packets or once it has run for longer than
+// BTU_HCI_BATCH_BUDGET_US, so that other main thread tasks are not starved;
+// the remaining packets are left for a new task.
+#define BTU_HCI_BATCH_DISPATCH_PROPERTY "persist.bluetooth.hci_batch_dispatch"
+#define BTU_HCI_BATCH_MAX_PACKETS 32
+#define BTU_HCI_BATCH_BUDGET_US 2000
+// Batch sizes are counted in power of two buckets: 1, 2, 3-4, ..., 17-32
+#define BTU_HCI_BATCH_HISTOGRAM_SIZE 6
+
+typedef struct {
+  uint64_t batches;
+  uint64_t packets;
+  uint64_t budget_exceeded;
+  size_t max_pending;
+  uint64_t size_histogram[BTU_HCI_BATCH_HISTOGRAM_SIZE];
+} hci_batch_stats_t;
+
+static std::atomic<bool> hci_batch_dispatch(true);
+static std::mutex hci_batch_mutex;
+static std::vector<BT_HDR*> hci_batch_pending;
+static bool hci_batch_posted = false;
+// Packets at the front of hci_batch_pending for the task posted
+static size_t hci_batch_posted_count = 0;
+static hci_batch_stats_t hci_batch_stats;
+// Only used on the main thread; kept around to reuse its capacity
+static std::vector<BT_HDR*> hci_batch_running;
+
 void btu_hci_msg_process(BT_HDR* p_msg) {
   /* Determine the input message type. */
   switch (p_msg->event & BT_EVT_MASK) {
@@ -77,6 +116,125 @@ void btu_hci_msg_process(BT_HDR* p_msg) {
   }
 }
 
+static size_t hci_batch_histogram_bucket(size_t batch_size) {
+  size_t bucket = 0;
+  while (bucket < BTU_HCI_BATCH_HISTOGRAM_SIZE - 1 &&
+         batch_size > (size_t)1 << bucket) {
+    bucket++;
+  }
+  return bucket;
+}
+
+// Posts a task for the packets pending. Called with hci_batch_mutex held.
+static void btu_hci_msg_post_batch_locked() {
+  hci_batch_posted = true;
+  hci_batch_posted_count = hci_batch_pending.size();
+}
+
+static void btu_hci_msg_process_batch() {
+  {
+    std::lock_guard<std::mutex> lock(hci_batch_mutex);
+    auto end = hci_batch_pending.begin() + hci_batch_posted_count;
+    hci_batch_running.assign(hci_batch_pending.begin(), end);
+    hci_batch_pending.erase(hci_batch_pending.begin(), end);
+    // Packets queued from now on need a new task
+    hci_batch_posted = false;
+    hci_batch_posted_count = 0;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto budget = std::chrono::microseconds(BTU_HCI_BATCH_BUDGET_US);
+  size_t processed = 0;
+  bool budget_exceeded = false;
+  while (processed < hci_batch_running.size() &&
+         processed < BTU_HCI_BATCH_MAX_PACKETS) {
+    btu_hci_msg_process(hci_batch_running[processed++]);
+    if (std::chrono::steady_clock::now() - start > budget) {
+      budget_exceeded = true;
+      break;
+    }
+  }
+
+  bool repost = false;
+  {
+    std::lock_guard<std::mutex> lock(hci_batch_mutex);
+    if (processed < hci_batch_running.size()) {
+      // Keep the leftovers ahead of anything queued in the meantime
+      size_t leftovers = hci_batch_running.size() - processed;
+      hci_batch_pending.insert(hci_batch_pending.begin(),
+                               hci_batch_running.begin() + processed,
+                               hci_batch_running.end());
+      if (hci_batch_posted) hci_batch_posted_count += leftovers;
+    }
+    // Packets queued after this task was posted get a task of their own
+    if (!hci_batch_posted && !hci_batch_pending.empty()) {
+      btu_hci_msg_post_batch_locked();
+      repost = true;
+    }
+    hci_batch_stats.batches++;
+    hci_batch_stats.packets += processed;
+    if (budget_exceeded) hci_batch_stats.budget_exceeded++;
+    hci_batch_stats.size_histogram[hci_batch_histogram_bucket(processed)]++;
+  }
+  hci_batch_running.clear();
+
+  if (repost &&
+      !main_thread.DoInThread(FROM_HERE,
+                              base::BindOnce(&btu_hci_msg_process_batch))) {
+    LOG(ERROR) << __func__ << ": unable to post the rest of the batch";
+    std::lock_guard<std::mutex> lock(hci_batch_mutex);
+    hci_batch_posted = false;
+    hci_batch_posted_count = 0;
+  }
+}
+
+void btu_hci_msg_enqueue(const base::Location& from_here, BT_HDR* p_msg) {
+  if (!hci_batch_dispatch) {
+    if (do_in_main_thread(from_here, base::Bind(&btu_hci_msg_process,
+                                                p_msg)) != BT_STATUS_SUCCESS) {
+      LOG(ERROR) << __func__ << ": do_in_main_thread failed from "
+                 << from_here.ToString();
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(hci_batch_mutex);
+    hci_batch_pending.push_back(p_msg);
+    if (hci_batch_pending.size() > hci_batch_stats.max_pending)
+      hci_batch_stats.max_pending = hci_batch_pending.size();
+    if (hci_batch_posted) return;
+    btu_hci_msg_post_batch_locked();
+  }
+
+  if (do_in_main_thread(from_here,
+                        base::BindOnce(&btu_hci_msg_process_batch)) !=
+      BT_STATUS_SUCCESS) {
+    // The packet stays queued and goes out with the next batch
+    std::lock_guard<std::mutex> lock(hci_batch_mutex);
+    hci_batch_posted = false;
+    hci_batch_posted_count = 0;
+  }
+}
+
+void btu_hci_batch_debug_dump(int fd) {
+  std::lock_guard<std::mutex> lock(hci_batch_mutex);
+  dprintf(fd, "\nHCI Inbound Batch Dispatch:\n");
+  dprintf(fd, "  Enabled: %s\n", hci_batch_dispatch ? "true" : "false");
+  dprintf(fd, "  Batches: %" PRIu64 "\n", hci_batch_stats.batches);
+  dprintf(fd, "  Packets: %" PRIu64 "\n", hci_batch_stats.packets);
+  dprintf(fd, "  Batches cut short by the time budget: %" PRIu64 "\n",
+          hci_batch_stats.budget_exceeded);
+  dprintf(fd, "  Max packets pending: %zu\n", hci_batch_stats.max_pending);
+  dprintf(fd, "  Batch size histogram:\n");
+  for (size_t i = 0; i < BTU_HCI_BATCH_HISTOGRAM_SIZE; i++) {
+    size_t high = (size_t)1 << i;
+    size_t low = (i < 2) ? high : (high / 2 + 1);
+    dprintf(fd, "    %2zu - %2zu : %" PRIu64 "\n", low, high,
+            hci_batch_stats.size_histogram[i]);
+  }
+}
+
 bluetooth::common::MessageLoopThread* get_main_thread() { return &main_thread; }
 
 base::MessageLoop* get_main_message_loop() {
@@ -112,6 +270,9 @@ void btu_task_start_up(UNUSED_ATTR void* context) {
    */
   module_init(get_module(BTE_LOGMSG_MODULE));
 
+  hci_batch_dispatch =
+      osi_property_get_bool(BTU_HCI_BATCH_DISPATCH_PROPERTY, true);
+
   main_thread.StartUp();
   if (!main_thread.IsRunning()) {
     LOG(FATAL) << __func__ << ": unable to start btu message loop thread.";
@@ -129,6 +290,14 @@ void btu_task_shut_down(UNUSED_ATTR void* context) {
   // Shutdown message loop on task completed
   main_thread.ShutDown();
 
+  // Packets whose batch never ran are dropped along with the message loop
+  {
+    std::lock_guard<std::mutex> lock(hci_batch_mutex);
+    for (BT_HDR* p_msg : hci_batch_pending) osi_free(p_msg);
+    hci_batch_pending.clear();
+    hci_batch_posted = false;
+  }
+
   module_clean_up(get_module(BTE_LOGMSG_MODULE));
 
   bta_sys_free();
@@ -22,9 +22,11 @@
  *
  ******************************************************************************/
 
-#include "stack/crypto_toolbox/aes.h"
+#include "stack/crypto_toolbox/aes_fast.h"
 #include "stack/crypto_toolbox/crypto_toolbox.h"
 
+#include <algorithm>
+
 #include <base/logging.h>
 #include <base/strings/string_number_conversions.h>
 
@@ -58,23 +60,41 @@ static void xor_128(Octet16* a, const Octet16& b) {
 }
 }  // namespace
 
+/* Number of blocks set up on the stack per call into the AES engine */
+#define AES_BATCH_CHUNK 8
+
 /* This function computes AES_128(key, message) */
 Octet16 aes_128(const Octet16& key, const Octet16& message) {
-  Octet16 key_reversed;
-  Octet16 message_reversed;
   Octet16 output;
-
-  std::reverse_copy(key.begin(), key.end(), key_reversed.begin());
-  std::reverse_copy(message.begin(), message.end(), message_reversed.begin());
-
-  aes_context ctx;
-  aes_set_key(key_reversed.data(), key_reversed.size(), &ctx);
-  aes_encrypt(message_reversed.data(), output.data(), &ctx);
-
-  std::reverse(output.begin(), output.end());
+  aes_128_batch(&key, &message, &output, 1);
   return output;
 }
 
+void aes_128_batch(const Octet16* keys, const Octet16* messages,
+                   Octet16* outputs, size_t count) {
+  aes_engine_t engine = aes_engine_default();
+  aes_128_key_schedule_t schedules[AES_BATCH_CHUNK];
+  uint8_t keys_reversed[AES_BATCH_CHUNK][OCTET16_LEN];
+  uint8_t blocks[AES_BATCH_CHUNK][OCTET16_LEN];
+
+  for (size_t i = 0; i < count; i += AES_BATCH_CHUNK) {
+    size_t n = std::min(count - i, (size_t)AES_BATCH_CHUNK);
+    for (size_t j = 0; j < n; j++) {
+      /* The engine expects the most significant byte first */
+      std::reverse_copy(keys[i + j].begin(), keys[i + j].end(),
+                        keys_reversed[j]);
+      std::reverse_copy(messages[i + j].begin(), messages[i + j].end(),
+                        blocks[j]);
+    }
+    aes_128_set_keys(engine, keys_reversed[0], schedules, n);
+    aes_128_encrypt_blocks(engine, schedules, blocks[0], blocks[0], n);
+    for (size_t j = 0; j < n; j++) {
+      std::reverse_copy(blocks[j], blocks[j] + OCTET16_LEN,
+                        outputs[i + j].begin());
+    }
+  }
+}
+
 /** utility function to padding the given text to be a 128 bits data. The
  * parameter dest is input and output parameter, it must point to a
  * OCTET16_LEN memory space; where include length bytes valid data. */
@@ -215,4 +235,65 @@ Octet16 aes_cmac(const Octet16& key, const uint8_t* input, uint16_t length) {
   return signature;
 }
 
+/** Doubling in GF(2^128) for the CMAC subkeys, MSB first. */
+static void cmac_double(const uint8_t* in, uint8_t* out) {
+  uint8_t carry = in[0] >> 7;
+  for (int i = 0; i < OCTET16_LEN - 1; i++)
+    out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+  out[OCTET16_LEN - 1] = (in[OCTET16_LEN - 1] << 1) ^ (carry ? 0x87 : 0x00);
+}
+
+void aes_cmac_batch(const Octet16* keys, const uint8_t* const* messages,
+                    uint16_t length, Octet16* signatures, size_t count) {
+  aes_engine_t engine = aes_engine_default();
+  aes_128_key_schedule_t schedules[AES_BATCH_CHUNK];
+  uint8_t keys_reversed[AES_BATCH_CHUNK][OCTET16_LEN];
+  uint8_t subkeys[AES_BATCH_CHUNK][OCTET16_LEN];
+  uint8_t x[AES_BATCH_CHUNK][OCTET16_LEN];
+
+  uint16_t n = (length + OCTET16_LEN - 1) / OCTET16_LEN;
+  if (n == 0) n = 1;
+  bool last_complete = length != 0 && (length % OCTET16_LEN) == 0;
+  uint16_t last_len = length - (n - 1) * OCTET16_LEN;
+
+  for (size_t i = 0; i < count; i += AES_BATCH_CHUNK) {
+    size_t m = std::min(count - i, (size_t)AES_BATCH_CHUNK);
+
+    /* L = AES(K, 0); K1 = 2L; K2 = 4L */
+    for (size_t j = 0; j < m; j++) {
+      std::reverse_copy(keys[i + j].begin(), keys[i + j].end(),
+                        keys_reversed[j]);
+    }
+    aes_128_set_keys(engine, keys_reversed[0], schedules, m);
+    memset(x, 0, sizeof(x));
+    aes_128_encrypt_blocks(engine, schedules, x[0], subkeys[0], m);
+    for (size_t j = 0; j < m; j++) {
+      cmac_double(subkeys[j], subkeys[j]);
+      if (!last_complete) cmac_double(subkeys[j], subkeys[j]);
+    }
+
+    /* The messages are little endian, so block b of the message in the
+     * order AES-CMAC expects ends |b| * 16 bytes before the end of the
+     * buffer. */
+    memset(x, 0, sizeof(x));
+    for (uint16_t b = 0; b < n; b++) {
+      bool last = (b == n - 1);
+      uint16_t block_len = last ? last_len : OCTET16_LEN;
+      for (size_t j = 0; j < m; j++) {
+        const uint8_t* p = messages[i + j] + length - b * OCTET16_LEN;
+        for (uint16_t k = 0; k < block_len; k++) x[j][k] ^= *--p;
+        if (last) {
+          if (!last_complete) x[j][block_len] ^= 0x80;
+          for (int k = 0; k < OCTET16_LEN; k++) x[j][k] ^= subkeys[j][k];
+        }
+      }
+      aes_128_encrypt_blocks(engine, schedules, x[0], x[0], m);
+    }
+
+    for (size_t j = 0; j < m; j++) {
+      std::reverse_copy(x[j], x[j] + OCTET16_LEN, signatures[i + j].begin());
+    }
+  }
+}
+
 }  // namespace crypto_toolbox
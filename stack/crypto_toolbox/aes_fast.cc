@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack/crypto_toolbox/aes_fast.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AES_HAVE_AESNI
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace crypto_toolbox {
+
+namespace {
+
+constexpr uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16,
+};
+
+constexpr uint8_t gf_mul2(uint8_t x) {
+  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+constexpr uint32_t ror32(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+// te[k][x] is the MixColumns column for S-box output x, rotated right by
+// 8 * k bits, so each round is 16 table lookups and XORs.
+struct TTables {
+  uint32_t te[4][256];
+
+  constexpr TTables() : te() {
+    for (int x = 0; x < 256; x++) {
+      uint8_t s = sbox[x];
+      uint8_t s2 = gf_mul2(s);
+      uint8_t s3 = s2 ^ s;
+      uint32_t t = ((uint32_t)s2 << 24) | ((uint32_t)s << 16) |
+                   ((uint32_t)s << 8) | s3;
+      for (int k = 0; k < 4; k++) te[k][x] = k ? ror32(t, 8 * k) : t;
+    }
+  }
+};
+
+constexpr TTables ttables;
+
+inline uint32_t load_be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+inline uint32_t sub_word(uint32_t w) {
+  return ((uint32_t)sbox[w >> 24] << 24) |
+         ((uint32_t)sbox[(w >> 16) & 0xff] << 16) |
+         ((uint32_t)sbox[(w >> 8) & 0xff] << 8) | sbox[w & 0xff];
+}
+
+void ttable_set_key(const uint8_t* key, aes_128_key_schedule_t* schedule) {
+  static const uint8_t rcon[AES_128_ROUNDS] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                                               0x20, 0x40, 0x80, 0x1b, 0x36};
+  uint32_t w[4 * (AES_128_ROUNDS + 1)];
+  for (int i = 0; i < 4; i++) w[i] = load_be32(key + 4 * i);
+  for (int i = 4; i < 4 * (AES_128_ROUNDS + 1); i++) {
+    uint32_t t = w[i - 1];
+    if (i % 4 == 0)
+      t = sub_word((t << 8) | (t >> 24)) ^ ((uint32_t)rcon[i / 4 - 1] << 24);
+    w[i] = w[i - 4] ^ t;
+  }
+  for (int i = 0; i < 4 * (AES_128_ROUNDS + 1); i++)
+    store_be32(&schedule->round_keys[i / 4][4 * (i % 4)], w[i]);
+}
+
+void ttable_encrypt_block(const aes_128_key_schedule_t* schedule,
+                          const uint8_t* in, uint8_t* out) {
+  const uint32_t(*te)[256] = ttables.te;
+  const uint8_t* rk = schedule->round_keys[0];
+
+  uint32_t s0 = load_be32(in) ^ load_be32(rk);
+  uint32_t s1 = load_be32(in + 4) ^ load_be32(rk + 4);
+  uint32_t s2 = load_be32(in + 8) ^ load_be32(rk + 8);
+  uint32_t s3 = load_be32(in + 12) ^ load_be32(rk + 12);
+
+  for (int round = 1; round < AES_128_ROUNDS; round++) {
+    rk = schedule->round_keys[round];
+    uint32_t t0 = te[0][s0 >> 24] ^ te[1][(s1 >> 16) & 0xff] ^
+                  te[2][(s2 >> 8) & 0xff] ^ te[3][s3 & 0xff] ^ load_be32(rk);
+    uint32_t t1 = te[0][s1 >> 24] ^ te[1][(s2 >> 16) & 0xff] ^
+                  te[2][(s3 >> 8) & 0xff] ^ te[3][s0 & 0xff] ^
+                  load_be32(rk + 4);
+    uint32_t t2 = te[0][s2 >> 24] ^ te[1][(s3 >> 16) & 0xff] ^
+                  te[2][(s0 >> 8) & 0xff] ^ te[3][s1 & 0xff] ^
+                  load_be32(rk + 8);
+    uint32_t t3 = te[0][s3 >> 24] ^ te[1][(s0 >> 16) & 0xff] ^
+                  te[2][(s1 >> 8) & 0xff] ^ te[3][s2 & 0xff] ^
+                  load_be32(rk + 12);
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+
+  // The last round has no MixColumns
+  rk = schedule->round_keys[AES_128_ROUNDS];
+  uint32_t s[4] = {s0, s1, s2, s3};
+  for (int c = 0; c < 4; c++) {
+    uint32_t v = ((uint32_t)sbox[s[c] >> 24] << 24) |
+                 ((uint32_t)sbox[(s[(c + 1) % 4] >> 16) & 0xff] << 16) |
+                 ((uint32_t)sbox[(s[(c + 2) % 4] >> 8) & 0xff] << 8) |
+                 sbox[s[(c + 3) % 4] & 0xff];
+    store_be32(out + 4 * c, v ^ load_be32(rk + 4 * c));
+  }
+}
+
+#if defined(AES_HAVE_AESNI)
+
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+
+// AESENC has a latency of several cycles but can issue every cycle, so
+// independent keys and blocks are processed in lockstep.
+#define AESNI_LANES 4
+
+// One step of the key expansion: given round key |k|, returns the next one.
+// SubWord(RotWord(w3)) is computed with AESENCLAST on a vector holding
+// RotWord(w3) in every column, where ShiftRows has no effect; unlike
+// AESKEYGENASSIST this pipelines well across lanes.
+AESNI_TARGET inline __m128i aesni_expand_step(__m128i k, __m128i rcon) {
+  const __m128i rot_w3 =
+      _mm_set_epi8(12, 15, 14, 13, 12, 15, 14, 13, 12, 15, 14, 13, 12, 15, 14,
+                   13);
+  __m128i t = _mm_aesenclast_si128(_mm_shuffle_epi8(k, rot_w3), rcon);
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 8));
+  return _mm_xor_si128(k, t);
+}
+
+AESNI_TARGET void aesni_set_keys(const uint8_t* keys,
+                                 aes_128_key_schedule_t* schedules,
+                                 size_t count) {
+  static const uint8_t rcon[AES_128_ROUNDS] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                                               0x20, 0x40, 0x80, 0x1b, 0x36};
+  size_t i = 0;
+  for (; i + AESNI_LANES <= count; i += AESNI_LANES) {
+    __m128i k[AESNI_LANES];
+    __m128i* rk[AESNI_LANES];
+    for (int l = 0; l < AESNI_LANES; l++) {
+      rk[l] = reinterpret_cast<__m128i*>(schedules[i + l].round_keys);
+      k[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          keys + (i + l) * AES_128_BLOCK_LEN));
+      _mm_store_si128(&rk[l][0], k[l]);
+    }
+    for (int round = 1; round <= AES_128_ROUNDS; round++) {
+      __m128i c = _mm_set1_epi32(rcon[round - 1]);
+      for (int l = 0; l < AESNI_LANES; l++) {
+        k[l] = aesni_expand_step(k[l], c);
+        _mm_store_si128(&rk[l][round], k[l]);
+      }
+    }
+  }
+
+  for (; i < count; i++) {
+    __m128i* rk = reinterpret_cast<__m128i*>(schedules[i].round_keys);
+    __m128i k = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(keys + i * AES_128_BLOCK_LEN));
+    _mm_store_si128(&rk[0], k);
+    for (int round = 1; round <= AES_128_ROUNDS; round++) {
+      k = aesni_expand_step(k, _mm_set1_epi32(rcon[round - 1]));
+      _mm_store_si128(&rk[round], k);
+    }
+  }
+}
+
+AESNI_TARGET void aesni_encrypt_blocks(const aes_128_key_schedule_t* schedules,
+                                       const uint8_t* in, uint8_t* out,
+                                       size_t count) {
+  size_t i = 0;
+  for (; i + AESNI_LANES <= count; i += AESNI_LANES) {
+    const __m128i* rk[AESNI_LANES];
+    __m128i s[AESNI_LANES];
+    for (int l = 0; l < AESNI_LANES; l++) {
+      rk[l] = reinterpret_cast<const __m128i*>(schedules[i + l].round_keys);
+      s[l] = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+              in + (i + l) * AES_128_BLOCK_LEN)),
+          _mm_load_si128(&rk[l][0]));
+    }
+    for (int round = 1; round < AES_128_ROUNDS; round++) {
+      for (int l = 0; l < AESNI_LANES; l++)
+        s[l] = _mm_aesenc_si128(s[l], _mm_load_si128(&rk[l][round]));
+    }
+    for (int l = 0; l < AESNI_LANES; l++) {
+      s[l] = _mm_aesenclast_si128(s[l],
+                                  _mm_load_si128(&rk[l][AES_128_ROUNDS]));
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(out + (i + l) * AES_128_BLOCK_LEN), s[l]);
+    }
+  }
+
+  for (; i < count; i++) {
+    const __m128i* rk =
+        reinterpret_cast<const __m128i*>(schedules[i].round_keys);
+    __m128i s = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                  in + i * AES_128_BLOCK_LEN)),
+                              _mm_load_si128(&rk[0]));
+    for (int round = 1; round < AES_128_ROUNDS; round++)
+      s = _mm_aesenc_si128(s, _mm_load_si128(&rk[round]));
+    s = _mm_aesenclast_si128(s, _mm_load_si128(&rk[AES_128_ROUNDS]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * AES_128_BLOCK_LEN),
+                     s);
+  }
+}
+
+#endif  // AES_HAVE_AESNI
+
+}  // namespace
+
+bool aes_engine_supported(aes_engine_t engine) {
+  switch (engine) {
+    case AES_ENGINE_TTABLE:
+      return true;
+    case AES_ENGINE_AESNI:
+#if defined(AES_HAVE_AESNI)
+      return __builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3");
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+aes_engine_t aes_engine_default() {
+  static const aes_engine_t engine = aes_engine_supported(AES_ENGINE_AESNI)
+                                         ? AES_ENGINE_AESNI
+                                         : AES_ENGINE_TTABLE;
+  return engine;
+}
+
+void aes_128_set_keys(aes_engine_t engine, const uint8_t* keys,
+                      aes_128_key_schedule_t* schedules, size_t count) {
+#if defined(AES_HAVE_AESNI)
+  if (engine == AES_ENGINE_AESNI) {
+    aesni_set_keys(keys, schedules, count);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; i++)
+    ttable_set_key(keys + i * AES_128_BLOCK_LEN, &schedules[i]);
+}
+
+void aes_128_encrypt_blocks(aes_engine_t engine,
+                            const aes_128_key_schedule_t* schedules,
+                            const uint8_t* in, uint8_t* out, size_t count) {
+#if defined(AES_HAVE_AESNI)
+  if (engine == AES_ENGINE_AESNI) {
+    aesni_encrypt_blocks(schedules, in, out, count);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; i++) {
+    ttable_encrypt_block(&schedules[i], in + i * AES_128_BLOCK_LEN,
+                         out + i * AES_128_BLOCK_LEN);
+  }
+}
+
+}  // namespace crypto_toolbox
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// AES-128 encryption engines backing crypto_toolbox::aes_128() and the
+// batched variants. Unlike the crypto_toolbox API, keys and blocks here are
+// in FIPS-197 byte order (most significant byte first).
+
+namespace crypto_toolbox {
+
+#define AES_128_BLOCK_LEN 16
+#define AES_128_ROUNDS 10
+
+typedef struct {
+  alignas(16) uint8_t round_keys[AES_128_ROUNDS + 1][AES_128_BLOCK_LEN];
+} aes_128_key_schedule_t;
+
+typedef enum {
+  // Portable implementation using four 1KB round tables
+  AES_ENGINE_TTABLE,
+  // x86 AES-NI instructions
+  AES_ENGINE_AESNI,
+} aes_engine_t;
+
+// Returns true if |engine| can run on this CPU. AES_ENGINE_TTABLE is always
+// supported.
+bool aes_engine_supported(aes_engine_t engine);
+
+// Returns the fastest supported engine. The CPU is only probed once.
+aes_engine_t aes_engine_default();
+
+// Expands |count| 16 byte keys from |keys| into |schedules|. Like the blocks
+// below, independent keys are expanded in lockstep.
+void aes_128_set_keys(aes_engine_t engine, const uint8_t* keys,
+                      aes_128_key_schedule_t* schedules, size_t count);
+
+// Encrypts |count| independent blocks: block i of |in| is encrypted with
+// |schedules[i]| into block i of |out|. |in| and |out| are |count| * 16
+// bytes long and may be the same buffer. Blocks are interleaved so that
+// engines with pipelined AES instructions keep several in flight.
+void aes_128_encrypt_blocks(aes_engine_t engine,
+                            const aes_128_key_schedule_t* schedules,
+                            const uint8_t* in, uint8_t* out, size_t count);
+
+}  // namespace crypto_toolbox
@@ -34,6 +34,18 @@ extern uint32_t g2(uint8_t* u, uint8_t* v, const Octet16& x, const Octet16& y);
 extern Octet16 ltk_to_link_key(const Octet16& ltk, bool use_h7);
 extern Octet16 link_key_to_ltk(const Octet16& link_key, bool use_h7);
 
+/* Computes |outputs[i]| = aes_128(|keys[i]|, |messages[i]|) for |count|
+ * independent blocks, e.g. the same prand under every known IRK. This is
+ * considerably faster than calling aes_128() in a loop when the CPU has AES
+ * instructions. |outputs| may alias |messages|. */
+extern void aes_128_batch(const Octet16* keys, const Octet16* messages,
+                          Octet16* outputs, size_t count);
+
+/* Computes |signatures[i]| = aes_cmac(|keys[i]|, |messages[i]|, |length|)
+ * for |count| messages of the same length. */
+extern void aes_cmac_batch(const Octet16* keys, const uint8_t* const* messages,
+                           uint16_t length, Octet16* signatures, size_t count);
+
 /* This function computes AES_128(key, message). |key| must be 128bit.
  * |message| can be at most 16 bytes long, it's length in bytes is given in
  * |length| */
@@ -665,6 +665,23 @@ tGATT_STATUS GATTC_Discover(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
                         Uuid::kEmpty);
 }
 
+/*******************************************************************************
+ *
+ * Function         GATTC_GetDiscoveryRequestCount
+ *
+ * Description      This function returns the number of ATT requests sent by
+ *                  discovery procedures on the link of a connection.
+ *
+ * Parameters       conn_id: connection identifier.
+ *
+ * Returns          number of requests, 0 if the connection is unknown.
+ *
+ ******************************************************************************/
+uint32_t GATTC_GetDiscoveryRequestCount(uint16_t conn_id) {
+  tGATT_TCB* p_tcb = gatt_get_tcb_by_idx(GATT_GET_TCB_IDX(conn_id));
+  return p_tcb ? p_tcb->num_disc_req : 0;
+}
+
 /*******************************************************************************
  *
  * Function         GATTC_Read
@@ -121,6 +121,7 @@ void gatt_act_discovery(tGATT_CLCB* p_clcb) {
              size);
   }
 
+  p_clcb->p_tcb->num_disc_req++;
   tGATT_STATUS st = attp_send_cl_msg(*p_clcb->p_tcb, p_clcb, op_code, &cl_req);
   if (st != GATT_SUCCESS && st != GATT_CMD_STARTED) {
     gatt_end_operation(p_clcb, GATT_ERROR, NULL);
@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "btm_int.h"
 #include "gatt_int.h"
 #include "l2c_api.h"
@@ -260,40 +261,52 @@ tGATT_STATUS gatts_db_read_attr_value_by_type(
   uint16_t len = 0;
   uint8_t* p = (uint8_t*)(p_rsp + 1) + p_rsp->len + L2CAP_MIN_OFFSET;
 
+  /* only visit the attributes of the requested type, from s_handle on */
+  const std::vector<uint16_t>* p_indices = nullptr;
   if (p_db) {
-    for (tGATT_ATTR& attr : p_db->attr_list) {
-      if (attr.handle >= s_handle && type == attr.uuid) {
-        if (*p_len <= 2) {
-          status = GATT_NO_RESOURCES;
-          break;
-        }
+    auto it = p_db->attr_by_type.find(type);
+    if (it != p_db->attr_by_type.end()) p_indices = &it->second;
+  }
 
-        UINT16_TO_STREAM(p, attr.handle);
+  if (p_indices) {
+    auto index = std::lower_bound(p_indices->begin(), p_indices->end(),
+                                  s_handle, [p_db](uint16_t i, uint16_t handle) {
+                                    return p_db->attr_list[i].handle < handle;
+                                  });
+    for (; index != p_indices->end(); index++) {
+      tGATT_ATTR& attr = p_db->attr_list[*index];
+      if (attr.handle > e_handle) break;
+
+      if (*p_len <= 2) {
+        status = GATT_NO_RESOURCES;
+        break;
+      }
 
-        status = read_attr_value(attr, 0, &p, false, (uint16_t)(*p_len - 2),
-                                 &len, sec_flag, key_size);
+      UINT16_TO_STREAM(p, attr.handle);
 
-        if (status == GATT_PENDING) {
-          status = gatts_send_app_read_request(tcb, op_code, attr.handle, 0,
-                                               trans_id, attr.gatt_type);
+      status = read_attr_value(attr, 0, &p, false, (uint16_t)(*p_len - 2),
+                               &len, sec_flag, key_size);
 
-          /* one callback at a time */
-          break;
-        } else if (status == GATT_SUCCESS) {
-          if (p_rsp->offset == 0) p_rsp->offset = len + 2;
-
-          if (p_rsp->offset == len + 2) {
-            p_rsp->len += (len + 2);
-            *p_len -= (len + 2);
-          } else {
-            LOG(ERROR) << "format mismatch";
-            status = GATT_NO_RESOURCES;
-            break;
-          }
+      if (status == GATT_PENDING) {
+        status = gatts_send_app_read_request(tcb, op_code, attr.handle, 0,
+                                             trans_id, attr.gatt_type);
+
+        /* one callback at a time */
+        break;
+      } else if (status == GATT_SUCCESS) {
+        if (p_rsp->offset == 0) p_rsp->offset = len + 2;
+
+        if (p_rsp->offset == len + 2) {
+          p_rsp->len += (len + 2);
+          *p_len -= (len + 2);
         } else {
-          *p_cur_handle = attr.handle;
+          LOG(ERROR) << "format mismatch";
+          status = GATT_NO_RESOURCES;
           break;
         }
+      } else {
+        *p_cur_handle = attr.handle;
+        break;
       }
     }
   }
@@ -409,15 +422,22 @@ uint16_t gatts_add_char_descr(tGATT_SVC_DB& db, tGATT_PERM perm,
 /******************************************************************************/
 /* Service Attribute Database Query Utility Functions */
 /******************************************************************************/
+/* Returns the first attribute of |db| whose handle is at least |handle| */
+std::vector<tGATT_ATTR>::iterator gatts_db_lower_bound(tGATT_SVC_DB& db,
+                                                       uint16_t handle) {
+  return std::lower_bound(db.attr_list.begin(), db.attr_list.end(), handle,
+                          [](const tGATT_ATTR& attr, uint16_t handle) {
+                            return attr.handle < handle;
+                          });
+}
+
 tGATT_ATTR* find_attr_by_handle(tGATT_SVC_DB* p_db, uint16_t handle) {
   if (!p_db) return nullptr;
 
-  for (auto& attr : p_db->attr_list) {
-    if (attr.handle == handle) return &attr;
-    if (attr.handle > handle) return nullptr;
-  }
+  auto it = gatts_db_lower_bound(*p_db, handle);
+  if (it == p_db->attr_list.end() || it->handle != handle) return nullptr;
 
-  return nullptr;
+  return &(*it);
 }
 
 /*******************************************************************************
@@ -658,6 +678,9 @@ static tGATT_ATTR& allocate_attr_in_db(tGATT_SVC_DB& db, const Uuid& uuid,
                << ", next_handle = " << +db.next_handle;
   }
 
+  /* handles are allocated in increasing order, which keeps both attr_list
+   * and the per type indices sorted */
+  db.attr_by_type[uuid].push_back(db.attr_list.size());
   db.attr_list.emplace_back();
   tGATT_ATTR& attr = db.attr_list.back();
   attr.handle = db.next_handle++;
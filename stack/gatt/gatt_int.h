@@ -29,6 +29,7 @@
 #include <base/strings/stringprintf.h>
 #include <string.h>
 #include <list>
+#include <map>
 #include <unordered_set>
 #include <vector>
 
@@ -177,7 +178,9 @@ typedef struct {
 /* Service Database definition
 */
 typedef struct {
-  std::vector<tGATT_ATTR> attr_list; /* pointer to the attributes */
+  std::vector<tGATT_ATTR> attr_list; /* attributes, sorted by handle */
+  /* indices into attr_list of the attributes of each type, in handle order */
+  std::map<bluetooth::Uuid, std::vector<uint16_t>> attr_by_type;
   uint16_t end_handle;       /* Last handle number           */
   uint16_t next_handle;      /* Next usable handle value     */
 } tGATT_SVC_DB;
@@ -292,6 +295,8 @@ typedef struct {
   std::queue<tGATT_CMD_Q> cl_cmd_q;
   alarm_t* ind_ack_timer; /* local app confirm to indication timer */
 
+  uint32_t num_disc_req; /* discovery requests sent on this link */
+
   bool in_use;
   uint8_t tcb_idx;
 } tGATT_TCB;
@@ -571,5 +576,8 @@ extern tGATT_STATUS gatts_read_attr_perm_check(tGATT_SVC_DB* p_db, bool is_long,
                                                tGATT_SEC_FLAG sec_flag,
                                                uint8_t key_size);
 extern bluetooth::Uuid* gatts_get_service_uuid(tGATT_SVC_DB* p_db);
+extern tGATT_ATTR* find_attr_by_handle(tGATT_SVC_DB* p_db, uint16_t handle);
+extern std::vector<tGATT_ATTR>::iterator gatts_db_lower_bound(
+    tGATT_SVC_DB& db, uint16_t handle);
 
 #endif
@@ -2068,4 +2068,16 @@ extern void BTM_PCM2Setup_Write(bool clk_master, tBTM_VSC_CMPL_CB* p_arc_cb);
  ******************************************************************************/
 extern tBTM_CONTRL_STATE BTM_PM_ReadControllerState(void);
 
+/*******************************************************************************
+ *
+ * Function         BTM_DebugDump
+ *
+ * Description      Dump the BTM resolvable private address cache statistics
+ *                  to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void BTM_DebugDump(int fd);
+
 #endif /* BTM_API_H */
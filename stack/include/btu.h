@@ -63,6 +63,13 @@ base::MessageLoop* get_main_message_loop();
 bt_status_t do_in_main_thread(const base::Location& from_here,
                               base::OnceClosure task);
 
+/* Queue an inbound HCI packet for btu_hci_msg_process on the main thread.
+ * Packets queued from any thread are processed in order, several per task. */
+void btu_hci_msg_enqueue(const base::Location& from_here, BT_HDR* p_msg);
+
+/* Dump the batch size counters of the inbound HCI dispatch to |fd| */
+void btu_hci_batch_debug_dump(int fd);
+
 void BTU_StartUp(void);
 void BTU_ShutDown(void);
 
@@ -830,6 +830,20 @@ extern tGATT_STATUS GATTC_Discover(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
 extern tGATT_STATUS GATTC_Discover(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
                                    uint16_t start_handle, uint16_t end_handle);
 
+/*******************************************************************************
+ *
+ * Function         GATTC_GetDiscoveryRequestCount
+ *
+ * Description      This function returns the number of ATT requests sent by
+ *                  discovery procedures on the link of a connection.
+ *
+ * Parameters       conn_id: connection identifier.
+ *
+ * Returns          number of requests, 0 if the connection is unknown.
+ *
+ ******************************************************************************/
+extern uint32_t GATTC_GetDiscoveryRequestCount(uint16_t conn_id);
+
 /*******************************************************************************
  *
  * Function         GATTC_Read
@@ -1284,4 +1284,16 @@ extern uint16_t L2CA_GetDisconnectReason(const RawAddress& remote_bda,
 extern void L2CA_AdjustConnectionIntervals(uint16_t* min_interval,
                                            uint16_t* max_interval,
                                            uint16_t floor_interval);
+
+/*******************************************************************************
+ *
+ * Function         L2CA_DebugDump
+ *
+ * Description      Dump the ACL transmit scheduling state of the links and
+ *                  the transmit queue statistics of their channels to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void L2CA_DebugDump(int fd);
 #endif /* L2C_API_H */
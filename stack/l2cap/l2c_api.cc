@@ -2261,3 +2261,65 @@ uint16_t L2CA_FlushChannel(uint16_t lcid, uint16_t num_to_flush) {
 
   return (num_left);
 }
+
+/* Dumps the transmit queue statistics of a channel */
+static void l2c_debug_dump_ccb(int fd, const tL2C_CCB* p_ccb) {
+  const tL2C_SCHED_STATS& stats = p_ccb->sched_stats;
+  uint64_t sent = stats.num_sent ? stats.num_sent : 1;
+
+  dprintf(fd,
+          "    CID 0x%04x  pri: %d  queued: %zu  sent: %u pkts / %llu bytes  "
+          "queue depth avg/max: %llu/%u  wait avg/max: %llu/%u ms\n",
+          p_ccb->local_cid, p_ccb->ccb_priority,
+          fixed_queue_length(p_ccb->xmit_hold_q), stats.num_sent,
+          (unsigned long long)stats.num_bytes,
+          (unsigned long long)(stats.total_queue_depth / sent),
+          stats.max_queue_depth,
+          (unsigned long long)(stats.total_wait_ms / sent), stats.max_wait_ms);
+}
+
+/*******************************************************************************
+ *
+ * Function         L2CA_DebugDump
+ *
+ * Description      Dump the ACL transmit scheduling state of the links and
+ *                  the transmit queue statistics of their channels to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void L2CA_DebugDump(int fd) {
+  dprintf(fd, "\nBluetooth L2CAP ACL Scheduling:\n");
+  dprintf(fd, "  Controller window BR/EDR: %u / %u  LE: %u / %u\n",
+          l2cb.controller_xmit_window, l2cb.num_lm_acl_bufs,
+          l2cb.controller_le_xmit_window, l2cb.num_lm_ble_bufs);
+  dprintf(fd, "  Round robin quota/unacked BR/EDR: %u/%u  LE: %u/%u\n",
+          l2cb.round_robin_quota, l2cb.round_robin_unacked,
+          l2cb.ble_round_robin_quota, l2cb.ble_round_robin_unacked);
+
+  const tL2C_LCB* p_lcb = &l2cb.lcb_pool[0];
+  for (int xx = 0; xx < MAX_L2CAP_LINKS; xx++, p_lcb++) {
+    if (!p_lcb->in_use) continue;
+
+    dprintf(fd,
+            "  Link handle 0x%04x  %s  pri: %s  quota min/max: %u/%u  "
+            "unacked: %u  deficit: %d  link queue: %zu\n",
+            p_lcb->handle,
+            (p_lcb->transport == BT_TRANSPORT_LE) ? "LE" : "BR/EDR",
+            (p_lcb->acl_priority == L2CAP_PRIORITY_HIGH) ? "high" : "normal",
+            p_lcb->link_xmit_min_quota, p_lcb->link_xmit_quota,
+            p_lcb->sent_not_acked, p_lcb->sched_deficit,
+            list_length(p_lcb->link_xmit_data_q));
+
+#if (L2CAP_NUM_FIXED_CHNLS > 0)
+    for (int yy = 0; yy < L2CAP_NUM_FIXED_CHNLS; yy++) {
+      if (p_lcb->p_fixed_ccbs[yy] != NULL)
+        l2c_debug_dump_ccb(fd, p_lcb->p_fixed_ccbs[yy]);
+    }
+#endif
+    for (const tL2C_CCB* p_ccb = p_lcb->ccb_queue.p_first_ccb; p_ccb;
+         p_ccb = p_ccb->p_next_ccb) {
+      l2c_debug_dump_ccb(fd, p_ccb);
+    }
+  }
+}
@@ -801,9 +801,7 @@ void l2c_link_processs_ble_num_bufs(uint16_t num_lm_ble_bufs) {
  *                  to calculate the amount of packets each link may send to
  *                  the HCI without an ack coming back.
  *
- *                  Currently, this is a simple allocation, dividing the
- *                  number of Controller Packets by the number of links. In
- *                  the future, QOS configuration should be examined.
+ *                  As l2c_link_adjust_allocation(), for the LE links.
  *
  * Returns          void
  *
@@ -876,6 +874,7 @@ void l2c_ble_link_adjust_allocation(void) {
     if (p_lcb->in_use && p_lcb->transport == BT_TRANSPORT_LE) {
       if (p_lcb->acl_priority == L2CAP_PRIORITY_HIGH) {
         p_lcb->link_xmit_quota = high_pri_link_quota;
+        p_lcb->link_xmit_min_quota = high_pri_link_quota;
       } else {
         /* Safety check in case we switched to round-robin with something
          * outstanding */
@@ -890,6 +889,12 @@ void l2c_ble_link_adjust_allocation(void) {
           p_lcb->link_xmit_quota++;
           qq_remainder--;
         }
+
+        /* The share of a link is guaranteed, beyond it the link may borrow
+         * the buffers other low priority links don't use */
+        p_lcb->link_xmit_min_quota = p_lcb->link_xmit_quota;
+        if ((qq > 0) && (l2cb.ble_round_robin_quota == 0))
+          p_lcb->link_xmit_quota = low_quota;
       }
 
       L2CAP_TRACE_EVENT(
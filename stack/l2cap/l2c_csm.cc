@@ -1383,18 +1383,12 @@ void l2c_enqueue_peer_data(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
         p_ccb->remote_cid);
   }
   fixed_queue_enqueue(p_ccb->xmit_hold_q, p_buf);
+  l2c_sched_stats_queued(&p_ccb->sched_stats,
+                         fixed_queue_length(p_ccb->xmit_hold_q),
+                         bluetooth::common::time_get_os_boottime_ms());
 
   l2cu_check_channel_congestion(p_ccb);
 
-#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-  /* if new packet is higher priority than serving ccb and it is not overrun */
-  if ((p_ccb->p_lcb->rr_pri > p_ccb->ccb_priority) &&
-      (p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].quota > 0)) {
-    /* send out higher priority packet */
-    p_ccb->p_lcb->rr_pri = p_ccb->ccb_priority;
-  }
-#endif
-
   /* if we are doing a round robin scheduling, set the flag */
   if (p_ccb->p_lcb->link_xmit_quota == 0) l2cb.check_round_robin = true;
 }
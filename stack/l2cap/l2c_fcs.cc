@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the CRC calculation for the L2CAP Frame Check Sequence
+ *  used by ERTM and streaming mode channels.
+ *
+ ******************************************************************************/
+
+#include "l2c_fcs.h"
+
+#define L2C_FCS_POLY_REFLECTED 0xA001
+
+/* Slicing-by-8 tables: fcs_tables.t[0] is the byte-wise look-up table, and
+ * fcs_tables.t[k][i] is the CRC of byte i followed by k zero bytes. They are
+ * derived from the polynomial at compile time. */
+
+struct fcs_tables_t {
+  uint16_t t[8][256];
+
+  constexpr fcs_tables_t() : t() {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc & 1) ? (crc >> 1) ^ L2C_FCS_POLY_REFLECTED : (crc >> 1);
+      t[0][i] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+      for (int i = 0; i < 256; i++)
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+    }
+  }
+};
+
+static constexpr fcs_tables_t fcs_tables;
+
+uint16_t l2c_fcs_calc_bytewise(uint16_t crc, const uint8_t* p, uint16_t len) {
+  const uint16_t* crctab = fcs_tables.t[0];
+
+  while (len--) {
+    crc = ((crc >> 8) & 0xff) ^ crctab[(crc & 0xff) ^ *p++];
+  }
+
+  return crc;
+}
+
+uint16_t l2c_fcs_calc(uint16_t crc, const uint8_t* p, uint16_t len) {
+  const uint16_t(*t)[256] = fcs_tables.t;
+
+  while (len >= 8) {
+    crc = t[7][p[0] ^ (crc & 0xff)] ^ t[6][p[1] ^ (crc >> 8)] ^ t[5][p[2]] ^
+          t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    len -= 8;
+  }
+
+  while (len--) {
+    crc = (crc >> 8) ^ t[0][(crc & 0xff) ^ *p++];
+  }
+
+  return crc;
+}
@@ -0,0 +1,31 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+/* Computes the L2CAP Frame Check Sequence (CRC-16, polynomial
+ * x^16 + x^15 + x^2 + 1, bit reflected) over |len| bytes at |p|, continuing
+ * from |crc|. Use L2CAP_FCR_INIT_CRC to start a new FCS. Processes eight
+ * bytes per step using slicing-by-8 look-up tables. */
+uint16_t l2c_fcs_calc(uint16_t crc, const uint8_t* p, uint16_t len);
+
+/* Same as l2c_fcs_calc(), but processes one byte per step. Kept as the
+ * reference implementation for testing. */
+uint16_t l2c_fcs_calc_bytewise(uint16_t crc, const uint8_t* p, uint16_t len);
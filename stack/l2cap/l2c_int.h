@@ -30,6 +30,7 @@
 #include "btm_api.h"
 #include "btm_ble_api.h"
 #include "l2c_api.h"
+#include "l2c_sched.h"
 #include "l2cdefs.h"
 #include "osi/include/alarm.h"
 #include "osi/include/fixed_queue.h"
@@ -317,6 +318,11 @@ typedef struct t_l2c_ccb {
   tL2CAP_CHNL_DATA_RATE tx_data_rate; /* Channel Tx data rate */
   tL2CAP_CHNL_DATA_RATE rx_data_rate; /* Channel Rx data rate */
 
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+  int32_t sched_deficit; /* Bytes left in this channel's turn on the link */
+#endif
+  tL2C_SCHED_STATS sched_stats; /* Transmit queue statistics */
+
   /* Fields used for eL2CAP */
   tL2CAP_ERTM_INFO ertm_info;
   tL2C_FCRB fcrb;
@@ -356,26 +362,17 @@ typedef struct {
 
 #if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
 
-/* Round-Robin service for the same priority channels */
-#define L2CAP_NUM_CHNL_PRIORITY \
-  3 /* Total number of priority group (high, medium, low)*/
-#define L2CAP_CHNL_PRIORITY_WEIGHT \
-  5 /* weight per priority for burst transmission quota */
-#define L2CAP_GET_PRIORITY_QUOTA(pri) \
-  ((L2CAP_NUM_CHNL_PRIORITY - (pri)) * L2CAP_CHNL_PRIORITY_WEIGHT)
-
-/* CCBs within the same LCB are served in round robin with priority It will make
+/* CCBs within the same LCB are served in weighted deficit round robin, the
+ * weight depending on the channel priority (high, medium, low). It will make
  * sure that low priority channel (for example, HF signaling on RFCOMM) can be
  * sent to the headset even if higher priority channel (for example, AV media
- * channel) is congested.
+ * channel) is congested, and that a channel sending large packets gets no
+ * more than its share of the bytes.
  */
-
-typedef struct {
-  tL2C_CCB* p_serve_ccb; /* current serving ccb within priority group */
-  tL2C_CCB* p_first_ccb; /* first ccb of priority group */
-  uint8_t num_ccb;       /* number of channels in priority group */
-  uint8_t quota;         /* burst transmission quota */
-} tL2C_RR_SERV;
+#define L2CAP_NUM_CHNL_PRIORITY \
+  3 /* Total number of priority group (high, medium, low)*/
+#define L2CAP_GET_PRIORITY_QUANTUM(pri) \
+  ((L2CAP_NUM_CHNL_PRIORITY - (pri)) * L2C_SCHED_QUANTUM)
 
 #endif /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE) */
 
@@ -404,8 +401,9 @@ typedef struct t_l2c_linkcb {
 
   uint16_t link_flush_tout; /* Flush timeout used */
 
-  uint16_t link_xmit_quota; /* Num outstanding pkts allowed */
-  uint16_t sent_not_acked;  /* Num packets sent but not acked */
+  uint16_t link_xmit_quota;     /* Num outstanding pkts allowed */
+  uint16_t link_xmit_min_quota; /* Num outstanding pkts guaranteed */
+  uint16_t sent_not_acked;      /* Num packets sent but not acked */
 
   bool partial_segment_being_sent; /* Set true when a partial segment */
                                    /* is being sent. */
@@ -450,11 +448,9 @@ typedef struct t_l2c_linkcb {
   uint16_t min_ce_len;
   uint16_t max_ce_len;
 
+  int32_t sched_deficit; /* Bytes left in this link's turn on the controller */
 #if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-  /* each priority group is limited burst transmission */
-  /* round robin service for the same priority channels */
-  tL2C_RR_SERV rr_serv[L2CAP_NUM_CHNL_PRIORITY];
-  uint8_t rr_pri; /* current serving priority group */
+  uint8_t sched_ccb_turn; /* Position in ccb_queue of the channel served */
 #endif
 
 } tL2C_LCB;
@@ -468,6 +464,7 @@ typedef struct {
   uint16_t round_robin_quota;   /* Round-robin link quota */
   uint16_t round_robin_unacked; /* Round-robin unacked */
   bool check_round_robin;       /* Do a round robin check */
+  uint8_t sched_link_turn;      /* Index of the link served in quota mode */
 
   bool is_cong_cback_context;
 
@@ -513,6 +510,7 @@ typedef struct {
   uint16_t ble_round_robin_quota;   /* Round-robin link quota */
   uint16_t ble_round_robin_unacked; /* Round-robin unacked */
   bool ble_check_round_robin;       /* Do a round robin check */
+  uint8_t ble_sched_link_turn;      /* Index of the link served in quota mode */
   tL2C_RCB ble_rcb_pool[BLE_MAX_L2CAP_CLIENTS]; /* Registration info pool */
 
   tL2CA_ECHO_DATA_CB* p_echo_data_cb; /* Echo data callback */
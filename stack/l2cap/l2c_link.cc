@@ -45,6 +45,8 @@
 
 static bool l2c_link_send_to_lower(tL2C_LCB* p_lcb, BT_HDR* p_buf,
                                    tL2C_TX_COMPLETE_CB_INFO* p_cbi);
+static void l2c_link_sched_xmit(tBT_TRANSPORT transport,
+                                bool link_queues_only);
 
 /*******************************************************************************
  *
@@ -653,6 +655,38 @@ void l2c_info_resp_timer_timeout(void* data) {
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         l2c_link_has_high_pri_chnl
+ *
+ * Description      Checks if a channel of a link is set to high priority, as
+ *                  the AV channels are. The channels of a link are queued by
+ *                  priority, so only the first one needs to be looked at.
+ *
+ * Returns          true if a channel of the link is high priority
+ *
+ ******************************************************************************/
+static bool l2c_link_has_high_pri_chnl(tL2C_LCB* p_lcb) {
+  return (p_lcb->ccb_queue.p_first_ccb != NULL) &&
+         (p_lcb->ccb_queue.p_first_ccb->ccb_priority ==
+          L2CAP_CHNL_PRIORITY_HIGH);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_link_sched_weight
+ *
+ * Description      Works out the weight of a low priority link for its share
+ *                  of the Controller Packets.
+ *
+ * Returns          the weight of the link
+ *
+ ******************************************************************************/
+static uint8_t l2c_link_sched_weight(tL2C_LCB* p_lcb) {
+  return l2c_link_has_high_pri_chnl(p_lcb) ? L2C_SCHED_HIGH_PRI_CHNL_WEIGHT
+                                           : 1;
+}
+
 /*******************************************************************************
  *
  * Function         l2c_link_adjust_allocation
@@ -661,9 +695,16 @@ void l2c_info_resp_timer_timeout(void* data) {
  *                  to calculate the amount of packets each link may send to
  *                  the HCI without an ack coming back.
  *
- *                  Currently, this is a simple allocation, dividing the
- *                  number of Controller Packets by the number of links. In
- *                  the future, QOS configuration should be examined.
+ *                  High priority links get a fixed quota. Each low priority
+ *                  link is guaranteed a share of the rest of the Controller
+ *                  Packets, weighted by l2c_link_sched_weight(), and may
+ *                  borrow the shares the other low priority links don't use,
+ *                  see l2c_link_sched_xmit(). If there are not enough for
+ *                  each low priority link to have one, they are served in
+ *                  round robin.
+ *
+ *                  It is also called when a channel gets or loses high
+ *                  priority, as that changes the weight of its link.
  *
  * Returns          void
  *
@@ -674,6 +715,8 @@ void l2c_link_adjust_allocation(void) {
   uint16_t hi_quota, low_quota;
   uint16_t num_lowpri_links = 0;
   uint16_t num_hipri_links = 0;
+  uint8_t low_weights[MAX_L2CAP_LINKS];
+  uint16_t low_quotas[MAX_L2CAP_LINKS];
   uint16_t controller_xmit_quota = l2cb.num_lm_acl_bufs;
   uint16_t high_pri_link_quota = L2CAP_HIGH_PRI_MIN_XMIT_QUOTA_A;
   bool is_share_buffer =
@@ -693,7 +736,7 @@ void l2c_link_adjust_allocation(void) {
       if (p_lcb->acl_priority == L2CAP_PRIORITY_HIGH)
         num_hipri_links++;
       else
-        num_lowpri_links++;
+        low_weights[num_lowpri_links++] = l2c_link_sched_weight(p_lcb);
     }
   }
 
@@ -721,6 +764,8 @@ void l2c_link_adjust_allocation(void) {
     l2cb.round_robin_unacked = 0;
     qq = low_quota / num_lowpri_links;
     qq_remainder = low_quota % num_lowpri_links;
+    l2c_sched_split_quota(low_weights, low_quotas, num_lowpri_links,
+                          low_quota);
   }
   /* If no low priority link */
   else {
@@ -735,11 +780,13 @@ void l2c_link_adjust_allocation(void) {
       num_hipri_links, num_lowpri_links, low_quota, l2cb.round_robin_quota, qq);
 
   /* Now, assign the quotas to each link */
+  uint16_t low_index = 0;
   for (yy = 0, p_lcb = &l2cb.lcb_pool[0]; yy < MAX_L2CAP_LINKS; yy++, p_lcb++) {
     if (p_lcb->in_use &&
         (is_share_buffer || p_lcb->transport != BT_TRANSPORT_LE)) {
       if (p_lcb->acl_priority == L2CAP_PRIORITY_HIGH) {
         p_lcb->link_xmit_quota = high_pri_link_quota;
+        p_lcb->link_xmit_min_quota = high_pri_link_quota;
       } else {
         /* Safety check in case we switched to round-robin with something
          * outstanding */
@@ -749,11 +796,20 @@ void l2c_link_adjust_allocation(void) {
         if ((p_lcb->link_xmit_quota > 0) && (qq == 0))
           l2cb.round_robin_unacked += p_lcb->sent_not_acked;
 
-        p_lcb->link_xmit_quota = qq;
-        if (qq_remainder > 0) {
-          p_lcb->link_xmit_quota++;
-          qq_remainder--;
+        if (l2cb.round_robin_quota == 0) {
+          p_lcb->link_xmit_quota = low_quotas[low_index++];
+        } else {
+          p_lcb->link_xmit_quota = qq;
+          if (qq_remainder > 0) {
+            p_lcb->link_xmit_quota++;
+            qq_remainder--;
+          }
         }
+
+        /* The share of a link is guaranteed, beyond it the link may borrow
+         * the buffers other low priority links don't use */
+        p_lcb->link_xmit_min_quota = p_lcb->link_xmit_quota;
+        if (l2cb.round_robin_quota == 0) p_lcb->link_xmit_quota = low_quota;
       }
 
       L2CAP_TRACE_EVENT(
@@ -954,6 +1010,156 @@ bool l2c_link_check_power_mode(tL2C_LCB* p_lcb) {
 }
 #endif /* L2CAP_WAKE_PARKED_LINK == TRUE) */
 
+/*******************************************************************************
+ *
+ * Function         l2c_link_has_queued_data
+ *
+ * Description      Checks if a link has data waiting to be sent, in its link
+ *                  queue or in the hold queue of one of its channels.
+ *
+ * Returns          true if the link has data queued
+ *
+ ******************************************************************************/
+static bool l2c_link_has_queued_data(tL2C_LCB* p_lcb) {
+  if (!list_is_empty(p_lcb->link_xmit_data_q)) return true;
+
+  for (tL2C_CCB* p_ccb = p_lcb->ccb_queue.p_first_ccb; p_ccb != NULL;
+       p_ccb = p_ccb->p_next_ccb) {
+    if (!fixed_queue_is_empty(p_ccb->xmit_hold_q)) return true;
+  }
+  return false;
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_link_xmit_reserve
+ *
+ * Description      Counts the controller buffers of a transport a link may not
+ *                  borrow: the part of their quota the high priority links,
+ *                  and the links with a high priority channel, have not used
+ *                  yet while they have data queued, so that a burst of media
+ *                  finds its buffers. Also one buffer for each other link
+ *                  below its guaranteed share so that it can start sending
+ *                  without waiting for a completion.
+ *
+ * Returns          number of buffers kept
+ *
+ ******************************************************************************/
+static uint16_t l2c_link_xmit_reserve(tBT_TRANSPORT transport) {
+  uint16_t reserve = 0;
+  tL2C_LCB* p_lcb = &l2cb.lcb_pool[0];
+
+  for (int xx = 0; xx < MAX_L2CAP_LINKS; xx++, p_lcb++) {
+    if (!p_lcb->in_use || (p_lcb->transport != transport) ||
+        (p_lcb->link_state != LST_CONNECTED) ||
+        (p_lcb->sent_not_acked >= p_lcb->link_xmit_min_quota))
+      continue;
+
+    if (((p_lcb->acl_priority == L2CAP_PRIORITY_HIGH) ||
+         l2c_link_has_high_pri_chnl(p_lcb)) &&
+        l2c_link_has_queued_data(p_lcb))
+      reserve += p_lcb->link_xmit_min_quota - p_lcb->sent_not_acked;
+    else
+      reserve++;
+  }
+  return reserve;
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_link_sched_xmit
+ *
+ * Description      Shares the controller buffers of a transport between the
+ *                  links that are not in round robin service, in weighted
+ *                  deficit round robin. A link is served while it has credit
+ *                  and pays for the bytes it sends, so a link sending small
+ *                  packets is not starved by a bulk transfer on another link.
+ *                  High priority links, and links with a high priority
+ *                  channel such as the AV media channel, get a larger share.
+ *
+ *                  A link may send up to its guaranteed quota. Beyond it, a
+ *                  low priority link may borrow buffers up to its quota,
+ *                  leaving those counted by l2c_link_xmit_reserve().
+ *
+ *                  If |link_queues_only| is set, only the link queues are
+ *                  served and no data is taken from the channels.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void l2c_link_sched_xmit(tBT_TRANSPORT transport,
+                                bool link_queues_only) {
+  tL2C_SCHED_FLOW flows[MAX_L2CAP_LINKS];
+  bool can_send[MAX_L2CAP_LINKS];
+  uint16_t* p_window;
+  uint8_t* p_turn;
+  tL2C_LCB* p_lcb;
+  int xx;
+
+  if (transport == BT_TRANSPORT_LE) {
+    p_window = &l2cb.controller_le_xmit_window;
+    p_turn = &l2cb.ble_sched_link_turn;
+  } else {
+    p_window = &l2cb.controller_xmit_window;
+    p_turn = &l2cb.sched_link_turn;
+  }
+
+  /* Links that can't send during this run at all */
+  for (xx = 0, p_lcb = &l2cb.lcb_pool[0]; xx < MAX_L2CAP_LINKS; xx++, p_lcb++) {
+    flows[xx].p_deficit = &p_lcb->sched_deficit;
+    can_send[xx] = p_lcb->in_use && (p_lcb->transport == transport) &&
+                   (p_lcb->link_state == LST_CONNECTED) &&
+                   (p_lcb->link_xmit_quota != 0) &&
+                   !L2C_LINK_CHECK_POWER_MODE(p_lcb);
+  }
+
+  while (*p_window != 0) {
+    uint16_t reserve = l2c_link_xmit_reserve(transport);
+
+    for (xx = 0, p_lcb = &l2cb.lcb_pool[0]; xx < MAX_L2CAP_LINKS;
+         xx++, p_lcb++) {
+      flows[xx].quantum = 0;
+
+      /* If a partial segment is being sent, can't send anything else */
+      if (!can_send[xx] || p_lcb->partial_segment_being_sent) continue;
+      if (link_queues_only && list_is_empty(p_lcb->link_xmit_data_q))
+        continue;
+      if ((p_lcb->sent_not_acked >= p_lcb->link_xmit_min_quota) &&
+          ((p_lcb->sent_not_acked >= p_lcb->link_xmit_quota) ||
+           (*p_window <= reserve)))
+        continue;
+
+      flows[xx].quantum =
+          l2c_sched_link_quantum(p_lcb->acl_priority == L2CAP_PRIORITY_HIGH,
+                                 l2c_link_has_high_pri_chnl(p_lcb));
+    }
+    int serve = l2c_sched_select(flows, MAX_L2CAP_LINKS, p_turn);
+    if (serve < 0) break;
+    p_lcb = &l2cb.lcb_pool[serve];
+
+    /* See if we can send anything from the link queue first */
+    BT_HDR* p_buf;
+    tL2C_TX_COMPLETE_CB_INFO cbi;
+    tL2C_TX_COMPLETE_CB_INFO* p_cbi = NULL;
+    if (!list_is_empty(p_lcb->link_xmit_data_q)) {
+      p_buf = (BT_HDR*)list_front(p_lcb->link_xmit_data_q);
+      list_remove(p_lcb->link_xmit_data_q, p_buf);
+    } else {
+      p_buf = l2cu_get_next_buffer_to_send(p_lcb, &cbi);
+      p_cbi = &cbi;
+    }
+
+    if (p_buf == NULL) {
+      /* No channel of this link can send for now */
+      can_send[serve] = false;
+      continue;
+    }
+
+    l2c_sched_charge(&p_lcb->sched_deficit, p_buf->len);
+    if (!l2c_link_send_to_lower(p_lcb, p_buf, p_cbi)) break;
+  }
+}
+
 /*******************************************************************************
  *
  * Function         l2c_link_check_send_pkts
@@ -1053,44 +1259,15 @@ void l2c_link_check_send_pkts(tL2C_LCB* p_lcb, tL2C_CCB* p_ccb, BT_HDR* p_buf) {
       l2cb.ble_check_round_robin = false;
   } else /* if this is not round-robin service */
   {
-    /* If a partial segment is being sent, can't send anything else */
-    if ((p_lcb->partial_segment_being_sent) ||
-        (p_lcb->link_state != LST_CONNECTED) ||
-        (L2C_LINK_CHECK_POWER_MODE(p_lcb)))
-      return;
-
-    /* See if we can send anything from the link queue */
-    while (((l2cb.controller_xmit_window != 0 &&
-             (p_lcb->transport == BT_TRANSPORT_BR_EDR)) ||
-            (l2cb.controller_le_xmit_window != 0 &&
-             (p_lcb->transport == BT_TRANSPORT_LE))) &&
-           (p_lcb->sent_not_acked < p_lcb->link_xmit_quota)) {
-      if (list_is_empty(p_lcb->link_xmit_data_q)) break;
-
-      p_buf = (BT_HDR*)list_front(p_lcb->link_xmit_data_q);
-      list_remove(p_lcb->link_xmit_data_q, p_buf);
-      if (!l2c_link_send_to_lower(p_lcb, p_buf, NULL)) break;
-    }
-
-    if (!single_write) {
-      /* See if we can send anything for any channel */
-      while (((l2cb.controller_xmit_window != 0 &&
-               (p_lcb->transport == BT_TRANSPORT_BR_EDR)) ||
-              (l2cb.controller_le_xmit_window != 0 &&
-               (p_lcb->transport == BT_TRANSPORT_LE))) &&
-             (p_lcb->sent_not_acked < p_lcb->link_xmit_quota)) {
-        tL2C_TX_COMPLETE_CB_INFO cbi;
-        p_buf = l2cu_get_next_buffer_to_send(p_lcb, &cbi);
-        if (p_buf == NULL) break;
-
-        if (!l2c_link_send_to_lower(p_lcb, p_buf, &cbi)) break;
-      }
-    }
+    /* Serve this link along with the other links waiting for buffers */
+    l2c_link_sched_xmit(p_lcb->transport, single_write);
 
     /* There is a special case where we have readjusted the link quotas and  */
     /* this link may have sent anything but some other link sent packets so  */
     /* so we may need a timer to kick off this link's transmissions.         */
-    if ((!list_is_empty(p_lcb->link_xmit_data_q)) &&
+    if ((p_lcb->link_state == LST_CONNECTED) &&
+        (!p_lcb->partial_segment_being_sent) &&
+        (!list_is_empty(p_lcb->link_xmit_data_q)) &&
         (p_lcb->sent_not_acked < p_lcb->link_xmit_quota)) {
       alarm_set_on_mloop(p_lcb->l2c_lcb_timer,
                          L2CAP_LINK_FLOW_CONTROL_TIMEOUT_MS,
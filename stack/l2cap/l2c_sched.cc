@@ -0,0 +1,92 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the weighted deficit round robin scheduler used to
+ *  share ACL buffers between links and channels
+ *
+ ******************************************************************************/
+
+#include "l2c_sched.h"
+
+int l2c_sched_select(tL2C_SCHED_FLOW* flows, uint8_t num_flows,
+                     uint8_t* p_turn) {
+  bool any_ready = false;
+  for (uint8_t i = 0; i < num_flows; i++) {
+    if (flows[i].quantum != 0) {
+      any_ready = true;
+    } else if (*flows[i].p_deficit > 0) {
+      /* idle flows don't save up credit, debts are kept */
+      *flows[i].p_deficit = 0;
+    }
+  }
+  if (!any_ready) return -1;
+
+  /* terminates as every visit credits a ready flow */
+  uint8_t turn = *p_turn % num_flows;
+  while (true) {
+    tL2C_SCHED_FLOW& flow = flows[turn];
+    if (flow.quantum != 0) {
+      if (*flow.p_deficit > 0) break;
+      *flow.p_deficit += flow.quantum;
+    }
+    turn = (turn + 1) % num_flows;
+  }
+
+  *p_turn = turn;
+  return turn;
+}
+
+void l2c_sched_split_quota(const uint8_t* weights, uint16_t* quotas,
+                           uint8_t num_links, uint16_t num_bufs) {
+  uint32_t total_weight = 0;
+  for (uint8_t i = 0; i < num_links; i++) total_weight += weights[i];
+  if (total_weight == 0) return;
+
+  uint16_t spare = num_bufs - num_links;
+  uint16_t left = spare;
+  for (uint8_t i = 0; i < num_links; i++) {
+    quotas[i] = 1 + (uint32_t)spare * weights[i] / total_weight;
+    left -= quotas[i] - 1;
+  }
+  for (uint8_t i = 0; left > 0; i = (i + 1) % num_links, left--) quotas[i]++;
+}
+
+void l2c_sched_stats_queued(tL2C_SCHED_STATS* p_stats, size_t queue_depth,
+                            uint64_t now_ms) {
+  if (queue_depth > p_stats->max_queue_depth)
+    p_stats->max_queue_depth = queue_depth;
+  /* the queue may have been flushed since the head was last seen */
+  if (queue_depth == 1 || p_stats->head_since_ms == 0)
+    p_stats->head_since_ms = now_ms;
+}
+
+void l2c_sched_stats_sent(tL2C_SCHED_STATS* p_stats, uint16_t len,
+                          size_t queue_depth, uint64_t now_ms) {
+  p_stats->num_sent++;
+  p_stats->num_bytes += len;
+  p_stats->total_queue_depth += queue_depth + 1;
+
+  if (p_stats->head_since_ms != 0 && now_ms >= p_stats->head_since_ms) {
+    uint64_t wait_ms = now_ms - p_stats->head_since_ms;
+    p_stats->total_wait_ms += wait_ms;
+    if (wait_ms > p_stats->max_wait_ms) p_stats->max_wait_ms = wait_ms;
+  }
+  p_stats->head_since_ms = (queue_depth > 0) ? now_ms : 0;
+}
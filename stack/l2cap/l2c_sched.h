@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bytes credited to a flow of weight 1 on each of its turns. About one
+ * 3-DH5 packet, so equally weighted flows alternate packet by packet. */
+#define L2C_SCHED_QUANTUM 1024
+
+/* Weight of a link set to L2CAP_PRIORITY_HIGH, normal links have weight 1 */
+#define L2C_SCHED_HIGH_PRI_LINK_WEIGHT 4
+
+/* Weight of a link with a channel set to L2CAP_CHNL_PRIORITY_HIGH, as the AV
+ * channels are, both for its share of the buffers of the low priority links
+ * and for its turns. The same as such a channel has over a low priority one
+ * on the same link. */
+#define L2C_SCHED_HIGH_PRI_CHNL_WEIGHT 3
+
+/* A flow served by the weighted deficit round robin scheduler */
+typedef struct {
+  int32_t* p_deficit; /* bytes left in the current turn, kept by the owner */
+  uint32_t quantum;   /* bytes credited per turn, 0 if it can't send now */
+} tL2C_SCHED_FLOW;
+
+/* Selects the flow to send next among |num_flows| flows, starting with
+ * the flow whose turn it is, |*p_turn|.
+ *
+ * A flow is served while its deficit is positive and pays for what it sends
+ * with l2c_sched_charge(). A flow whose deficit is used up is credited its
+ * quantum and the turn passes on, so a packet larger than what is left in a
+ * turn is paid back in the next turns and packets never need to be looked at
+ * before they are dequeued. Flows that can't send do not keep credit.
+ *
+ * Returns the index of the selected flow, which keeps the turn, or -1 when
+ * no flow can send. */
+int l2c_sched_select(tL2C_SCHED_FLOW* flows, uint8_t num_flows,
+                     uint8_t* p_turn);
+
+/* Charges |len| bytes sent to the deficit of a flow */
+inline void l2c_sched_charge(int32_t* p_deficit, uint16_t len) {
+  *p_deficit -= len;
+}
+
+/* Returns the bytes credited per turn to a link, set to L2CAP_PRIORITY_HIGH
+ * if |high_pri_link|, and with a high priority channel if |high_pri_chnl| */
+inline uint32_t l2c_sched_link_quantum(bool high_pri_link,
+                                       bool high_pri_chnl) {
+  uint32_t quantum = L2C_SCHED_QUANTUM;
+  if (high_pri_link) quantum *= L2C_SCHED_HIGH_PRI_LINK_WEIGHT;
+  if (high_pri_chnl) quantum *= L2C_SCHED_HIGH_PRI_CHNL_WEIGHT;
+  return quantum;
+}
+
+/* Splits |num_bufs| controller buffers into the guaranteed quotas of
+ * |num_links| links. Each link gets one, and the rest in proportion to
+ * |weights|, the buffers left by rounding going one each to the first links.
+ * With equal weights it is an even split. |num_bufs| must be at least
+ * |num_links|. */
+void l2c_sched_split_quota(const uint8_t* weights, uint16_t* quotas,
+                           uint8_t num_links, uint16_t num_bufs);
+
+/* Transmit queue statistics of a channel */
+typedef struct {
+  uint32_t num_sent;          /* packets handed to the link */
+  uint64_t num_bytes;         /* bytes handed to the link */
+  uint16_t max_queue_depth;   /* longest transmit queue seen */
+  uint64_t total_queue_depth; /* queue depth summed over packets sent */
+  uint64_t head_since_ms;     /* when the head packet got to the head, or 0 */
+  uint64_t total_wait_ms;     /* head of line wait summed over packets sent */
+  uint32_t max_wait_ms;       /* longest head of line wait */
+} tL2C_SCHED_STATS;
+
+/* Records a packet queued, |queue_depth| packets are queued now */
+void l2c_sched_stats_queued(tL2C_SCHED_STATS* p_stats, size_t queue_depth,
+                            uint64_t now_ms);
+
+/* Records a packet of |len| bytes sent, |queue_depth| packets are left */
+void l2c_sched_stats_sent(tL2C_SCHED_STATS* p_stats, uint16_t len,
+                          size_t queue_depth, uint64_t now_ms);
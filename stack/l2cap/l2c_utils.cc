@@ -32,6 +32,7 @@
 #include "btm_api.h"
 #include "btm_int.h"
 #include "btu.h"
+#include "common/time_util.h"
 #include "device/include/controller.h"
 #include "hci/include/btsnoop.h"
 #include "hcidefs.h"
@@ -1223,24 +1224,6 @@ void l2cu_enqueue_ccb(tL2C_CCB* p_ccb) {
       p_q->p_last_ccb = p_ccb;
     }
   }
-
-#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-  /* Adding CCB into round robin service table of its LCB */
-  if (p_ccb->p_lcb != NULL) {
-    /* if this is the first channel in this priority group */
-    if (p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].num_ccb == 0) {
-      /* Set the first channel to this CCB */
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb = p_ccb;
-      /* Set the next serving channel in this group to this CCB */
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb = p_ccb;
-      /* Initialize quota of this priority group based on its priority */
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].quota =
-          L2CAP_GET_PRIORITY_QUOTA(p_ccb->ccb_priority);
-    }
-    /* increase number of channels in this group */
-    p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].num_ccb++;
-  }
-#endif
 }
 
 /******************************************************************************
@@ -1270,32 +1253,6 @@ void l2cu_dequeue_ccb(tL2C_CCB* p_ccb) {
     return;
   }
 
-#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
-  /* Removing CCB from round robin service table of its LCB */
-  if (p_ccb->p_lcb != NULL) {
-    /* decrease number of channels in this priority group */
-    p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].num_ccb--;
-
-    /* if it was the last channel in the priority group */
-    if (p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].num_ccb == 0) {
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb = NULL;
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb = NULL;
-    } else {
-      /* if it is the first channel of this group */
-      if (p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb == p_ccb) {
-        p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb =
-            p_ccb->p_next_ccb;
-      }
-      /* if it is the next serving channel of this group */
-      if (p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb == p_ccb) {
-        /* simply, start serving from the first channel */
-        p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb =
-            p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb;
-      }
-    }
-  }
-#endif
-
   if (p_ccb == p_q->p_first_ccb) {
     /* We are removing the first in a queue */
     p_q->p_first_ccb = p_ccb->p_next_ccb;
@@ -1338,23 +1295,13 @@ void l2cu_change_pri_ccb(tL2C_CCB* p_ccb, tL2CAP_CHNL_PRIORITY priority) {
       p_ccb->ccb_priority = priority;
       l2cu_enqueue_ccb(p_ccb);
     }
-#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
     else {
       /* If CCB is the only guy on the queue, no need to re-enqueue */
-      /* update only round robin service data */
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].num_ccb = 0;
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb = NULL;
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb = NULL;
-
       p_ccb->ccb_priority = priority;
-
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_first_ccb = p_ccb;
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].p_serve_ccb = p_ccb;
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].quota =
-          L2CAP_GET_PRIORITY_QUOTA(p_ccb->ccb_priority);
-      p_ccb->p_lcb->rr_serv[p_ccb->ccb_priority].num_ccb = 1;
     }
-#endif
+
+    /* The share of a link is weighted by its high priority channels */
+    l2c_link_adjust_allocation();
   }
 }
 
@@ -1482,6 +1429,11 @@ tL2C_CCB* l2cu_allocate_ccb(tL2C_LCB* p_lcb, uint16_t cid) {
   p_ccb->cong_sent = false;
   p_ccb->buff_quota = 2; /* This gets set after config */
 
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+  p_ccb->sched_deficit = 0;
+#endif
+  memset(&p_ccb->sched_stats, 0, sizeof(tL2C_SCHED_STATS));
+
   /* If CCB was reserved Config_Done can already have some value */
   if (cid == 0)
     p_ccb->config_done = 0;
@@ -1621,6 +1573,10 @@ void l2cu_release_ccb(tL2C_CCB* p_ccb) {
   /* If no channels on the connection, start idle timeout */
   if ((p_lcb) && p_lcb->in_use) {
     if (p_lcb->link_state == LST_CONNECTED) {
+      /* The share of a link is weighted by its high priority channels */
+      if (p_ccb->ccb_priority == L2CAP_CHNL_PRIORITY_HIGH)
+        l2c_link_adjust_allocation();
+
       if (!p_lcb->ccb_queue.p_first_ccb) {
         // Closing a security channel on LE device should not start connection
         // timeout
@@ -3091,99 +3047,74 @@ tL2C_CCB* l2cu_find_ccb_by_cid(tL2C_LCB* p_lcb, uint16_t local_cid) {
 
 /******************************************************************************
  *
- * Function         l2cu_get_next_channel_in_rr
+ * Function         l2cu_is_channel_ready
  *
- * Description      get the next channel to send on a link. It also adjusts the
- *                  CCB queue to do a basic priority and round-robin scheduling.
+ * Description      check if a dynamic channel has data it may send now
  *
- * Returns          pointer to CCB or NULL
+ * Returns          true if it can send
  *
  ******************************************************************************/
-static tL2C_CCB* l2cu_get_next_channel_in_rr(tL2C_LCB* p_lcb) {
-  tL2C_CCB* p_serve_ccb = NULL;
-  tL2C_CCB* p_ccb;
+static bool l2cu_is_channel_ready(tL2C_CCB* p_ccb) {
+  if (p_ccb->chnl_state != CST_OPEN) return false;
 
-  int i, j;
+  if (p_ccb->p_lcb->transport == BT_TRANSPORT_LE)
+    return (p_ccb->peer_conn_cfg.credits != 0) &&
+           !fixed_queue_is_empty(p_ccb->xmit_hold_q);
 
-  /* scan all of priority until finding a channel to serve */
-  for (i = 0; (i < L2CAP_NUM_CHNL_PRIORITY) && (!p_serve_ccb); i++) {
-    /* scan all channel within serving priority group until finding a channel to
-     * serve */
-    for (j = 0; (j < p_lcb->rr_serv[p_lcb->rr_pri].num_ccb) && (!p_serve_ccb);
-         j++) {
-      /* scaning from next serving channel */
-      p_ccb = p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb;
-
-      if (!p_ccb) {
-        L2CAP_TRACE_ERROR("p_serve_ccb is NULL, rr_pri=%d", p_lcb->rr_pri);
-        return NULL;
-      }
+  /* eL2CAP option in use */
+  if (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_BASIC_MODE) {
+    if (p_ccb->fcrb.wait_ack || p_ccb->fcrb.remote_busy) return false;
 
-      L2CAP_TRACE_DEBUG("RR scan pri=%d, lcid=0x%04x, q_cout=%d",
-                        p_ccb->ccb_priority, p_ccb->local_cid,
-                        fixed_queue_length(p_ccb->xmit_hold_q));
-
-      /* store the next serving channel */
-      /* this channel is the last channel of its priority group */
-      if ((p_ccb->p_next_ccb == NULL) ||
-          (p_ccb->p_next_ccb->ccb_priority != p_ccb->ccb_priority)) {
-        /* next serving channel is set to the first channel in the group */
-        p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb =
-            p_lcb->rr_serv[p_lcb->rr_pri].p_first_ccb;
-      } else {
-        /* next serving channel is set to the next channel in the group */
-        p_lcb->rr_serv[p_lcb->rr_pri].p_serve_ccb = p_ccb->p_next_ccb;
-      }
+    /* No more checks needed if sending from the reatransmit queue */
+    if (!fixed_queue_is_empty(p_ccb->fcrb.retrans_q)) return true;
 
-      if (p_ccb->chnl_state != CST_OPEN) continue;
+    if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) return false;
 
-      if (p_ccb->p_lcb->transport == BT_TRANSPORT_LE) {
-        L2CAP_TRACE_DEBUG("%s : Connection oriented channel", __func__);
-        if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) continue;
-
-      } else {
-        /* eL2CAP option in use */
-        if (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_BASIC_MODE) {
-          if (p_ccb->fcrb.wait_ack || p_ccb->fcrb.remote_busy) continue;
-
-          if (fixed_queue_is_empty(p_ccb->fcrb.retrans_q)) {
-            if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) continue;
+    /* If in eRTM mode, check for window closure */
+    return (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_ERTM_MODE) ||
+           !l2c_fcr_is_flow_controlled(p_ccb);
+  }
 
-            /* If in eRTM mode, check for window closure */
-            if ((p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE) &&
-                (l2c_fcr_is_flow_controlled(p_ccb)))
-              continue;
-          }
-        } else {
-          if (fixed_queue_is_empty(p_ccb->xmit_hold_q)) continue;
-        }
-      }
+  return !fixed_queue_is_empty(p_ccb->xmit_hold_q);
+}
 
-      /* found a channel to serve */
-      p_serve_ccb = p_ccb;
-      /* decrease quota of its priority group */
-      p_lcb->rr_serv[p_lcb->rr_pri].quota--;
-    }
+/******************************************************************************
+ *
+ * Function         l2cu_get_next_channel_in_rr
+ *
+ * Description      get the next channel to send on a link. The channels of a
+ *                  link are served in weighted deficit round robin, a channel
+ *                  getting a share of the link bytes by its priority.
+ *
+ * Returns          pointer to CCB or NULL
+ *
+ ******************************************************************************/
+static tL2C_CCB* l2cu_get_next_channel_in_rr(tL2C_LCB* p_lcb) {
+  tL2C_SCHED_FLOW flows[MAX_L2CAP_CHANNELS];
+  tL2C_CCB* p_ccbs[MAX_L2CAP_CHANNELS];
+  uint8_t num_ccbs = 0;
+  tL2C_CCB* p_ccb;
 
-    /* if there is no more quota of the priority group or no channel to have
-     * data to send */
-    if ((p_lcb->rr_serv[p_lcb->rr_pri].quota == 0) || (!p_serve_ccb)) {
-      /* serve next priority group */
-      p_lcb->rr_pri = (p_lcb->rr_pri + 1) % L2CAP_NUM_CHNL_PRIORITY;
-      /* initialize its quota */
-      p_lcb->rr_serv[p_lcb->rr_pri].quota =
-          L2CAP_GET_PRIORITY_QUOTA(p_lcb->rr_pri);
-    }
+  for (p_ccb = p_lcb->ccb_queue.p_first_ccb;
+       p_ccb && num_ccbs < MAX_L2CAP_CHANNELS; p_ccb = p_ccb->p_next_ccb) {
+    p_ccbs[num_ccbs] = p_ccb;
+    flows[num_ccbs].p_deficit = &p_ccb->sched_deficit;
+    flows[num_ccbs].quantum = l2cu_is_channel_ready(p_ccb)
+                                  ? L2CAP_GET_PRIORITY_QUANTUM(
+                                        p_ccb->ccb_priority)
+                                  : 0;
+    num_ccbs++;
   }
+  if (num_ccbs == 0) return NULL;
 
-  if (p_serve_ccb) {
-    L2CAP_TRACE_DEBUG("RR service pri=%d, quota=%d, lcid=0x%04x",
-                      p_serve_ccb->ccb_priority,
-                      p_lcb->rr_serv[p_serve_ccb->ccb_priority].quota,
-                      p_serve_ccb->local_cid);
-  }
+  int serve = l2c_sched_select(flows, num_ccbs, &p_lcb->sched_ccb_turn);
+  if (serve < 0) return NULL;
 
-  return p_serve_ccb;
+  p_ccb = p_ccbs[serve];
+  L2CAP_TRACE_DEBUG("RR service pri=%d, deficit=%d, lcid=0x%04x",
+                    p_ccb->ccb_priority, p_ccb->sched_deficit,
+                    p_ccb->local_cid);
+  return p_ccb;
 }
 
 #else  /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE) */
@@ -3225,6 +3156,24 @@ static tL2C_CCB* l2cu_get_next_channel(tL2C_LCB* p_lcb) {
 }
 #endif /* (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE) */
 
+/******************************************************************************
+ *
+ * Function         l2cu_sched_sent
+ *
+ * Description      account for a buffer of a channel handed to the link
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void l2cu_sched_sent(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
+#if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
+  l2c_sched_charge(&p_ccb->sched_deficit, p_buf->len);
+#endif
+  l2c_sched_stats_sent(&p_ccb->sched_stats, p_buf->len,
+                       fixed_queue_length(p_ccb->xmit_hold_q),
+                       bluetooth::common::time_get_os_boottime_ms());
+}
+
 void l2cu_tx_complete(tL2C_TX_COMPLETE_CB_INFO* p_cbi) {
   if (p_cbi->cb != NULL) p_cbi->cb(p_cbi->local_cid, p_cbi->num_sdu);
 }
@@ -3270,6 +3219,7 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
 
       p_buf = l2c_fcr_get_next_xmit_sdu_seg(p_ccb, 0);
       if (p_buf != NULL) {
+        l2cu_sched_sent(p_ccb, p_buf);
         l2cu_check_channel_congestion(p_ccb);
         l2cu_set_acl_hci_header(p_buf, p_ccb);
         return (p_buf);
@@ -3287,6 +3237,7 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
         p_cbi->local_cid = p_ccb->local_cid;
         p_cbi->num_sdu = 1;
 
+        l2cu_sched_sent(p_ccb, p_buf);
         l2cu_check_channel_congestion(p_ccb);
         l2cu_set_acl_hci_header(p_buf, p_ccb);
         return (p_buf);
@@ -3334,6 +3285,8 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
     }
   }
 
+  l2cu_sched_sent(p_ccb, p_buf);
+
   if (p_ccb->p_rcb && p_ccb->p_rcb->api.pL2CA_TxComplete_Cb &&
       (p_ccb->peer_cfg.fcr.mode != L2CAP_FCR_ERTM_MODE))
     (*p_ccb->p_rcb->api.pL2CA_TxComplete_Cb)(p_ccb->local_cid, 1);
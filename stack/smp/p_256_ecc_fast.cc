@@ -0,0 +1,490 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*******************************************************************************
+ *
+ *  This file contains a constant time P-256 point multiplication used for
+ *  the LE Secure Connections public key and DHKey.
+ *
+ *  Field elements are in Montgomery form (R = 2^256), in 64-bit limbs where
+ *  the compiler has a 128-bit type and in 32-bit limbs elsewhere. Points are
+ *  kept in Jacobian coordinates, so the only inversion is the final
+ *  conversion to affine. The scalar is processed in 4-bit windows:
+ *  multiples of the base point use a table of j * 16^i * G for every window,
+ *  which needs no doublings at all; other points use a fixed window over a
+ *  table of 0..15 * P built per call. Table entries are always read with a
+ *  full scan, so neither the memory access pattern nor the sequence of
+ *  operations depends on the scalar.
+ *
+ ******************************************************************************/
+#include "p_256_ecc_pp.h"
+
+#include <string.h>
+#include <mutex>
+
+#if defined(__SIZEOF_INT128__)
+typedef uint64_t limb_t;
+typedef unsigned __int128 dlimb_t;
+#define P256_LIMB_BITS 64
+// A 64-bit constant as limbs
+#define P256_LIMB64(x) (x)
+#else
+typedef uint32_t limb_t;
+typedef uint64_t dlimb_t;
+#define P256_LIMB_BITS 32
+#define P256_LIMB64(x) (limb_t)(x), (limb_t)((x) >> 32)
+#endif
+
+#define P256_LIMBS (256 / P256_LIMB_BITS)
+#define P256_WINDOW_BITS 4
+#define P256_WINDOWS (256 / P256_WINDOW_BITS)
+#define P256_WINDOW_SIZE (1 << P256_WINDOW_BITS)
+
+typedef limb_t felem[P256_LIMBS];
+
+typedef struct {
+  felem x;
+  felem y;
+  felem z;
+} jacobian_point;
+
+typedef struct {
+  felem x;
+  felem y;
+} affine_point;
+
+// p = 2^256 - 2^224 + 2^192 + 2^96 - 1
+static const felem kP = {
+    P256_LIMB64(0xffffffffffffffffULL), P256_LIMB64(0x00000000ffffffffULL),
+    P256_LIMB64(0x0000000000000000ULL), P256_LIMB64(0xffffffff00000001ULL)};
+// R^2 mod p, to convert into Montgomery form
+static const felem kRR = {
+    P256_LIMB64(0x0000000000000003ULL), P256_LIMB64(0xfffffffbffffffffULL),
+    P256_LIMB64(0xfffffffffffffffeULL), P256_LIMB64(0x00000004fffffffdULL)};
+// R mod p, i.e. 1 in Montgomery form
+static const felem kOne = {
+    P256_LIMB64(0x0000000000000001ULL), P256_LIMB64(0xffffffff00000000ULL),
+    P256_LIMB64(0xffffffffffffffffULL), P256_LIMB64(0x00000000fffffffeULL)};
+// The base point G
+static const felem kGx = {
+    P256_LIMB64(0xf4a13945d898c296ULL), P256_LIMB64(0x77037d812deb33a0ULL),
+    P256_LIMB64(0xf8bce6e563a440f2ULL), P256_LIMB64(0x6b17d1f2e12c4247ULL)};
+static const felem kGy = {
+    P256_LIMB64(0xcbb6406837bf51f5ULL), P256_LIMB64(0x2bce33576b315eceULL),
+    P256_LIMB64(0x8ee7eb4a7c0f9e16ULL), P256_LIMB64(0x4fe342e2fe1a7f9bULL)};
+
+// All ones if |a| is zero, all zeroes otherwise
+static limb_t ct_is_zero_mask(limb_t a) {
+  return ((~a & (a - 1)) >> (P256_LIMB_BITS - 1)) * ~(limb_t)0;
+}
+
+static limb_t fe_is_zero_mask(const felem a) {
+  limb_t bits = 0;
+  for (int i = 0; i < P256_LIMBS; i++) bits |= a[i];
+  return ct_is_zero_mask(bits);
+}
+
+// r = mask ? a : r
+static void fe_select(felem r, const felem a, limb_t mask) {
+  for (int i = 0; i < P256_LIMBS; i++) r[i] ^= mask & (a[i] ^ r[i]);
+}
+
+// r = (a_hi * 2^256 + a) mod p, where the value is known to be less than 2p
+static void fe_reduce_once(felem r, const felem a, limb_t a_hi) {
+  felem s;
+  dlimb_t borrow = 0;
+  for (int i = 0; i < P256_LIMBS; i++) {
+    dlimb_t d = (dlimb_t)a[i] - kP[i] - borrow;
+    s[i] = (limb_t)d;
+    borrow = (d >> P256_LIMB_BITS) & 1;
+  }
+  // Keep |a| if subtracting p borrowed past the top limb
+  limb_t keep_a = ct_is_zero_mask(a_hi) & (0 - (limb_t)borrow);
+  for (int i = 0; i < P256_LIMBS; i++) r[i] = s[i] ^ (keep_a & (a[i] ^ s[i]));
+}
+
+static void fe_add(felem r, const felem a, const felem b) {
+  felem t;
+  dlimb_t carry = 0;
+  for (int i = 0; i < P256_LIMBS; i++) {
+    carry += (dlimb_t)a[i] + b[i];
+    t[i] = (limb_t)carry;
+    carry >>= P256_LIMB_BITS;
+  }
+  fe_reduce_once(r, t, (limb_t)carry);
+}
+
+static void fe_sub(felem r, const felem a, const felem b) {
+  felem t;
+  dlimb_t borrow = 0;
+  for (int i = 0; i < P256_LIMBS; i++) {
+    dlimb_t d = (dlimb_t)a[i] - b[i] - borrow;
+    t[i] = (limb_t)d;
+    borrow = (d >> P256_LIMB_BITS) & 1;
+  }
+  // Add p back if the subtraction went negative
+  limb_t mask = 0 - (limb_t)borrow;
+  dlimb_t carry = 0;
+  for (int i = 0; i < P256_LIMBS; i++) {
+    carry += (dlimb_t)t[i] + (kP[i] & mask);
+    r[i] = (limb_t)carry;
+    carry >>= P256_LIMB_BITS;
+  }
+}
+
+// r = a * b / R mod p. Since p = -1 modulo the limb size, each reduction
+// step simply adds t[0] * p.
+static void fe_mul(felem r, const felem a, const felem b) {
+  limb_t t[P256_LIMBS + 2] = {0};
+  for (int i = 0; i < P256_LIMBS; i++) {
+    dlimb_t carry = 0;
+    for (int j = 0; j < P256_LIMBS; j++) {
+      carry += (dlimb_t)a[j] * b[i] + t[j];
+      t[j] = (limb_t)carry;
+      carry >>= P256_LIMB_BITS;
+    }
+    carry += t[P256_LIMBS];
+    t[P256_LIMBS] = (limb_t)carry;
+    t[P256_LIMBS + 1] = (limb_t)(carry >> P256_LIMB_BITS);
+
+    limb_t m = t[0];
+    carry = (dlimb_t)m * kP[0] + t[0];
+    carry >>= P256_LIMB_BITS;
+    for (int j = 1; j < P256_LIMBS; j++) {
+      carry += (dlimb_t)m * kP[j] + t[j];
+      t[j - 1] = (limb_t)carry;
+      carry >>= P256_LIMB_BITS;
+    }
+    carry += t[P256_LIMBS];
+    t[P256_LIMBS - 1] = (limb_t)carry;
+    t[P256_LIMBS] = t[P256_LIMBS + 1] + (limb_t)(carry >> P256_LIMB_BITS);
+  }
+  fe_reduce_once(r, t, t[P256_LIMBS]);
+}
+
+static void fe_sqr(felem r, const felem a) { fe_mul(r, a, a); }
+
+// r = a^-1 = a^(p-2) mod p. The exponent is public, so square and multiply
+// runs in constant time. Maps zero to zero.
+static void fe_inv(felem r, const felem a) {
+  static const felem kPMinus2 = {
+      P256_LIMB64(0xfffffffffffffffdULL), P256_LIMB64(0x00000000ffffffffULL),
+      P256_LIMB64(0x0000000000000000ULL), P256_LIMB64(0xffffffff00000001ULL)};
+  felem t;
+  memcpy(t, kOne, sizeof(felem));
+  for (int i = 255; i >= 0; i--) {
+    fe_sqr(t, t);
+    if ((kPMinus2[i / P256_LIMB_BITS] >> (i % P256_LIMB_BITS)) & 1)
+      fe_mul(t, t, a);
+  }
+  memcpy(r, t, sizeof(felem));
+}
+
+static void fe_from_words(felem r, const uint32_t* words) {
+  felem a = {0};
+  for (int i = 0; i < KEY_LENGTH_DWORDS_P256; i++)
+    a[i * 32 / P256_LIMB_BITS] |= (limb_t)words[i]
+                                  << (i * 32 % P256_LIMB_BITS);
+  fe_mul(r, a, kRR);
+}
+
+static void fe_to_words(uint32_t* words, const felem a) {
+  static const felem kRawOne = {1, 0, 0, 0};
+  felem r;
+  fe_mul(r, a, kRawOne);
+  for (int i = 0; i < KEY_LENGTH_DWORDS_P256; i++)
+    words[i] = (uint32_t)(r[i * 32 / P256_LIMB_BITS] >>
+                          (i * 32 % P256_LIMB_BITS));
+}
+
+// r = 2p, for a = -3 (dbl-2001-b). Maps infinity (z = 0) to infinity.
+static void point_double(jacobian_point* r, const jacobian_point* p) {
+  felem delta, gamma, beta, alpha, t, u;
+
+  fe_sqr(delta, p->z);
+  fe_sqr(gamma, p->y);
+  fe_mul(beta, p->x, gamma);
+
+  fe_sub(t, p->x, delta);
+  fe_add(u, p->x, delta);
+  fe_mul(alpha, t, u);
+  fe_add(t, alpha, alpha);
+  fe_add(alpha, t, alpha);  // alpha = 3 * (x - delta) * (x + delta)
+
+  fe_add(t, p->y, p->z);
+  fe_sqr(t, t);
+  fe_sub(t, t, gamma);
+  fe_sub(r->z, t, delta);  // z3 = (y + z)^2 - gamma - delta
+
+  fe_add(beta, beta, beta);
+  fe_add(beta, beta, beta);  // beta = 4 * beta
+  fe_sqr(t, alpha);
+  fe_add(u, beta, beta);
+  fe_sub(r->x, t, u);  // x3 = alpha^2 - 8 * beta
+
+  fe_sub(t, beta, r->x);
+  fe_mul(t, alpha, t);
+  fe_sqr(gamma, gamma);
+  fe_add(gamma, gamma, gamma);
+  fe_add(gamma, gamma, gamma);
+  fe_add(gamma, gamma, gamma);
+  fe_sub(r->y, t, gamma);  // y3 = alpha * (4 * beta - x3) - 8 * gamma^2
+}
+
+// r = p + q (add-2007-bl). Either point may be infinity. The formula does
+// not hold for p == q, so 2p is always computed as well and selected then.
+static void point_add(jacobian_point* r, const jacobian_point* p,
+                      const jacobian_point* q) {
+  felem z1z1, z2z2, u1, u2, s1, s2, h, i, j, rr, v, t;
+  jacobian_point out, dbl;
+
+  limb_t p_is_inf = fe_is_zero_mask(p->z);
+  limb_t q_is_inf = fe_is_zero_mask(q->z);
+
+  fe_sqr(z1z1, p->z);
+  fe_sqr(z2z2, q->z);
+  fe_mul(u1, p->x, z2z2);
+  fe_mul(u2, q->x, z1z1);
+  fe_mul(s1, p->y, q->z);
+  fe_mul(s1, s1, z2z2);
+  fe_mul(s2, q->y, p->z);
+  fe_mul(s2, s2, z1z1);
+
+  fe_sub(h, u2, u1);
+  fe_sub(rr, s2, s1);
+  fe_add(rr, rr, rr);
+  limb_t is_double =
+      fe_is_zero_mask(h) & fe_is_zero_mask(rr) & ~p_is_inf & ~q_is_inf;
+  point_double(&dbl, p);
+
+  fe_add(i, h, h);
+  fe_sqr(i, i);
+  fe_mul(j, h, i);
+  fe_mul(v, u1, i);
+
+  fe_sqr(out.x, rr);
+  fe_sub(out.x, out.x, j);
+  fe_sub(out.x, out.x, v);
+  fe_sub(out.x, out.x, v);  // x3 = r^2 - J - 2V
+
+  fe_sub(t, v, out.x);
+  fe_mul(t, rr, t);
+  fe_mul(s1, s1, j);
+  fe_add(s1, s1, s1);
+  fe_sub(out.y, t, s1);  // y3 = r * (V - x3) - 2 * s1 * J
+
+  fe_add(t, p->z, q->z);
+  fe_sqr(t, t);
+  fe_sub(t, t, z1z1);
+  fe_sub(t, t, z2z2);
+  fe_mul(out.z, t, h);  // z3 = ((z1 + z2)^2 - z1z1 - z2z2) * H
+
+  for (int k = 0; k < 3; k++) {
+    felem* out_coord = &out.x + k;
+    fe_select(*out_coord, (&q->x)[k], p_is_inf);
+    fe_select(*out_coord, (&p->x)[k], q_is_inf);
+    fe_select(*out_coord, (&dbl.x)[k], is_double);
+  }
+  memcpy(r, &out, sizeof(out));
+}
+
+// r = p + q where q is affine (madd-2007-bl), unless |q_is_zero| is set, in
+// which case r = p. p may be infinity. As in point_add, 2p is always computed
+// for the case p == q.
+static void point_add_mixed(jacobian_point* r, const jacobian_point* p,
+                            const affine_point* q, limb_t q_is_zero) {
+  felem z1z1, u2, s2, h, hh, i, j, rr, v, t;
+  jacobian_point out, dbl;
+
+  limb_t p_is_inf = fe_is_zero_mask(p->z);
+
+  fe_sqr(z1z1, p->z);
+  fe_mul(u2, q->x, z1z1);
+  fe_mul(s2, q->y, p->z);
+  fe_mul(s2, s2, z1z1);
+
+  fe_sub(h, u2, p->x);
+  fe_sub(rr, s2, p->y);
+  fe_add(rr, rr, rr);
+  limb_t is_double =
+      fe_is_zero_mask(h) & fe_is_zero_mask(rr) & ~p_is_inf & ~q_is_zero;
+  point_double(&dbl, p);
+
+  fe_sqr(hh, h);
+  fe_add(i, hh, hh);
+  fe_add(i, i, i);
+  fe_mul(j, h, i);
+  fe_mul(v, p->x, i);
+
+  fe_sqr(out.x, rr);
+  fe_sub(out.x, out.x, j);
+  fe_sub(out.x, out.x, v);
+  fe_sub(out.x, out.x, v);  // x3 = r^2 - J - 2V
+
+  fe_sub(t, v, out.x);
+  fe_mul(t, rr, t);
+  fe_mul(s2, p->y, j);
+  fe_add(s2, s2, s2);
+  fe_sub(out.y, t, s2);  // y3 = r * (V - x3) - 2 * y1 * J
+
+  fe_add(t, p->z, h);
+  fe_sqr(t, t);
+  fe_sub(t, t, z1z1);
+  fe_sub(out.z, t, hh);  // z3 = (z1 + H)^2 - z1z1 - HH
+
+  fe_select(out.x, q->x, p_is_inf);
+  fe_select(out.y, q->y, p_is_inf);
+  fe_select(out.z, kOne, p_is_inf);
+  fe_select(out.x, p->x, q_is_zero);
+  fe_select(out.y, p->y, q_is_zero);
+  fe_select(out.z, p->z, q_is_zero);
+  fe_select(out.x, dbl.x, is_double);
+  fe_select(out.y, dbl.y, is_double);
+  fe_select(out.z, dbl.z, is_double);
+  memcpy(r, &out, sizeof(out));
+}
+
+static uint32_t scalar_window(const uint32_t* n, int window) {
+  int bit = window * P256_WINDOW_BITS;
+  return (n[bit / 32] >> (bit % 32)) & (P256_WINDOW_SIZE - 1);
+}
+
+// Multiples j * 16^i * G, j = 1..15, for every window i
+static affine_point (*base_table)[P256_WINDOW_SIZE - 1];
+static std::once_flag base_table_once;
+
+// Converts |count| points to affine with a single inversion
+static void batch_to_affine(affine_point* r, const jacobian_point* p,
+                            int count) {
+  felem* prefix = new felem[count];
+  felem inv, t, zinv, zinv2;
+
+  memcpy(prefix[0], p[0].z, sizeof(felem));
+  for (int k = 1; k < count; k++) fe_mul(prefix[k], prefix[k - 1], p[k].z);
+  fe_inv(inv, prefix[count - 1]);
+
+  for (int k = count - 1; k >= 0; k--) {
+    if (k > 0) {
+      fe_mul(zinv, inv, prefix[k - 1]);
+      fe_mul(inv, inv, p[k].z);
+    } else {
+      memcpy(zinv, inv, sizeof(felem));
+    }
+    fe_sqr(zinv2, zinv);
+    fe_mul(r[k].x, p[k].x, zinv2);
+    fe_mul(t, zinv2, zinv);
+    fe_mul(r[k].y, p[k].y, t);
+  }
+  delete[] prefix;
+}
+
+static void init_base_table() {
+  base_table = new affine_point[P256_WINDOWS][P256_WINDOW_SIZE - 1];
+
+  jacobian_point multiples[P256_WINDOW_SIZE - 1];
+  jacobian_point base;
+  memcpy(base.x, kGx, sizeof(felem));
+  memcpy(base.y, kGy, sizeof(felem));
+  fe_mul(base.x, base.x, kRR);
+  fe_mul(base.y, base.y, kRR);
+  memcpy(base.z, kOne, sizeof(felem));
+
+  for (int i = 0; i < P256_WINDOWS; i++) {
+    multiples[0] = base;
+    point_double(&multiples[1], &base);
+    for (int j = 2; j < P256_WINDOW_SIZE - 1; j++)
+      point_add(&multiples[j], &multiples[j - 1], &base);
+    batch_to_affine(base_table[i], multiples, P256_WINDOW_SIZE - 1);
+
+    for (int k = 0; k < P256_WINDOW_BITS; k++) point_double(&base, &base);
+  }
+}
+
+// r = n * G
+static void point_mult_base(jacobian_point* r, const uint32_t* n) {
+  std::call_once(base_table_once, init_base_table);
+
+  memset(r, 0, sizeof(jacobian_point));
+  for (int i = 0; i < P256_WINDOWS; i++) {
+    uint32_t digit = scalar_window(n, i);
+    affine_point t;
+    memset(&t, 0, sizeof(t));
+    for (uint32_t j = 1; j < P256_WINDOW_SIZE; j++) {
+      limb_t mask = ct_is_zero_mask(j ^ digit);
+      fe_select(t.x, base_table[i][j - 1].x, mask);
+      fe_select(t.y, base_table[i][j - 1].y, mask);
+    }
+    point_add_mixed(r, r, &t, ct_is_zero_mask(digit));
+  }
+}
+
+// r = n * p
+static void point_mult(jacobian_point* r, const jacobian_point* p,
+                       const uint32_t* n) {
+  jacobian_point table[P256_WINDOW_SIZE];
+  memset(&table[0], 0, sizeof(jacobian_point));
+  table[1] = *p;
+  point_double(&table[2], p);
+  for (int j = 3; j < P256_WINDOW_SIZE; j++)
+    point_add(&table[j], &table[j - 1], p);
+
+  memset(r, 0, sizeof(jacobian_point));
+  for (int i = P256_WINDOWS - 1; i >= 0; i--) {
+    for (int k = 0; k < P256_WINDOW_BITS; k++) point_double(r, r);
+
+    uint32_t digit = scalar_window(n, i);
+    jacobian_point t;
+    memset(&t, 0, sizeof(t));
+    for (uint32_t j = 1; j < P256_WINDOW_SIZE; j++) {
+      limb_t mask = ct_is_zero_mask(j ^ digit);
+      fe_select(t.x, table[j].x, mask);
+      fe_select(t.y, table[j].y, mask);
+      fe_select(t.z, table[j].z, mask);
+    }
+    point_add(r, r, &t);
+  }
+}
+
+void ECC_PointMult_P256(Point* q, const Point* p, const uint32_t* n) {
+  jacobian_point r;
+  jacobian_point in;
+  fe_from_words(in.x, p->x);
+  fe_from_words(in.y, p->y);
+  memcpy(in.z, kOne, sizeof(felem));
+
+  felem gx, gy;
+  fe_mul(gx, kGx, kRR);
+  fe_mul(gy, kGy, kRR);
+  if (memcmp(in.x, gx, sizeof(felem)) == 0 &&
+      memcmp(in.y, gy, sizeof(felem)) == 0) {
+    point_mult_base(&r, n);
+  } else {
+    point_mult(&r, &in, n);
+  }
+
+  felem zinv, zinv2, t;
+  fe_inv(zinv, r.z);
+  fe_sqr(zinv2, zinv);
+  fe_mul(t, r.x, zinv2);
+  fe_to_words(q->x, t);
+  fe_mul(zinv2, zinv2, zinv);
+  fe_mul(t, r.y, zinv2);
+  fe_to_words(q->y, t);
+  memset(q->z, 0, sizeof(q->z));
+  q->z[0] = 1;
+}
@@ -60,7 +60,14 @@ bool ECC_ValidatePoint(const Point& p);
 
 void ECC_PointMult_Bin_NAF(Point* q, Point* p, uint32_t* n, uint32_t keyLength);
 
-#define ECC_PointMult(q, p, n, keyLength) \
-  ECC_PointMult_Bin_NAF(q, p, n, keyLength)
+// Constant time q = n * p on P-256, see p_256_ecc_fast.cc. |p| must be a
+// point on the curve with z = 1. Unlike ECC_PointMult_Bin_NAF, |n| is left
+// untouched.
+void ECC_PointMult_P256(Point* q, const Point* p, const uint32_t* n);
+
+#define ECC_PointMult(q, p, n, keyLength)                        \
+  (((keyLength) == KEY_LENGTH_DWORDS_P256)                       \
+       ? ECC_PointMult_P256(q, p, n)                             \
+       : ECC_PointMult_Bin_NAF(q, p, n, keyLength))
 
 void p_256_init_curve(uint32_t keyLength);
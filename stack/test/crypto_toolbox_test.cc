@@ -20,6 +20,7 @@
 #include <gtest/gtest.h>
 
 #include "stack/crypto_toolbox/aes.h"
+#include "stack/crypto_toolbox/aes_fast.h"
 #include "stack/crypto_toolbox/crypto_toolbox.h"
 
 #include <base/logging.h>
@@ -397,4 +398,117 @@ TEST(CryptoToolboxTest, bt_spec_example_d_12_test) {
   EXPECT_EQ(expected_ltk, ltk);
 }
 
+static void fill_pseudo_random(uint8_t* data, size_t length, uint32_t* seed) {
+  for (size_t i = 0; i < length; i++) {
+    *seed = *seed * 1103515245 + 12345;
+    data[i] = *seed >> 16;
+  }
+}
+
+// Reference AES_128 with the byte-oriented implementation in aes.cc
+static Octet16 reference_aes_128(const Octet16& key, const Octet16& message) {
+  Octet16 key_reversed, message_reversed, output;
+  std::reverse_copy(key.begin(), key.end(), key_reversed.begin());
+  std::reverse_copy(message.begin(), message.end(), message_reversed.begin());
+
+  aes_context ctx;
+  aes_set_key(key_reversed.data(), key_reversed.size(), &ctx);
+  aes_encrypt(message_reversed.data(), output.data(), &ctx);
+
+  std::reverse(output.begin(), output.end());
+  return output;
+}
+
+// FIPS-197 Appendix C.1
+TEST(CryptoToolboxTest, aes_engines_fips_197_test) {
+  uint8_t key[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                   0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  uint8_t plaintext[] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                         0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+  uint8_t ciphertext[] = {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                          0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+
+  for (aes_engine_t engine : {AES_ENGINE_TTABLE, AES_ENGINE_AESNI}) {
+    if (!aes_engine_supported(engine)) continue;
+    aes_128_key_schedule_t schedule;
+    uint8_t output[AES_128_BLOCK_LEN];
+    aes_128_set_keys(engine, key, &schedule, 1);
+    aes_128_encrypt_blocks(engine, &schedule, plaintext, output, 1);
+    EXPECT_THAT(output, ElementsAreArray(ciphertext)) << "engine " << engine;
+  }
+}
+
+// Every engine must match aes.cc, for batch sizes that do and do not fill
+// the interleaved lanes.
+TEST(CryptoToolboxTest, aes_engines_match_reference_test) {
+  uint32_t seed = 1;
+  for (aes_engine_t engine : {AES_ENGINE_TTABLE, AES_ENGINE_AESNI}) {
+    if (!aes_engine_supported(engine)) continue;
+    for (size_t count : {1, 3, 4, 13}) {
+      std::vector<uint8_t> keys(count * AES_128_BLOCK_LEN);
+      std::vector<uint8_t> blocks(count * AES_128_BLOCK_LEN);
+      std::vector<uint8_t> expected(count * AES_128_BLOCK_LEN);
+      std::vector<aes_128_key_schedule_t> schedules(count);
+      fill_pseudo_random(keys.data(), keys.size(), &seed);
+      fill_pseudo_random(blocks.data(), blocks.size(), &seed);
+
+      for (size_t i = 0; i < count; i++) {
+        aes_context ctx;
+        aes_set_key(&keys[i * AES_128_BLOCK_LEN], AES_128_BLOCK_LEN, &ctx);
+        aes_encrypt(&blocks[i * AES_128_BLOCK_LEN],
+                    &expected[i * AES_128_BLOCK_LEN], &ctx);
+      }
+
+      aes_128_set_keys(engine, keys.data(), schedules.data(), count);
+
+      // In place
+      aes_128_encrypt_blocks(engine, schedules.data(), blocks.data(),
+                             blocks.data(), count);
+      EXPECT_EQ(expected, blocks) << "engine " << engine << " count " << count;
+    }
+  }
+}
+
+TEST(CryptoToolboxTest, aes_128_batch_test) {
+  uint32_t seed = 2;
+  const size_t count = 21;
+  std::vector<Octet16> keys(count), messages(count), outputs(count);
+  for (size_t i = 0; i < count; i++) {
+    fill_pseudo_random(keys[i].data(), OCTET16_LEN, &seed);
+    fill_pseudo_random(messages[i].data(), OCTET16_LEN, &seed);
+  }
+
+  aes_128_batch(keys.data(), messages.data(), outputs.data(), count);
+
+  for (size_t i = 0; i < count; i++) {
+    EXPECT_EQ(reference_aes_128(keys[i], messages[i]), outputs[i]);
+    EXPECT_EQ(reference_aes_128(keys[i], messages[i]),
+              aes_128(keys[i], messages[i]));
+  }
+}
+
+TEST(CryptoToolboxTest, aes_cmac_batch_test) {
+  uint32_t seed = 3;
+  const size_t count = 11;
+  for (uint16_t length : {0, 1, 15, 16, 17, 40, 64, 65}) {
+    std::vector<Octet16> keys(count), signatures(count);
+    std::vector<std::vector<uint8_t>> messages(count);
+    std::vector<const uint8_t*> message_ptrs(count);
+    for (size_t i = 0; i < count; i++) {
+      fill_pseudo_random(keys[i].data(), OCTET16_LEN, &seed);
+      messages[i].resize(length);
+      fill_pseudo_random(messages[i].data(), length, &seed);
+      message_ptrs[i] = messages[i].data();
+    }
+
+    aes_cmac_batch(keys.data(), message_ptrs.data(), length, signatures.data(),
+                   count);
+
+    for (size_t i = 0; i < count; i++) {
+      EXPECT_EQ(aes_cmac(keys[i], messages[i].data(), length), signatures[i])
+          << "length " << length;
+    }
+  }
+}
+
 }  // namespace crypto_toolbox
@@ -0,0 +1,281 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <utility>
+#include <vector>
+
+#include "stack/btm/btm_int.h"
+#include "stack/gatt/gatt_int.h"
+#include "stack/include/l2c_api.h"
+
+using bluetooth::Uuid;
+
+tGATT_CB gatt_cb;
+
+// Require bte_logmsg.cc to run, here is just to fake it as we don't care about
+// trace in unit test
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+// Dependencies of gatt_db.cc. Values of characteristics with a UUID longer
+// than 16 bits are read from the application, which is recorded here.
+static std::list<tGATT_SRV_LIST_ELEM> app_services(1);
+static std::vector<uint16_t> app_read_handles;
+
+uint8_t gatt_build_uuid_to_stream_len(const Uuid& uuid) {
+  return uuid.GetShortestRepresentationSize();
+}
+uint8_t gatt_build_uuid_to_stream(uint8_t** p_dst, const Uuid& uuid) {
+  return 0;
+}
+std::list<tGATT_SRV_LIST_ELEM>::iterator gatt_sr_find_i_rcb_by_handle(
+    uint16_t handle) {
+  return app_services.begin();
+}
+uint32_t gatt_sr_enqueue_cmd(tGATT_TCB& tcb, uint8_t op_code,
+                             uint16_t handle) {
+  return 1;
+}
+void gatt_sr_update_cback_cnt(tGATT_TCB& tcb, tGATT_IF gatt_if, bool is_inc,
+                              bool is_reset_first) {}
+void gatt_sr_send_req_callback(uint16_t conn_id, uint32_t trans_id,
+                               uint8_t op_code, tGATTS_DATA* p_data) {
+  app_read_handles.push_back(p_data->read_req.handle);
+}
+bool BTM_GetSecurityFlags(const RawAddress& bd_addr, uint8_t* p_sec_flags) {
+  return false;
+}
+tACL_CONN* btm_bda_to_acl(const RawAddress& bda, tBT_TRANSPORT transport) {
+  return nullptr;
+}
+tBTM_STATUS btm_ble_set_encryption(const RawAddress& bd_addr,
+                                   tBTM_BLE_SEC_ACT sec_act,
+                                   uint8_t link_role) {
+  return BTM_SUCCESS;
+}
+
+namespace {
+
+const Uuid kCharDeclaration = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
+const Uuid kClientConfig = Uuid::From16Bit(GATT_UUID_CHAR_CLIENT_CONFIG);
+
+// First handle of the service and the number of handles reserved for it. Only
+// some of them are used, leaving a hole at the end of the range.
+constexpr uint16_t kStartHandle = 0x20;
+constexpr uint16_t kNumHandles = 40;
+
+}  // namespace
+
+class GattDbTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    gatts_init_service_db(db_, Uuid::From16Bit(0x180F), true, kStartHandle,
+                          kNumHandles);
+    app_read_handles.clear();
+  }
+
+  // Adds a characteristic with a 16 bit UUID and a client configuration
+  // descriptor, and returns the handle of its declaration
+  uint16_t AddCharacteristic(tGATT_SVC_DB& db, uint16_t uuid) {
+    uint16_t value_handle = gatts_add_characteristic(
+        db, GATT_PERM_READ, GATT_CHAR_PROP_BIT_READ, Uuid::From16Bit(uuid));
+    gatts_add_char_descr(db, GATT_PERM_READ | GATT_PERM_WRITE, kClientConfig);
+    return value_handle - 1;
+  }
+
+  // Returns the handles in a Read By Type response for |type| over
+  // [s_handle, e_handle], and the status in |*status|
+  std::vector<uint16_t> ReadByType(tGATT_SVC_DB& db, uint16_t s_handle,
+                                   uint16_t e_handle, const Uuid& type,
+                                   tGATT_STATUS* status) {
+    std::vector<uint8_t> buffer(sizeof(BT_HDR) + L2CAP_MIN_OFFSET +
+                                GATT_MAX_MTU_SIZE);
+    BT_HDR* p_rsp = reinterpret_cast<BT_HDR*>(buffer.data());
+    p_rsp->len = 2;
+    p_rsp->offset = 0;
+    uint16_t len = GATT_MAX_MTU_SIZE - 2;
+    uint16_t err_handle = 0;
+    *status = gatts_db_read_attr_value_by_type(
+        tcb_, &db, GATT_REQ_READ_BY_TYPE, p_rsp, s_handle, e_handle, type,
+        &len, 0, 0, 0, &err_handle);
+
+    std::vector<uint16_t> handles;
+    if (p_rsp->offset == 0) return handles;
+    uint8_t* p = buffer.data() + sizeof(BT_HDR) + L2CAP_MIN_OFFSET + 2;
+    for (int i = 0; i < (p_rsp->len - 2) / p_rsp->offset; i++) {
+      uint8_t* p_entry = p + i * p_rsp->offset;
+      uint16_t handle;
+      STREAM_TO_UINT16(handle, p_entry);
+      handles.push_back(handle);
+    }
+    return handles;
+  }
+
+  tGATT_TCB tcb_;
+  tGATT_SVC_DB db_;
+};
+
+TEST_F(GattDbTest, test_find_attr_by_handle) {
+  for (int i = 0; i < 4; i++) AddCharacteristic(db_, 0x2A00 + i);
+  ASSERT_EQ(13u, db_.attr_list.size());
+
+  for (const tGATT_ATTR& attr : db_.attr_list) {
+    EXPECT_EQ(&attr, find_attr_by_handle(&db_, attr.handle));
+  }
+  EXPECT_EQ(nullptr, find_attr_by_handle(nullptr, kStartHandle));
+
+  // Before the service, and in the unused end of its range
+  EXPECT_EQ(nullptr, find_attr_by_handle(&db_, 0));
+  EXPECT_EQ(nullptr, find_attr_by_handle(&db_, kStartHandle - 1));
+  EXPECT_EQ(nullptr, find_attr_by_handle(&db_, kStartHandle + 13));
+  EXPECT_EQ(nullptr,
+            find_attr_by_handle(&db_, kStartHandle + kNumHandles - 1));
+  EXPECT_EQ(nullptr, find_attr_by_handle(&db_, 0xFFFF));
+}
+
+TEST_F(GattDbTest, test_lower_bound) {
+  for (int i = 0; i < 4; i++) AddCharacteristic(db_, 0x2A00 + i);
+
+  EXPECT_EQ(db_.attr_list.begin(), gatts_db_lower_bound(db_, 0));
+  EXPECT_EQ(db_.attr_list.begin(),
+            gatts_db_lower_bound(db_, kStartHandle - 1));
+  EXPECT_EQ(db_.attr_list.begin(), gatts_db_lower_bound(db_, kStartHandle));
+  for (size_t i = 0; i < db_.attr_list.size(); i++) {
+    EXPECT_EQ(db_.attr_list.begin() + i,
+              gatts_db_lower_bound(db_, db_.attr_list[i].handle));
+  }
+  EXPECT_EQ(db_.attr_list.end(), gatts_db_lower_bound(db_, kStartHandle + 13));
+  EXPECT_EQ(db_.attr_list.end(), gatts_db_lower_bound(db_, 0xFFFF));
+}
+
+TEST_F(GattDbTest, test_read_by_type_range_bounds) {
+  std::vector<uint16_t> decls;
+  for (int i = 0; i < 4; i++) decls.push_back(AddCharacteristic(db_, 0x2A00));
+
+  tGATT_STATUS status;
+  EXPECT_EQ(decls, ReadByType(db_, 1, 0xFFFF, kCharDeclaration, &status));
+  EXPECT_EQ(GATT_SUCCESS, status);
+
+  // Both ends of the range are inclusive
+  EXPECT_EQ(std::vector<uint16_t>(decls.begin() + 1, decls.begin() + 3),
+            ReadByType(db_, decls[1], decls[2], kCharDeclaration, &status));
+  EXPECT_EQ(GATT_SUCCESS, status);
+  EXPECT_EQ(std::vector<uint16_t>{decls[1]},
+            ReadByType(db_, decls[1], decls[1], kCharDeclaration, &status));
+
+  // Ranges starting or ending between declarations
+  EXPECT_EQ(std::vector<uint16_t>(decls.begin() + 1, decls.begin() + 3),
+            ReadByType(db_, decls[0] + 1, decls[3] - 1, kCharDeclaration,
+                       &status));
+
+  // No declaration in the range
+  EXPECT_TRUE(
+      ReadByType(db_, decls[0] + 1, decls[1] - 1, kCharDeclaration, &status)
+          .empty());
+  EXPECT_EQ(GATT_NOT_FOUND, status);
+  EXPECT_TRUE(ReadByType(db_, decls[3] + 1, 0xFFFF, kCharDeclaration, &status)
+                  .empty());
+  EXPECT_EQ(GATT_NOT_FOUND, status);
+
+  // A type the service does not have
+  EXPECT_TRUE(ReadByType(db_, 1, 0xFFFF, Uuid::From16Bit(GATT_UUID_GAP_ICON),
+                         &status)
+                  .empty());
+  EXPECT_EQ(GATT_NOT_FOUND, status);
+}
+
+TEST_F(GattDbTest, test_read_by_type_handle_holes) {
+  std::vector<uint16_t> decls;
+  for (int i = 0; i < 2; i++) decls.push_back(AddCharacteristic(db_, 0x2A00));
+  uint16_t last_handle = db_.attr_list.back().handle;
+
+  tGATT_STATUS status;
+  EXPECT_TRUE(ReadByType(db_, 1, kStartHandle - 1, kCharDeclaration, &status)
+                  .empty());
+  EXPECT_EQ(GATT_NOT_FOUND, status);
+  EXPECT_TRUE(ReadByType(db_, last_handle + 1, kStartHandle + kNumHandles - 1,
+                         kCharDeclaration, &status)
+                  .empty());
+  EXPECT_EQ(GATT_NOT_FOUND, status);
+
+  // Ranges reaching into the holes on either side of the service
+  EXPECT_EQ(decls,
+            ReadByType(db_, 1, kStartHandle + kNumHandles + 10,
+                       kCharDeclaration, &status));
+  EXPECT_EQ(GATT_SUCCESS, status);
+}
+
+TEST_F(GattDbTest, test_read_by_type_stops_at_application_value) {
+  gatts_add_characteristic(db_, GATT_PERM_READ, GATT_CHAR_PROP_BIT_READ,
+                           Uuid::From16Bit(0x2A19));
+  const Uuid app_uuid = Uuid::From32Bit(0x12345678);
+  uint16_t first = gatts_add_characteristic(db_, GATT_PERM_READ,
+                                            GATT_CHAR_PROP_BIT_READ, app_uuid);
+  uint16_t second = gatts_add_characteristic(
+      db_, GATT_PERM_READ, GATT_CHAR_PROP_BIT_READ, app_uuid);
+
+  // Values owned by the application are read one at a time
+  tGATT_STATUS status;
+  ReadByType(db_, 1, 0xFFFF, app_uuid, &status);
+  EXPECT_EQ(GATT_PENDING, status);
+  EXPECT_EQ(std::vector<uint16_t>{first}, app_read_handles);
+
+  app_read_handles.clear();
+  ReadByType(db_, first + 1, 0xFFFF, app_uuid, &status);
+  EXPECT_EQ(GATT_PENDING, status);
+  EXPECT_EQ(std::vector<uint16_t>{second}, app_read_handles);
+
+  app_read_handles.clear();
+  ReadByType(db_, second + 1, 0xFFFF, app_uuid, &status);
+  EXPECT_EQ(GATT_NOT_FOUND, status);
+  EXPECT_TRUE(app_read_handles.empty());
+}
+
+TEST_F(GattDbTest, test_lookups_while_the_database_grows) {
+  std::vector<uint16_t> decls;
+  tGATT_STATUS status;
+  for (int i = 0; i < 8; i++) {
+    decls.push_back(AddCharacteristic(db_, 0x2A00 + i));
+    for (const tGATT_ATTR& attr : db_.attr_list) {
+      ASSERT_EQ(&attr, find_attr_by_handle(&db_, attr.handle));
+    }
+    ASSERT_EQ(nullptr,
+              find_attr_by_handle(&db_, db_.attr_list.back().handle + 1));
+    ASSERT_EQ(decls, ReadByType(db_, 1, 0xFFFF, kCharDeclaration, &status));
+  }
+}
+
+TEST_F(GattDbTest, test_lookups_after_move) {
+  std::vector<uint16_t> decls;
+  for (int i = 0; i < 4; i++) decls.push_back(AddCharacteristic(db_, 0x2A00));
+
+  tGATT_SVC_DB moved = std::move(db_);
+  for (const tGATT_ATTR& attr : moved.attr_list) {
+    EXPECT_EQ(&attr, find_attr_by_handle(&moved, attr.handle));
+  }
+  tGATT_STATUS status;
+  EXPECT_EQ(decls, ReadByType(moved, 1, 0xFFFF, kCharDeclaration, &status));
+  EXPECT_EQ(std::vector<uint16_t>(decls.begin() + 2, decls.end()),
+            ReadByType(moved, decls[2], 0xFFFF, kCharDeclaration, &status));
+
+  // The moved database keeps allocating handles in order
+  decls.push_back(AddCharacteristic(moved, 0x2A00));
+  EXPECT_EQ(decls, ReadByType(moved, 1, 0xFFFF, kCharDeclaration, &status));
+}
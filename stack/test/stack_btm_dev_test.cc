@@ -0,0 +1,424 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+#include <stdarg.h>
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "btm_ble_int.h"
+#include "btm_int.h"
+#include "device/include/controller.h"
+#include "osi/include/allocator.h"
+#include "osi/include/list.h"
+#include "stack/crypto_toolbox/crypto_toolbox.h"
+
+tBTM_CB btm_cb;
+
+// Require bte_logmsg.cc to run, here is just to fake it as we don't care about
+// trace in unit test
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+// Dependencies of btm_dev.cc that are not exercised by these tests
+tBTM_INQ_INFO* BTM_InqDbRead(const RawAddress& p_bda) { return NULL; }
+uint16_t BTM_GetHCIConnHandle(const RawAddress& remote_bda,
+                              tBT_TRANSPORT transport) {
+  return BTM_SEC_INVALID_HANDLE;
+}
+bool BTM_IsAclConnectionUp(const RawAddress& remote_bda,
+                           tBT_TRANSPORT transport) {
+  return false;
+}
+void btm_sec_clear_ble_keys(tBTM_SEC_DEV_REC* p_dev_rec) {}
+tBTM_STATUS BTM_DeleteStoredLinkKey(const RawAddress* bd_addr,
+                                    tBTM_CMPL_CB* p_cb) {
+  return BTM_SUCCESS;
+}
+const controller_t* controller_get_interface() { return NULL; }
+bool btm_is_sco_active_by_bdaddr(const RawAddress& remote_bda) {
+  return false;
+}
+
+// Fake IRK check: a record with an IRK resolves every RPA whose last octet
+// matches the first octet of its IRK.
+bool btm_ble_addr_resolvable(const RawAddress& rpa,
+                             tBTM_SEC_DEV_REC* p_dev_rec) {
+  if (!BTM_BLE_IS_RESOLVE_BDA(rpa)) return false;
+  if (!(p_dev_rec->ble.key_type & BTM_LE_KEY_PID)) return false;
+  return rpa.address[5] == p_dev_rec->ble.keys.irk[0];
+}
+
+namespace {
+
+RawAddress MakeAddress(int index) {
+  RawAddress address;
+  uint8_t octets[] = {0x00, 0x11, 0x22, (uint8_t)(index >> 16),
+                      (uint8_t)(index >> 8), (uint8_t)index};
+  address.FromOctets(octets);
+  return address;
+}
+
+// Reference implementation of the lookups, as a linear scan of the list
+tBTM_SEC_DEV_REC* LinearFindByAddress(const RawAddress& bd_addr) {
+  list_node_t* end = list_end(btm_cb.sec_dev_rec);
+  for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+       node = list_next(node)) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+    if (p_dev_rec->bd_addr == bd_addr ||
+        p_dev_rec->ble.pseudo_addr == bd_addr)
+      return p_dev_rec;
+  }
+  return NULL;
+}
+
+tBTM_SEC_DEV_REC* LinearFindByHandle(uint16_t handle) {
+  list_node_t* end = list_end(btm_cb.sec_dev_rec);
+  for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+       node = list_next(node)) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+    if (p_dev_rec->hci_handle == handle || p_dev_rec->ble_hci_handle == handle)
+      return p_dev_rec;
+  }
+  return NULL;
+}
+
+// Makes a resolvable private address for |irk| from a 22 bit |prand|
+RawAddress MakeRpa(const Octet16& irk, uint32_t prand) {
+  Octet16 message{0};
+  message[0] = prand;
+  message[1] = prand >> 8;
+  message[2] = 0x40 | ((prand >> 16) & 0x3f);
+  Octet16 hash = crypto_toolbox::aes_128(irk, message);
+
+  uint8_t octets[] = {message[2], message[1], message[0],
+                      hash[2],    hash[1],    hash[0]};
+  RawAddress rpa;
+  rpa.FromOctets(octets);
+  return rpa;
+}
+
+Octet16 MakeIrk(int index) {
+  Octet16 irk;
+  for (size_t i = 0; i < irk.size(); i++) irk[i] = index * 31 + i;
+  return irk;
+}
+
+tBTM_SEC_DEV_REC* AllocLeDevWithIrk(int index) {
+  tBTM_SEC_DEV_REC* p_dev_rec = btm_sec_alloc_dev(MakeAddress(index));
+  p_dev_rec->device_type |= BT_DEVICE_TYPE_BLE;
+  p_dev_rec->ble.key_type |= BTM_LE_KEY_PID;
+  p_dev_rec->ble.keys.irk = MakeIrk(index);
+  // As btm_sec_save_le_key() does for a new IRK
+  btm_ble_rpa_cache_flush();
+  return p_dev_rec;
+}
+
+// Reference RPA resolution: one aes_128() per record, in list order
+tBTM_SEC_DEV_REC* LinearResolve(const RawAddress& rpa) {
+  Octet16 message{0};
+  message[0] = rpa.address[2];
+  message[1] = rpa.address[1];
+  message[2] = rpa.address[0];
+  list_node_t* end = list_end(btm_cb.sec_dev_rec);
+  for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+       node = list_next(node)) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+    if (!(p_dev_rec->device_type & BT_DEVICE_TYPE_BLE) ||
+        !(p_dev_rec->ble.key_type & BTM_LE_KEY_PID))
+      continue;
+    Octet16 hash = crypto_toolbox::aes_128(p_dev_rec->ble.keys.irk, message);
+    if (hash[0] == rpa.address[5] && hash[1] == rpa.address[4] &&
+        hash[2] == rpa.address[3])
+      return p_dev_rec;
+  }
+  return NULL;
+}
+
+}  // namespace
+
+class BtmDevTest : public ::testing::Test {
+ protected:
+  void SetUp() override { btm_cb.sec_dev_rec = list_new(osi_free); }
+
+  void TearDown() override {
+    while (!list_is_empty(btm_cb.sec_dev_rec)) {
+      wipe_secrets_and_remove(
+          static_cast<tBTM_SEC_DEV_REC*>(list_front(btm_cb.sec_dev_rec)));
+    }
+    list_free(btm_cb.sec_dev_rec);
+    btm_cb.sec_dev_rec = NULL;
+  }
+};
+
+TEST_F(BtmDevTest, find_dev_by_address) {
+  tBTM_SEC_DEV_REC* p_dev_rec1 = btm_sec_alloc_dev(MakeAddress(1));
+  tBTM_SEC_DEV_REC* p_dev_rec2 = btm_sec_alloc_dev(MakeAddress(2));
+
+  EXPECT_EQ(btm_find_dev(MakeAddress(1)), p_dev_rec1);
+  EXPECT_EQ(btm_find_dev(MakeAddress(2)), p_dev_rec2);
+  EXPECT_EQ(btm_find_dev(MakeAddress(3)), nullptr);
+  EXPECT_EQ(btm_find_or_alloc_dev(MakeAddress(2)), p_dev_rec2);
+}
+
+TEST_F(BtmDevTest, find_dev_by_pseudo_and_identity_address) {
+  RawAddress pseudo_addr = MakeAddress(100);
+  RawAddress identity_addr = MakeAddress(200);
+  tBTM_SEC_DEV_REC* p_dev_rec = btm_sec_alloc_dev(pseudo_addr);
+  p_dev_rec->ble.pseudo_addr = pseudo_addr;
+  btm_dev_index_update(p_dev_rec);
+
+  // Distributing the identity address replaces bd_addr, the pseudo address
+  // keeps pointing at the same record
+  p_dev_rec->bd_addr = identity_addr;
+  btm_dev_index_update(p_dev_rec);
+  EXPECT_EQ(btm_find_dev(identity_addr), p_dev_rec);
+  EXPECT_EQ(btm_find_dev(pseudo_addr), p_dev_rec);
+
+  RawAddress new_pseudo_addr = MakeAddress(300);
+  p_dev_rec->ble.pseudo_addr = new_pseudo_addr;
+  btm_dev_index_update(p_dev_rec);
+  EXPECT_EQ(btm_find_dev(new_pseudo_addr), p_dev_rec);
+  EXPECT_EQ(btm_find_dev(pseudo_addr), nullptr);
+}
+
+TEST_F(BtmDevTest, find_dev_by_resolvable_private_address) {
+  tBTM_SEC_DEV_REC* p_dev_rec = btm_sec_alloc_dev(MakeAddress(1));
+  p_dev_rec->device_type |= BT_DEVICE_TYPE_BLE;
+  p_dev_rec->ble.key_type |= BTM_LE_KEY_PID;
+  p_dev_rec->ble.keys.irk[0] = 0x5a;
+
+  RawAddress rpa;
+  uint8_t octets[] = {0x40, 0x01, 0x02, 0x03, 0x04, 0x5a};
+  rpa.FromOctets(octets);
+  EXPECT_EQ(btm_find_dev(rpa), p_dev_rec);
+
+  octets[5] = 0x5b;
+  rpa.FromOctets(octets);
+  EXPECT_EQ(btm_find_dev(rpa), nullptr);
+}
+
+TEST_F(BtmDevTest, find_dev_keeps_list_order_for_private_address) {
+  RawAddress rpa;
+  uint8_t octets[] = {0x40, 0x01, 0x02, 0x03, 0x04, 0x5a};
+  rpa.FromOctets(octets);
+
+  // The first record resolves |rpa|, the second one has it as its address
+  tBTM_SEC_DEV_REC* p_resolving_rec = btm_sec_alloc_dev(MakeAddress(1));
+  p_resolving_rec->device_type |= BT_DEVICE_TYPE_BLE;
+  p_resolving_rec->ble.key_type |= BTM_LE_KEY_PID;
+  p_resolving_rec->ble.keys.irk[0] = 0x5a;
+  tBTM_SEC_DEV_REC* p_pseudo_rec = btm_sec_alloc_dev(MakeAddress(2));
+  p_pseudo_rec->ble.pseudo_addr = rpa;
+  btm_dev_index_update(p_pseudo_rec);
+  EXPECT_EQ(btm_find_dev(rpa), p_resolving_rec);
+
+  // A record after the match in the list does not take precedence
+  wipe_secrets_and_remove(p_resolving_rec);
+  tBTM_SEC_DEV_REC* p_later_rec = btm_sec_alloc_dev(MakeAddress(3));
+  p_later_rec->device_type |= BT_DEVICE_TYPE_BLE;
+  p_later_rec->ble.key_type |= BTM_LE_KEY_PID;
+  p_later_rec->ble.keys.irk[0] = 0x5a;
+  EXPECT_EQ(btm_find_dev(rpa), p_pseudo_rec);
+}
+
+TEST_F(BtmDevTest, find_dev_by_handle) {
+  tBTM_SEC_DEV_REC* p_dev_rec = btm_sec_alloc_dev(MakeAddress(1));
+  EXPECT_EQ(btm_find_dev_by_handle(0x0042), nullptr);
+
+  p_dev_rec->hci_handle = 0x0042;
+  btm_dev_index_update(p_dev_rec);
+  p_dev_rec->ble_hci_handle = 0x0043;
+  btm_dev_index_update(p_dev_rec);
+  EXPECT_EQ(btm_find_dev_by_handle(0x0042), p_dev_rec);
+  EXPECT_EQ(btm_find_dev_by_handle(0x0043), p_dev_rec);
+
+  // Disconnection
+  p_dev_rec->hci_handle = BTM_SEC_INVALID_HANDLE;
+  btm_dev_index_update(p_dev_rec);
+  EXPECT_EQ(btm_find_dev_by_handle(0x0042), nullptr);
+  EXPECT_EQ(btm_find_dev_by_handle(0x0043), p_dev_rec);
+}
+
+TEST_F(BtmDevTest, duplicate_keys_return_oldest_record) {
+  tBTM_SEC_DEV_REC* p_dev_rec1 = btm_sec_alloc_dev(MakeAddress(1));
+  tBTM_SEC_DEV_REC* p_dev_rec2 = btm_sec_alloc_dev(MakeAddress(1));
+  EXPECT_EQ(btm_find_dev(MakeAddress(1)), p_dev_rec1);
+
+  wipe_secrets_and_remove(p_dev_rec1);
+  EXPECT_EQ(btm_find_dev(MakeAddress(1)), p_dev_rec2);
+
+  wipe_secrets_and_remove(p_dev_rec2);
+  EXPECT_EQ(btm_find_dev(MakeAddress(1)), nullptr);
+}
+
+TEST_F(BtmDevTest, consolidate_dev_keeps_index) {
+  RawAddress identity_addr = MakeAddress(1);
+  tBTM_SEC_DEV_REC* p_classic_rec = btm_sec_alloc_dev(identity_addr);
+  p_classic_rec->hci_handle = 0x0001;
+  btm_dev_index_update(p_classic_rec);
+
+  tBTM_SEC_DEV_REC* p_le_rec = btm_sec_alloc_dev(MakeAddress(2));
+  p_le_rec->ble_hci_handle = 0x0002;
+  p_le_rec->bd_addr = identity_addr;
+  btm_dev_index_update(p_le_rec);
+
+  btm_consolidate_dev(p_le_rec);
+  EXPECT_EQ(list_length(btm_cb.sec_dev_rec), 1u);
+  EXPECT_EQ(btm_find_dev(identity_addr), p_le_rec);
+  EXPECT_EQ(btm_find_dev_by_handle(0x0001), p_le_rec);
+  EXPECT_EQ(btm_find_dev_by_handle(0x0002), p_le_rec);
+}
+
+// Churns a few hundred records through allocation, connection, disconnection,
+// address updates and removal, and checks that the indexed lookups always
+// agree with a linear scan of the list.
+TEST_F(BtmDevTest, stress_matches_linear_scan) {
+  const int kNumDevices = BTM_SEC_MAX_DEVICE_RECORDS;
+  const int kNumIterations = 20000;
+  std::mt19937 rng(42);
+  int next_address = 0;
+  uint16_t next_handle = 0;
+
+  for (int i = 0; i < kNumDevices; i++) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        btm_sec_alloc_dev(MakeAddress(next_address++));
+    p_dev_rec->hci_handle = next_handle++;
+    btm_dev_index_update(p_dev_rec);
+  }
+
+  for (int i = 0; i < kNumIterations; i++) {
+    std::vector<tBTM_SEC_DEV_REC*> records;
+    list_node_t* end = list_end(btm_cb.sec_dev_rec);
+    for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+         node = list_next(node))
+      records.push_back(static_cast<tBTM_SEC_DEV_REC*>(list_node(node)));
+    tBTM_SEC_DEV_REC* p_dev_rec = records[rng() % records.size()];
+
+    switch (rng() % 5) {
+      case 0:  // Connect
+        p_dev_rec->ble_hci_handle = (next_handle++) % 0x0F00;
+        break;
+      case 1:  // Disconnect
+        p_dev_rec->hci_handle = BTM_SEC_INVALID_HANDLE;
+        break;
+      case 2:  // Identity or pseudo address update
+        p_dev_rec->ble.pseudo_addr = p_dev_rec->bd_addr;
+        p_dev_rec->bd_addr = MakeAddress(next_address++);
+        break;
+      case 3:  // Replace the device with a new one
+        wipe_secrets_and_remove(p_dev_rec);
+        p_dev_rec = btm_sec_alloc_dev(MakeAddress(next_address++));
+        break;
+      case 4:  // Allocate past the limit, evicting the oldest record
+        p_dev_rec = btm_sec_alloc_dev(MakeAddress(next_address++));
+        break;
+    }
+    btm_dev_index_update(p_dev_rec);
+
+    RawAddress address = MakeAddress(rng() % next_address);
+    ASSERT_EQ(btm_find_dev(address), LinearFindByAddress(address));
+    uint16_t handle = rng() % (next_handle + 1);
+    ASSERT_EQ(btm_find_dev_by_handle(handle), LinearFindByHandle(handle));
+  }
+  EXPECT_LE(list_length(btm_cb.sec_dev_rec), kNumDevices + 1u);
+}
+
+TEST_F(BtmDevTest, rpa_cache_resolves_matching_irk) {
+  std::vector<tBTM_SEC_DEV_REC*> records;
+  // Enough records to span several IRK batches
+  for (int i = 0; i < 70; i++) records.push_back(AllocLeDevWithIrk(i));
+
+  for (int i = 0; i < 70; i++) {
+    RawAddress rpa = MakeRpa(MakeIrk(i), 0x1234 + i);
+    EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), records[i]);
+    // Second lookup is served from the cache
+    EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), records[i]);
+  }
+
+  // Unresolvable addresses are remembered as such
+  RawAddress rpa = MakeRpa(MakeIrk(1000), 0x1234);
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), nullptr);
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), nullptr);
+}
+
+TEST_F(BtmDevTest, rpa_cache_flushed_on_removal_and_new_irk) {
+  tBTM_SEC_DEV_REC* p_dev_rec1 = AllocLeDevWithIrk(1);
+  RawAddress rpa = MakeRpa(MakeIrk(1), 0x4242);
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), p_dev_rec1);
+
+  // A removed record must not be returned from the cache
+  wipe_secrets_and_remove(p_dev_rec1);
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), nullptr);
+
+  // Storing a new IRK flushes the cached negative result
+  tBTM_SEC_DEV_REC* p_dev_rec2 = btm_sec_alloc_dev(MakeAddress(2));
+  p_dev_rec2->device_type |= BT_DEVICE_TYPE_BLE;
+  p_dev_rec2->ble.keys.irk = MakeIrk(1);
+  p_dev_rec2->ble.key_type |= BTM_LE_KEY_PID;
+  btm_ble_rpa_cache_flush();
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), p_dev_rec2);
+}
+
+TEST_F(BtmDevTest, rpa_cache_skips_records_that_are_not_le) {
+  // Both records share an IRK, the first one is not an LE device
+  tBTM_SEC_DEV_REC* p_classic_rec = AllocLeDevWithIrk(1);
+  p_classic_rec->device_type = BT_DEVICE_TYPE_BREDR;
+  tBTM_SEC_DEV_REC* p_le_rec = AllocLeDevWithIrk(2);
+  p_le_rec->ble.keys.irk = MakeIrk(1);
+
+  RawAddress rpa = MakeRpa(MakeIrk(1), 0x0101);
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), p_le_rec);
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), p_le_rec);
+
+  // Device type changes do not flush, the first record now takes precedence
+  p_classic_rec->device_type |= BT_DEVICE_TYPE_BLE;
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), p_classic_rec);
+  p_classic_rec->device_type = BT_DEVICE_TYPE_BREDR;
+  EXPECT_EQ(btm_ble_rpa_cache_resolve(rpa), p_le_rec);
+}
+
+// Resolves a stream of RPAs, more distinct ones than the cache holds, while
+// records come and go, and checks the result against a linear evaluation.
+TEST_F(BtmDevTest, rpa_cache_matches_linear_resolution) {
+  const int kNumDevices = 40;
+  const int kNumIterations = 5000;
+  std::mt19937 rng(7);
+  int next_device = 0;
+
+  int resolved = 0;
+  for (int i = 0; i < kNumDevices; i++) AllocLeDevWithIrk(next_device++);
+
+  for (int i = 0; i < kNumIterations; i++) {
+    if (rng() % 50 == 0) {
+      wipe_secrets_and_remove(
+          static_cast<tBTM_SEC_DEV_REC*>(list_front(btm_cb.sec_dev_rec)));
+      AllocLeDevWithIrk(next_device++);
+    }
+
+    // Mostly addresses of known devices, some of them from unknown IRKs
+    int device = next_device - kNumDevices + rng() % (kNumDevices + 10);
+    RawAddress rpa = MakeRpa(MakeIrk(device), rng() % 400);
+    tBTM_SEC_DEV_REC* p_dev_rec = LinearResolve(rpa);
+    ASSERT_EQ(btm_ble_rpa_cache_resolve(rpa), p_dev_rec);
+    if (p_dev_rec != nullptr) resolved++;
+  }
+  EXPECT_GT(resolved, kNumIterations / 2);
+}
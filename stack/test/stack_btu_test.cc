@@ -22,12 +22,18 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <string>
+
 #include "btcore/include/module.h"
 #include "common/message_loop_thread.h"
 #include "osi/include/alarm.h"
+#include "osi/include/allocator.h"
 #include "osi/include/fixed_queue.h"
 #include "stack/include/btu.h"
 
@@ -125,3 +131,96 @@ TEST_F(BtuMessageLoopTest, send_message) {
   helper.wait(5, base::Bind(&BtuMessageLoopTest::Fail, base::Unretained(this),
                             "Timed out waiting for callback"));
 }
+
+static std::string read_batch_debug_dump() {
+  FILE* dump = tmpfile();
+  btu_hci_batch_debug_dump(fileno(dump));
+  rewind(dump);
+  std::string contents;
+  char buf[256];
+  while (fgets(buf, sizeof(buf), dump)) contents += buf;
+  fclose(dump);
+  return contents;
+}
+
+static uint64_t read_batch_packets() {
+  std::string dump = read_batch_debug_dump();
+  size_t pos = dump.find("Packets: ");
+  if (pos == std::string::npos) return 0;
+  return strtoull(dump.c_str() + pos + strlen("Packets: "), nullptr, 10);
+}
+
+static uint64_t packets_processed_by_task;
+
+static void record_packets_processed() {
+  packets_processed_by_task = read_batch_packets();
+}
+
+TEST_F(BtuMessageLoopTest, hci_msgs_queued_together_are_batched) {
+  message_loop = get_main_message_loop();
+  EXPECT_FALSE(message_loop == nullptr);
+
+  // Keep the main thread busy until all packets are queued
+  TimeoutHelper main_thread_blocked;
+  message_loop->task_runner()->PostTask(
+      FROM_HERE, base::Bind(&TimeoutHelper::wait,
+                            base::Unretained(&main_thread_blocked), 5,
+                            base::Closure()));
+
+  for (int i = 0; i < 10; i++) {
+    // Unknown events are freed by btu_hci_msg_process
+    BT_HDR* p_msg = (BT_HDR*)osi_calloc(sizeof(BT_HDR));
+    btu_hci_msg_enqueue(FROM_HERE, p_msg);
+  }
+  main_thread_blocked.notify();
+
+  // The second batch is posted by the first one
+  for (int i = 0; i < 2; i++) {
+    message_loop->task_runner()->PostTask(
+        FROM_HERE,
+        base::Bind(&TimeoutHelper::notify, base::Unretained(&helper)));
+    helper.wait(5, base::Bind(&BtuMessageLoopTest::Fail,
+                              base::Unretained(this),
+                              "Timed out waiting for the batches"));
+  }
+
+  // The task posted for the first packet only processes it, and the next one
+  // processes the packets queued in the meantime
+  std::string dump = read_batch_debug_dump();
+  EXPECT_NE(dump.find("Batches: 2\n"), std::string::npos) << dump;
+  EXPECT_NE(dump.find("Packets: 10\n"), std::string::npos) << dump;
+  EXPECT_NE(dump.find(" 1 -  1 : 1\n"), std::string::npos) << dump;
+  EXPECT_NE(dump.find(" 9 - 16 : 1\n"), std::string::npos) << dump;
+}
+
+TEST_F(BtuMessageLoopTest, hci_msgs_do_not_run_ahead_of_earlier_tasks) {
+  message_loop = get_main_message_loop();
+  EXPECT_FALSE(message_loop == nullptr);
+
+  TimeoutHelper main_thread_blocked;
+  message_loop->task_runner()->PostTask(
+      FROM_HERE, base::Bind(&TimeoutHelper::wait,
+                            base::Unretained(&main_thread_blocked), 5,
+                            base::Closure()));
+
+  uint64_t packets = read_batch_packets();
+  btu_hci_msg_enqueue(FROM_HERE, (BT_HDR*)osi_calloc(sizeof(BT_HDR)));
+  message_loop->task_runner()->PostTask(FROM_HERE,
+                                        base::Bind(&record_packets_processed));
+  btu_hci_msg_enqueue(FROM_HERE, (BT_HDR*)osi_calloc(sizeof(BT_HDR)));
+  main_thread_blocked.notify();
+
+  // The second batch is posted by the first one
+  for (int i = 0; i < 2; i++) {
+    message_loop->task_runner()->PostTask(
+        FROM_HERE,
+        base::Bind(&TimeoutHelper::notify, base::Unretained(&helper)));
+    helper.wait(5, base::Bind(&BtuMessageLoopTest::Fail,
+                              base::Unretained(this),
+                              "Timed out waiting for the batches"));
+  }
+
+  // The task ran after the first packet and before the second one
+  EXPECT_EQ(packets + 1, packets_processed_by_task);
+  EXPECT_EQ(packets + 2, read_batch_packets());
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "l2c_fcs.h"
+#include "l2cdefs.h"
+
+// CRC-16/ARC check value: the CRC of the ASCII string "123456789"
+TEST(L2capFcsTest, test_check_value) {
+  const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+  EXPECT_EQ(0xBB3D, l2c_fcs_calc_bytewise(L2CAP_FCR_INIT_CRC, data,
+                                          sizeof(data)));
+  EXPECT_EQ(0xBB3D, l2c_fcs_calc(L2CAP_FCR_INIT_CRC, data, sizeof(data)));
+}
+
+TEST(L2capFcsTest, test_empty_buffer) {
+  uint8_t data = 0;
+
+  EXPECT_EQ(L2CAP_FCR_INIT_CRC, l2c_fcs_calc(L2CAP_FCR_INIT_CRC, &data, 0));
+  EXPECT_EQ(0x1234, l2c_fcs_calc(0x1234, &data, 0));
+}
+
+// Compares the slicing-by-8 kernel against the byte-wise one on random frames
+// of every length up to the largest L2CAP payload, at every alignment and with
+// random starting CRCs.
+TEST(L2capFcsTest, test_matches_bytewise_on_random_frames) {
+  std::mt19937 rng(0x12cf);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> crc(0, 0xffff);
+
+  std::vector<uint8_t> data(1100);
+  for (auto& b : data) b = byte(rng);
+
+  for (uint16_t len = 0; len <= 1024; len++) {
+    const uint8_t* p = data.data() + (len % 8);
+    EXPECT_EQ(l2c_fcs_calc_bytewise(L2CAP_FCR_INIT_CRC, p, len),
+              l2c_fcs_calc(L2CAP_FCR_INIT_CRC, p, len))
+        << "len " << len;
+
+    uint16_t init = crc(rng);
+    EXPECT_EQ(l2c_fcs_calc_bytewise(init, p, len), l2c_fcs_calc(init, p, len))
+        << "len " << len << " init " << init;
+  }
+}
+
+// The FCS of a frame must not depend on how it is split between calls.
+TEST(L2capFcsTest, test_incremental_calculation) {
+  std::mt19937 rng(0x5a5a);
+  std::uniform_int_distribution<int> byte(0, 255);
+
+  std::vector<uint8_t> data(700);
+  for (auto& b : data) b = byte(rng);
+  uint16_t expected =
+      l2c_fcs_calc_bytewise(L2CAP_FCR_INIT_CRC, data.data(), data.size());
+
+  for (uint16_t split = 0; split <= data.size(); split++) {
+    uint16_t fcs = l2c_fcs_calc(L2CAP_FCR_INIT_CRC, data.data(), split);
+    fcs = l2c_fcs_calc(fcs, data.data() + split, data.size() - split);
+    EXPECT_EQ(expected, fcs) << "split " << split;
+  }
+}
+
+// Appending the FCS (little endian) to a frame yields a zero remainder, which
+// is what the receiver relies on.
+TEST(L2capFcsTest, test_residue_with_appended_fcs) {
+  std::vector<uint8_t> frame = {0x08, 0x00, 0x40, 0x00, 0x02, 0x01,
+                                0xde, 0xad, 0xbe, 0xef, 0x00, 0x11};
+  uint16_t fcs = l2c_fcs_calc(L2CAP_FCR_INIT_CRC, frame.data(), frame.size());
+  frame.push_back(fcs & 0xff);
+  frame.push_back(fcs >> 8);
+
+  EXPECT_EQ(0, l2c_fcs_calc(L2CAP_FCR_INIT_CRC, frame.data(), frame.size()));
+}
@@ -0,0 +1,228 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "l2c_sched.h"
+
+namespace {
+
+// Flows that always have packets of a fixed size to send
+class L2capSchedTest : public ::testing::Test {
+ protected:
+  void AddFlow(uint32_t quantum, uint16_t packet_len) {
+    deficits_.push_back(0);
+    quanta_.push_back(quantum);
+    packet_lens_.push_back(packet_len);
+    bytes_sent_.push_back(0);
+    packets_sent_.push_back(0);
+  }
+
+  // Sends |num_packets| packets, returns the index of the flow of each
+  std::vector<int> Run(int num_packets) {
+    std::vector<int> order;
+    for (int i = 0; i < num_packets; i++) {
+      std::vector<tL2C_SCHED_FLOW> flows = Flows();
+      int serve = l2c_sched_select(flows.data(), flows.size(), &turn_);
+      if (serve < 0) break;
+      l2c_sched_charge(&deficits_[serve], packet_lens_[serve]);
+      bytes_sent_[serve] += packet_lens_[serve];
+      packets_sent_[serve]++;
+      order.push_back(serve);
+    }
+    return order;
+  }
+
+  std::vector<tL2C_SCHED_FLOW> Flows() {
+    std::vector<tL2C_SCHED_FLOW> flows;
+    for (size_t i = 0; i < deficits_.size(); i++)
+      flows.push_back({&deficits_[i], quanta_[i]});
+    return flows;
+  }
+
+  uint8_t turn_ = 0;
+  std::vector<int32_t> deficits_;
+  std::vector<uint32_t> quanta_;
+  std::vector<uint16_t> packet_lens_;
+  std::vector<uint64_t> bytes_sent_;
+  std::vector<int> packets_sent_;
+};
+
+}  // namespace
+
+TEST_F(L2capSchedTest, test_no_flow_ready) {
+  AddFlow(0, 100);
+  AddFlow(0, 100);
+  deficits_[0] = 500;
+  deficits_[1] = -500;
+
+  std::vector<tL2C_SCHED_FLOW> flows = Flows();
+  EXPECT_EQ(-1, l2c_sched_select(flows.data(), flows.size(), &turn_));
+
+  // Credit is dropped, debts are kept
+  EXPECT_EQ(0, deficits_[0]);
+  EXPECT_EQ(-500, deficits_[1]);
+}
+
+TEST_F(L2capSchedTest, test_equal_flows_alternate) {
+  AddFlow(L2C_SCHED_QUANTUM, L2C_SCHED_QUANTUM);
+  AddFlow(L2C_SCHED_QUANTUM, L2C_SCHED_QUANTUM);
+
+  std::vector<int> order = Run(6);
+  EXPECT_EQ(std::vector<int>({0, 1, 0, 1, 0, 1}), order);
+}
+
+TEST_F(L2capSchedTest, test_byte_fairness) {
+  // A flow of small packets against a bulk transfer of large packets
+  AddFlow(L2C_SCHED_QUANTUM, 100);
+  AddFlow(L2C_SCHED_QUANTUM, 1021);
+
+  Run(10000);
+
+  EXPECT_GT(packets_sent_[0], 9 * packets_sent_[1]);
+  EXPECT_NEAR(1.0, (double)bytes_sent_[0] / bytes_sent_[1], 0.02);
+}
+
+TEST_F(L2capSchedTest, test_weighted_share) {
+  AddFlow(3 * L2C_SCHED_QUANTUM, 679);
+  AddFlow(L2C_SCHED_QUANTUM, 1021);
+
+  Run(10000);
+
+  EXPECT_NEAR(3.0, (double)bytes_sent_[0] / bytes_sent_[1], 0.06);
+}
+
+TEST_F(L2capSchedTest, test_packet_larger_than_quantum) {
+  AddFlow(L2C_SCHED_QUANTUM, 3 * L2C_SCHED_QUANTUM);
+  AddFlow(L2C_SCHED_QUANTUM, L2C_SCHED_QUANTUM);
+
+  Run(4000);
+
+  // The large packets are paid back over the next turns
+  EXPECT_NEAR(1.0, (double)bytes_sent_[0] / bytes_sent_[1], 0.01);
+  EXPECT_NEAR(3.0, (double)packets_sent_[1] / packets_sent_[0], 0.01);
+}
+
+TEST_F(L2capSchedTest, test_idle_flow_does_not_save_credit) {
+  AddFlow(L2C_SCHED_QUANTUM, 100);
+  AddFlow(L2C_SCHED_QUANTUM, 100);
+
+  // Flow 1 is idle while flow 0 sends
+  quanta_[1] = 0;
+  Run(100);
+  EXPECT_EQ(100, packets_sent_[0]);
+  EXPECT_EQ(0, packets_sent_[1]);
+
+  // Once it has data it gets its share, not a burst
+  quanta_[1] = L2C_SCHED_QUANTUM;
+  std::vector<int> order = Run(100);
+  int longest_run = 0, run = 0;
+  for (size_t i = 0; i < order.size(); i++) {
+    run = (i > 0 && order[i] == order[i - 1]) ? run + 1 : 1;
+    if (order[i] == 1 && run > longest_run) longest_run = run;
+  }
+  EXPECT_LE(longest_run, L2C_SCHED_QUANTUM / 100 + 1);
+  EXPECT_NEAR(packets_sent_[0] - 100, packets_sent_[1], 11);
+}
+
+TEST_F(L2capSchedTest, test_turn_out_of_range) {
+  AddFlow(L2C_SCHED_QUANTUM, 100);
+  turn_ = 5;
+
+  std::vector<int> order = Run(1);
+  EXPECT_EQ(std::vector<int>({0}), order);
+  EXPECT_EQ(0, turn_);
+}
+
+TEST_F(L2capSchedTest, test_media_link_share) {
+  // A link with the AV media channel against three bulk transfers
+  AddFlow(l2c_sched_link_quantum(false, true), 660);
+  for (int i = 0; i < 3; i++)
+    AddFlow(l2c_sched_link_quantum(false, false), 1021);
+
+  Run(10000);
+
+  for (int i = 1; i < 4; i++) {
+    EXPECT_NEAR(L2C_SCHED_HIGH_PRI_CHNL_WEIGHT,
+                (double)bytes_sent_[0] / bytes_sent_[i], 0.06);
+  }
+}
+
+TEST(L2capSchedQuotaTest, test_split_quota_even) {
+  // The same split as the unweighted allocation: 8 / 3, remainder first
+  const uint8_t weights[] = {1, 1, 1};
+  uint16_t quotas[3];
+  l2c_sched_split_quota(weights, quotas, 3, 8);
+  EXPECT_EQ(3, quotas[0]);
+  EXPECT_EQ(3, quotas[1]);
+  EXPECT_EQ(2, quotas[2]);
+}
+
+TEST(L2capSchedQuotaTest, test_split_quota_weighted) {
+  // A link with a high priority channel and three bulk transfers
+  const uint8_t weights[] = {1, L2C_SCHED_HIGH_PRI_CHNL_WEIGHT, 1, 1};
+  uint16_t quotas[4];
+  l2c_sched_split_quota(weights, quotas, 4, 8);
+  EXPECT_EQ(2, quotas[0]);
+  EXPECT_EQ(4, quotas[1]);
+  EXPECT_EQ(1, quotas[2]);
+  EXPECT_EQ(1, quotas[3]);
+}
+
+TEST(L2capSchedQuotaTest, test_split_quota_one_each) {
+  const uint8_t weights[] = {L2C_SCHED_HIGH_PRI_CHNL_WEIGHT, 1, 1};
+  uint16_t quotas[3];
+  l2c_sched_split_quota(weights, quotas, 3, 3);
+  EXPECT_EQ(1, quotas[0]);
+  EXPECT_EQ(1, quotas[1]);
+  EXPECT_EQ(1, quotas[2]);
+}
+
+TEST(L2capSchedStatsTest, test_queue_depth_and_wait) {
+  tL2C_SCHED_STATS stats = {};
+
+  l2c_sched_stats_queued(&stats, 1, 1000);
+  l2c_sched_stats_queued(&stats, 2, 1005);
+  l2c_sched_stats_queued(&stats, 3, 1010);
+  EXPECT_EQ(3, stats.max_queue_depth);
+
+  // The head waited 20 ms, the next one got to the head when it was sent
+  l2c_sched_stats_sent(&stats, 100, 2, 1020);
+  l2c_sched_stats_sent(&stats, 200, 1, 1050);
+  l2c_sched_stats_sent(&stats, 300, 0, 1060);
+
+  EXPECT_EQ(3u, stats.num_sent);
+  EXPECT_EQ(600u, stats.num_bytes);
+  EXPECT_EQ(3u + 2u + 1u, stats.total_queue_depth);
+  EXPECT_EQ(20u + 30u + 10u, stats.total_wait_ms);
+  EXPECT_EQ(30u, stats.max_wait_ms);
+  EXPECT_EQ(0u, stats.head_since_ms);
+}
+
+TEST(L2capSchedStatsTest, test_queue_flushed) {
+  tL2C_SCHED_STATS stats = {};
+
+  // The queue is flushed without the packets being sent
+  l2c_sched_stats_queued(&stats, 1, 1000);
+  l2c_sched_stats_queued(&stats, 1, 5000);
+  l2c_sched_stats_sent(&stats, 100, 0, 5010);
+
+  EXPECT_EQ(10u, stats.total_wait_ms);
+}
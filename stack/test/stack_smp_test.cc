@@ -16,6 +16,7 @@
  *
  ******************************************************************************/
 #include <stdarg.h>
+#include <string.h>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -291,4 +292,146 @@ TEST(SmpEccValidationTest, test_invalid_points) {
 
   EXPECT_FALSE(ECC_ValidatePoint(p));
 }
+
+// P-256 test vectors from Bluetooth Core Specification
+// Version 5.0 | Vol 2, Part G | 7.1.2
+struct EccTestVector {
+  uint32_t private_a[KEY_LENGTH_DWORDS_P256];
+  uint32_t private_b[KEY_LENGTH_DWORDS_P256];
+  uint32_t public_a_x[KEY_LENGTH_DWORDS_P256];
+  uint32_t public_a_y[KEY_LENGTH_DWORDS_P256];
+  uint32_t public_b_x[KEY_LENGTH_DWORDS_P256];
+  uint32_t public_b_y[KEY_LENGTH_DWORDS_P256];
+  uint32_t dhkey[KEY_LENGTH_DWORDS_P256];
+};
+
+static const EccTestVector ecc_test_vectors[] = {
+    // Sample 1
+    {{0xcd3c1abd, 0x5899b8a6, 0xeb40b799, 0x4aff607b,
+      0xd2103f50, 0x74c9b3e3, 0xa3c55f38, 0x3f49f6d4},
+     {0xf47fc5fd, 0x6b4fdd49, 0xf19d7cfb, 0x59cb9ac2,
+      0xeed4e72a, 0x900afcfb, 0x32f6bb9a, 0x55188b3d},
+     {0x0e359de6, 0xcc030148, 0xacf4fddb, 0xeff49111,
+      0xe9f9a5b9, 0x5e2c83a7, 0xf297be2c, 0x20b003d2},
+     {0x1589d28b, 0x741c8ed0, 0x8fed3024, 0x766345c2,
+      0x5a52155c, 0x63329abf, 0x652aeb6d, 0xdc809c49},
+     {0x2faaa190, 0x559077b2, 0x8615a69f, 0x47b58afd,
+      0xf19e4c00, 0x09592284, 0x1faf1d96, 0x1ea1f0f0},
+     {0x15b1214a, 0x5f89aff9, 0xe28e3676, 0x472d1130,
+      0x9ab85160, 0x7356703a, 0x429dad37, 0x4c55f33e},
+     {0x73bfa698, 0x868d34f3, 0xb4f866f1, 0x99796b13,
+      0x0a397d9b, 0x341010a6, 0x57c8ad05, 0xec0234a3}},
+    // Sample 2
+    {{0xd0457663, 0xb7ac73f7, 0x7203ddff, 0xb48572b9,
+      0x0c5db641, 0x6084545d, 0x3c9aa31a, 0x06a51669},
+     {0x505530ba, 0xa3caa219, 0xc60829a5, 0x7e8803b5,
+      0x73502b03, 0x97502ed4, 0x0d72cd64, 0x529aa067},
+     {0x745c78dd, 0x987e9b03, 0x4a8794cb, 0xd5f8faad,
+      0xaf5c3e43, 0xf44cb5ea, 0x5779809e, 0x2c31a47b},
+     {0x43715d4f, 0xeaf84377, 0x17bd3ed4, 0xd0211091,
+      0x8e43871f, 0xcd52e240, 0x3898dfbe, 0x91951218},
+     {0xe16500cc, 0xcf0d6cf5, 0x204796ec, 0x84dbc966,
+      0x4da87581, 0x9dc7dfc0, 0xf23d3f1b, 0xf465e43f},
+     {0xd8ecb279, 0xa8a155ca, 0xca6b4d43, 0x01c2b010,
+      0x164e33c2, 0xeeefc424, 0xbcbbd899, 0x0201d048},
+     {0x3221eb69, 0x4105c6f2, 0x5ecd1960, 0x5fe6e194,
+      0x38e30733, 0x62e5684b, 0x2f6d883f, 0xab85843a}},
+};
+
+static void make_point(Point* p, const uint32_t* x, const uint32_t* y) {
+  memcpy(p->x, x, sizeof(p->x));
+  memcpy(p->y, y, sizeof(p->y));
+  multiprecision_init(p->z, KEY_LENGTH_DWORDS_P256);
+  p->z[0] = 1;
+}
+
+TEST(SmpEccPointMultTest, test_public_keys) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  for (const auto& v : ecc_test_vectors) {
+    Point q;
+    ECC_PointMult_P256(&q, &curve_p256.G, v.private_a);
+    EXPECT_EQ(0, memcmp(q.x, v.public_a_x, sizeof(q.x)));
+    EXPECT_EQ(0, memcmp(q.y, v.public_a_y, sizeof(q.y)));
+
+    ECC_PointMult_P256(&q, &curve_p256.G, v.private_b);
+    EXPECT_EQ(0, memcmp(q.x, v.public_b_x, sizeof(q.x)));
+    EXPECT_EQ(0, memcmp(q.y, v.public_b_y, sizeof(q.y)));
+  }
+}
+
+TEST(SmpEccPointMultTest, test_dhkey) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  for (const auto& v : ecc_test_vectors) {
+    Point peer, q;
+
+    make_point(&peer, v.public_b_x, v.public_b_y);
+    ECC_PointMult_P256(&q, &peer, v.private_a);
+    EXPECT_EQ(0, memcmp(q.x, v.dhkey, sizeof(q.x)));
+
+    make_point(&peer, v.public_a_x, v.public_a_y);
+    ECC_PointMult_P256(&q, &peer, v.private_b);
+    EXPECT_EQ(0, memcmp(q.x, v.dhkey, sizeof(q.x)));
+  }
+}
+
+// The fast path must agree with the reference implementation, including
+// scalars with long runs of zero and one bits.
+TEST(SmpEccPointMultTest, test_matches_bin_naf) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  Point peer;
+  make_point(&peer, ecc_test_vectors[0].public_b_x,
+             ecc_test_vectors[0].public_b_y);
+
+  uint32_t seed = 0x12345678;
+  for (int i = 0; i < 32; i++) {
+    uint32_t n[KEY_LENGTH_DWORDS_P256];
+    for (int j = 0; j < KEY_LENGTH_DWORDS_P256; j++) {
+      seed = seed * 1103515245 + 12345;
+      n[j] = seed;
+    }
+    if (i == 0) {
+      multiprecision_init(n, KEY_LENGTH_DWORDS_P256);
+      n[0] = 1;
+    } else if (i == 1) {
+      for (int j = 0; j < KEY_LENGTH_DWORDS_P256 / 2; j++) n[j] = 0;
+    } else if (i == 2) {
+      for (int j = 0; j < KEY_LENGTH_DWORDS_P256 / 2; j++) n[j] = 0xffffffff;
+    }
+    n[KEY_LENGTH_DWORDS_P256 - 1] &= 0x7fffffff;  // Keep n below the order
+
+    for (Point* p : {&curve_p256.G, &peer}) {
+      uint32_t n_copy[KEY_LENGTH_DWORDS_P256];
+      Point expected, actual;
+
+      ECC_PointMult_P256(&actual, p, n);
+
+      memcpy(n_copy, n, sizeof(n));
+      ECC_PointMult_Bin_NAF(&expected, p, n_copy, KEY_LENGTH_DWORDS_P256);
+
+      EXPECT_EQ(0, memcmp(expected.x, actual.x, sizeof(actual.x)));
+      EXPECT_EQ(0, memcmp(expected.y, actual.y, sizeof(actual.y)));
+    }
+  }
+}
+
+// With n = order + 30 the last window adds 15 * P to 15 * P, which the
+// addition has to compute as a doubling.
+TEST(SmpEccPointMultTest, test_add_equal_points) {
+  p_256_init_curve(KEY_LENGTH_DWORDS_P256);
+  Point peer;
+  make_point(&peer, ecc_test_vectors[0].public_b_x,
+             ecc_test_vectors[0].public_b_y);
+
+  uint32_t n[KEY_LENGTH_DWORDS_P256] = {0xfc63256f, 0xf3b9cac2, 0xa7179e84,
+                                        0xbce6faad, 0xffffffff, 0xffffffff,
+                                        0x00000000, 0xffffffff};
+  uint32_t thirty[KEY_LENGTH_DWORDS_P256] = {30};
+  Point expected, actual;
+
+  ECC_PointMult_P256(&actual, &peer, n);
+  ECC_PointMult_Bin_NAF(&expected, &peer, thirty, KEY_LENGTH_DWORDS_P256);
+
+  EXPECT_EQ(0, memcmp(expected.x, actual.x, sizeof(actual.x)));
+  EXPECT_EQ(0, memcmp(expected.y, actual.y, sizeof(actual.y)));
+}
 }  // namespace testing
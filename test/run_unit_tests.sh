@@ -11,14 +11,21 @@ known_tests=(
   net_test_btcore
   net_test_bta
   net_test_btif
+  net_test_btif_a2dp_encode_ahead
+  net_test_btif_a2dp_jitter_buffer
   net_test_btif_profile_queue
+  net_test_btif_sock_thread
   net_test_device
   net_test_hci
   net_test_stack
   net_test_stack_multi_adv
   net_test_stack_ad_parser
+  net_test_stack_gatt_db
   net_test_stack_smp
+  net_test_sbc_decoder
+  net_test_sbc_encoder
   net_test_types
+  net_test_udrv_uipc_ring
   net_test_btu_message_loop
   net_test_osi
   net_test_performance
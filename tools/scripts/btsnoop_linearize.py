@@ -0,0 +1,112 @@
+#!/usr/bin/env python
+"""
+This script converts a circular btsnoop log (the "flight recorder" written
+when persist.bluetooth.btsnoopcircularsize is set) into a regular btsnoop
+log file which can be viewed using standard tools like Wireshark.
+
+The circular log is a memory-mapped file laid out as:
+
+file_header {
+  magic        "btsnpcir"
+  version      uint32_t
+  data_offset  uint32_t
+  data_size    uint64_t
+  head         uint64_t
+  tail         uint64_t
+}
+record area of data_size bytes at data_offset {
+  repeated {
+    btsnoop record_header
+    record_data
+  }
+}
+
+where all file_header fields are little endian. The records between the
+byte positions tail and head are complete; position p is found at offset
+data_offset + p % data_size, and a record may wrap around the end of the
+record area.
+"""
+
+
+import struct
+import sys
+
+
+MAGIC = b'btsnpcir'
+SUPPORTED_VERSION = 1
+FILE_HEADER_FORMAT = '<8sIIQQQ'
+RECORD_HEADER_FORMAT = '>IIIIQ'
+RECORD_HEADER_SIZE = struct.calcsize(RECORD_HEADER_FORMAT)
+BTSNOOP_FILE_HEADER = b'btsnoop\x00\x00\x00\x00\x01\x00\x00\x03\xea'
+
+
+def read_circular(data, data_offset, data_size, position, length):
+  """
+  Returns |length| bytes of the record area starting at byte |position|.
+  """
+  start = data_offset + position % data_size
+  end = start + length
+  if end <= data_offset + data_size:
+    return data[start:end]
+  first = data_offset + data_size - start
+  return data[start:] + data[data_offset:data_offset + length - first]
+
+
+def linearize(data, output):
+  """
+  Writes the records of the circular log |data|, oldest first, to |output|
+  as a btsnoop file. Returns the number of records written.
+  """
+  magic, version, data_offset, data_size, head, tail = struct.unpack_from(
+      FILE_HEADER_FORMAT, data)
+
+  if magic != MAGIC:
+    sys.stderr.write('Not a circular btsnoop log.\n')
+    sys.exit(1)
+  if version != SUPPORTED_VERSION:
+    sys.stderr.write('Unsupported circular btsnoop version: %s\n' % version)
+    sys.exit(1)
+  if len(data) < data_offset + data_size or head < tail or \
+      head - tail > data_size:
+    sys.stderr.write('Corrupted circular btsnoop log header.\n')
+    sys.exit(1)
+
+  output.write(BTSNOOP_FILE_HEADER)
+
+  count = 0
+  position = tail
+  while position + RECORD_HEADER_SIZE <= head:
+    record_header = read_circular(data, data_offset, data_size, position,
+                                  RECORD_HEADER_SIZE)
+    length_original, length_captured, flags, dropped, timestamp = \
+        struct.unpack(RECORD_HEADER_FORMAT, record_header)
+    record_size = RECORD_HEADER_SIZE + length_captured
+    if length_captured == 0 or position + record_size > head:
+      sys.stderr.write('Truncated record at position %d, stopping.\n' %
+                       position)
+      break
+    output.write(read_circular(data, data_offset, data_size, position,
+                               record_size))
+    position += record_size
+    count += 1
+
+  return count
+
+
+def main():
+  if len(sys.argv) != 3:
+    sys.stderr.write('Usage: %s <circular log> <btsnoop output>\n' %
+                     sys.argv[0])
+    sys.exit(1)
+
+  with open(sys.argv[1], 'rb') as f:
+    data = f.read()
+
+  with open(sys.argv[2], 'wb') as output:
+    count = linearize(data, output)
+
+  sys.stderr.write('Wrote %d records.\n' % count)
+
+
+if __name__ == '__main__':
+  main()
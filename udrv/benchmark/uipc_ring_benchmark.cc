@@ -0,0 +1,166 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#include "audio_a2dp_hw/include/audio_a2dp_hw.h"
+#include "uipc_ring.h"
+
+using ::benchmark::State;
+
+// Each iteration sends one audio frame to an echo thread and waits for it to
+// come back, the time per iteration is twice the one way latency of the
+// transport including the wakeup of the reader.
+
+static const int kWaitMs = 1000;
+
+static bool socket_read_all(int fd, uint8_t* p_buf, size_t len) {
+  size_t n_read = 0;
+  while (n_read < len) {
+    // poll before reading, as UIPC_Read() does
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, kWaitMs) <= 0) return false;
+
+    ssize_t n = recv(fd, p_buf + n_read, len - n_read, 0);
+    if (n <= 0) return false;
+    n_read += n;
+  }
+  return true;
+}
+
+static bool socket_write_all(int fd, const uint8_t* p_buf, size_t len) {
+  size_t sent = 0;
+  while (sent < len) {
+    ssize_t n = send(fd, p_buf + sent, len - sent, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+static bool ring_read_all(tUIPC_RING* ring, int skt_fd, uint8_t* p_buf,
+                          uint32_t len) {
+  uint32_t n_read = uipc_ring_read(ring, p_buf, len);
+  while (n_read < len) {
+    if (uipc_ring_wait_data(ring, skt_fd, kWaitMs) <= 0) return false;
+    n_read += uipc_ring_read(ring, p_buf + n_read, len - n_read);
+  }
+  return true;
+}
+
+static bool ring_write_all(tUIPC_RING* ring, int skt_fd, const uint8_t* p_buf,
+                           uint32_t len) {
+  uint32_t sent = uipc_ring_write(ring, p_buf, len);
+  while (sent < len) {
+    if (uipc_ring_wait_space(ring, skt_fd, kWaitMs) <= 0) return false;
+    sent += uipc_ring_write(ring, p_buf + sent, len - sent);
+  }
+  return true;
+}
+
+static void BM_UipcSocketRoundTrip(State& state) {
+  const size_t frame_size = state.range(0);
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    state.SkipWithError("socketpair failed");
+    return;
+  }
+  for (int fd : fds) {
+    const int size = AUDIO_STREAM_OUTPUT_BUFFER_SZ;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+
+  std::thread echo([&]() {
+    std::vector<uint8_t> buf(frame_size);
+    while (socket_read_all(fds[1], buf.data(), frame_size) &&
+           socket_write_all(fds[1], buf.data(), frame_size)) {
+    }
+  });
+
+  std::vector<uint8_t> frame(frame_size, 0x5a);
+  for (auto _ : state) {
+    if (!socket_write_all(fds[0], frame.data(), frame_size) ||
+        !socket_read_all(fds[0], frame.data(), frame_size)) {
+      state.SkipWithError("transfer failed");
+      break;
+    }
+  }
+
+  shutdown(fds[0], SHUT_RDWR);
+  echo.join();
+  close(fds[0]);
+  close(fds[1]);
+  state.SetBytesProcessed(state.iterations() * frame_size);
+}
+BENCHMARK(BM_UipcSocketRoundTrip)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Repetitions(5)
+    ->ReportAggregatesOnly(true)
+    ->UseRealTime();
+
+static void BM_UipcRingRoundTrip(State& state) {
+  const uint32_t frame_size = state.range(0);
+  tUIPC_RING to_echo, from_echo;
+  int fds[2];
+  if (!uipc_ring_create(&to_echo, AUDIO_STREAM_OUTPUT_BUFFER_SZ) ||
+      !uipc_ring_create(&from_echo, AUDIO_STREAM_OUTPUT_BUFFER_SZ) ||
+      socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    state.SkipWithError("ring setup failed");
+    return;
+  }
+
+  // the socket is only used to tell the echo thread to exit
+  std::thread echo([&]() {
+    std::vector<uint8_t> buf(frame_size);
+    while (ring_read_all(&to_echo, fds[1], buf.data(), frame_size) &&
+           ring_write_all(&from_echo, fds[1], buf.data(), frame_size)) {
+    }
+  });
+
+  std::vector<uint8_t> frame(frame_size, 0x5a);
+  for (auto _ : state) {
+    if (!ring_write_all(&to_echo, fds[0], frame.data(), frame_size) ||
+        !ring_read_all(&from_echo, fds[0], frame.data(), frame_size)) {
+      state.SkipWithError("transfer failed");
+      break;
+    }
+  }
+
+  shutdown(fds[0], SHUT_RDWR);
+  echo.join();
+  close(fds[0]);
+  close(fds[1]);
+  uipc_ring_close(&to_echo);
+  uipc_ring_close(&from_echo);
+  state.SetBytesProcessed(state.iterations() * frame_size);
+}
+BENCHMARK(BM_UipcRingRoundTrip)
+    ->Arg(512)
+    ->Arg(4096)
+    ->Repetitions(5)
+    ->ReportAggregatesOnly(true)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -18,8 +18,11 @@
 #ifndef UIPC_H
 #define UIPC_H
 
+#include <memory>
 #include <mutex>
 
+#include "uipc_ring.h"
+
 #define UIPC_CH_ID_AV_CTRL 0
 #define UIPC_CH_ID_AV_AUDIO 1
 #define UIPC_CH_NUM 2
@@ -47,6 +50,7 @@ typedef enum {
 #define UIPC_REG_CBACK 2
 #define UIPC_REG_REMOVE_ACTIVE_READSET 3
 #define UIPC_SET_READ_POLL_TMO 4
+#define UIPC_REG_RX_RING 5 /* peer sets up a shared memory ring on connect */
 
 typedef void(tUIPC_RCV_CBACK)(
     tUIPC_CH_ID ch_id,
@@ -63,6 +67,8 @@ typedef struct {
   int read_poll_tmo_ms;
   int task_evt_flags; /* event flags pending to be processed in read task */
   tUIPC_RCV_CBACK* cback;
+  bool ring_setup_pending; /* the next message is a tUIPC_RING_SETUP */
+  std::shared_ptr<tUIPC_RING> ring; /* set when the peer writes to a ring */
 } tUIPC_CHAN;
 
 struct tUIPC_STATE {
@@ -73,7 +79,7 @@ struct tUIPC_STATE {
   fd_set active_set;
   fd_set read_set;
   int max_fd;
-  int signal_fds[2];
+  int wakeup_fd; /* eventfd interrupting select() */
 
   tUIPC_CHAN ch[UIPC_CH_NUM];
 };
@@ -0,0 +1,138 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+#ifndef UIPC_RING_H
+#define UIPC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Shared memory single producer / single consumer ring for UIPC data
+ * channels.
+ *
+ * The producer creates the ring and sends a tUIPC_RING_SETUP message as the
+ * very first message on the data socket, passing the shared memory and two
+ * eventfd doorbells along with it. The consumer answers with a
+ * tUIPC_RING_ACK telling whether it attached the ring. Only once the ring is
+ * acknowledged is the data written to the ring instead of the socket, and
+ * the socket is then only used to detect that the peer went away. A doorbell
+ * is only rung when the peer announced in the shared header that it is about
+ * to wait, so a stream flowing steadily does not enter the kernel at all.
+ *
+ * The device SELinux policy, outside of this tree, must allow the bluetooth
+ * domain to use the fds of the audio HAL domain (fd use), and to read, write
+ * and map its memfd. When the kernel drops the fds instead, the consumer
+ * rejects the ring and both sides keep using the socket.
+ */
+
+#define UIPC_RING_MAGIC 0x52435055 /* "UPCR" */
+#define UIPC_RING_VERSION 1
+
+/* Upper bound of the data area, rings announcing more are rejected */
+#define UIPC_RING_MAX_SIZE (1 << 20)
+
+/* First message on a data socket. The shared memory, the data and the space
+ * doorbell are passed as SCM_RIGHTS, in that order. A size of 0 means the
+ * producer keeps writing to the socket. */
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t size; /* size of the data area, a power of two */
+} tUIPC_RING_SETUP;
+
+/* Reply of the consumer to the setup message, on the same socket. A size of
+ * 0 means the ring was not attached and the socket must be used. */
+typedef struct {
+  uint32_t magic;
+  uint32_t size; /* size of the attached data area */
+} tUIPC_RING_ACK;
+
+/* Header of the shared memory, followed by the data area. head and tail
+ * count the bytes written and read so far, and live on separate cache lines
+ * as each is written by one side only. Neither side trusts the values the
+ * other one writes. */
+struct tUIPC_RING_SHARED {
+  alignas(64) std::atomic<uint32_t> head;
+  std::atomic<uint32_t> consumer_waiting;
+  alignas(64) std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> producer_waiting;
+};
+
+typedef struct {
+  struct tUIPC_RING_SHARED* shared; /* NULL when no ring is attached */
+  uint8_t* data;
+  uint32_t size; /* local copy, the shared memory is not trusted */
+  size_t map_size;
+  int mem_fd;
+  int data_fd;  /* rung by the producer when data was written */
+  int space_fd; /* rung by the consumer when data was read */
+} tUIPC_RING;
+
+/* Marks |ring| as not attached */
+void uipc_ring_init(tUIPC_RING* ring);
+
+/* Creates a ring of at least |size| bytes. Returns true on success */
+bool uipc_ring_create(tUIPC_RING* ring, uint32_t size);
+
+/* Unmaps |ring| and closes its file descriptors */
+void uipc_ring_close(tUIPC_RING* ring);
+
+bool uipc_ring_is_attached(const tUIPC_RING* ring);
+
+/* Sends the setup message for |ring| on |skt_fd|. A NULL or detached |ring|
+ * tells the peer to keep using the socket. Returns true on success */
+bool uipc_ring_send_setup(int skt_fd, const tUIPC_RING* ring);
+
+/* Receives the setup message from |skt_fd| and attaches |ring| to the shared
+ * memory passed along. Returns 1 when the ring is attached, 0 when the peer
+ * keeps using the socket, and -1 when the socket is closed or failed */
+int uipc_ring_recv_setup(int skt_fd, tUIPC_RING* ring);
+
+/* Consumer: acknowledges the setup message on |skt_fd|, with the attached
+ * |ring| or NULL when the socket is used. Returns true on success */
+bool uipc_ring_send_ack(int skt_fd, const tUIPC_RING* ring);
+
+/* Producer: waits up to |timeout_ms| for the acknowledgement of the setup of
+ * |ring| on |skt_fd|. Returns 1 when the peer attached the ring, 0 when it
+ * keeps reading the socket, and -1 on timeout, failure or an invalid reply */
+int uipc_ring_recv_ack(int skt_fd, const tUIPC_RING* ring, int timeout_ms);
+
+/* Producer: copies up to |len| bytes into |ring|. Returns the number of bytes
+ * written, less than |len| when the ring is full */
+uint32_t uipc_ring_write(tUIPC_RING* ring, const void* p_buf, uint32_t len);
+
+/* Consumer: copies up to |len| bytes out of |ring|. Returns the number of
+ * bytes read, less than |len| when the ring runs empty */
+uint32_t uipc_ring_read(tUIPC_RING* ring, void* p_buf, uint32_t len);
+
+/* Consumer: drops all data in |ring| */
+void uipc_ring_flush(tUIPC_RING* ring);
+
+/* Consumer: waits up to |timeout_ms| for data in |ring|, or for |skt_fd| to
+ * be closed by the peer. Returns 1 when data is available, 0 on timeout and
+ * -1 when the peer went away */
+int uipc_ring_wait_data(tUIPC_RING* ring, int skt_fd, int timeout_ms);
+
+/* Producer: waits up to |timeout_ms| for free space in |ring|, or for
+ * |skt_fd| to be closed by the peer. Same return values as
+ * uipc_ring_wait_data() */
+int uipc_ring_wait_space(tUIPC_RING* ring, int skt_fd, int timeout_ms);
+
+#endif /* UIPC_RING_H */
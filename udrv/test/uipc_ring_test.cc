@@ -0,0 +1,253 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(OS_GENERIC)
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#endif  // defined(OS_GENERIC)
+
+#include "uipc_ring.h"
+
+namespace {
+
+constexpr uint32_t kRingSize = 4096;
+
+// Sends a setup message as a peer would, with |fds| passed along
+void send_setup(int skt_fd, uint32_t magic, uint32_t size,
+                const std::vector<int>& fds) {
+  tUIPC_RING_SETUP setup;
+  memset(&setup, 0, sizeof(setup));
+  setup.magic = magic;
+  setup.version = UIPC_RING_VERSION;
+  setup.size = size;
+
+  struct iovec iov;
+  iov.iov_base = &setup;
+  iov.iov_len = sizeof(setup);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  std::vector<char> cmsg_buf(CMSG_SPACE(fds.size() * sizeof(int)));
+  if (!fds.empty()) {
+    msg.msg_control = cmsg_buf.data();
+    msg.msg_controllen = cmsg_buf.size();
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+  }
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(setup)), sendmsg(skt_fd, &msg, 0));
+}
+
+}  // namespace
+
+class UipcRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+    ASSERT_TRUE(uipc_ring_create(&producer_, kRingSize));
+    uipc_ring_init(&consumer_);
+  }
+
+  void TearDown() override {
+    uipc_ring_close(&producer_);
+    uipc_ring_close(&consumer_);
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  // Returns the fds a producer passes for |producer_|
+  std::vector<int> RingFds() {
+    return {producer_.mem_fd, producer_.data_fd, producer_.space_fd};
+  }
+
+  // Receives the setup message sent on the producer end of the socket
+  int RecvSetup() { return uipc_ring_recv_setup(fds_[1], &consumer_); }
+
+  int fds_[2];
+  tUIPC_RING producer_;
+  tUIPC_RING consumer_;
+};
+
+TEST_F(UipcRingTest, test_setup) {
+  ASSERT_TRUE(uipc_ring_send_setup(fds_[0], &producer_));
+  EXPECT_EQ(1, RecvSetup());
+  EXPECT_TRUE(uipc_ring_is_attached(&consumer_));
+  EXPECT_EQ(kRingSize, consumer_.size);
+
+  const char data[] = "audio";
+  EXPECT_EQ(sizeof(data), uipc_ring_write(&producer_, data, sizeof(data)));
+  char buf[sizeof(data)];
+  EXPECT_EQ(sizeof(data), uipc_ring_read(&consumer_, buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(data, buf, sizeof(data)));
+}
+
+TEST_F(UipcRingTest, test_ack_ring) {
+  ASSERT_TRUE(uipc_ring_send_setup(fds_[0], &producer_));
+  ASSERT_EQ(1, RecvSetup());
+  ASSERT_TRUE(uipc_ring_send_ack(fds_[1], &consumer_));
+  EXPECT_EQ(1, uipc_ring_recv_ack(fds_[0], &producer_, 100));
+}
+
+TEST_F(UipcRingTest, test_ack_rejected_ring) {
+  // The fds were dropped on the way, the consumer keeps the socket
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize, {});
+  ASSERT_EQ(0, RecvSetup());
+  ASSERT_TRUE(uipc_ring_send_ack(fds_[1], nullptr));
+  EXPECT_EQ(0, uipc_ring_recv_ack(fds_[0], &producer_, 100));
+}
+
+TEST_F(UipcRingTest, test_ack_timeout) {
+  ASSERT_TRUE(uipc_ring_send_setup(fds_[0], &producer_));
+  EXPECT_EQ(-1, uipc_ring_recv_ack(fds_[0], &producer_, 10));
+}
+
+TEST_F(UipcRingTest, test_ack_wrong_size) {
+  tUIPC_RING other;
+  ASSERT_TRUE(uipc_ring_create(&other, kRingSize * 2));
+  ASSERT_TRUE(uipc_ring_send_ack(fds_[1], &other));
+  EXPECT_EQ(-1, uipc_ring_recv_ack(fds_[0], &producer_, 100));
+  uipc_ring_close(&other);
+
+  // Nor is a ring acknowledged when none was offered
+  tUIPC_RING none;
+  uipc_ring_init(&none);
+  ASSERT_TRUE(uipc_ring_send_ack(fds_[1], &producer_));
+  EXPECT_EQ(-1, uipc_ring_recv_ack(fds_[0], &none, 100));
+}
+
+TEST_F(UipcRingTest, test_setup_without_ring) {
+  ASSERT_TRUE(uipc_ring_send_setup(fds_[0], nullptr));
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+}
+
+TEST_F(UipcRingTest, test_setup_closed_socket) {
+  close(fds_[0]);
+  fds_[0] = socket(AF_UNIX, SOCK_STREAM, 0);
+  EXPECT_EQ(-1, RecvSetup());
+}
+
+TEST_F(UipcRingTest, test_setup_invalid_magic) {
+  send_setup(fds_[0], UIPC_RING_MAGIC + 1, kRingSize, RingFds());
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+}
+
+TEST_F(UipcRingTest, test_setup_invalid_size) {
+  send_setup(fds_[0], UIPC_RING_MAGIC, UIPC_RING_MAX_SIZE * 2, RingFds());
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+
+  // Larger than the shared memory
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize * 2, RingFds());
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+}
+
+TEST_F(UipcRingTest, test_setup_size_not_power_of_two) {
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize - 1, RingFds());
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+}
+
+TEST_F(UipcRingTest, test_setup_wrong_fd_count) {
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize, {});
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize,
+             {producer_.mem_fd, producer_.data_fd});
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+
+  std::vector<int> fds = RingFds();
+  fds.push_back(producer_.data_fd);
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize, fds);
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+}
+
+#if defined(OS_GENERIC)
+TEST_F(UipcRingTest, test_setup_unsealed_memory) {
+  int mem_fd = syscall(__NR_memfd_create, "uipc_ring_test", MFD_CLOEXEC);
+  ASSERT_GE(mem_fd, 0);
+  ASSERT_EQ(0, ftruncate(mem_fd, sizeof(tUIPC_RING_SHARED) + kRingSize));
+
+  send_setup(fds_[0], UIPC_RING_MAGIC, kRingSize,
+             {mem_fd, producer_.data_fd, producer_.space_fd});
+  close(mem_fd);
+  EXPECT_EQ(0, RecvSetup());
+  EXPECT_FALSE(uipc_ring_is_attached(&consumer_));
+}
+
+TEST_F(UipcRingTest, test_memory_is_sealed) {
+  EXPECT_NE(0, ftruncate(producer_.mem_fd, sizeof(tUIPC_RING_SHARED)));
+  EXPECT_NE(0, ftruncate(producer_.mem_fd,
+                         sizeof(tUIPC_RING_SHARED) + kRingSize * 2));
+}
+#endif  // defined(OS_GENERIC)
+
+TEST_F(UipcRingTest, test_index_wraparound) {
+  ASSERT_TRUE(uipc_ring_send_setup(fds_[0], &producer_));
+  ASSERT_EQ(1, RecvSetup());
+
+  // Both the 32 bit indexes and the offset in the data area wrap
+  producer_.shared->head = 0xFFFFFFFFu - kRingSize / 2;
+  producer_.shared->tail = 0xFFFFFFFFu - kRingSize / 2;
+
+  std::vector<uint8_t> data(kRingSize);
+  for (size_t i = 0; i < data.size(); i++) data[i] = i * 7;
+  std::vector<uint8_t> buf(kRingSize);
+  for (int round = 0; round < 3; round++) {
+    EXPECT_EQ(kRingSize,
+              uipc_ring_write(&producer_, data.data(), data.size()));
+    EXPECT_EQ(0u, uipc_ring_write(&producer_, data.data(), 1));
+
+    EXPECT_EQ(kRingSize / 4, uipc_ring_read(&consumer_, buf.data(),
+                                            kRingSize / 4));
+    EXPECT_EQ(kRingSize - kRingSize / 4,
+              uipc_ring_read(&consumer_, buf.data() + kRingSize / 4,
+                             kRingSize));
+    EXPECT_EQ(data, buf);
+    EXPECT_EQ(0u, uipc_ring_read(&consumer_, buf.data(), 1));
+  }
+}
+
+TEST_F(UipcRingTest, test_invalid_indexes_are_empty) {
+  ASSERT_TRUE(uipc_ring_send_setup(fds_[0], &producer_));
+  ASSERT_EQ(1, RecvSetup());
+
+  // A peer announcing more data than the ring holds
+  producer_.shared->tail = 100;
+  producer_.shared->head = 100 + kRingSize + 1;
+  uint8_t buf[16];
+  EXPECT_EQ(0u, uipc_ring_read(&consumer_, buf, sizeof(buf)));
+  EXPECT_EQ(0, uipc_ring_wait_data(&consumer_, fds_[1], 0));
+}
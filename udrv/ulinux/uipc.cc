@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/prctl.h>
@@ -188,23 +189,25 @@ static int uipc_main_init(tUIPC_STATE& uipc) {
   memset(&uipc.active_set, 0, sizeof(uipc.active_set));
   memset(&uipc.read_set, 0, sizeof(uipc.read_set));
   uipc.max_fd = 0;
-  memset(&uipc.signal_fds, 0, sizeof(uipc.signal_fds));
-  memset(&uipc.ch, 0, sizeof(uipc.ch));
 
-  /* setup interrupt socket pair */
-  if (socketpair(AF_UNIX, SOCK_STREAM, 0, uipc.signal_fds) < 0) {
+  /* setup interrupt eventfd */
+  uipc.wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (uipc.wakeup_fd < 0) {
     return -1;
   }
 
-  FD_SET(uipc.signal_fds[0], &uipc.active_set);
-  uipc.max_fd = MAX(uipc.max_fd, uipc.signal_fds[0]);
+  FD_SET(uipc.wakeup_fd, &uipc.active_set);
+  uipc.max_fd = MAX(uipc.max_fd, uipc.wakeup_fd);
 
   for (i = 0; i < UIPC_CH_NUM; i++) {
     tUIPC_CHAN* p = &uipc.ch[i];
     p->srvfd = UIPC_DISCONNECTED;
     p->fd = UIPC_DISCONNECTED;
+    p->read_poll_tmo_ms = 0;
     p->task_evt_flags = 0;
     p->cback = NULL;
+    p->ring_setup_pending = false;
+    p->ring.reset();
   }
 
   return 0;
@@ -215,8 +218,7 @@ void uipc_main_cleanup(tUIPC_STATE& uipc) {
 
   BTIF_TRACE_EVENT("uipc_main_cleanup");
 
-  close(uipc.signal_fds[0]);
-  close(uipc.signal_fds[1]);
+  close(uipc.wakeup_fd);
 
   /* close any open channels */
   for (i = 0; i < UIPC_CH_NUM; i++) uipc_close_ch_locked(uipc, i);
@@ -252,6 +254,8 @@ static int uipc_check_fd_locked(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id) {
       FD_CLR(uipc.ch[ch_id].fd, &uipc.active_set);
       uipc.ch[ch_id].fd = UIPC_DISCONNECTED;
     }
+    uipc.ch[ch_id].ring_setup_pending = false;
+    uipc.ch[ch_id].ring.reset();
 
     uipc.ch[ch_id].fd = accept_server_socket(uipc.ch[ch_id].srvfd);
 
@@ -285,18 +289,16 @@ static int uipc_check_fd_locked(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id) {
 }
 
 static void uipc_check_interrupt_locked(tUIPC_STATE& uipc) {
-  if (SAFE_FD_ISSET(uipc.signal_fds[0], &uipc.read_set)) {
-    char sig_recv = 0;
-    OSI_NO_INTR(
-        recv(uipc.signal_fds[0], &sig_recv, sizeof(sig_recv), MSG_WAITALL));
+  if (SAFE_FD_ISSET(uipc.wakeup_fd, &uipc.read_set)) {
+    eventfd_t value;
+    eventfd_read(uipc.wakeup_fd, &value);
   }
 }
 
 static inline void uipc_wakeup_locked(tUIPC_STATE& uipc) {
-  char sig_on = 1;
   BTIF_TRACE_EVENT("UIPC SEND WAKE UP");
 
-  OSI_NO_INTR(send(uipc.signal_fds[1], &sig_on, sizeof(sig_on), 0));
+  eventfd_write(uipc.wakeup_fd, 1);
 }
 
 static int uipc_setup_server_locked(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id,
@@ -342,6 +344,14 @@ static void uipc_flush_ch_locked(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id) {
     return;
   }
 
+  /* the socket only carries the setup message when a ring is used */
+  if (uipc.ch[ch_id].ring_setup_pending) return;
+
+  if (uipc.ch[ch_id].ring) {
+    uipc_ring_flush(uipc.ch[ch_id].ring.get());
+    return;
+  }
+
   while (1) {
     int ret;
     OSI_NO_INTR(ret = poll(&pfd, 1, 1));
@@ -406,6 +416,9 @@ static int uipc_close_ch_locked(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id) {
     wakeup = 1;
   }
 
+  uipc.ch[ch_id].ring_setup_pending = false;
+  uipc.ch[ch_id].ring.reset();
+
   /* notify this connection is closed */
   if (uipc.ch[ch_id].cback) uipc.ch[ch_id].cback(ch_id, UIPC_CLOSE_EVT);
 
@@ -426,6 +439,83 @@ void uipc_close_locked(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id) {
   uipc_wakeup_locked(uipc);
 }
 
+/* Receives the ring setup message of the peer connected on |fd|. Returns
+ * false until the channel is set up */
+static bool uipc_recv_ring_setup(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id,
+                                 int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  int poll_ret;
+  OSI_NO_INTR(poll_ret = poll(&pfd, 1, uipc.ch[ch_id].read_poll_tmo_ms));
+  if (poll_ret <= 0) {
+    BTIF_TRACE_WARNING("%s: no ring setup on ch %d", __func__, ch_id);
+    return false;
+  }
+
+  tUIPC_RING ring;
+  int ret = uipc_ring_recv_setup(fd, &ring);
+
+  std::lock_guard<std::recursive_mutex> lock(uipc.mutex);
+  if (uipc.ch[ch_id].fd != fd || !uipc.ch[ch_id].ring_setup_pending) {
+    /* reconnected in the meantime */
+    uipc_ring_close(&ring);
+    return false;
+  }
+
+  uipc.ch[ch_id].ring_setup_pending = false;
+  if (ret < 0) {
+    uipc_close_locked(uipc, ch_id);
+    return false;
+  }
+
+  /* the peer writes to the ring only once it is acknowledged */
+  if (!uipc_ring_send_ack(fd, ret > 0 ? &ring : nullptr)) {
+    uipc_ring_close(&ring);
+    uipc_close_locked(uipc, ch_id);
+    return false;
+  }
+
+  if (ret > 0) {
+    BTIF_TRACE_EVENT("CH %d USES A RING OF %u BYTES", ch_id, ring.size);
+    uipc.ch[ch_id].ring = std::shared_ptr<tUIPC_RING>(
+        new tUIPC_RING(ring), [](tUIPC_RING* p_ring) {
+          uipc_ring_close(p_ring);
+          delete p_ring;
+        });
+  }
+  return true;
+}
+
+/* Reads from the shared memory ring of the channel, waiting on its doorbell
+ * with the same timeout as a socket read */
+static uint32_t uipc_read_ring(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id,
+                               std::shared_ptr<tUIPC_RING> ring, int fd,
+                               uint8_t* p_buf, uint32_t len) {
+  uint32_t n_read = uipc_ring_read(ring.get(), p_buf, len);
+
+  while (n_read < len) {
+    int ret = uipc_ring_wait_data(ring.get(), fd,
+                                  uipc.ch[ch_id].read_poll_tmo_ms);
+    if (ret == 0) {
+      BTIF_TRACE_WARNING("poll timeout (%d ms)",
+                         uipc.ch[ch_id].read_poll_tmo_ms);
+      break;
+    }
+    if (ret < 0) {
+      BTIF_TRACE_WARNING("UIPC_Read : channel detached remotely");
+      std::lock_guard<std::recursive_mutex> lock(uipc.mutex);
+      if (uipc.ch[ch_id].fd == fd) uipc_close_locked(uipc, ch_id);
+      return 0;
+    }
+
+    n_read += uipc_ring_read(ring.get(), p_buf + n_read, len - n_read);
+  }
+
+  return n_read;
+}
+
 static void* uipc_read_task(void* arg) {
   tUIPC_STATE& uipc = *((tUIPC_STATE*)arg);
   int ch_id;
@@ -635,6 +725,18 @@ uint32_t UIPC_Read(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id,
     return 0;
   }
 
+  if (uipc.ch[ch_id].ring_setup_pending &&
+      !uipc_recv_ring_setup(uipc, ch_id, fd)) {
+    return 0;
+  }
+
+  std::shared_ptr<tUIPC_RING> ring;
+  {
+    std::lock_guard<std::recursive_mutex> lock(uipc.mutex);
+    ring = uipc.ch[ch_id].ring;
+  }
+  if (ring) return uipc_read_ring(uipc, ch_id, ring, fd, p_buf, len);
+
   while (n_read < (int)len) {
     pfd.fd = fd;
     pfd.events = POLLIN | POLLHUP;
@@ -725,6 +827,13 @@ extern bool UIPC_Ioctl(tUIPC_STATE& uipc, tUIPC_CH_ID ch_id, uint32_t request,
       }
       break;
 
+    case UIPC_REG_RX_RING:
+      /* peer sends a ring setup before any data */
+      if (uipc.ch[ch_id].fd != UIPC_DISCONNECTED && !uipc.ch[ch_id].ring) {
+        uipc.ch[ch_id].ring_setup_pending = true;
+      }
+      break;
+
     case UIPC_SET_READ_POLL_TMO:
       uipc.ch[ch_id].read_poll_tmo_ms = (intptr_t)param;
       BTIF_TRACE_EVENT("UIPC_SET_READ_POLL_TMO : CH %d, TMO %d ms", ch_id,
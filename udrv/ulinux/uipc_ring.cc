@@ -0,0 +1,454 @@
+/******************************************************************************
+ *
+ *  Copyright 2018 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/*****************************************************************************
+ *
+ *  Filename:      uipc_ring.cc
+ *
+ *  Description:   Shared memory ring for UIPC data channels
+ *
+ *****************************************************************************/
+
+#define LOG_TAG "bt_uipc_ring"
+
+#include "uipc_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+
+#if defined(OS_GENERIC)
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#else  // !defined(OS_GENERIC)
+#include <cutils/ashmem.h>
+#endif  // defined(OS_GENERIC)
+
+#include "osi/include/log.h"
+#include "osi/include/osi.h"
+
+#define UIPC_RING_NUM_FDS 3
+
+#if defined(OS_GENERIC)
+/* the peer must not be able to shrink the memory under our mapping */
+#define UIPC_RING_SEALS (F_SEAL_SHRINK | F_SEAL_GROW)
+#endif  // defined(OS_GENERIC)
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "ring indexes are shared between processes");
+
+/*****************************************************************************
+ *   Static functions
+ *****************************************************************************/
+
+static int ring_create_memory(size_t size) {
+#if defined(OS_GENERIC)
+  int fd = syscall(__NR_memfd_create, "uipc_ring",
+                   MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd >= 0 && (ftruncate(fd, size) < 0 ||
+                  fcntl(fd, F_ADD_SEALS, UIPC_RING_SEALS) < 0)) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+#else   // !defined(OS_GENERIC)
+  return ashmem_create_region("uipc_ring", size);
+#endif  // defined(OS_GENERIC)
+}
+
+/* makes sure the memory passed by the peer is large enough to be mapped, and
+ * stays so. ashmem regions can't be resized once they have a size. */
+static bool ring_check_memory(int fd, size_t size) {
+#if defined(OS_GENERIC)
+  struct stat st;
+  int seals = fcntl(fd, F_GET_SEALS);
+  return seals >= 0 && (seals & UIPC_RING_SEALS) == UIPC_RING_SEALS &&
+         fstat(fd, &st) == 0 && (size_t)st.st_size >= size;
+#else   // !defined(OS_GENERIC)
+  int region_size = ashmem_get_size_region(fd);
+  return region_size >= 0 && (size_t)region_size >= size;
+#endif  // defined(OS_GENERIC)
+}
+
+static bool ring_map(tUIPC_RING* ring, int mem_fd, uint32_t size) {
+  size_t map_size = sizeof(tUIPC_RING_SHARED) + size;
+  void* addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    mem_fd, 0);
+  if (addr == MAP_FAILED) {
+    LOG_ERROR(LOG_TAG, "%s: mmap failed (%s)", __func__, strerror(errno));
+    return false;
+  }
+
+  ring->shared = static_cast<tUIPC_RING_SHARED*>(addr);
+  ring->data = static_cast<uint8_t*>(addr) + sizeof(tUIPC_RING_SHARED);
+  ring->size = size;
+  ring->map_size = map_size;
+  ring->mem_fd = mem_fd;
+  return true;
+}
+
+/* number of bytes in |ring|, the indexes of a misbehaving peer are treated
+ * as an empty ring */
+static uint32_t ring_used(const tUIPC_RING* ring) {
+  uint32_t used = ring->shared->head.load(std::memory_order_acquire) -
+                  ring->shared->tail.load(std::memory_order_acquire);
+  if (used > ring->size) {
+    LOG_ERROR(LOG_TAG, "%s: invalid ring indexes", __func__);
+    return 0;
+  }
+  return used;
+}
+
+static uint64_t ring_time_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool ring_ready(const tUIPC_RING* ring, bool for_data) {
+  uint32_t used = ring_used(ring);
+  return for_data ? used > 0 : used < ring->size;
+}
+
+/* Announces that this side waits, then sleeps on its doorbell. The waiting
+ * flag is set before checking the ring once more, and the peer updates the
+ * ring before checking the flag. Both sides separate the two with a seq_cst
+ * fence, so either the peer sees the flag and rings, or its update is seen
+ * here. */
+static int ring_wait(tUIPC_RING* ring, bool for_data, int skt_fd,
+                     int timeout_ms) {
+  std::atomic<uint32_t>& waiting = for_data ? ring->shared->consumer_waiting
+                                            : ring->shared->producer_waiting;
+  struct pollfd pfd[2];
+  pfd[0].fd = for_data ? ring->data_fd : ring->space_fd;
+  pfd[0].events = POLLIN;
+  /* the peer does not write to the socket after the setup handshake, so
+   * readable means closed */
+  pfd[1].fd = skt_fd;
+  pfd[1].events = POLLIN;
+
+  uint64_t deadline = ring_time_ms() + timeout_ms;
+  int result = 0;
+  while (true) {
+    waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ring_ready(ring, for_data)) {
+      result = 1;
+      break;
+    }
+
+    uint64_t now = ring_time_ms();
+    if (now >= deadline) break;
+
+    int ret;
+    pfd[0].revents = 0;
+    pfd[1].revents = 0;
+    OSI_NO_INTR(ret = poll(pfd, skt_fd < 0 ? 1 : 2, (int)(deadline - now)));
+    if (ret < 0) {
+      LOG_ERROR(LOG_TAG, "%s: poll failed (%s)", __func__, strerror(errno));
+      break;
+    }
+    if (pfd[1].revents) {
+      result = -1;
+      break;
+    }
+    if (pfd[0].revents & POLLIN) {
+      eventfd_t value;
+      eventfd_read(pfd[0].fd, &value);
+    }
+  }
+
+  waiting.store(0, std::memory_order_relaxed);
+  return result;
+}
+
+/*****************************************************************************
+ *   Ring functions
+ *****************************************************************************/
+
+void uipc_ring_init(tUIPC_RING* ring) {
+  ring->shared = NULL;
+  ring->data = NULL;
+  ring->size = 0;
+  ring->map_size = 0;
+  ring->mem_fd = -1;
+  ring->data_fd = -1;
+  ring->space_fd = -1;
+}
+
+bool uipc_ring_create(tUIPC_RING* ring, uint32_t size) {
+  uipc_ring_init(ring);
+
+  uint32_t ring_size = 1;
+  while (ring_size < size) ring_size <<= 1;
+  if (ring_size > UIPC_RING_MAX_SIZE) return false;
+
+  int mem_fd = ring_create_memory(sizeof(tUIPC_RING_SHARED) + ring_size);
+  if (mem_fd < 0) {
+    LOG_ERROR(LOG_TAG, "%s: can't create shared memory (%s)", __func__,
+              strerror(errno));
+    return false;
+  }
+
+  if (!ring_map(ring, mem_fd, ring_size)) {
+    close(mem_fd);
+    return false;
+  }
+  new (ring->shared) tUIPC_RING_SHARED();
+
+  ring->data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  ring->space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ring->data_fd < 0 || ring->space_fd < 0) {
+    LOG_ERROR(LOG_TAG, "%s: can't create eventfd (%s)", __func__,
+              strerror(errno));
+    uipc_ring_close(ring);
+    return false;
+  }
+
+  return true;
+}
+
+void uipc_ring_close(tUIPC_RING* ring) {
+  if (ring->shared != NULL) munmap(ring->shared, ring->map_size);
+  if (ring->mem_fd >= 0) close(ring->mem_fd);
+  if (ring->data_fd >= 0) close(ring->data_fd);
+  if (ring->space_fd >= 0) close(ring->space_fd);
+  uipc_ring_init(ring);
+}
+
+bool uipc_ring_is_attached(const tUIPC_RING* ring) {
+  return ring != NULL && ring->shared != NULL;
+}
+
+bool uipc_ring_send_setup(int skt_fd, const tUIPC_RING* ring) {
+  tUIPC_RING_SETUP setup;
+  memset(&setup, 0, sizeof(setup));
+  setup.magic = UIPC_RING_MAGIC;
+  setup.version = UIPC_RING_VERSION;
+
+  struct iovec iov;
+  iov.iov_base = &setup;
+  iov.iov_len = sizeof(setup);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  char cmsg_buf[CMSG_SPACE(UIPC_RING_NUM_FDS * sizeof(int))];
+  if (uipc_ring_is_attached(ring)) {
+    setup.size = ring->size;
+
+    int fds[UIPC_RING_NUM_FDS] = {ring->mem_fd, ring->data_fd,
+                                  ring->space_fd};
+    memset(cmsg_buf, 0, sizeof(cmsg_buf));
+    msg.msg_control = cmsg_buf;
+    msg.msg_controllen = sizeof(cmsg_buf);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  }
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = sendmsg(skt_fd, &msg, MSG_NOSIGNAL));
+  if (ret != sizeof(setup)) {
+    LOG_ERROR(LOG_TAG, "%s: sendmsg failed (%s)", __func__, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int uipc_ring_recv_setup(int skt_fd, tUIPC_RING* ring) {
+  uipc_ring_init(ring);
+
+  tUIPC_RING_SETUP setup;
+  struct iovec iov;
+  iov.iov_base = &setup;
+  iov.iov_len = sizeof(setup);
+
+  char cmsg_buf[CMSG_SPACE(UIPC_RING_NUM_FDS * sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cmsg_buf;
+  msg.msg_controllen = sizeof(cmsg_buf);
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = recvmsg(skt_fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC));
+  if (ret <= 0) {
+    LOG_WARN(LOG_TAG, "%s: channel closed while waiting for setup", __func__);
+    return -1;
+  }
+
+  /* fds beyond the control buffer are closed by the kernel, and flagged */
+  int fds[UIPC_RING_NUM_FDS] = {-1, -1, -1};
+  int num_fds = 0;
+  bool extra_fds = (msg.msg_flags & MSG_CTRUNC) != 0;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    int* p_fds = (int*)CMSG_DATA(cmsg);
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; i++) {
+      if (num_fds < UIPC_RING_NUM_FDS) {
+        fds[num_fds++] = p_fds[i];
+      } else {
+        close(p_fds[i]);
+        extra_fds = true;
+      }
+    }
+  }
+
+  bool valid = ret == sizeof(setup) && setup.magic == UIPC_RING_MAGIC &&
+               setup.version == UIPC_RING_VERSION;
+  if (!valid) {
+    LOG_ERROR(LOG_TAG, "%s: invalid setup message", __func__);
+  } else if (setup.size == 0) {
+    LOG_INFO(LOG_TAG, "%s: peer uses the socket", __func__);
+  } else if (num_fds != UIPC_RING_NUM_FDS || extra_fds ||
+             setup.size > UIPC_RING_MAX_SIZE ||
+             (setup.size & (setup.size - 1)) != 0 ||
+             !ring_check_memory(fds[0],
+                                sizeof(tUIPC_RING_SHARED) + setup.size)) {
+    LOG_ERROR(LOG_TAG, "%s: invalid ring (size %u, %d fds)", __func__,
+              setup.size, num_fds);
+  } else if (ring_map(ring, fds[0], setup.size)) {
+    ring->data_fd = fds[1];
+    ring->space_fd = fds[2];
+    LOG_INFO(LOG_TAG, "%s: attached ring of %u bytes", __func__, ring->size);
+    return 1;
+  }
+
+  for (int i = 0; i < num_fds; i++) close(fds[i]);
+  return 0;
+}
+
+bool uipc_ring_send_ack(int skt_fd, const tUIPC_RING* ring) {
+  tUIPC_RING_ACK ack;
+  ack.magic = UIPC_RING_MAGIC;
+  ack.size = uipc_ring_is_attached(ring) ? ring->size : 0;
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = send(skt_fd, &ack, sizeof(ack), MSG_NOSIGNAL));
+  if (ret != sizeof(ack)) {
+    LOG_ERROR(LOG_TAG, "%s: send failed (%s)", __func__, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int uipc_ring_recv_ack(int skt_fd, const tUIPC_RING* ring, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = skt_fd;
+  pfd.events = POLLIN;
+
+  int ret;
+  OSI_NO_INTR(ret = poll(&pfd, 1, timeout_ms));
+  if (ret <= 0) {
+    LOG_ERROR(LOG_TAG, "%s: no ring acknowledgement", __func__);
+    return -1;
+  }
+
+  tUIPC_RING_ACK ack;
+  ssize_t len;
+  OSI_NO_INTR(len = recv(skt_fd, &ack, sizeof(ack), MSG_WAITALL));
+  if (len != sizeof(ack) || ack.magic != UIPC_RING_MAGIC) {
+    LOG_ERROR(LOG_TAG, "%s: invalid ring acknowledgement", __func__);
+    return -1;
+  }
+  if (ack.size == 0) return 0;
+
+  if (!uipc_ring_is_attached(ring) || ack.size != ring->size) {
+    LOG_ERROR(LOG_TAG, "%s: peer attached a ring of %u bytes", __func__,
+              ack.size);
+    return -1;
+  }
+  return 1;
+}
+
+uint32_t uipc_ring_write(tUIPC_RING* ring, const void* p_buf, uint32_t len) {
+  tUIPC_RING_SHARED* shared = ring->shared;
+  uint32_t head = shared->head.load(std::memory_order_relaxed);
+  uint32_t n = ring->size - ring_used(ring);
+  if (n > len) n = len;
+  if (n == 0) return 0;
+
+  uint32_t offset = head & (ring->size - 1);
+  uint32_t first = ring->size - offset;
+  if (first > n) first = n;
+  memcpy(ring->data + offset, p_buf, first);
+  memcpy(ring->data, (const uint8_t*)p_buf + first, n - first);
+
+  shared->head.store(head + n, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (shared->consumer_waiting.load(std::memory_order_relaxed))
+    eventfd_write(ring->data_fd, 1);
+  return n;
+}
+
+uint32_t uipc_ring_read(tUIPC_RING* ring, void* p_buf, uint32_t len) {
+  tUIPC_RING_SHARED* shared = ring->shared;
+  uint32_t tail = shared->tail.load(std::memory_order_relaxed);
+  uint32_t n = ring_used(ring);
+  if (n > len) n = len;
+  if (n == 0) return 0;
+
+  uint32_t offset = tail & (ring->size - 1);
+  uint32_t first = ring->size - offset;
+  if (first > n) first = n;
+  memcpy(p_buf, ring->data + offset, first);
+  memcpy((uint8_t*)p_buf + first, ring->data, n - first);
+
+  shared->tail.store(tail + n, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (shared->producer_waiting.load(std::memory_order_relaxed))
+    eventfd_write(ring->space_fd, 1);
+  return n;
+}
+
+void uipc_ring_flush(tUIPC_RING* ring) {
+  tUIPC_RING_SHARED* shared = ring->shared;
+  shared->tail.store(shared->head.load(std::memory_order_acquire),
+                     std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (shared->producer_waiting.load(std::memory_order_relaxed))
+    eventfd_write(ring->space_fd, 1);
+}
+
+int uipc_ring_wait_data(tUIPC_RING* ring, int skt_fd, int timeout_ms) {
+  return ring_wait(ring, true, skt_fd, timeout_ms);
+}
+
+int uipc_ring_wait_space(tUIPC_RING* ring, int skt_fd, int timeout_ms) {
+  return ring_wait(ring, false, skt_fd, timeout_ms);
+}